@@ -0,0 +1,1286 @@
+/*
+ * bench.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#define _GNU_SOURCE
+#include "simcom.h"
+#include "simcom/net.h"
+#include "simcom/gps.h"
+#include "simcom/socket.h"
+#include "simcom/utils.h"
+#include "modem_sim.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Driver figures against the simulator, one scenario per driver feature.
+ * "commands" reports percentiles of blocking commands over -n runs. Virtual
+ * mode reports modem time in ms (the cost of command timing and round-trips
+ * the driver waits for), pty mode reports wall time in us through a real
+ * tty. Most other scenarios script the simulator and run on the virtual
+ * clock only, "handoff" needs threads in real time and runs in pty mode
+ * only. Host CPU figures are taken with the process clock. The same
+ * source built against the transparent socket library is simcom_bench_stream
+ * and runs the socket throughput scenarios only.
+ *
+ *   simcom_bench [-n count] [-m virtual|pty] [-s script] [-d cmd_delay_ms] [-b scenario]
+ */
+
+#define BENCH_MAX_RUNS 10000
+
+typedef struct {
+  const char  *name;
+  void        (*run)(void);
+} Bench_t;
+
+typedef struct {
+  const char  *name;
+  void        (*run)(void);
+  uint8_t     isVirtualOnly;          // scripts the simulator from this thread
+  uint8_t     isStream;               // also run by simcom_bench_stream
+} Scenario_t;
+
+static ModemSim_t         sim;
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t       sock;
+static uint8_t            sockBuffer[1024];
+static uint8_t            sockTxBuffer[4096];
+static uint8_t            payload[64];
+static uint8_t            isPty;
+static const char         *script;
+static int                count = 1000;
+static int                cmdDelay = -1;
+static double             samples[BENCH_MAX_RUNS];
+static uint32_t           savedConfig[SIM_CONFIG_MAX];
+
+
+static double now(void)
+{
+  struct timespec ts;
+
+  if (!isPty) return ModemSim_Tick();
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+// host CPU time in ns
+static double cpuNow(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static int compare(const void *a, const void *b)
+{
+  double d = *(const double*) a - *(const double*) b;
+  return (d > 0) - (d < 0);
+}
+
+
+static void report(const char *name, double *values, int count)
+{
+  qsort(values, count, sizeof(double), compare);
+  printf("%-24s %8.1f %8.1f %8.1f %8.1f\n", name,
+         values[count * 50 / 100],
+         values[count * 90 / 100],
+         values[count * 99 / 100],
+         values[count - 1]);
+}
+
+
+static void loop(uint32_t ms)
+{
+  uint32_t end = hsim.getTick() + ms;
+
+  while ((int32_t)(hsim.getTick() - end) < 0) {
+    SIM_CheckAnyResponse(&hsim);
+    hsim.delay(1);
+  }
+}
+
+
+static uint8_t waitFor(uint8_t (*cond)(void), uint32_t ms)
+{
+  uint32_t end = hsim.getTick() + ms;
+
+  while (!cond()) {
+    if ((int32_t)(hsim.getTick() - end) >= 0) return 0;
+    loop(10);
+  }
+  return 1;
+}
+
+
+static uint8_t isRegistered(void)
+{
+  return hsim.bringUp.state == SIM_STATE_READY && (hsim.status & SIM_STATUS_REGISTERED);
+}
+
+
+static uint8_t isOnline(void)
+{
+  return SIM_NET_IS_STATUS(&hsim, SIM_NET_STATUS_OPEN) && SIM_NET_IS_STATUS(&hsim, SIM_NET_STATUS_NTP_WAS_SYNCED);
+}
+
+
+static uint8_t isSockOpen(void)
+{
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+/*
+ * Fresh modem and driver, powered on but not yet registered
+ */
+static uint8_t setUp(void)
+{
+  ModemSim_Init(&sim);
+  if (cmdDelay >= 0) sim.delay.cmd = (uint32_t) cmdDelay;
+  if (script != NULL && ModemSim_LoadScript(&sim, script) != 0) {
+    fprintf(stderr, "cannot load %s\n", script);
+    return 0;
+  }
+
+  memset(&hsim, 0, sizeof(hsim));
+  hsim.serial.device = &sim;
+  if (isPty) {
+    ModemSim_PowerOn(&sim);
+    if (ModemSim_PtyStart(&sim) != 0) {
+      fprintf(stderr, "cannot open pty\n");
+      return 0;
+    }
+    hsim.delay              = ModemSim_PtyDelay;
+    hsim.getTick            = ModemSim_PtyTick;
+    hsim.serial.isReadable  = ModemSim_PtyIsReadable;
+    hsim.serial.read        = ModemSim_PtyRead;
+    hsim.serial.write       = ModemSim_PtyWrite;
+    hsim.serial.writeline   = ModemSim_PtyWriteline;
+  }
+  else {
+    ModemSim_SetTick(0x1000);
+    ModemSim_PowerOn(&sim);
+    hsim.delay              = ModemSim_Delay;
+    hsim.getTick            = ModemSim_Tick;
+    hsim.serial.isReadable  = ModemSim_IsReadable;
+    hsim.serial.read        = ModemSim_Read;
+    hsim.serial.write       = ModemSim_Write;
+    hsim.serial.writeline   = ModemSim_Writeline;
+  }
+
+  hsim.NTP.config.retryInterval   = 10000;
+  hsim.NTP.config.resyncInterval  = 3600000;
+  SIM_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  SIM_SetNTP(&hsim, "pool.ntp.org", 28);
+  return 1;
+}
+
+
+static void tearDown(void)
+{
+  if (isPty) ModemSim_PtyStop(&sim);
+  ModemSim_Free(&sim);
+}
+
+
+static uint8_t openSocket(SIM_Socket_t *s, const char *host, uint16_t port)
+{
+  SIM_SOCK_SetBuffer(s, sockBuffer, sizeof(sockBuffer));
+  SIM_SOCK_SetTxBuffer(s, sockTxBuffer, sizeof(sockTxBuffer));
+  SIM_SOCK_Init(s, host, port);
+  s->config.autoReconnect = 1;
+  SIM_SOCK_Open(s, &hsim);
+  if (!waitFor(isSockOpen, 60000)) {
+    fprintf(stderr, "socket did not open\n");
+    return 0;
+  }
+  return 1;
+}
+
+
+static void runCheckAT(void)      { SIM_CheckAT(&hsim); }
+static void runCheckSignal(void)  { SIM_CheckSignal(&hsim); }
+static void runCheckSIMCard(void) { SIM_CheckSIMCard(&hsim); }
+static void runRegister(void)     { SIM_ReqisterNetwork(&hsim); }
+static void runGetTime(void)      { SIM_GetTime(&hsim); }
+static void runSockSend(void)     { SIM_SOCK_SendData(&sock, payload, sizeof(payload)); }
+
+static const Bench_t benches[] = {
+  {"AT",                runCheckAT},
+  {"AT+CSQ",            runCheckSignal},
+  {"AT+CPIN?",          runCheckSIMCard},
+  {"AT+CREG?",          runRegister},
+  {"AT+CCLK?",          runGetTime},
+  {"AT+CIPSEND 64B",    runSockSend},
+};
+
+
+static void benchCommands(void)
+{
+  double start;
+
+  if (!setUp()) return;
+  start = now();
+  if (!waitFor(isRegistered, 120000)) {
+    fprintf(stderr, "modem did not register\n");
+    tearDown();
+    return;
+  }
+  printf("%-24s %8.1f %s\n", "bring-up", now() - start, isPty? "us": "ms");
+  if (!openSocket(&sock, "example.com", 80)) {
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  printf("%-24s %8s %8s %8s %8s  (%s, n=%d)\n", "command", "p50", "p90", "p99", "max",
+         isPty? "us": "ms", count);
+  for (size_t b = 0; b < sizeof(benches) / sizeof(benches[0]); b++) {
+    for (int i = 0; i < count; i++) {
+      start = now();
+      benches[b].run();
+      samples[i] = now() - start;
+      // let confirmations and URC of this run settle outside the sample
+      SIM_CheckAnyResponse(&hsim);
+    }
+    report(benches[b].name, samples, count);
+    loop(200);
+  }
+  tearDown();
+}
+
+
+/*
+ * AT+CSQ while the line at 115200 also carries socket payload and NMEA.
+ * The driver parses them as URC on the control channel, CMUX or not, so
+ * the command waits for whatever is on the line ahead of its answer.
+ */
+static void benchCommandsUnderLoad(void)
+{
+  static const char nmea[] =
+    "$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*76";
+  uint8_t data[1024];
+  double start;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  memset(data, 'x', sizeof(data));
+  if (!waitFor(isRegistered, 120000) || !openSocket(&sock, "example.com", 80)) {
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  printf("%-24s %8s %8s %8s %8s  (ms, n=%d)\n", "AT+CSQ at 115200", "p50", "p90", "p99", "max", count);
+  for (int i = 0; i < count; i++) {
+    start = now();
+    SIM_CheckSignal(&hsim);
+    samples[i] = now() - start;
+    loop(10);
+  }
+  report("idle", samples, count);
+
+  for (int i = 0; i < count; i++) {
+    ModemSim_PeerSend(&sim, sock.linkNum, data, sizeof(data));
+    ModemSim_URC(&sim, 0, nmea);
+    // command goes out at a different point of the 90 ms burst each run
+    loop(i % 100);
+    start = now();
+    SIM_CheckSignal(&hsim);
+    samples[i] = now() - start;
+    loop(100);
+  }
+  report("1 KB socket + NMEA", samples, count);
+  tearDown();
+}
+
+
+/*
+ * Commands of SIM_GPS_DefaultSetup and of the health poll, one line per
+ * command as before batching against one line for all of them
+ */
+static const char *gpsSetup[] = {
+  "+CGPSHOR=50", "+CGPSNMEARATE=0", "+CGPSXDAUTO=1", "+CGPSINFOCFG=5,31",
+  "+CGPSMD=1", "+CGPSURL=\"supl.google.com:7276\"", "+CGPSSSL=0", "+CVAUXV=3050",
+  "+CVAUXS=1",
+};
+static const char *healthPoll[] = {"+CSQ", "+CREG?", "+CGREG?"};
+
+static void runBatch(const char *name, const char **cmds, int num)
+{
+  SIM_Batch_t batch;
+  double start, single, batched;
+  uint32_t commands;
+
+  commands = sim.commands;
+  start = now();
+  for (int i = 0; i < num; i++) {
+    SIM_BatchInit(&batch);
+    SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "%s", cmds[i]);
+    SIM_BatchExec(&hsim, &batch, 0);
+  }
+  single = now() - start;
+  printf("%-24s %8u %8.1f\n", name, sim.commands - commands, single);
+
+  commands = sim.commands;
+  start = now();
+  SIM_BatchInit(&batch);
+  for (int i = 0; i < num; i++)
+    SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "%s", cmds[i]);
+  SIM_BatchExec(&hsim, &batch, 0);
+  batched = now() - start;
+  printf("%-24s %8u %8.1f  (%.1f saved)\n", "  batched", sim.commands - commands, batched, single - batched);
+}
+
+
+static void benchBatch(void)
+{
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  loop(1000);
+
+  printf("%-24s %8s %8s  (115200, %u ms per command)\n", "", "lines", "ms", sim.delay.cmd);
+  runBatch("GPS setup", gpsSetup, sizeof(gpsSetup) / sizeof(gpsSetup[0]));
+  runBatch("health poll", healthPoll, sizeof(healthPoll) / sizeof(healthPoll[0]));
+  tearDown();
+}
+
+
+/*
+ * Cost of one SIM_CheckAnyResponse with nothing on the line and nothing
+ * pending, the pass a firmware main loop repeats most of the time
+ */
+static void benchIdle(void)
+{
+  double start;
+
+  if (!setUp()) return;
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  loop(5000);
+
+  printf("%-24s %8s %8s %8s %8s  (ns per pass, n=%d x 1000)\n", "idle loop", "p50", "p90", "p99", "max", count);
+  for (int i = 0; i < count; i++) {
+    start = cpuNow();
+    for (int j = 0; j < 1000; j++)
+      SIM_CheckAnyResponse(&hsim);
+    samples[i] = (cpuNow() - start) / 1000;
+  }
+  report("SIM_CheckAnyResponse", samples, count);
+  tearDown();
+}
+
+
+static uint32_t loadConfig(SIM_HandlerTypeDef *h, SIM_Config_t config)
+{
+  (void) h;
+  return savedConfig[config];
+}
+
+
+static void saveConfig(SIM_HandlerTypeDef *h, SIM_Config_t config, uint32_t fingerprint)
+{
+  (void) h;
+  savedConfig[config] = fingerprint;
+}
+
+
+/*
+ * Power-on to data online with NTP synced and GPS set up. Cold boot sends
+ * every setting, as each boot did while RDY dropped the fingerprints. Warm
+ * boot powers modem and driver on again with fingerprints kept by the host.
+ */
+static void benchBoot(void)
+{
+  const char *names[] = {"cold boot", "warm boot"};
+  double start;
+  uint32_t commands;
+
+  memset(savedConfig, 0, sizeof(savedConfig));
+  printf("%-24s %8s %8s\n", "boot to online", "lines", "ms");
+  for (int i = 0; i < 2; i++) {
+    if (!setUp()) return;
+    hsim.loadConfig = loadConfig;
+    hsim.saveConfig = saveConfig;
+    start = now();
+    commands = sim.commands;
+    if (!waitFor(isOnline, 120000) || SIM_GPS_DefaultSetup(&hsim) != SIM_OK) {
+      fprintf(stderr, "modem did not get online\n");
+      tearDown();
+      return;
+    }
+    printf("%-24s %8u %8.1f\n", names[i], sim.commands - commands, now() - start);
+    tearDown();
+  }
+}
+
+
+/*
+ * Bring-up as SIM_HandleEvents did it before the state machine, from the
+ * loop of the application: sleep 3 s after a failed step, 2 more while
+ * the modem is searching
+ */
+static void blockingBringUp(void)
+{
+  if (!SIM_CheckSIMCard(&hsim)) {
+    hsim.delay(3000);
+    return;
+  }
+  if (!SIM_ReqisterNetwork(&hsim)) {
+    if (sim.creg == 2) hsim.delay(2000);
+    hsim.delay(3000);
+  }
+}
+
+
+/*
+ * SIM card ready 3 s after power-on, network some seconds later. Time
+ * until data online and the longest single pass of the application loop.
+ */
+static void runBringUp(const char *name, uint8_t isBlocking, uint32_t regAt)
+{
+  double start, pass, stall = 0;
+
+  if (!setUp()) return;
+  sim.simReady = 0;
+  sim.creg = 2;
+  sim.cgreg = 2;
+  start = now();
+  while (!SIM_NET_IS_STATUS(&hsim, SIM_NET_STATUS_OPEN)) {
+    if (!sim.simReady && now() - start >= 3000) sim.simReady = 1;
+    if (sim.creg != 1 && now() - start >= regAt) ModemSim_SetReg(&sim, 1);
+    if (now() - start > 120000) {
+      fprintf(stderr, "modem did not get online\n");
+      break;
+    }
+
+    pass = now();
+    SIM_CheckAnyResponse(&hsim);
+    if (isBlocking && hsim.bringUp.state != SIM_STATE_READY) blockingBringUp();
+    if (now() - pass > stall) stall = now() - pass;
+    hsim.delay(1);
+  }
+  printf("%-18s %5.1f s %8.1f %8.1f\n", name, regAt / 1000.0, now() - start, stall);
+  tearDown();
+}
+
+
+static void benchBringUp(void)
+{
+  static const uint32_t regAt[] = {4000, 6000, 8000};
+
+  printf("%-24s %8s %8s  (ms, SIM at 3 s, network at)\n", "bring-up", "online", "stall");
+  for (size_t i = 0; i < sizeof(regAt) / sizeof(regAt[0]); i++) {
+    runBringUp("sleeping retries", 1, regAt[i]);
+    runBringUp("scheduled retries", 0, regAt[i]);
+  }
+}
+
+
+/*
+ * Lines as the modem sends them while idle with GPS on, most of them NMEA
+ */
+static const char *urcLines[] = {
+  "$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*76\r\n",
+  "$GPRMC,092750.000,A,5321.6802,N,00630.3372,W,0.02,31.66,280511,,,A*43\r\n",
+  "$GPGSV,3,1,11,10,63,137,17,07,61,098,15,05,59,290,20,08,54,157,30*70\r\n",
+  "$GPGSA,A,3,10,07,05,02,29,04,08,13,,,,,1.72,1.03,1.38*0A\r\n",
+  "$GPVTG,31.66,T,,M,0.02,N,0.04,K,A*3F\r\n",
+  "+CREG: 1,\"1A2B\",\"0C3D4E5F\"\r\n",
+  "+CGREG: 1,\"1A2B\",\"0C3D4E5F\"\r\n",
+  "+CTZV: +28,0\r\n",
+  "SMS DONE\r\n",
+};
+
+
+// every registered prefix compared in order, as the strncmp cascade did
+static uint8_t dispatchLinear(SIM_HandlerTypeDef *h)
+{
+  SIM_URC_t *urc;
+
+  for (uint8_t i = 0; i < h->urc.count; i++) {
+    urc = &h->urc.handlers[i];
+    if (strncmp((const char*) h->respBuffer, urc->prefix, urc->prefixLen) == 0 && urc->handler(h))
+      return 1;
+  }
+  return 0;
+}
+
+
+static void runDispatch(const char *name, uint8_t (*dispatch)(SIM_HandlerTypeDef*))
+{
+  const int num = sizeof(urcLines) / sizeof(urcLines[0]);
+  double start;
+
+  for (int i = 0; i < count; i++) {
+    start = cpuNow();
+    for (int j = 0; j < 1000; j++) {
+      const char *line = urcLines[j % num];
+      hsim.respBufferLen = (uint16_t) strlen(line);
+      memcpy(hsim.respBuffer, line, hsim.respBufferLen + 1);
+      dispatch(&hsim);
+    }
+    samples[i] = 1000 / ((cpuNow() - start) / 1e9) / 1e6;
+  }
+  report(name, samples, count);
+}
+
+
+static void benchDispatch(void)
+{
+  if (!setUp()) return;
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  loop(1000);
+
+  printf("%-24s %8s %8s %8s %8s  (M lines/s, %u prefixes, n=%d x 1000)\n",
+         "URC dispatch", "p50", "p90", "p99", "max", hsim.urc.count, count);
+  runDispatch("prefix cascade", dispatchLinear);
+  runDispatch("first-char table", SIM_DispatchURC);
+  tearDown();
+}
+
+
+/*
+ * Response lines the modules parse, fields after the "+XXX: " prefix
+ */
+static const struct {
+  const char  *line;
+  uint8_t     start;
+  uint8_t     fields;
+} respLines[] = {
+  {"+HTTPACTION: 0,200,1024\r\n",                13, 3},
+  {"+RECEIVE,0,512\r\n",                          9,  2},
+  {"+CIPCLOSE: 1,0,0,0,0,0,0,0,0,0\r\n",          11, 10},
+  {"+CREG: 2,1,\"1A2B\",\"0C3D4E5F\"\r\n",         7,  4},
+  {"+CSQ: 20,99\r\n",                             6,  2},
+  {"+CCLK: \"26/10/17,09:00:00+28\"\r\n",           7,  1},
+};
+static volatile int32_t parsed;
+
+
+// each field found again from the line start, copied out, then converted
+static void parseCopy(const uint8_t *str, uint8_t fields)
+{
+  uint8_t field[32];
+
+  for (uint8_t i = 0; i < fields; i++) {
+    SIM_ParseStr(str, ',', i, field);
+    parsed += atoi((const char*) field);
+  }
+}
+
+
+static void parseTokens(const uint8_t *str, uint8_t fields)
+{
+  SIM_Tokens_t tokens;
+
+  SIM_Tokenize(&tokens, str, (uint16_t) strlen((const char*) str), ',');
+  for (uint8_t i = 0; i < fields; i++)
+    parsed += SIM_TokenInt(&tokens, i);
+}
+
+
+static void runParse(const char *name, void (*parse)(const uint8_t*, uint8_t))
+{
+  const int num = sizeof(respLines) / sizeof(respLines[0]);
+  double start;
+
+  for (int i = 0; i < count; i++) {
+    start = cpuNow();
+    for (int j = 0; j < 1000; j++)
+      parse((const uint8_t*) respLines[j % num].line + respLines[j % num].start, respLines[j % num].fields);
+    samples[i] = (cpuNow() - start) / 1000;
+  }
+  report(name, samples, count);
+}
+
+
+static void benchParse(void)
+{
+  printf("%-24s %8s %8s %8s %8s  (ns per line, n=%d x 1000)\n", "response parse", "p50", "p90", "p99", "max", count);
+  runParse("SIM_ParseStr + atoi", parseCopy);
+  runParse("SIM_Tokenize", parseTokens);
+}
+
+
+static pthread_mutex_t eventMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  eventCond = PTHREAD_COND_INITIALIZER;
+static volatile double lockedAt;
+
+
+static void waitEvent(SIM_HandlerTypeDef *h, uint32_t timeout)
+{
+  struct timespec ts;
+
+  (void) h;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  ts.tv_sec += timeout / 1000;
+  ts.tv_nsec += (long) (timeout % 1000) * 1000000;
+  if (ts.tv_nsec >= 1000000000) {
+    ts.tv_sec++;
+    ts.tv_nsec -= 1000000000;
+  }
+  pthread_mutex_lock(&eventMutex);
+  if (hsim.status & SIM_STATUS_CMD_RUNNING)
+    pthread_cond_timedwait(&eventCond, &eventMutex, &ts);
+  pthread_mutex_unlock(&eventMutex);
+}
+
+
+static void notifyEvent(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  pthread_mutex_lock(&eventMutex);
+  pthread_cond_broadcast(&eventCond);
+  pthread_mutex_unlock(&eventMutex);
+}
+
+
+// application task blocked on the lock, then its command
+static void *waiterTask(void *arg)
+{
+  (void) arg;
+  SIM_CheckSignal(&hsim);
+  lockedAt = now();
+  return NULL;
+}
+
+
+static void runHandoff(const char *name, uint8_t isEvent)
+{
+  pthread_t waiter;
+  double cpu, idle, released;
+
+  if (!setUp()) return;
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  loop(1000);
+  hsim.waitEvent = isEvent? waitEvent: NULL;
+  hsim.notifyEvent = isEvent? notifyEvent: NULL;
+
+  idle = 0;
+  for (int i = 0; i < count; i++) {
+    // other task holds the driver for 5 ms
+    hsim.mutexLock(&hsim);
+    pthread_create(&waiter, NULL, waiterTask, NULL);
+    cpu = cpuNow();
+    usleep(5000);
+    idle += cpuNow() - cpu;
+    released = now();
+    hsim.mutexUnlock(&hsim);
+    pthread_join(waiter, NULL);
+    samples[i] = lockedAt - released;
+  }
+
+  report(name, samples, count);
+  printf("%-24s %8.1f us CPU per 5 ms wait\n", "", idle / 1e3 / count);
+  tearDown();
+}
+
+
+/*
+ * Another task holds the driver through the default mutexLock while the
+ * application calls SIM_CheckSignal. Time from unlock until the command
+ * is done, and CPU the process burns while the application waits. Lock
+ * waits poll with delay(1) without hooks, or block until notified with them.
+ * Run with -d 0 so the command itself is only the pty round-trip.
+ */
+static void benchHandoff(void)
+{
+  if (!isPty) {
+    printf("needs -m pty, threads wait in real time\n");
+    return;
+  }
+  printf("%-24s %8s %8s %8s %8s  (us from unlock to AT+CSQ done, n=%d)\n",
+         "lock handoff", "p50", "p90", "p99", "max", count);
+  runHandoff("delay(1) poll", 0);
+  runHandoff("wait/notify hooks", 1);
+}
+
+
+static uint8_t   rxData[64 * 1024];
+static uint32_t rxLen;
+
+
+// copied out of the socket buffer, the second copy
+static void onReceivedCopy(Buffer_t *buffer)
+{
+  uint32_t space;
+  uint16_t len;
+
+  do {
+    space = sizeof(rxData) - rxLen % sizeof(rxData);
+    len = Buffer_Read(buffer, &rxData[rxLen % sizeof(rxData)], (uint16_t) (space > 1024? 1024: space));
+    rxLen += len;
+  } while (len);
+}
+
+
+// straight from the RX line buffer to where it is used
+static void onDataSink(const uint8_t *data, uint16_t len)
+{
+  if (rxLen + len <= sizeof(rxData)) memcpy(&rxData[rxLen], data, len);
+  rxLen += len;
+}
+
+
+static void runReceive(const char *name, uint32_t byteTime, uint8_t isSink)
+{
+  uint8_t chunk[1024];
+  double start, cpu;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = byteTime;
+  memset(&sock, 0, sizeof(sock));
+  if (isSink) sock.listeners.onData = onDataSink;
+  else        sock.listeners.onReceived = onReceivedCopy;
+  if (!waitFor(isRegistered, 120000) || !openSocket(&sock, "example.com", 80)) {
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  memset(chunk, 'x', sizeof(chunk));
+  rxLen = 0;
+  start = now();
+  cpu = cpuNow();
+  for (uint32_t i = 0; i < sizeof(rxData) / sizeof(chunk); i++)
+    ModemSim_PeerSend(&sim, sock.linkNum, chunk, sizeof(chunk));
+  while (rxLen < sizeof(rxData) && now() - start < 60000) {
+    SIM_CheckAnyResponse(&hsim);
+    hsim.delay(1);
+  }
+  cpu = cpuNow() - cpu;
+  printf("%-24s %8.1f %8.1f %8u\n", name, rxLen / (now() - start), cpu / rxLen, rxLen);
+  tearDown();
+}
+
+
+/*
+ * 64 KB from the peer in 1 KB +RECEIVE chunks over a serial line at
+ * 115200 and 921600. Line throughput and host CPU per byte, through the
+ * socket buffer and onReceived, or through onData.
+ */
+static void benchReceive(void)
+{
+  printf("%-24s %8s %8s %8s\n", "socket receive", "KB/s", "ns/B", "bytes");
+  runReceive("115200 onReceived", 87, 0);
+  runReceive("115200 onData", 87, 1);
+  runReceive("921600 onReceived", 11, 0);
+  runReceive("921600 onData", 11, 1);
+}
+
+
+static uint32_t sentLen;
+
+
+static void onSent(uint16_t len)
+{
+  sentLen += len;
+}
+
+
+static void runSend(uint16_t size, uint8_t isQueued)
+{
+  const int num = 200;
+  uint8_t msg[512];
+  double start;
+  uint32_t commands;
+  int i = 0;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  memset(&sock, 0, sizeof(sock));
+  sock.listeners.onSent = onSent;
+  if (!waitFor(isRegistered, 120000) || !openSocket(&sock, "example.com", 80)) {
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  memset(msg, 'x', size);
+  sentLen = 0;
+  commands = sim.commands;
+  start = now();
+  if (!isQueued) {
+    for (i = 0; i < num; i++) SIM_SOCK_SendData(&sock, msg, size);
+  }
+  else {
+    // as fast as the queue takes them
+    while (sentLen < (uint32_t) num * size && now() - start < 120000) {
+      while (i < num && SIM_SOCK_Write(&sock, msg, size) == size) i++;
+      SIM_CheckAnyResponse(&hsim);
+      hsim.delay(1);
+    }
+  }
+  printf("%-18s %4u B %8.1f %8u\n", isQueued? "SIM_SOCK_Write": "SIM_SOCK_SendData",
+         size, num / ((now() - start) / 1000), sim.commands - commands);
+  tearDown();
+}
+
+
+/*
+ * 200 messages at 115200 with 50 ms until +CIPSEND, one stop-and-wait
+ * CIPSEND per message against the coalescing, pipelined queue
+ */
+static void benchSend(void)
+{
+  printf("%-24s %8s %8s\n", "socket send", "msg/s", "lines");
+  runSend(32, 0);
+  runSend(32, 1);
+  runSend(512, 0);
+  runSend(512, 1);
+}
+
+
+static uint32_t echoLen;
+
+
+static void onEcho(const uint8_t *data, uint16_t len)
+{
+  (void) data;
+  echoLen += len;
+}
+
+
+static void waitEcho(uint32_t len)
+{
+  double start = now();
+
+  while (echoLen < len && now() - start < 10000) {
+    SIM_CheckAnyResponse(&hsim);
+    hsim.delay(1);
+  }
+}
+
+
+static void runUDP(const char *name, uint32_t byteTime, uint8_t isQueued)
+{
+  const int num = 200;
+  uint8_t msg[64];
+  double start, rate;
+  int lat = (count < num)? count: num;
+  int i = 0;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = byteTime;
+  sim.delay.udpEcho = 20;
+  memset(&sock, 0, sizeof(sock));
+  sock.listeners.onData = onEcho;
+  SIM_SOCK_SetTxBuffer(&sock, sockTxBuffer, sizeof(sockTxBuffer));
+  SIM_SOCK_InitUDP(&sock, "10.1.2.3", 5000, 5000);
+  sock.config.autoReconnect = 1;
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  SIM_SOCK_Open(&sock, &hsim);
+  if (!waitFor(isSockOpen, 60000)) {
+    fprintf(stderr, "socket did not open\n");
+    tearDown();
+    return;
+  }
+  loop(100);
+  memset(msg, 'x', sizeof(msg));
+
+  // one datagram out, wait for it to come back
+  echoLen = 0;
+  for (i = 0; i < lat; i++) {
+    start = now();
+    if (isQueued) SIM_SOCK_Write(&sock, msg, sizeof(msg));
+    else          SIM_SOCK_SendData(&sock, msg, sizeof(msg));
+    waitEcho((i + 1) * sizeof(msg));
+    samples[i] = now() - start;
+  }
+
+  // back to back until all came back
+  echoLen = 0;
+  i = 0;
+  start = now();
+  while (echoLen < num * sizeof(msg) && now() - start < 120000) {
+    if (!isQueued) {
+      if (i < num) SIM_SOCK_SendData(&sock, msg, sizeof(msg));
+      i++;
+    }
+    else {
+      while (i < num && SIM_SOCK_Write(&sock, msg, sizeof(msg)) == sizeof(msg)) i++;
+    }
+    SIM_CheckAnyResponse(&hsim);
+    hsim.delay(1);
+  }
+  rate = echoLen / sizeof(msg) / ((now() - start) / 1000);
+
+  qsort(samples, lat, sizeof(double), compare);
+  printf("%-24s %8.1f %8.1f %8.1f %8.1f\n", name, rate,
+         samples[lat * 50 / 100], samples[lat * 99 / 100], samples[lat - 1]);
+  tearDown();
+}
+
+
+/*
+ * 64 B datagrams to an echo server 20 ms behind the modem, at 115200
+ * and 921600. Datagrams/s echoed back to back and round-trip of one
+ * datagram in ms, stop-and-wait CIPSEND against the batched queue.
+ */
+static void benchUDP(void)
+{
+  printf("%-24s %8s %8s %8s %8s\n", "udp echo 64 B", "dgram/s", "p50", "p99", "max");
+  runUDP("115200 SendData", 87, 0);
+  runUDP("115200 Write", 87, 1);
+  runUDP("921600 SendData", 11, 0);
+  runUDP("921600 Write", 11, 1);
+}
+
+
+static void runUpload(uint32_t byteTime)
+{
+  const uint32_t total = 64 * 1024;
+  uint8_t chunk[1024];
+  ModemSim_Link_t *link;
+  double start;
+  uint32_t written = 0;
+  uint32_t commands;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = byteTime;
+  memset(&sock, 0, sizeof(sock));
+  if (!waitFor(isRegistered, 120000) || !openSocket(&sock, "example.com", 80)) {
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  memset(chunk, 'x', sizeof(chunk));
+  link = &sim.links[sock.linkNum];
+  link->txLen = 0;
+  commands = sim.commands;
+  start = now();
+  while (link->txLen < total && now() - start < 120000) {
+    while (written < total && SIM_SOCK_Write(&sock, chunk, sizeof(chunk)) == sizeof(chunk))
+      written += sizeof(chunk);
+    SIM_CheckAnyResponse(&hsim);
+    hsim.delay(1);
+  }
+  printf("%-6u %-17s %8.1f %8u\n", (unsigned) (byteTime > 50? 115200: 921600),
+         SIM_SOCK_TRANSPARENT? "transparent": "CIPSEND", link->txLen / (now() - start), sim.commands - commands);
+  tearDown();
+}
+
+
+/*
+ * 64 KB from the host through one socket, 1 KB writes at 115200 and
+ * 921600. Bytes/s the modem took, in this build's socket mode: CIPSEND
+ * framed in simcom_bench, raw pipe after CONNECT in simcom_bench_stream.
+ */
+static void benchUpload(void)
+{
+  printf("%-24s %8s %8s\n", "socket upload 64 KB", "KB/s", "lines");
+  runUpload(87);
+  runUpload(11);
+}
+
+
+static SIM_Socket_t socks[SIM_NUM_OF_SOCKET];
+
+
+static uint8_t isAllOpen(void)
+{
+  for (int i = 0; i < SIM_NUM_OF_SOCKET; i++)
+    if (!SIM_SOCK_IS_STATE(&socks[i], SIM_SOCK_STATE_OPEN)) return 0;
+  return 1;
+}
+
+
+static void runRecover(const char *name, int failedOpens)
+{
+  SIM_Socket_t *top = &socks[SIM_NUM_OF_SOCKET - 1];
+  double start, first = 0;
+  uint32_t commands, opens;
+  uint8_t isTopClosed = 0;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  memset(socks, 0, sizeof(socks));
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  for (int i = 0; i < SIM_NUM_OF_SOCKET; i++) {
+    socks[i].listeners.onData = onDataSink;
+    socks[i].config.autoReconnect = 1;
+    socks[i].config.priority = (uint8_t) i;
+    SIM_SOCK_Init(&socks[i], "10.0.0.1", (uint16_t) (8000 + i));
+    SIM_SOCK_Open(&socks[i], &hsim);
+  }
+  if (!waitFor(isAllOpen, 60000)) {
+    fprintf(stderr, "sockets did not open\n");
+    tearDown();
+    return;
+  }
+  loop(100);
+
+  if (failedOpens) ModemSim_On(&sim, "AT+CIPOPEN", 0, failedOpens, "\r\nERROR\r\n");
+  commands = sim.commands;
+  opens = ModemSim_Count(&sim, "AT+CIPOPEN");
+  ModemSim_NetDrop(&sim);
+  start = now();
+  while (now() - start < 600000) {
+    loop(1);
+    if (!SIM_SOCK_IS_STATE(top, SIM_SOCK_STATE_OPEN)) isTopClosed = 1;
+    else if (isTopClosed && !first) first = now() - start;
+    if (first && isAllOpen()) break;
+  }
+  printf("%-24s %8.1f %8.1f %8u %8u\n", name, first, now() - start,
+         ModemSim_Count(&sim, "AT+CIPOPEN") - opens, sim.commands - commands);
+  tearDown();
+}
+
+
+/*
+ * All sockets back after the PDP context dropped, at 115200 with the
+ * default 5 s first reconnect delay. ms until the top priority socket
+ * and until all of them are open, and the AT+CIPOPEN and all command
+ * lines it took, with every open answered and with the first ones
+ * failing.
+ */
+static void benchRecover(void)
+{
+  printf("%-24s %8s %8s %8s %8s\n", "net drop, 4 sockets", "first", "all", "opens", "lines");
+  runRecover("opens succeed", 0);
+  runRecover("4 opens fail", 4);
+  runRecover("12 opens fail", 12);
+}
+
+
+static double connectedAt;
+
+
+static void onConnected(void)
+{
+  connectedAt = now();
+}
+
+
+static uint8_t isSockClosed(void)
+{
+  return !isSockOpen();
+}
+
+
+// tries until one gets through, each lost with loss percent
+static uint32_t lost(int loss)
+{
+  uint32_t n = 0;
+
+  while (rand() % 100 < loss) n++;
+  return n;
+}
+
+
+static void runLossy(const char *name, int loss, uint8_t isCached)
+{
+  const int num = (count < 200)? count: 200;
+  uint32_t due;
+  int i;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  memset(&sock, 0, sizeof(sock));
+  sock.listeners.onData = onDataSink;
+  sock.listeners.onConnected = onConnected;
+  sock.config.autoReconnect = 1;
+  sock.config.reconnectingDelay = 1000;
+  SIM_SOCK_Init(&sock, "example.com", 80);
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  SIM_SOCK_Open(&sock, &hsim);
+  if (!waitFor(isSockOpen, 60000)) {
+    fprintf(stderr, "socket did not open\n");
+    tearDown();
+    return;
+  }
+
+  // same losses for both modes
+  srand(1);
+  for (i = 0; i < num; i++) {
+    ModemSim_PeerClose(&sim, sock.linkNum);
+    if (!waitFor(isSockClosed, 10000)) break;
+    due = sock.tick.reconnDelay + sock.reconn.wait;
+    // query retried every second, SYN after 1, 2, 4 s
+    sim.delay.dns = 100 + 1000 * lost(loss);
+    sim.delay.connect = 200 + 1000 * ((1u << lost(loss)) - 1);
+    if (!isCached) memset(hsim.net.dns, 0, sizeof(hsim.net.dns));
+    if (!waitFor(isSockOpen, 120000)) break;
+    samples[i] = connectedAt - due;
+  }
+  if (i > 0) report(name, samples, i);
+  tearDown();
+}
+
+
+/*
+ * Socket reconnect after the peer closed, from the due reconnect to
+ * +CIPOPEN, in ms at 115200 over a link losing packets. The DNS cache
+ * goes straight to the cached IP, a miss resolves first like the modem
+ * did for a hostname in AT+CIPOPEN.
+ */
+static void benchLossy(void)
+{
+  printf("%-24s %8s %8s %8s %8s\n", "reconnect, lossy link", "p50", "p90", "p99", "max");
+  runLossy("0% cached IP", 0, 1);
+  runLossy("0% resolved", 0, 0);
+  runLossy("10% cached IP", 10, 1);
+  runLossy("10% resolved", 10, 0);
+  runLossy("30% cached IP", 30, 1);
+  runLossy("30% resolved", 30, 0);
+}
+
+
+#if SIM_EN_FEATURE_TLS
+
+
+static void runTLS(const char *name, uint8_t isCold)
+{
+  const int num = (count < 50)? count: 50;
+  uint32_t commands = 0;
+  uint32_t due;
+
+  if (!setUp()) return;
+  sim.delay.byteTime = 87;
+  memset(&sock, 0, sizeof(sock));
+  SIM_SOCK_SetBuffer(&sock, sockBuffer, sizeof(sockBuffer));
+  sock.listeners.onConnected = onConnected;
+  sock.config.autoReconnect = 1;
+  sock.config.reconnectingDelay = 1000;
+  SIM_SOCK_InitTLS(&sock, "secure.example.com", 443, NULL);
+  if (!waitFor(isRegistered, 120000)) {
+    tearDown();
+    return;
+  }
+  SIM_SOCK_Open(&sock, &hsim);
+  if (!waitFor(isSockOpen, 60000)) {
+    fprintf(stderr, "socket did not open\n");
+    tearDown();
+    return;
+  }
+
+  for (int i = 0; i < num; i++) {
+    ModemSim_SessionClose(&sim, sock.session);
+    if (!waitFor(isSockClosed, 10000)) break;
+    due = sock.tick.reconnDelay + sock.reconn.wait;
+    if (isCold) {
+      // as if the service was stopped with the link, nothing to reuse
+      sim.cchStarted = 0;
+      hsim.net.tls.isStarted = 0;
+      memset(hsim.net.tls.applied, 0, sizeof(hsim.net.tls.applied));
+    }
+    commands -= sim.commands;
+    if (!waitFor(isSockOpen, 60000)) break;
+    commands += sim.commands;
+    samples[i] = connectedAt - due;
+  }
+  qsort(samples, num, sizeof(double), compare);
+  printf("%-24s %8.1f %8.1f %8.1f %8.1f\n", name,
+         samples[num * 50 / 100], samples[num * 99 / 100], samples[num - 1], (double) commands / num);
+  tearDown();
+}
+
+
+/*
+ * TLS socket reconnect after the peer closed, from the due reconnect to
+ * +CCHOPEN, in ms at 115200. The handshake is 3 connect delays in the
+ * simulator either way. CCH offers no TLS session resumption, what is
+ * kept is the started SSL service and the applied SSL context.
+ */
+static void benchTLS(void)
+{
+  printf("%-24s %8s %8s %8s %8s\n", "tls reconnect", "p50", "p99", "max", "lines");
+  runTLS("service and ctx kept", 0);
+  runTLS("full setup", 1);
+}
+#endif
+
+
+static const Scenario_t scenarios[] = {
+  {"commands",      benchCommands,          0, 0},
+  {"load",          benchCommandsUnderLoad, 1, 0},
+  {"batch",         benchBatch,             1, 0},
+  {"idle",          benchIdle,              1, 0},
+  {"boot",          benchBoot,              1, 0},
+  {"bringup",       benchBringUp,           1, 0},
+  {"dispatch",      benchDispatch,          1, 0},
+  {"parse",         benchParse,             1, 0},
+  {"handoff",       benchHandoff,           0, 0},
+  {"receive",       benchReceive,           1, 1},
+  {"send",          benchSend,              1, 0},
+  {"udp",           benchUDP,               1, 0},
+  {"upload",        benchUpload,            1, 1},
+  {"recover",       benchRecover,           1, 0},
+  {"lossy",         benchLossy,             1, 0},
+#if SIM_EN_FEATURE_TLS
+  {"tls",           benchTLS,               1, 0},
+#endif
+};
+
+
+int main(int argc, char **argv)
+{
+  const char *only = NULL;
+  uint8_t isFound = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:m:s:d:b:")) != -1) {
+    switch (opt) {
+    case 'n': count = atoi(optarg); break;
+    case 'm': isPty = (strcmp(optarg, "pty") == 0); break;
+    case 's': script = optarg; break;
+    case 'd': cmdDelay = atoi(optarg); break;
+    case 'b': only = optarg; break;
+    default:
+      fprintf(stderr, "usage: %s [-n count] [-m virtual|pty] [-s script] [-d cmd_delay_ms] [-b scenario]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (count < 1) count = 1;
+  if (count > BENCH_MAX_RUNS) count = BENCH_MAX_RUNS;
+
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    if (only != NULL && strcmp(only, scenarios[i].name) != 0) continue;
+    if (isPty && scenarios[i].isVirtualOnly) continue;
+#if SIM_SOCK_TRANSPARENT
+    // TCP sockets are the raw pipe, AT framed figures come from simcom_bench
+    if (!scenarios[i].isStream) continue;
+#endif
+    isFound = 1;
+    printf("== %s\n", scenarios[i].name);
+    scenarios[i].run();
+  }
+  if (!isFound) {
+    fprintf(stderr, "no scenario %s\n", only);
+    return 2;
+  }
+  return 0;
+}
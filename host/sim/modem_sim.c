@@ -0,0 +1,1555 @@
+/*
+ * modem_sim.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "modem_sim.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define RES_OK      0
+#define RES_ERROR   1
+#define RES_NONE    2     // command sent its own result
+
+#define ESCAPE_GUARD  1000
+
+typedef struct {
+  uint8_t   *buf;
+  uint32_t  len;
+  uint32_t  size;
+} Resp_t;
+
+typedef int (*CmdHandler_t)(ModemSim_t*, char op, const char *args, Resp_t*, uint32_t *t);
+
+typedef struct {
+  const char    *name;
+  CmdHandler_t  handler;
+} Cmd_t;
+
+static void     schedule(ModemSim_t*, uint32_t tick, const uint8_t *data, uint32_t len,
+                         void (*action)(ModemSim_t*, int), int arg);
+static void     insertEvent(ModemSim_t*, const ModemSim_Event_t*);
+static uint32_t lineSend(ModemSim_t*, uint32_t tick, uint32_t len);
+static void     emitAt(ModemSim_t*, uint32_t tick, const char *format, ...);
+static void     outAppend(ModemSim_t*, const uint8_t *data, uint32_t len);
+static void     logLine(ModemSim_t*, const char *line);
+static void     inputByte(ModemSim_t*, uint8_t c);
+static void     streamByte(ModemSim_t*, uint8_t c);
+static void     dataDone(ModemSim_t*);
+static void     peerReceive(ModemSim_t*, int linkNum, uint32_t tick, const uint8_t *data, uint32_t len);
+static void     processLine(ModemSim_t*);
+static uint8_t  applyRule(ModemSim_t*, const char *line);
+static int      execute(ModemSim_t*, const char *cmd, Resp_t*, uint32_t *t);
+static void     respPrintf(Resp_t*, const char *format, ...);
+static void     respAppend(Resp_t*, const void *data, uint32_t len);
+static int      argInt(const char *args, int idx);
+static int      argStr(const char *args, int idx, char *dst, int size);
+static void     linkTx(ModemSim_Link_t*, const uint8_t *data, uint32_t len);
+static void     linkReset(ModemSim_Link_t*);
+static void     actionNMEA(ModemSim_t*, int gen);
+static void     actionOnline(ModemSim_t*, int arg);
+static void     actionEscape(ModemSim_t*, int arg);
+static uint32_t later(ModemSim_t*, uint32_t tick);
+
+static int cmdBasic(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdOK(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCPIN(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCSQ(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCREG(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCGREG(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCEREG(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCOPS(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCLK(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCNTP(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdNETOPEN(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdNETCLOSE(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPMODE(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPSRIP(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPRXGET(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPOPEN(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPSEND(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCIPCLOSE(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdSERVERSTART(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdSERVERSTOP(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCDNSGIP(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCHSTART(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCHSTOP(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCHOPEN(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCHSEND(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCCHCLOSE(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdHTTPACTION(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdHTTPHEAD(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdHTTPREAD(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+static int cmdCGPS(ModemSim_t*, char, const char*, Resp_t*, uint32_t*);
+
+static const Cmd_t commands[] = {
+  {"+CPIN",         cmdCPIN},
+  {"+CSQ",          cmdCSQ},
+  {"+CREG",         cmdCREG},
+  {"+CGREG",        cmdCGREG},
+  {"+CEREG",        cmdCEREG},
+  {"+COPS",         cmdCOPS},
+  {"+CCLK",         cmdCCLK},
+  {"+CGDCONT",      cmdOK},
+  {"+CGAUTH",       cmdOK},
+  {"+CNTP",         cmdCNTP},
+  {"+NETOPEN",      cmdNETOPEN},
+  {"+NETCLOSE",     cmdNETCLOSE},
+  {"+CIPMODE",      cmdCIPMODE},
+  {"+CIPSRIP",      cmdCIPSRIP},
+  {"+CIPCCFG",      cmdOK},
+  {"+CIPRXGET",     cmdCIPRXGET},
+  {"+CIPOPEN",      cmdCIPOPEN},
+  {"+CIPSEND",      cmdCIPSEND},
+  {"+CIPCLOSE",     cmdCIPCLOSE},
+  {"+SERVERSTART",  cmdSERVERSTART},
+  {"+SERVERSTOP",   cmdSERVERSTOP},
+  {"+CDNSGIP",      cmdCDNSGIP},
+  {"+CCHSTART",     cmdCCHSTART},
+  {"+CCHSTOP",      cmdCCHSTOP},
+  {"+CSSLCFG",      cmdOK},
+  {"+CCHSSLCFG",    cmdOK},
+  {"+CCHOPEN",      cmdCCHOPEN},
+  {"+CCHSEND",      cmdCCHSEND},
+  {"+CCHCLOSE",     cmdCCHCLOSE},
+  {"+HTTPINIT",     cmdOK},
+  {"+HTTPPARA",     cmdOK},
+  {"+HTTPACTION",   cmdHTTPACTION},
+  {"+HTTPHEAD",     cmdHTTPHEAD},
+  {"+HTTPREAD",     cmdHTTPREAD},
+  {"+HTTPTERM",     cmdOK},
+  {"+CGPS",         cmdCGPS},
+  {"+CGPSHOR",      cmdOK},
+  {"+CGPSNMEARATE", cmdOK},
+  {"+CGPSXDAUTO",   cmdOK},
+  {"+CGPSINFOCFG",  cmdOK},
+  {"+CGPSMD",       cmdOK},
+  {"+CGPSURL",      cmdOK},
+  {"+CGPSSSL",      cmdOK},
+  {"+CGPSMSB",      cmdOK},
+  {"+CVAUXV",       cmdOK},
+  {"+CVAUXS",       cmdOK},
+  {"+CSCS",         cmdOK},
+  {"+CUSD",         cmdOK},
+  {"+CMEE",         cmdOK},
+};
+
+static const char nmea[] =
+  "$GPGGA,092750.000,5321.6802,N,00630.3372,W,1,8,1.03,61.7,M,55.2,M,,*76\r\n"
+  "$GPRMC,092750.000,A,5321.6802,N,00630.3372,W,0.02,31.66,280511,,,A*43\r\n";
+
+// modem and clock of the virtual transport, one per thread driving a modem
+static __thread ModemSim_t *vsim;
+static __thread uint32_t vnow;
+
+
+void ModemSim_Init(ModemSim_t *sim)
+{
+  memset(sim, 0, sizeof(ModemSim_t));
+  // virtual clock drives this modem from now on, ModemSim_SetTick included
+  vsim = sim;
+  sim->now = vnow;
+  sim->delay.cmd      = 5;
+  sim->delay.connect  = 200;
+  sim->delay.netOpen  = 500;
+  sim->delay.dns      = 100;
+  sim->delay.scan     = 30000;
+  sim->delay.sendAck  = 50;
+  sim->echo       = 1;
+  sim->simReady   = 1;
+  sim->csq        = 20;
+  sim->creg       = 1;
+  sim->cgreg      = 1;
+  sim->httpBody   = "hello";
+  sim->httpStatus = 200;
+  strcpy(sim->operator, "46000");
+}
+
+
+void ModemSim_Free(ModemSim_t *sim)
+{
+  for (uint32_t i = 0; i < sim->eventCount; i++) free(sim->events[i].data);
+  for (uint8_t i = 0; i < sim->ruleCount; i++) {
+    free(sim->rules[i].prefix);
+    free(sim->rules[i].reply);
+  }
+  free(sim->events);
+  free(sim->out);
+  free(sim->log);
+  sim->events = NULL;
+  sim->out = NULL;
+  sim->log = NULL;
+  sim->eventCount = 0;
+  sim->ruleCount = 0;
+}
+
+
+/*
+ * Modem (re)boots, everything set by AT commands is lost
+ */
+void ModemSim_PowerOn(ModemSim_t *sim)
+{
+  for (uint32_t i = 0; i < sim->eventCount; i++) free(sim->events[i].data);
+  sim->eventCount = 0;
+  sim->outLen     = 0;
+  sim->lineLen    = 0;
+  sim->dataLeft   = 0;
+  sim->dataLink   = NULL;
+  sim->busyUntil  = sim->now;
+  sim->lineFree   = sim->now;
+  sim->lineFreeUs = 0;
+  sim->echo       = 1;
+  sim->regReport  = 0;
+  sim->netOpen    = 0;
+  sim->cipMode    = 0;
+  sim->srip       = 0;
+  sim->manualRx   = 0;
+  sim->cchStarted = 0;
+  sim->gpsOn      = 0;
+  sim->gpsGen++;
+  sim->isStream   = 0;
+  memset(sim->servers, 0, sizeof(sim->servers));
+  for (int i = 0; i < MODEMSIM_NUM_OF_LINK; i++) linkReset(&sim->links[i]);
+  for (int i = 0; i < MODEMSIM_NUM_OF_SESSION; i++) linkReset(&sim->sessions[i]);
+
+  emitAt(sim, sim->now + 100, "\r\nRDY\r\n");
+  emitAt(sim, sim->now + 200, "\r\n+CPIN: READY\r\n");
+  emitAt(sim, sim->now + 300, "\r\nSMS DONE\r\n");
+  emitAt(sim, sim->now + 400, "\r\nPB DONE\r\n");
+}
+
+
+void ModemSim_Input(ModemSim_t *sim, const uint8_t *data, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++) inputByte(sim, data[i]);
+  sim->lastInputTick = sim->now;
+}
+
+
+/*
+ * Run events due until now, their output becomes readable
+ */
+void ModemSim_Advance(ModemSim_t *sim, uint32_t now)
+{
+  ModemSim_Event_t ev;
+
+  while (sim->eventCount && (int32_t)(sim->events[0].tick - now) <= 0) {
+    ev = sim->events[0];
+    sim->eventCount--;
+    memmove(&sim->events[0], &sim->events[1], sim->eventCount * sizeof(ModemSim_Event_t));
+
+    // output queues on the serial line behind what is still being sent
+    if (ev.data != NULL && sim->delay.byteTime && !ev.isOnLine) {
+      ev.isOnLine = 1;
+      ev.tick = lineSend(sim, ev.tick, ev.len);
+      insertEvent(sim, &ev);
+      continue;
+    }
+
+    if ((int32_t)(ev.tick - sim->now) > 0) sim->now = ev.tick;
+    if (ev.data != NULL) {
+      outAppend(sim, ev.data, ev.len);
+      free(ev.data);
+    }
+    if (ev.action != NULL) ev.action(sim, ev.arg);
+  }
+  sim->now = now;
+  // idle modem, keep busy tick comparable after long clock jumps
+  if ((int32_t)(sim->busyUntil - now) < 0) sim->busyUntil = now;
+  if ((int32_t)(sim->lineFree - now) < 0) {
+    sim->lineFree = now;
+    sim->lineFreeUs = 0;
+  }
+}
+
+
+uint32_t ModemSim_Output(ModemSim_t *sim, uint8_t *dst, uint32_t size)
+{
+  uint32_t len = (size < sim->outLen)? size: sim->outLen;
+
+  memcpy(dst, sim->out, len);
+  sim->outLen -= len;
+  memmove(sim->out, sim->out + len, sim->outLen);
+  return len;
+}
+
+
+uint8_t ModemSim_NextEvent(ModemSim_t *sim, uint32_t *tick)
+{
+  if (sim->eventCount == 0) return 0;
+  *tick = sim->events[0].tick;
+  return 1;
+}
+
+
+/*
+ * Answer command lines starting with prefix with reply instead of the
+ * built-in behaviour, count times or forever when -1
+ */
+void ModemSim_On(ModemSim_t *sim, const char *prefix, uint32_t delay, int32_t count, const char *reply)
+{
+  ModemSim_Rule_t *rule;
+
+  if (sim->ruleCount >= MODEMSIM_NUM_OF_RULE) return;
+  rule = &sim->rules[sim->ruleCount++];
+  rule->prefix  = strdup(prefix);
+  rule->reply   = strdup(reply);
+  rule->delay   = delay;
+  rule->count   = count;
+}
+
+
+/*
+ * Script lines, '#' starts a comment, \r \n \" and \\ are unescaped:
+ *   delay <cmd|connect|netopen|dns|scan|sendack|byte> <value>
+ *   on <prefix> <delay> <count> <reply>
+ *   set <echo|csq|creg|cgreg|dnsfail> <value>
+ */
+int ModemSim_LoadScript(ModemSim_t *sim, const char *path)
+{
+  FILE *file = fopen(path, "r");
+  char line[1024];
+  char key[32];
+  char prefix[128];
+  char reply[1024];
+  uint32_t value;
+  int32_t count;
+  int pos;
+  int n;
+
+  if (file == NULL) return -1;
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    line[strcspn(line, "\r\n")] = 0;
+
+    if (sscanf(line, "delay %31s %u", key, &value) == 2) {
+      if      (strcmp(key, "cmd") == 0)     sim->delay.cmd = value;
+      else if (strcmp(key, "connect") == 0) sim->delay.connect = value;
+      else if (strcmp(key, "netopen") == 0) sim->delay.netOpen = value;
+      else if (strcmp(key, "dns") == 0)     sim->delay.dns = value;
+      else if (strcmp(key, "scan") == 0)    sim->delay.scan = value;
+      else if (strcmp(key, "sendack") == 0) sim->delay.sendAck = value;
+      else if (strcmp(key, "udpecho") == 0) sim->delay.udpEcho = value;
+      else if (strcmp(key, "byte") == 0)    sim->delay.byteTime = value;
+    }
+    else if (sscanf(line, "set %31s %u", key, &value) == 2) {
+      if      (strcmp(key, "echo") == 0)    sim->echo = (uint8_t) value;
+      else if (strcmp(key, "csq") == 0)     sim->csq = (uint8_t) value;
+      else if (strcmp(key, "creg") == 0)    sim->creg = (uint8_t) value;
+      else if (strcmp(key, "cgreg") == 0)   sim->cgreg = (uint8_t) value;
+      else if (strcmp(key, "dnsfail") == 0) sim->dnsFail = (uint8_t) value;
+    }
+    else if (sscanf(line, "on %127s %u %d %n", prefix, &value, &count, &pos) == 3) {
+      n = 0;
+      for (char *s = &line[pos]; *s && n < (int) sizeof(reply) - 1; s++) {
+        if (*s == '\\' && s[1] != 0) {
+          s++;
+          if      (*s == 'r') reply[n++] = '\r';
+          else if (*s == 'n') reply[n++] = '\n';
+          else                reply[n++] = *s;
+        }
+        else reply[n++] = *s;
+      }
+      reply[n] = 0;
+      ModemSim_On(sim, prefix, value, count, reply);
+    }
+  }
+
+  fclose(file);
+  return 0;
+}
+
+
+void ModemSim_Emit(ModemSim_t *sim, uint32_t delay, const uint8_t *data, uint32_t len)
+{
+  schedule(sim, sim->now + delay, data, len, NULL, 0);
+}
+
+
+/*
+ * URC text without line ends
+ */
+void ModemSim_URC(ModemSim_t *sim, uint32_t delay, const char *format, ...)
+{
+  char text[MODEMSIM_LINE_SIZE];
+  va_list arglist;
+  int len;
+
+  text[0] = '\r';
+  text[1] = '\n';
+  va_start(arglist, format);
+  len = vsnprintf(&text[2], sizeof(text) - 4, format, arglist);
+  va_end(arglist);
+  if (len < 0) return;
+  if (len > (int) sizeof(text) - 5) len = sizeof(text) - 5;
+  text[2 + len] = '\r';
+  text[3 + len] = '\n';
+  schedule(sim, sim->now + delay, (uint8_t*) text, len + 4, NULL, 0);
+}
+
+
+/*
+ * Registration of circuit and packet domain changes, reported as URC
+ * when enabled by AT+CREG=n
+ */
+void ModemSim_SetReg(ModemSim_t *sim, uint8_t stat)
+{
+  sim->creg = stat;
+  sim->cgreg = stat;
+  if (sim->regReport == 0) return;
+
+  if (sim->regReport == 2 && (stat == 1 || stat == 5)) {
+    ModemSim_URC(sim, 0, "+CREG: %d,\"1A2B\",\"0C3D4E5F\"", stat);
+    ModemSim_URC(sim, 0, "+CGREG: %d,\"1A2B\",\"0C3D4E5F\"", stat);
+    ModemSim_URC(sim, 0, "+CEREG: %d,\"1A2B\",\"0C3D4E5F\"", stat);
+  }
+  else {
+    ModemSim_URC(sim, 0, "+CREG: %d", stat);
+    ModemSim_URC(sim, 0, "+CGREG: %d", stat);
+    ModemSim_URC(sim, 0, "+CEREG: %d", stat);
+  }
+}
+
+
+/*
+ * PDP context lost, links go down with it
+ */
+void ModemSim_NetDrop(ModemSim_t *sim)
+{
+  for (int i = 0; i < MODEMSIM_NUM_OF_LINK; i++) {
+    if (sim->links[i].state == MODEMSIM_LINK_OPEN) {
+      sim->links[i].state = MODEMSIM_LINK_CLOSED;
+      sim->links[i].rxLen = 0;
+      if (i == 0 && sim->isStream) {
+        sim->isStream = 0;
+        ModemSim_URC(sim, 0, "CLOSED");
+      }
+      else ModemSim_URC(sim, 0, "+IPCLOSE: %d,2", i);
+    }
+  }
+  for (int i = 0; i < MODEMSIM_NUM_OF_SESSION; i++) {
+    if (sim->sessions[i].state == MODEMSIM_LINK_OPEN) {
+      sim->sessions[i].state = MODEMSIM_LINK_CLOSED;
+      ModemSim_URC(sim, 0, "+CCH_PEER_CLOSED: %d", i);
+    }
+  }
+  memset(sim->servers, 0, sizeof(sim->servers));
+  sim->netOpen = 0;
+  ModemSim_URC(sim, 0, "+CIPEVENT: NETWORK CLOSED UNEXPECTEDLY");
+}
+
+
+// pushed as +RECEIVE at tick
+static void peerReceive(ModemSim_t *sim, int linkNum, uint32_t tick, const uint8_t *data, uint32_t len)
+{
+  ModemSim_Link_t *link = &sim->links[linkNum];
+  Resp_t resp = {0};
+
+  if (sim->srip) respPrintf(&resp, "\r\nRECV FROM:%s:%d", link->isUDP? "10.1.2.3": link->host, link->isUDP? 5000: link->port);
+  respPrintf(&resp, "\r\n+RECEIVE,%d,%u\r\n", linkNum, len);
+  respAppend(&resp, data, len);
+  schedule(sim, tick, resp.buf, resp.len, NULL, 0);
+  free(resp.buf);
+}
+
+
+/*
+ * Data from remote of link, pushed as +RECEIVE or held for AT+CIPRXGET
+ */
+void ModemSim_PeerSend(ModemSim_t *sim, int linkNum, const uint8_t *data, uint32_t len)
+{
+  ModemSim_Link_t *link = &sim->links[linkNum];
+
+  if (link->state != MODEMSIM_LINK_OPEN) return;
+
+  if (linkNum == 0 && sim->isStream) {
+    ModemSim_Emit(sim, 0, data, len);
+    return;
+  }
+
+  if (sim->manualRx) {
+    if (link->rxLen + len > MODEMSIM_LOG_SIZE) len = MODEMSIM_LOG_SIZE - link->rxLen;
+    memcpy(&link->rx[link->rxLen], data, len);
+    link->rxLen += len;
+    // reported once until the buffer was read empty
+    if (link->rxLen == len) ModemSim_URC(sim, 0, "+CIPRXGET: 1,%d", linkNum);
+    return;
+  }
+
+  peerReceive(sim, linkNum, sim->now, data, len);
+}
+
+
+void ModemSim_PeerClose(ModemSim_t *sim, int linkNum)
+{
+  ModemSim_Link_t *link = &sim->links[linkNum];
+
+  if (link->state != MODEMSIM_LINK_OPEN) return;
+  link->state = MODEMSIM_LINK_CLOSED;
+
+  if (linkNum == 0 && sim->isStream) {
+    sim->isStream = 0;
+    ModemSim_URC(sim, 0, "CLOSED");
+    return;
+  }
+  ModemSim_URC(sim, 0, "+IPCLOSE: %d,1", linkNum);
+}
+
+
+/*
+ * Data from remote of CCH session, pushed as +CCHRECV
+ */
+void ModemSim_SessionSend(ModemSim_t *sim, int session, const uint8_t *data, uint32_t len)
+{
+  Resp_t resp = {0};
+
+  if (sim->sessions[session].state != MODEMSIM_LINK_OPEN) return;
+
+  respPrintf(&resp, "\r\n+CCHRECV: DATA,%d,%u\r\n", session, len);
+  respAppend(&resp, data, len);
+  respPrintf(&resp, "\r\n+CCHRECV: %d,0\r\n", session);
+  schedule(sim, sim->now, resp.buf, resp.len, NULL, 0);
+  free(resp.buf);
+}
+
+
+void ModemSim_SessionClose(ModemSim_t *sim, int session)
+{
+  if (sim->sessions[session].state != MODEMSIM_LINK_OPEN) return;
+  sim->sessions[session].state = MODEMSIM_LINK_CLOSED;
+  ModemSim_URC(sim, 0, "+CCH_PEER_CLOSED: %d", session);
+}
+
+
+void ModemSim_ClientConnect(ModemSim_t *sim, int linkNum, int server, const char *addr)
+{
+  ModemSim_Link_t *link = &sim->links[linkNum];
+
+  linkReset(link);
+  link->state = MODEMSIM_LINK_OPEN;
+  strncpy(link->host, addr, sizeof(link->host) - 1);
+  ModemSim_URC(sim, 0, "+CLIENT: %d,%d,%s", linkNum, server, addr);
+}
+
+
+/*
+ * number of received command lines starting with prefix
+ */
+uint32_t ModemSim_Count(ModemSim_t *sim, const char *prefix)
+{
+  size_t prefixLen = strlen(prefix);
+  uint32_t count = 0;
+  uint32_t i = 0;
+
+  while (i < sim->logLen) {
+    if (strncmp(&sim->log[i], prefix, prefixLen) == 0) count++;
+    while (i < sim->logLen && sim->log[i] != '\n') i++;
+    i++;
+  }
+  return count;
+}
+
+
+void ModemSim_ClearLog(ModemSim_t *sim)
+{
+  sim->logLen = 0;
+  sim->commands = 0;
+}
+
+
+static void schedule(ModemSim_t *sim, uint32_t tick, const uint8_t *data, uint32_t len,
+                     void (*action)(ModemSim_t*, int), int arg)
+{
+  ModemSim_Event_t ev = {0};
+
+  ev.tick    = tick;
+  ev.len     = len;
+  ev.action  = action;
+  ev.arg     = arg;
+  if (data != NULL) {
+    ev.data = malloc(len? len: 1);
+    memcpy(ev.data, data, len);
+  }
+  insertEvent(sim, &ev);
+}
+
+
+static void insertEvent(ModemSim_t *sim, const ModemSim_Event_t *ev)
+{
+  uint32_t i;
+
+  if (sim->eventCount == sim->eventSize) {
+    sim->eventSize = sim->eventSize? sim->eventSize * 2: 64;
+    sim->events = realloc(sim->events, sim->eventSize * sizeof(ModemSim_Event_t));
+  }
+
+  i = sim->eventCount;
+  while (i > 0 && (int32_t)(sim->events[i-1].tick - ev->tick) > 0) i--;
+  memmove(&sim->events[i+1], &sim->events[i], (sim->eventCount - i) * sizeof(ModemSim_Event_t));
+  sim->eventCount++;
+
+  sim->events[i] = *ev;
+  sim->events[i].seq = sim->seq++;
+}
+
+
+/*
+ * Put len bytes on the line to the driver at tick or once the line is
+ * idle, returns the tick the last byte arrives
+ */
+static uint32_t lineSend(ModemSim_t *sim, uint32_t tick, uint32_t len)
+{
+  uint64_t us;
+
+  if ((int32_t)(tick - sim->lineFree) > 0) {
+    sim->lineFree = tick;
+    sim->lineFreeUs = 0;
+  }
+  us = sim->lineFreeUs + (uint64_t) len * sim->delay.byteTime;
+  sim->lineFree   += (uint32_t) (us / 1000);
+  sim->lineFreeUs  = (uint32_t) (us % 1000);
+  return sim->lineFree + (sim->lineFreeUs? 1: 0);
+}
+
+
+static void emitAt(ModemSim_t *sim, uint32_t tick, const char *format, ...)
+{
+  char text[MODEMSIM_LINE_SIZE];
+  va_list arglist;
+  int len;
+
+  va_start(arglist, format);
+  len = vsnprintf(text, sizeof(text), format, arglist);
+  va_end(arglist);
+  if (len < 0) return;
+  if (len >= (int) sizeof(text)) len = sizeof(text) - 1;
+  schedule(sim, tick, (uint8_t*) text, len, NULL, 0);
+}
+
+
+static void outAppend(ModemSim_t *sim, const uint8_t *data, uint32_t len)
+{
+  if (sim->outLen + len > sim->outSize) {
+    while (sim->outLen + len > sim->outSize)
+      sim->outSize = sim->outSize? sim->outSize * 2: 4096;
+    sim->out = realloc(sim->out, sim->outSize);
+  }
+  memcpy(sim->out + sim->outLen, data, len);
+  sim->outLen += len;
+}
+
+
+static void logLine(ModemSim_t *sim, const char *line)
+{
+  uint32_t len = strlen(line);
+
+  if (sim->logLen + len + 1 > sim->logSize) {
+    while (sim->logLen + len + 1 > sim->logSize)
+      sim->logSize = sim->logSize? sim->logSize * 2: 4096;
+    sim->log = realloc(sim->log, sim->logSize);
+  }
+  memcpy(sim->log + sim->logLen, line, len);
+  sim->logLen += len;
+  sim->log[sim->logLen++] = '\n';
+  sim->commands++;
+}
+
+
+static void inputByte(ModemSim_t *sim, uint8_t c)
+{
+  if (sim->dataLeft) {
+    if (sim->dataLink != NULL) linkTx(sim->dataLink, &c, 1);
+    if (--sim->dataLeft == 0) dataDone(sim);
+    return;
+  }
+
+  if (sim->isStream) {
+    streamByte(sim, c);
+    return;
+  }
+
+  if (c == '\n') return;
+  if (c != '\r') {
+    if (sim->lineLen < MODEMSIM_LINE_SIZE - 1) sim->line[sim->lineLen++] = (char) c;
+    return;
+  }
+
+  sim->line[sim->lineLen] = 0;
+  if (sim->echo && sim->lineLen) {
+    emitAt(sim, sim->now, "%s\r", sim->line);
+  }
+  processLine(sim);
+  sim->lineLen = 0;
+}
+
+
+/*
+ * Data mode, "+++" between ESCAPE_GUARD of silence goes back to command mode
+ */
+static void streamByte(ModemSim_t *sim, uint8_t c)
+{
+  ModemSim_Link_t *link = &sim->links[0];
+
+  if (c == '+' && (sim->escapeMatch > 0 || (uint32_t)(sim->now - sim->lastInputTick) >= ESCAPE_GUARD)) {
+    if (++sim->escapeMatch == 3) {
+      schedule(sim, sim->now + ESCAPE_GUARD, NULL, 0, actionEscape, (int) sim->now);
+    }
+    return;
+  }
+
+  // not an escape, the plus signs were data
+  while (sim->escapeMatch) {
+    linkTx(link, (const uint8_t*) "+", 1);
+    sim->escapeMatch--;
+  }
+  linkTx(link, &c, 1);
+}
+
+
+// online once CONNECT is out, the LF after the command is not data
+static void actionOnline(ModemSim_t *sim, int arg)
+{
+  (void) arg;
+  if (sim->links[0].state != MODEMSIM_LINK_OPEN) return;
+  sim->isStream = 1;
+  sim->escapeMatch = 0;
+}
+
+
+static void actionEscape(ModemSim_t *sim, int arg)
+{
+  // data after "+++" cancels it
+  if (sim->escapeMatch != 3 || sim->lastInputTick != (uint32_t) arg) {
+    return;
+  }
+  sim->escapeMatch = 0;
+  sim->isStream = 0;
+  emitAt(sim, sim->now, "\r\nOK\r\n");
+}
+
+
+static void dataDone(ModemSim_t *sim)
+{
+  uint32_t t = later(sim, sim->now) + sim->delay.cmd;
+  ModemSim_Link_t *link = sim->dataLink;
+  uint32_t len = (uint32_t) argInt(sim->line, 1);
+
+  sim->busyUntil = t;
+  sim->dataLink = NULL;
+  if (link == NULL) {
+    emitAt(sim, t, "\r\nERROR\r\n");
+    return;
+  }
+
+  link->sends++;
+  emitAt(sim, t, "\r\nOK\r\n");
+  if (sim->dataLinkNum >= 0) {
+    emitAt(sim, t + sim->delay.sendAck, "\r\n+CIPSEND: %d,%u,%u\r\n", sim->dataLinkNum, len, len);
+  }
+  // echo server behind the remote address
+  if (sim->dataLinkNum >= 0 && link->isUDP && sim->delay.udpEcho && !sim->manualRx && len <= link->txLen) {
+    peerReceive(sim, sim->dataLinkNum, t + sim->delay.udpEcho, &link->tx[link->txLen - len], len);
+  }
+}
+
+
+static void processLine(ModemSim_t *sim)
+{
+  char cmd[MODEMSIM_LINE_SIZE];
+  const char *body;
+  Resp_t resp = {0};
+  uint32_t t;
+  int result = RES_OK;
+  uint8_t isInStr = 0;
+  int len;
+
+  if (sim->lineLen == 0) return;
+  logLine(sim, sim->line);
+
+  if (applyRule(sim, sim->line)) return;
+  if (sim->lineLen < 2 || toupper((unsigned char) sim->line[0]) != 'A' || toupper((unsigned char) sim->line[1]) != 'T')
+    return;
+
+  // modem takes next command only when previous one was answered
+  t = later(sim, sim->now) + sim->delay.cmd;
+
+  // "AT+A;+B" runs each part, one final result
+  body = &sim->line[2];
+  do {
+    len = 0;
+    while (*body && (*body != ';' || isInStr)) {
+      if (*body == '\"') isInStr = !isInStr;
+      cmd[len++] = *body++;
+    }
+    cmd[len] = 0;
+    if (*body == ';') body++;
+
+    result = execute(sim, cmd, &resp, &t);
+    if (result != RES_OK) break;
+  } while (*body);
+
+  if (result == RES_OK)     respPrintf(&resp, "\r\nOK\r\n");
+  if (result == RES_ERROR)  respPrintf(&resp, "\r\nERROR\r\n");
+  if (resp.len) schedule(sim, t, resp.buf, resp.len, NULL, 0);
+  free(resp.buf);
+
+  if ((int32_t)(t - sim->busyUntil) > 0) sim->busyUntil = t;
+}
+
+
+static uint8_t applyRule(ModemSim_t *sim, const char *line)
+{
+  ModemSim_Rule_t *rule;
+  uint32_t t;
+
+  for (uint8_t i = 0; i < sim->ruleCount; i++) {
+    rule = &sim->rules[i];
+    if (rule->count == 0 || strncmp(line, rule->prefix, strlen(rule->prefix)) != 0) continue;
+
+    if (rule->count > 0) rule->count--;
+    t = later(sim, sim->now) + rule->delay;
+    emitAt(sim, t, "%s", rule->reply);
+    sim->busyUntil = t;
+    return 1;
+  }
+  return 0;
+}
+
+
+static int execute(ModemSim_t *sim, const char *cmd, Resp_t *resp, uint32_t *t)
+{
+  size_t nameLen = strcspn(cmd, "=?");
+  const char *args = cmd + nameLen;
+  char op = 0;
+
+  if (cmd[0] != '+') return cmdBasic(sim, 0, cmd, resp, t);
+
+  if (args[0] == '?') op = '?';
+  else if (args[0] == '=' && args[1] == '?') op = 't';
+  else if (args[0] == '=') {
+    op = '=';
+    args++;
+  }
+
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+    if (strlen(commands[i].name) == nameLen && strncmp(cmd, commands[i].name, nameLen) == 0)
+      return commands[i].handler(sim, op, args, resp, t);
+  }
+  return RES_ERROR;
+}
+
+
+static void respPrintf(Resp_t *resp, const char *format, ...)
+{
+  char text[MODEMSIM_LINE_SIZE];
+  va_list arglist;
+  int len;
+
+  va_start(arglist, format);
+  len = vsnprintf(text, sizeof(text), format, arglist);
+  va_end(arglist);
+  if (len < 0) return;
+  if (len >= (int) sizeof(text)) len = sizeof(text) - 1;
+  respAppend(resp, text, len);
+}
+
+
+static void respAppend(Resp_t *resp, const void *data, uint32_t len)
+{
+  if (resp->len + len > resp->size) {
+    while (resp->len + len > resp->size)
+      resp->size = resp->size? resp->size * 2: 256;
+    resp->buf = realloc(resp->buf, resp->size);
+  }
+  memcpy(resp->buf + resp->len, data, len);
+  resp->len += len;
+}
+
+
+/*
+ * field idx of comma separated args, quotes are kept out
+ */
+static int argStr(const char *args, int idx, char *dst, int size)
+{
+  uint8_t isInStr = 0;
+  int len = 0;
+
+  while (idx > 0 && *args) {
+    if (*args == '\"') isInStr = !isInStr;
+    else if (*args == ',' && !isInStr) idx--;
+    args++;
+  }
+  if (idx > 0) {
+    dst[0] = 0;
+    return -1;
+  }
+
+  while (*args && (*args != ',' || isInStr)) {
+    if (*args == '\"') isInStr = !isInStr;
+    else if (len < size - 1) dst[len++] = *args;
+    args++;
+  }
+  dst[len] = 0;
+  return len;
+}
+
+
+static int argInt(const char *args, int idx)
+{
+  char field[64];
+
+  // CIPSEND line is kept with its "AT+CIPSEND=" prefix
+  if (strncmp(args, "AT+", 3) == 0) args += strcspn(args, "=") + 1;
+  if (argStr(args, idx, field, sizeof(field)) <= 0) return -1;
+  return atoi(field);
+}
+
+
+static void linkTx(ModemSim_Link_t *link, const uint8_t *data, uint32_t len)
+{
+  if (link->txLen + len > MODEMSIM_LOG_SIZE) {
+    // keep the newest bytes
+    uint32_t drop = link->txLen + len - MODEMSIM_LOG_SIZE;
+    if (drop > link->txLen) drop = link->txLen;
+    memmove(link->tx, link->tx + drop, link->txLen - drop);
+    link->txLen -= drop;
+  }
+  memcpy(&link->tx[link->txLen], data, len);
+  link->txLen += len;
+}
+
+
+static void linkReset(ModemSim_Link_t *link)
+{
+  link->state = MODEMSIM_LINK_CLOSED;
+  link->isUDP = 0;
+  link->host[0] = 0;
+  link->port  = 0;
+  link->rxLen = 0;
+}
+
+
+static void actionNMEA(ModemSim_t *sim, int gen)
+{
+  if (!sim->gpsOn || gen != sim->gpsGen) return;
+  schedule(sim, sim->now, (const uint8_t*) nmea, sizeof(nmea) - 1, NULL, 0);
+  schedule(sim, sim->now + 1000, NULL, 0, actionNMEA, gen);
+}
+
+
+/*
+ * tick when modem can start on a new command
+ */
+static uint32_t later(ModemSim_t *sim, uint32_t tick)
+{
+  return ((int32_t)(sim->busyUntil - tick) > 0)? sim->busyUntil: tick;
+}
+
+
+static int cmdBasic(ModemSim_t *sim, char op, const char *cmd, Resp_t *resp, uint32_t *t)
+{
+  (void) op;
+  (void) resp;
+
+  if (cmd[0] == 0) return RES_OK;
+  if (strcmp(cmd, "E0") == 0) {
+    sim->echo = 0;
+    return RES_OK;
+  }
+  if (strcmp(cmd, "E1") == 0) {
+    sim->echo = 1;
+    return RES_OK;
+  }
+  // back to data mode
+  if (strcmp(cmd, "O") == 0) {
+    if (sim->links[0].state != MODEMSIM_LINK_OPEN || sim->cipMode != 1) return RES_ERROR;
+    emitAt(sim, *t, "\r\nCONNECT 115200\r\n");
+    schedule(sim, *t, NULL, 0, actionOnline, 0);
+    return RES_NONE;
+  }
+  if (strcmp(cmd, "&W") == 0 || strcmp(cmd, "Z") == 0) return RES_OK;
+  return RES_ERROR;
+}
+
+
+static int cmdOK(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) sim;
+  (void) op;
+  (void) args;
+  (void) resp;
+  (void) t;
+  return RES_OK;
+}
+
+
+static int cmdCPIN(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+  (void) t;
+
+  if (op != '?') return RES_OK;
+  if (!sim->simReady) {
+    respPrintf(resp, "\r\n+CME ERROR: 10\r\n");
+    return RES_NONE;
+  }
+  respPrintf(resp, "\r\n+CPIN: READY\r\n");
+  return RES_OK;
+}
+
+
+static int cmdCSQ(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) op;
+  (void) args;
+  (void) t;
+
+  respPrintf(resp, "\r\n+CSQ: %d,99\r\n", sim->csq);
+  return RES_OK;
+}
+
+
+static void regStat(ModemSim_t *sim, Resp_t *resp, const char *name, uint8_t stat)
+{
+  if (sim->regReport == 2 && (stat == 1 || stat == 5))
+    respPrintf(resp, "\r\n%s: %d,%d,\"1A2B\",\"0C3D4E5F\"\r\n", name, sim->regReport, stat);
+  else
+    respPrintf(resp, "\r\n%s: %d,%d\r\n", name, sim->regReport, stat);
+}
+
+
+static int cmdCREG(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) t;
+
+  if (op == '=') sim->regReport = (uint8_t) argInt(args, 0);
+  if (op == '?') regStat(sim, resp, "+CREG", sim->creg);
+  return RES_OK;
+}
+
+
+static int cmdCGREG(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+  (void) t;
+
+  if (op == '?') regStat(sim, resp, "+CGREG", sim->cgreg);
+  return RES_OK;
+}
+
+
+static int cmdCEREG(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+  (void) t;
+
+  if (op == '?') regStat(sim, resp, "+CEREG", sim->cgreg);
+  return RES_OK;
+}
+
+
+static int cmdCOPS(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+
+  if (op == '?') {
+    if (sim->creg == 1 || sim->creg == 5)
+      respPrintf(resp, "\r\n+COPS: 0,2,\"%s\",7\r\n", sim->operator);
+    else
+      respPrintf(resp, "\r\n+COPS: 0\r\n");
+  }
+  // scan, modem answers nothing else meanwhile
+  else if (op == 't') {
+    *t += sim->delay.scan;
+    respPrintf(resp, "\r\n+COPS: (2,\"SIM\",\"SIM\",\"%s\",7),(1,\"Other\",\"Other\",\"46001\",7),"
+                     "(3,\"Barred\",\"Barred\",\"46002\",2),,(0,1,2,3,4),(0,1,2)\r\n", sim->operator);
+  }
+  return RES_OK;
+}
+
+
+static int cmdCCLK(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) sim;
+  (void) op;
+  (void) args;
+  (void) t;
+
+  respPrintf(resp, "\r\n+CCLK: \"26/10/17,09:00:00+28\"\r\n");
+  return RES_OK;
+}
+
+
+static int cmdCNTP(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+  (void) resp;
+
+  if (op == 0) emitAt(sim, *t + 100, "\r\n+CNTP: 0\r\n");
+  return RES_OK;
+}
+
+
+static int cmdNETOPEN(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) args;
+
+  if (op == '?') {
+    respPrintf(resp, "\r\n+NETOPEN: %d\r\n", sim->netOpen);
+    return RES_OK;
+  }
+  if (sim->netOpen) {
+    respPrintf(resp, "\r\n+IP ERROR: Network is already opened\r\n");
+    return RES_ERROR;
+  }
+  if (sim->netOpenErr == 0) sim->netOpen = 1;
+  emitAt(sim, *t + sim->delay.netOpen, "\r\n+NETOPEN: %d\r\n", sim->netOpenErr);
+  return RES_OK;
+}
+
+
+static int cmdNETCLOSE(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) op;
+  (void) args;
+  (void) resp;
+
+  if (!sim->netOpen) return RES_ERROR;
+  sim->netOpen = 0;
+  for (int i = 0; i < MODEMSIM_NUM_OF_LINK; i++) sim->links[i].state = MODEMSIM_LINK_CLOSED;
+  emitAt(sim, *t + 10, "\r\n+NETCLOSE: 0\r\n");
+  return RES_OK;
+}
+
+
+static int cmdCIPMODE(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) resp;
+  (void) t;
+
+  if (op != '=') return RES_OK;
+  if (sim->netOpen) return RES_ERROR;
+  sim->cipMode = (uint8_t) argInt(args, 0);
+  return RES_OK;
+}
+
+
+static int cmdCIPSRIP(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) resp;
+  (void) t;
+
+  if (op == '=') sim->srip = (uint8_t) argInt(args, 0);
+  return RES_OK;
+}
+
+
+static int cmdCIPRXGET(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  ModemSim_Link_t *link;
+  int mode = argInt(args, 0);
+  int linkNum = argInt(args, 1);
+  uint32_t readLen;
+
+  (void) t;
+
+  if (op != '=') return RES_OK;
+  if (mode == 0 || mode == 1) {
+    sim->manualRx = (uint8_t) mode;
+    return RES_OK;
+  }
+  if (linkNum < 0 || linkNum >= MODEMSIM_NUM_OF_LINK) return RES_ERROR;
+  link = &sim->links[linkNum];
+
+  if (mode == 4) {
+    respPrintf(resp, "\r\n+CIPRXGET: 4,%d,%u\r\n", linkNum, link->rxLen);
+    return RES_OK;
+  }
+  if (mode != 2) return RES_ERROR;
+
+  // modem gives at most 1500 bytes per read
+  readLen = (uint32_t) argInt(args, 2);
+  if (readLen > 1500) readLen = 1500;
+  if (readLen > link->rxLen) readLen = link->rxLen;
+
+  respPrintf(resp, "\r\n+CIPRXGET: 2,%d,%u,%u\r\n", linkNum, readLen, link->rxLen - readLen);
+  respAppend(resp, link->rx, readLen);
+  link->rxLen -= readLen;
+  memmove(link->rx, link->rx + readLen, link->rxLen);
+  return RES_OK;
+}
+
+
+static int cmdCIPOPEN(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  ModemSim_Link_t *link;
+  char type[8];
+  int linkNum = argInt(args, 0);
+
+  if (op != '=') return RES_OK;
+  if (linkNum < 0 || linkNum >= MODEMSIM_NUM_OF_LINK) return RES_ERROR;
+  link = &sim->links[linkNum];
+
+  if (!sim->netOpen) {
+    respPrintf(resp, "\r\n+CIPOPEN: %d,1\r\n", linkNum);
+    return RES_ERROR;
+  }
+  if (link->state == MODEMSIM_LINK_OPEN) {
+    respPrintf(resp, "\r\n+CIPOPEN: %d,4\r\n", linkNum);
+    return RES_ERROR;
+  }
+
+  linkReset(link);
+  argStr(args, 1, type, sizeof(type));
+  link->isUDP = (strcmp(type, "UDP") == 0);
+  if (link->isUDP) {
+    link->port = (uint16_t) argInt(args, 4);
+  }
+  else {
+    argStr(args, 2, link->host, sizeof(link->host));
+    link->port = (uint16_t) argInt(args, 3);
+  }
+  link->state = MODEMSIM_LINK_OPEN;
+
+  // transparent, CONNECT instead of OK and URC
+  if (sim->cipMode == 1 && linkNum == 0) {
+    emitAt(sim, *t + sim->delay.connect, "\r\nCONNECT 115200\r\n");
+    schedule(sim, *t + sim->delay.connect, NULL, 0, actionOnline, 0);
+    return RES_NONE;
+  }
+
+  emitAt(sim, *t + (link->isUDP? 10: sim->delay.connect), "\r\n+CIPOPEN: %d,0\r\n", linkNum);
+  return RES_OK;
+}
+
+
+static int cmdCIPSEND(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int linkNum = argInt(args, 0);
+  int length = argInt(args, 1);
+
+  (void) resp;
+
+  if (op != '=' || linkNum < 0 || linkNum >= MODEMSIM_NUM_OF_LINK || length <= 0) return RES_ERROR;
+  if (sim->links[linkNum].state != MODEMSIM_LINK_OPEN) return RES_ERROR;
+
+  emitAt(sim, *t, "\r\n> ");
+  sim->dataLink = &sim->links[linkNum];
+  sim->dataLinkNum = linkNum;
+  sim->dataLeft = (uint32_t) length;
+  return RES_NONE;
+}
+
+
+static int cmdCIPCLOSE(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int linkNum = argInt(args, 0);
+
+  if (op == '?') {
+    respPrintf(resp, "\r\n+CIPCLOSE: ");
+    for (int i = 0; i < MODEMSIM_NUM_OF_LINK; i++)
+      respPrintf(resp, (i == 0)? "%d": ",%d", sim->links[i].state == MODEMSIM_LINK_OPEN);
+    respPrintf(resp, "\r\n");
+    return RES_OK;
+  }
+
+  if (linkNum < 0 || linkNum >= MODEMSIM_NUM_OF_LINK) return RES_ERROR;
+  if (sim->links[linkNum].state != MODEMSIM_LINK_OPEN) {
+    respPrintf(resp, "\r\n+CIPCLOSE: %d,4\r\n", linkNum);
+    return RES_ERROR;
+  }
+  sim->links[linkNum].state = MODEMSIM_LINK_CLOSED;
+  emitAt(sim, *t + 10, "\r\n+CIPCLOSE: %d,0\r\n", linkNum);
+  return RES_OK;
+}
+
+
+static int cmdSERVERSTART(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int index = argInt(args, 1);
+
+  (void) resp;
+  (void) t;
+
+  if (op != '=' || !sim->netOpen || index < 0 || index >= MODEMSIM_NUM_OF_SERVER) return RES_ERROR;
+  if (sim->servers[index]) return RES_ERROR;
+  sim->servers[index] = 1;
+  return RES_OK;
+}
+
+
+static int cmdSERVERSTOP(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int index = argInt(args, 0);
+
+  (void) resp;
+
+  if (op != '=' || index < 0 || index >= MODEMSIM_NUM_OF_SERVER) return RES_ERROR;
+  sim->servers[index] = 0;
+  emitAt(sim, *t + 10, "\r\n+SERVERSTOP: %d,0\r\n", index);
+  return RES_OK;
+}
+
+
+static int cmdCDNSGIP(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  char host[64];
+  uint32_t hash = 0;
+
+  if (op != '=') return RES_ERROR;
+  argStr(args, 0, host, sizeof(host));
+  *t += sim->delay.dns;
+
+  if (sim->dnsFail) {
+    respPrintf(resp, "\r\n+CDNSGIP: 0,10\r\n");
+    return RES_ERROR;
+  }
+  for (char *c = host; *c; c++) hash = hash * 31 + (uint8_t) *c;
+  respPrintf(resp, "\r\n+CDNSGIP: 1,\"%s\",\"10.0.%u.%u\"\r\n", host, (hash >> 8) & 0xFF, hash & 0xFF);
+  return RES_OK;
+}
+
+
+static int cmdCCHSTART(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) op;
+  (void) args;
+
+  if (sim->cchStarted) {
+    respPrintf(resp, "\r\n+CCHSTART: 1\r\n");
+    return RES_ERROR;
+  }
+  sim->cchStarted = 1;
+  emitAt(sim, *t + 10, "\r\n+CCHSTART: 0\r\n");
+  return RES_OK;
+}
+
+
+static int cmdCCHSTOP(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) op;
+  (void) args;
+  (void) resp;
+
+  sim->cchStarted = 0;
+  for (int i = 0; i < MODEMSIM_NUM_OF_SESSION; i++) sim->sessions[i].state = MODEMSIM_LINK_CLOSED;
+  emitAt(sim, *t + 10, "\r\n+CCHSTOP: 0\r\n");
+  return RES_OK;
+}
+
+
+static int cmdCCHOPEN(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  ModemSim_Link_t *session;
+  int index = argInt(args, 0);
+
+  (void) resp;
+
+  if (op != '=' || !sim->cchStarted || index < 0 || index >= MODEMSIM_NUM_OF_SESSION) return RES_ERROR;
+  session = &sim->sessions[index];
+  if (session->state == MODEMSIM_LINK_OPEN) return RES_ERROR;
+
+  linkReset(session);
+  argStr(args, 1, session->host, sizeof(session->host));
+  session->port = (uint16_t) argInt(args, 2);
+  session->state = MODEMSIM_LINK_OPEN;
+
+  // TLS handshake takes a few round-trips
+  emitAt(sim, *t + 3 * sim->delay.connect, "\r\n+CCHOPEN: %d,0\r\n", index);
+  return RES_OK;
+}
+
+
+static int cmdCCHSEND(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int index = argInt(args, 0);
+  int length = argInt(args, 1);
+
+  (void) resp;
+
+  if (op != '=' || index < 0 || index >= MODEMSIM_NUM_OF_SESSION || length <= 0) return RES_ERROR;
+  if (sim->sessions[index].state != MODEMSIM_LINK_OPEN) return RES_ERROR;
+
+  emitAt(sim, *t, "\r\n> ");
+  sim->dataLink = &sim->sessions[index];
+  sim->dataLinkNum = -1;
+  sim->dataLeft = (uint32_t) length;
+  return RES_NONE;
+}
+
+
+static int cmdCCHCLOSE(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  int index = argInt(args, 0);
+
+  (void) resp;
+
+  if (op != '=' || index < 0 || index >= MODEMSIM_NUM_OF_SESSION) return RES_ERROR;
+  if (sim->sessions[index].state != MODEMSIM_LINK_OPEN) return RES_ERROR;
+  sim->sessions[index].state = MODEMSIM_LINK_CLOSED;
+  emitAt(sim, *t + 10, "\r\n+CCHCLOSE: %d,0\r\n", index);
+  return RES_OK;
+}
+
+
+static int cmdHTTPACTION(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  (void) resp;
+
+  if (op != '=') return RES_ERROR;
+  emitAt(sim, *t + sim->delay.connect, "\r\n+HTTPACTION: %d,%d,%u\r\n",
+         argInt(args, 0), sim->httpStatus, (unsigned) strlen(sim->httpBody));
+  return RES_OK;
+}
+
+
+static int cmdHTTPHEAD(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  static const char head[] = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n\r\n";
+
+  (void) sim;
+  (void) op;
+  (void) args;
+
+  respPrintf(resp, "\r\nOK\r\n");
+  emitAt(sim, *t, "%s", (char*) resp->buf);
+  resp->len = 0;
+  emitAt(sim, *t, "\r\n+HTTPHEAD: DATA,%u\r\n%s", (unsigned) sizeof(head) - 1, head);
+  return RES_NONE;
+}
+
+
+static int cmdHTTPREAD(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  uint32_t bodyLen = strlen(sim->httpBody);
+  uint32_t offset = (uint32_t) argInt(args, 0);
+  uint32_t len = (uint32_t) argInt(args, 1);
+
+  if (op != '=') return RES_ERROR;
+  if (offset > bodyLen) offset = bodyLen;
+  if (len > bodyLen - offset) len = bodyLen - offset;
+
+  respPrintf(resp, "\r\nOK\r\n");
+  respPrintf(resp, "\r\n+HTTPREAD: DATA,%u\r\n", len);
+  respAppend(resp, sim->httpBody + offset, len);
+  schedule(sim, *t, resp->buf, resp->len, NULL, 0);
+  resp->len = 0;
+  return RES_NONE;
+}
+
+
+static int cmdCGPS(ModemSim_t *sim, char op, const char *args, Resp_t *resp, uint32_t *t)
+{
+  if (op == '?') {
+    respPrintf(resp, "\r\n+CGPS: %d,1\r\n", sim->gpsOn);
+    return RES_OK;
+  }
+  if (op != '=') return RES_ERROR;
+
+  if (argInt(args, 0) == 1) {
+    if (sim->gpsOn) return RES_ERROR;
+    sim->gpsOn = 1;
+    sim->gpsGen++;
+    schedule(sim, *t + 1000, NULL, 0, actionNMEA, sim->gpsGen);
+    return RES_OK;
+  }
+  sim->gpsOn = 0;
+  emitAt(sim, *t + 10, "\r\n+CGPS: 0\r\n");
+  return RES_OK;
+}
+
+
+/*
+ * Virtual clock transport, reading with timeout moves the clock to the
+ * next modem output so waits cost no real time
+ */
+uint32_t ModemSim_Tick(void)
+{
+  return vnow;
+}
+
+
+void ModemSim_Delay(uint32_t ms)
+{
+  // events are ordered by signed distance, keep steps below half range
+  while (ms) {
+    uint32_t step = (ms > 0x40000000)? 0x40000000: ms;
+    vnow += step;
+    ms -= step;
+    if (vsim != NULL) ModemSim_Advance(vsim, vnow);
+  }
+}
+
+
+void ModemSim_SetTick(uint32_t tick)
+{
+  vnow = tick;
+  if (vsim != NULL) {
+    vsim->now = tick;
+    vsim->busyUntil = tick;
+    vsim->lineFree = tick;
+    vsim->lineFreeUs = 0;
+    vsim->lastInputTick = tick;
+  }
+}
+
+
+uint8_t ModemSim_IsReadable(void *device)
+{
+  ModemSim_t *sim = (ModemSim_t*) device;
+
+  vsim = sim;
+  ModemSim_Advance(sim, vnow);
+  return sim->outLen > 0;
+}
+
+
+int ModemSim_Read(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  ModemSim_t *sim = (ModemSim_t*) device;
+  uint32_t deadline = vnow + timeout;
+  uint32_t next;
+
+  vsim = sim;
+  ModemSim_Advance(sim, vnow);
+  while (sim->outLen == 0 && timeout > 0) {
+    if (!ModemSim_NextEvent(sim, &next) || (int32_t)(next - deadline) > 0) {
+      vnow = deadline;
+      ModemSim_Advance(sim, vnow);
+      break;
+    }
+    if ((int32_t)(next - vnow) > 0) vnow = next;
+    ModemSim_Advance(sim, vnow);
+  }
+  return (int) ModemSim_Output(sim, dst, sz);
+}
+
+
+int ModemSim_Write(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  ModemSim_t *sim = (ModemSim_t*) device;
+  uint64_t us = sim->inputUs + (uint64_t) sz * sim->delay.byteTime;
+
+  (void) timeout;
+
+  // blocking UART write, returns once the bytes are out
+  vsim = sim;
+  sim->inputUs = (uint32_t) (us % 1000);
+  if (us >= 1000) ModemSim_Delay((uint32_t) (us / 1000));
+  ModemSim_Advance(sim, vnow);
+  ModemSim_Input(sim, src, sz);
+  return sz;
+}
+
+
+int ModemSim_Writeline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  ModemSim_Write(device, src, sz, timeout);
+  ModemSim_Write(device, (const uint8_t*) "\r\n", 2, timeout);
+  return sz;
+}
@@ -0,0 +1,183 @@
+/*
+ * modem_sim.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_MODEM_SIM_H_
+#define HOST_MODEM_SIM_H_
+
+#include <stdint.h>
+
+/**
+ * Scripted SIM7600 for host builds. Commands written by the driver are
+ * answered with configurable delays, URC and peer traffic are injected
+ * by the test. Time is either a virtual clock (ModemSim_Tick) that jumps
+ * to the next modem output whenever the driver waits, or real time when
+ * the modem runs behind a pty (ModemSim_PtyStart). The virtual clock is
+ * per thread, so modems driven from separate threads run independently.
+ */
+
+#define MODEMSIM_NUM_OF_LINK    10
+#define MODEMSIM_NUM_OF_SESSION 2
+#define MODEMSIM_NUM_OF_SERVER  4
+#define MODEMSIM_NUM_OF_RULE    16
+#define MODEMSIM_LINE_SIZE      1024
+#define MODEMSIM_LOG_SIZE       65536
+
+#define MODEMSIM_LINK_CLOSED    0
+#define MODEMSIM_LINK_OPEN      1
+
+typedef struct ModemSim_s ModemSim_t;
+
+typedef struct {
+  uint8_t   state;
+  uint8_t   isUDP;
+  char      host[64];
+  uint16_t  port;
+
+  // bytes the driver sent, oldest dropped when full
+  uint8_t   tx[MODEMSIM_LOG_SIZE];
+  uint32_t  txLen;
+  uint32_t  sends;                // CIPSEND or CCHSEND accepted
+
+  // held for AT+CIPRXGET
+  uint8_t   rx[MODEMSIM_LOG_SIZE];
+  uint32_t  rxLen;
+} ModemSim_Link_t;
+
+typedef struct {
+  char      *prefix;
+  char      *reply;
+  uint32_t  delay;
+  int32_t   count;                // replies left, -1 forever
+} ModemSim_Rule_t;
+
+typedef struct {
+  uint32_t  tick;
+  uint32_t  seq;
+  uint8_t   *data;
+  uint32_t  len;
+  void      (*action)(ModemSim_t*, int arg);
+  int       arg;
+  uint8_t   isOnLine;             // data already timed on the serial line
+} ModemSim_Event_t;
+
+struct ModemSim_s {
+  uint32_t  now;
+
+  // delays in ms
+  struct {
+    uint32_t cmd;                 // final result of plain command
+    uint32_t connect;             // +CIPOPEN, +CCHOPEN, CONNECT
+    uint32_t netOpen;             // +NETOPEN
+    uint32_t dns;                 // +CDNSGIP
+    uint32_t scan;                // AT+COPS=?
+    uint32_t sendAck;             // +CIPSEND after OK
+    uint32_t udpEcho;             // UDP datagram back from the remote, 0 for no echo
+    uint32_t byteTime;            // us per byte on the line, both ways, 0 for no limit
+  } delay;
+
+  // modem state
+  uint8_t   echo;
+  uint8_t   simReady;
+  uint8_t   csq;
+  uint8_t   creg;                 // stat of +CREG, +CGREG and +CEREG
+  uint8_t   cgreg;
+  uint8_t   regReport;            // <n> of AT+CREG=
+  uint8_t   netOpen;
+  uint8_t   netOpenErr;           // <err> of next +NETOPEN
+  uint8_t   cipMode;
+  uint8_t   srip;
+  uint8_t   manualRx;
+  uint8_t   dnsFail;
+  uint8_t   cchStarted;
+  uint8_t   gpsOn;
+  uint8_t   isStream;             // link 0 is raw pipe
+  uint8_t   gpsGen;               // stops NMEA timer of previous CGPS=1
+  uint8_t   servers[MODEMSIM_NUM_OF_SERVER];
+  char      operator[8];
+  const char *httpBody;
+  uint16_t  httpStatus;
+  uint32_t  busyUntil;            // modem answers one command at a time
+  uint32_t  lineFree;             // serial line to driver idle from this tick
+  uint32_t  lineFreeUs;           // and us past it
+  uint32_t  inputUs;              // driver bytes on the line not yet a whole ms
+
+  ModemSim_Link_t   links[MODEMSIM_NUM_OF_LINK];
+  ModemSim_Link_t   sessions[MODEMSIM_NUM_OF_SESSION];
+  ModemSim_Rule_t   rules[MODEMSIM_NUM_OF_RULE];
+  uint8_t           ruleCount;
+
+  // command lines received, '\n' separated
+  char      *log;
+  uint32_t  logLen;
+  uint32_t  logSize;
+  uint32_t  commands;
+
+  // input parser
+  char      line[MODEMSIM_LINE_SIZE];
+  uint16_t  lineLen;
+  ModemSim_Link_t *dataLink;      // CIPSEND payload target
+  int       dataLinkNum;
+  uint32_t  dataLeft;
+  uint8_t   escapeMatch;          // "+++" seen in stream
+  uint32_t  lastInputTick;
+
+  // scheduled output and actions, ordered by tick then seq
+  ModemSim_Event_t  *events;
+  uint32_t  eventCount;
+  uint32_t  eventSize;
+  uint32_t  seq;
+
+  // output ready for the driver
+  uint8_t   *out;
+  uint32_t  outLen;
+  uint32_t  outSize;
+};
+
+void      ModemSim_Init(ModemSim_t*);
+void      ModemSim_Free(ModemSim_t*);
+void      ModemSim_PowerOn(ModemSim_t*);
+
+// transport independent core
+void      ModemSim_Input(ModemSim_t*, const uint8_t *data, uint32_t len);
+void      ModemSim_Advance(ModemSim_t*, uint32_t now);
+uint32_t  ModemSim_Output(ModemSim_t*, uint8_t *dst, uint32_t size);
+uint8_t   ModemSim_NextEvent(ModemSim_t*, uint32_t *tick);
+
+// scripting
+void      ModemSim_On(ModemSim_t*, const char *prefix, uint32_t delay, int32_t count, const char *reply);
+int       ModemSim_LoadScript(ModemSim_t*, const char *path);
+void      ModemSim_Emit(ModemSim_t*, uint32_t delay, const uint8_t *data, uint32_t len);
+void      ModemSim_URC(ModemSim_t*, uint32_t delay, const char *format, ...);
+void      ModemSim_SetReg(ModemSim_t*, uint8_t stat);
+void      ModemSim_NetDrop(ModemSim_t*);
+void      ModemSim_PeerSend(ModemSim_t*, int linkNum, const uint8_t *data, uint32_t len);
+void      ModemSim_PeerClose(ModemSim_t*, int linkNum);
+void      ModemSim_SessionSend(ModemSim_t*, int session, const uint8_t *data, uint32_t len);
+void      ModemSim_SessionClose(ModemSim_t*, int session);
+void      ModemSim_ClientConnect(ModemSim_t*, int linkNum, int server, const char *addr);
+uint32_t  ModemSim_Count(ModemSim_t*, const char *prefix);
+void      ModemSim_ClearLog(ModemSim_t*);
+
+// virtual clock transport, one modem per process
+uint32_t  ModemSim_Tick(void);
+void      ModemSim_Delay(uint32_t ms);
+void      ModemSim_SetTick(uint32_t tick);
+uint8_t   ModemSim_IsReadable(void *device);
+int       ModemSim_Read(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+int       ModemSim_Write(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+int       ModemSim_Writeline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+
+// pty transport, modem runs in its own thread on real time
+int       ModemSim_PtyStart(ModemSim_t*);
+void      ModemSim_PtyStop(ModemSim_t*);
+uint32_t  ModemSim_PtyTick(void);
+void      ModemSim_PtyDelay(uint32_t ms);
+uint8_t   ModemSim_PtyIsReadable(void *device);
+int       ModemSim_PtyRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+int       ModemSim_PtyWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+int       ModemSim_PtyWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+
+#endif /* HOST_MODEM_SIM_H_ */
@@ -0,0 +1,163 @@
+/*
+ * pty.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#define _GNU_SOURCE
+#include "modem_sim.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Modem runs on the master side of a pty in its own thread, the driver
+ * talks to the slave side like a real tty. Only the thread touches the
+ * ModemSim_t while running.
+ */
+
+static int masterFd = -1;
+static int slaveFd = -1;
+static volatile int isRunning;
+static pthread_t thread;
+
+
+uint32_t ModemSim_PtyTick(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t) ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+
+void ModemSim_PtyDelay(uint32_t ms)
+{
+  usleep((useconds_t) ms * 1000);
+}
+
+
+static void *modemLoop(void *arg)
+{
+  ModemSim_t *sim = (ModemSim_t*) arg;
+  struct pollfd pfd = {.fd = masterFd, .events = POLLIN};
+  uint8_t buf[512];
+  uint32_t next;
+  int timeout;
+  int len;
+  int written;
+
+  while (isRunning) {
+    ModemSim_Advance(sim, ModemSim_PtyTick());
+
+    while (sim->outLen) {
+      written = write(masterFd, sim->out, sim->outLen);
+      if (written <= 0) break;
+      sim->outLen -= written;
+      memmove(sim->out, sim->out + written, sim->outLen);
+    }
+
+    timeout = 10;
+    if (ModemSim_NextEvent(sim, &next)) {
+      int32_t dt = (int32_t) (next - ModemSim_PtyTick());
+      if (dt < timeout) timeout = (dt < 0)? 0: dt;
+    }
+
+    if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+      len = read(masterFd, buf, sizeof(buf));
+      if (len > 0) {
+        sim->now = ModemSim_PtyTick();
+        ModemSim_Input(sim, buf, (uint32_t) len);
+      }
+    }
+  }
+  return NULL;
+}
+
+
+int ModemSim_PtyStart(ModemSim_t *sim)
+{
+  struct termios tio;
+
+  masterFd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (masterFd < 0) return -1;
+  if (grantpt(masterFd) != 0 || unlockpt(masterFd) != 0) goto error;
+
+  slaveFd = open(ptsname(masterFd), O_RDWR | O_NOCTTY);
+  if (slaveFd < 0) goto error;
+  tcgetattr(slaveFd, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slaveFd, TCSANOW, &tio);
+
+  sim->now = ModemSim_PtyTick();
+  sim->busyUntil = sim->now;
+  sim->lastInputTick = sim->now;
+  isRunning = 1;
+  if (pthread_create(&thread, NULL, modemLoop, sim) != 0) goto error;
+  return 0;
+
+error:
+  if (slaveFd >= 0) close(slaveFd);
+  close(masterFd);
+  masterFd = slaveFd = -1;
+  return -1;
+}
+
+
+void ModemSim_PtyStop(ModemSim_t *sim)
+{
+  (void) sim;
+
+  if (masterFd < 0) return;
+  isRunning = 0;
+  pthread_join(thread, NULL);
+  close(slaveFd);
+  close(masterFd);
+  masterFd = slaveFd = -1;
+}
+
+
+uint8_t ModemSim_PtyIsReadable(void *device)
+{
+  struct pollfd pfd = {.fd = slaveFd, .events = POLLIN};
+
+  (void) device;
+  return poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN);
+}
+
+
+int ModemSim_PtyRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  struct pollfd pfd = {.fd = slaveFd, .events = POLLIN};
+  int len;
+
+  (void) device;
+  if (poll(&pfd, 1, (int) timeout) <= 0) return 0;
+  len = read(slaveFd, dst, sz);
+  return (len < 0)? 0: len;
+}
+
+
+int ModemSim_PtyWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  int len;
+
+  (void) device;
+  (void) timeout;
+  len = write(slaveFd, src, sz);
+  return (len < 0)? 0: len;
+}
+
+
+int ModemSim_PtyWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  int len = ModemSim_PtyWrite(device, src, sz, timeout);
+
+  ModemSim_PtyWrite(device, (const uint8_t*) "\r\n", 2, timeout);
+  return len;
+}
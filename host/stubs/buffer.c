@@ -0,0 +1,56 @@
+/*
+ * buffer.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "buffer.h"
+
+
+uint16_t Buffer_Write(Buffer_t *buf, const uint8_t *data, uint16_t len)
+{
+  uint16_t writeLen = 0;
+  uint16_t next;
+
+  if (buf->size == 0) return 0;
+
+  while (writeLen < len) {
+    next = (buf->w_idx + 1) % buf->size;
+    if (next == buf->r_idx) break;
+    buf->buffer[buf->w_idx] = data[writeLen++];
+    buf->w_idx = next;
+  }
+  return writeLen;
+}
+
+
+uint16_t Buffer_Read(Buffer_t *buf, uint8_t *data, uint16_t len)
+{
+  uint16_t readLen = 0;
+
+  while (readLen < len && buf->r_idx != buf->w_idx) {
+    data[readLen++] = buf->buffer[buf->r_idx];
+    buf->r_idx = (buf->r_idx + 1) % buf->size;
+  }
+  return readLen;
+}
+
+
+uint16_t Buffer_Length(Buffer_t *buf)
+{
+  if (buf->size == 0) return 0;
+  return (buf->w_idx + buf->size - buf->r_idx) % buf->size;
+}
+
+
+uint8_t Buffer_IsAvailable(Buffer_t *buf)
+{
+  return buf->r_idx != buf->w_idx;
+}
+
+
+void Buffer_Clear(Buffer_t *buf)
+{
+  buf->r_idx = 0;
+  buf->w_idx = 0;
+}
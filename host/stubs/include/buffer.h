@@ -0,0 +1,29 @@
+/*
+ * buffer.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_BUFFER_H_
+#define HOST_BUFFER_H_
+
+#include <stdint.h>
+
+/*
+ * Host build of the ring buffer the driver is linked with on target,
+ * one slot is kept free so r_idx == w_idx means empty
+ */
+typedef struct {
+  uint8_t   *buffer;
+  uint16_t  size;
+  uint16_t  r_idx;
+  uint16_t  w_idx;
+} Buffer_t;
+
+uint16_t  Buffer_Write(Buffer_t*, const uint8_t *data, uint16_t len);
+uint16_t  Buffer_Read(Buffer_t*, uint8_t *data, uint16_t len);
+uint16_t  Buffer_Length(Buffer_t*);
+uint8_t   Buffer_IsAvailable(Buffer_t*);
+void      Buffer_Clear(Buffer_t*);
+
+#endif /* HOST_BUFFER_H_ */
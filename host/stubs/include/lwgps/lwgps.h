@@ -0,0 +1,25 @@
+/*
+ * lwgps.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef HOST_LWGPS_H_
+#define HOST_LWGPS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Host stand-in for lwgps, only counts NMEA sentences so tests can
+ * check what reached the parser
+ */
+typedef struct {
+  uint32_t  sentences;
+  uint32_t  bytes;
+} lwgps_t;
+
+uint8_t   lwgps_init(lwgps_t*);
+uint8_t   lwgps_process(lwgps_t*, const void *data, size_t len);
+
+#endif /* HOST_LWGPS_H_ */
@@ -0,0 +1,27 @@
+/*
+ * lwgps.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "lwgps/lwgps.h"
+#include <string.h>
+
+
+uint8_t lwgps_init(lwgps_t *gh)
+{
+  memset(gh, 0, sizeof(lwgps_t));
+  return 1;
+}
+
+
+uint8_t lwgps_process(lwgps_t *gh, const void *data, size_t len)
+{
+  const uint8_t *bytes = (const uint8_t*) data;
+
+  for (size_t i = 0; i < len; i++) {
+    if (bytes[i] == '$') gh->sentences++;
+  }
+  gh->bytes += len;
+  return 1;
+}
@@ -41,6 +41,26 @@
 #define SIM_EVENT_ON_STARTED    0x02
 #define SIM_EVENT_ON_REGISTERED 0x04
 
+// subsystems serviced by SIM_HandleEvents only when marked pending
+typedef enum {
+  SIM_SUBSYS_CORE = 0,
+  SIM_SUBSYS_NET,
+  SIM_SUBSYS_SOCK,
+  SIM_SUBSYS_HTTP,
+  SIM_SUBSYS_GPS,
+  SIM_SUBSYS_MAX,
+} SIM_Subsys_t;
+
+#define SIM_SUBSYS_ALL ((1 << SIM_SUBSYS_MAX) - 1)
+
+// bring-up state, retried at SIM_HandlerTypeDef.bringUp.wakeTick
+typedef enum {
+  SIM_STATE_AT = 0,
+  SIM_STATE_CPIN,
+  SIM_STATE_CREG,
+  SIM_STATE_READY,
+} SIM_State_t;
+
 // MACROS
 
 
@@ -48,9 +68,85 @@ typedef uint8_t (*asyncResponseHandler) (uint16_t bufLen);
 typedef enum {
   SIM_OK,
   SIM_ERROR,
-  SIM_TIMEOUT
+  SIM_TIMEOUT,
+  SIM_BUSY,       // long queued command runs, modem answers nothing else
 } SIM_Status_t;
 
+struct SIM_HandlerTypeDef;
+
+/**
+ * read returns number of bytes copied to dst, when timeout is 0 it must
+ * return immediately with bytes that already received.
+ */
+typedef struct {
+  void *device;
+  uint8_t (*isReadable)(void *device);
+  int (*read)(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+  int (*write)(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+  int (*writeline)(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+} SIM_Serial_t;
+
+typedef void (*SIM_CmdCallback_t)(struct SIM_HandlerTypeDef*, SIM_Status_t, void *ctx);
+
+typedef struct {
+  char              cmd[SIM_CMD_QUEUE_CMD_SIZE];
+  uint16_t          cmdLen;
+  const char        *respCode;
+  uint16_t          rcsize;
+  uint8_t           *respData;
+  uint16_t          rdsize;
+  uint32_t          timeout;
+  SIM_CmdCallback_t callback;
+  void              *ctx;
+} SIM_CmdEntry_t;
+
+typedef uint8_t (*SIM_URCHandler_t)(struct SIM_HandlerTypeDef*);
+
+typedef void (*SIM_DataSink_t)(void *ctx, const uint8_t *data, uint16_t len);
+
+#define SIM_URC_NONE        0xFF
+#define SIM_URC_TABLE_SIZE  96    // printable ascii 0x20 - 0x7F
+
+typedef struct {
+  const char        *prefix;
+  uint8_t           prefixLen;
+  uint8_t           next;         // next handler with same key or SIM_URC_NONE
+  SIM_URCHandler_t  handler;
+} SIM_URC_t;
+
+#if SIM_EN_FEATURE_STATS
+#define SIM_STATS_NUM_OF_BUCKET 8   // latency < 8ms, 32ms, 128ms, ... 32s, >= 32s
+
+typedef struct {
+  char      prefix[SIM_STATS_PREFIX_SIZE];  // command until '=' or '?'
+  uint32_t  count;
+  uint32_t  timeouts;
+  uint32_t  errors;
+  uint16_t  lastErrCode;                    // code of last +CME ERROR
+  uint32_t  totalTime;                      // send to final result in ms
+  uint32_t  maxTime;
+  uint32_t  histogram[SIM_STATS_NUM_OF_BUCKET];
+  uint32_t  bytesTx;
+  uint32_t  bytesRx;
+} SIM_CmdStats_t;
+#endif /* SIM_EN_FEATURE_STATS */
+
+// settings the modem keeps in NV, fingerprinted to skip them on warm start
+typedef enum {
+  SIM_CONFIG_APN = 0,
+  SIM_CONFIG_NTP,
+  SIM_CONFIG_GPS,
+  SIM_CONFIG_MAX,
+} SIM_Config_t;
+
+#define SIM_OPERATOR_SIZE 8
+
+typedef struct {
+  uint8_t stat;                       // 0 unknown, 1 available, 2 current, 3 forbidden
+  uint8_t act;
+  char    numeric[SIM_OPERATOR_SIZE]; // MCC and MNC
+} SIM_Operator_t;
+
 typedef struct {
   uint8_t year;
   uint8_t month;
@@ -68,22 +164,34 @@ typedef struct SIM_HandlerTypeDef {
   uint8_t             signal;
   uint32_t            timeout;
 
+  // serving cell from +CREG
+  struct {
+    uint16_t lac;
+    uint32_t ci;
+  } cell;
+
   void (*delay)(uint32_t ms);
   uint32_t (*getTick)(void);
 
   void (*mutexLock)(struct SIM_HandlerTypeDef*);
   void (*mutexUnlock)(struct SIM_HandlerTypeDef*);
 
-  struct {
-    void *device;
-    uint8_t (*isReadable)(void *device);
-    int (*read)(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
-    int (*readline)(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
-    int (*readinto)(void *device, Buffer_t *buffer, uint16_t sz, uint32_t timeout);
-    int (*unread)(void *device, uint16_t sz);
-    int (*write)(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
-    int (*writeline)(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
-  } serial;
+  /**
+   * optional, block the caller until notifyEvent or timeout
+   * (condition variable, semaphore or event flag of the OS).
+   * when not set waiters poll with delay(1).
+   */
+  void (*waitEvent)(struct SIM_HandlerTypeDef*, uint32_t timeout);
+  void (*notifyEvent)(struct SIM_HandlerTypeDef*);
+
+  /**
+   * optional, keep fingerprint of applied config in host persistent storage
+   * (flash, EEPROM, backup RAM). load returns 0 when nothing was stored.
+   */
+  uint32_t (*loadConfig)(struct SIM_HandlerTypeDef*, SIM_Config_t);
+  void (*saveConfig)(struct SIM_HandlerTypeDef*, SIM_Config_t, uint32_t fingerprint);
+
+  SIM_Serial_t        serial;
 
   #if SIM_EN_FEATURE_NET
   struct {
@@ -96,6 +204,13 @@ typedef struct SIM_HandlerTypeDef {
       const char *pass;
     } APN;
 
+    uint8_t  cgregStat;     // last +CGREG and +CEREG stat
+    uint8_t  ceregStat;
+    uint8_t  armed;         // SIM_NET_ARMED_*, unarmed deadline is due at once
+    uint32_t pollTick;      // next fallback AT+CGREG? poll
+    uint32_t wakeTick;      // next APN/NETOPEN attempt
+    uint32_t openTick;      // AT+NETOPEN sent
+
     void (*onOpening)(void);
     void (*onOpened)(void);
     void (*onOpenError)(void);
@@ -103,6 +218,42 @@ typedef struct SIM_HandlerTypeDef {
 
     #if SIM_EN_FEATURE_SOCKET
     void *sockets[SIM_NUM_OF_SOCKET];
+    void *servers[SIM_NUM_OF_SERVER];
+    uint32_t jitterSeed;    // xorshift state of reconnect jitter
+
+    // source of the next +RECEIVE, reported with AT+CIPSRIP=1
+    struct {
+      char     host[40];
+      uint16_t port;
+    } recvFrom;
+    uint8_t isSripOn;       // AT+CIPSRIP=1 sent, only once a UDP socket opens
+
+    #if SIM_SOCK_DNS_CACHE
+    // host side DNS cache, resolved by AT+CDNSGIP
+    struct {
+      char     host[64];
+      char     ip[40];
+      uint32_t expireTick;
+      uint32_t refreshTick;   // next background resolve
+    } dns[SIM_SOCK_DNS_CACHE];
+    #endif
+
+    #if SIM_EN_FEATURE_TLS
+    struct {
+      uint8_t  isStarted;                 // AT+CCHSTART done
+      void     *sockets[SIM_NUM_OF_TLS];  // by CCH session, link numbers stay free
+      uint32_t applied[SIM_NUM_OF_TLS];   // fingerprint of SSL context config
+    } tls;
+    #endif
+
+    #if SIM_SOCK_TRANSPARENT
+    // transparent mode, UART is raw pipe of the socket while online
+    struct {
+      void    *socket;
+      uint8_t isOnline;
+      uint8_t closeMatch;   // matched bytes of "\r\nCLOSED\r\n"
+    } stream;
+    #endif
     #endif
 
   } net;
@@ -142,6 +293,7 @@ typedef struct SIM_HandlerTypeDef {
   struct {
     uint8_t   status;
     uint8_t   events;
+    uint32_t  retryTick;
     Buffer_t  buffer;
     uint8_t   readBuffer[SIM_GPS_TMP_BUF_SIZE];
     lwgps_t   lwgps;
@@ -149,18 +301,77 @@ typedef struct SIM_HandlerTypeDef {
   #endif
 
   // Buffers
+  uint8_t  rxBuffer[SIM_RX_BUFFER_SIZE];
+  uint16_t rxHead;
+  uint16_t rxLen;
+  uint16_t rxScanned;     // bytes after rxHead that have no line end
+
   uint8_t  respBuffer[SIM_RESP_BUFFER_SIZE];
   uint16_t respBufferLen;
 
   char     cmdBuffer[SIM_CMD_BUFFER_SIZE];
   uint16_t cmdBufferLen;
 
+  // scratch for parsing response and building command, used under mutexLock
+  uint8_t  respTmp[SIM_TMP_BUFFER_SIZE];
+  uint8_t  cmdTmp[SIM_TMP_BUFFER_SIZE];
+
+  // URC handlers, bucketed by first char of prefix (char after '+' if any)
+  struct {
+    SIM_URC_t handlers[SIM_NUM_OF_URC];
+    uint8_t   count;
+    uint8_t   table[SIM_URC_TABLE_SIZE];
+  } urc;
+
+  #if SIM_EN_FEATURE_STATS
+  struct {
+    SIM_CmdStats_t  cmd[SIM_STATS_NUM_OF_CMD];
+    uint8_t         count;
+    int8_t          running;      // index of command waiting final result
+    uint32_t        sentTick;
+  } stats;
+  #endif
+
+  // async command queue, head is the command sent to modem
+  struct {
+    SIM_CmdEntry_t  entries[SIM_CMD_QUEUE_SIZE];
+    uint8_t         head;
+    uint8_t         tail;
+    uint8_t         isSent;
+    uint32_t        sentTick;
+  } cmdQueue;
+
   uint32_t  initAt;
-} SIM_HandlerTypeDef;
 
+  // result of last AT+COPS=?
+  struct {
+    SIM_Operator_t  list[SIM_NUM_OF_OPERATOR];
+    uint8_t         count;
+    uint8_t         isScanning;
+    uint32_t        scanTick;       // 0 when there is no result
+    char            lastGood[SIM_OPERATOR_SIZE];
+
+    struct {
+      uint8_t pinLastGood;          // register with AT+COPS=4 to last good operator
+    } config;
+  } cops;
+
+  struct {
+    SIM_State_t state;
+    uint32_t    wakeTick;
+    uint32_t    healthTick;     // next CSQ/CREG/CGREG batch when ready
+  } bringUp;
+
+  // work for SIM_HandleEvents, set by URC handlers, API calls and timers
+  struct {
+    uint8_t   bits;                           // 1 << SIM_Subsys_t
+    uint8_t   armed;                          // wakeTick is valid
+    uint32_t  wakeTick[SIM_SUBSYS_MAX];
+    uint8_t   status;                         // state seen on last pass
+    uint8_t   netStatus;
+  } pending;
+} SIM_HandlerTypeDef;
 
-extern uint8_t SIM_CmdTmp[64];
-extern uint8_t SIM_RespTmp[64];
 
 SIM_Status_t  SIM_Init(SIM_HandlerTypeDef*);
 void          SIM_CheckAnyResponse(SIM_HandlerTypeDef*);
@@ -171,6 +382,8 @@ uint8_t       SIM_CheckAT(SIM_HandlerTypeDef*);
 uint8_t       SIM_CheckSignal(SIM_HandlerTypeDef*);
 uint8_t       SIM_CheckSIMCard(SIM_HandlerTypeDef*);
 uint8_t       SIM_ReqisterNetwork(SIM_HandlerTypeDef*);
+SIM_Status_t  SIM_ScanOperators(SIM_HandlerTypeDef*);
+const SIM_Operator_t *SIM_GetOperators(SIM_HandlerTypeDef*, uint8_t *count);
 SIM_Datetime  SIM_GetTime(SIM_HandlerTypeDef*);
 void          SIM_HashTime(SIM_HandlerTypeDef*, char *hashed);
 void          SIM_SendSms(SIM_HandlerTypeDef*);
@@ -0,0 +1,69 @@
+/*
+ * cmux.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SIM7600E_INC_SIMCOM_CMUX_H_
+#define SIM7600E_INC_SIMCOM_CMUX_H_
+
+#include "../simcom.h"
+#include "conf.h"
+
+#if SIM_EN_FEATURE_CMUX
+
+#define SIM_CMUX_CH_CONTROL   1
+#define SIM_CMUX_CH_NMEA      2
+#define SIM_CMUX_CH_DATA      3
+
+struct SIM_CMUX_s;
+
+typedef struct {
+  struct SIM_CMUX_s *mux;
+  uint8_t   dlci;
+  uint8_t   isOpen;
+  uint8_t   rxBuffer[SIM_CMUX_CH_BUFFER_SIZE];
+  uint16_t  rxHead;
+  uint16_t  rxLen;
+  uint32_t  dropped;                  // bytes lost because rxBuffer was full
+} SIM_CMUX_Channel_t;
+
+/**
+ * 3GPP 27.010 basic option multiplexer. Each channel is a SIM_Serial_t, so
+ * the driver runs on the control channel and other channels can be read
+ * independently. Frames are demultiplexed by whoever reads a channel, so
+ * channels of one mux must be read from one task or under one lock.
+ *
+ * The driver routes nothing to the other channels. Socket commands are
+ * sent on the control channel, so their URC and payload come back there
+ * and still share it with AT responses. NMEA reaches the GPS module only
+ * when the application reads SIM_CMUX_CH_NMEA into SIM_GPS_Feed.
+ */
+typedef struct SIM_CMUX_s {
+  SIM_Serial_t        serial;         // physical serial
+  uint32_t            (*getTick)(void);
+  SIM_CMUX_Channel_t  channels[SIM_CMUX_NUM_OF_CHANNEL];
+
+  // receive frame parser
+  struct {
+    uint8_t   state;
+    uint8_t   address;
+    uint8_t   control;
+    uint8_t   lenBytes;
+    uint16_t  len;
+    uint16_t  idx;
+    uint8_t   header[4];              // address, control, length
+    uint8_t   fcs;
+    uint8_t   isAcked;
+    uint8_t   ackDLCI;
+    uint8_t   info[SIM_CMUX_MAX_FRAME_SIZE];
+  } rx;
+} SIM_CMUX_t;
+
+SIM_Status_t  SIM_CMUX_Start(SIM_CMUX_t*, SIM_HandlerTypeDef*);
+void          SIM_CMUX_Stop(SIM_CMUX_t*, SIM_HandlerTypeDef*);
+SIM_Serial_t  SIM_CMUX_GetSerial(SIM_CMUX_t*, uint8_t channel);
+void          SIM_CMUX_Process(SIM_CMUX_t*);
+
+#endif /* SIM_EN_FEATURE_CMUX */
+#endif /* SIM7600E_INC_SIMCOM_CMUX_H_ */
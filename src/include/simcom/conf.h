@@ -17,6 +17,10 @@
 #define SIM_EN_FEATURE_SOCKET 0
 #endif
 
+#ifndef SIM_EN_FEATURE_TLS
+#define SIM_EN_FEATURE_TLS 0    // needs SIM_EN_FEATURE_SOCKET
+#endif
+
 #ifndef SIM_EN_FEATURE_NTP
 #define SIM_EN_FEATURE_NTP 1
 #endif
@@ -25,12 +29,24 @@
 #define SIM_EN_FEATURE_HTTP 0
 #endif
 
-#define SIM_EN_FEATURE_NET SIM_EN_FEATURE_NTP|SIM_EN_FEATURE_SOCKET|SIM_EN_FEATURE_HTTP
+#define SIM_EN_FEATURE_NET (SIM_EN_FEATURE_NTP|SIM_EN_FEATURE_SOCKET|SIM_EN_FEATURE_HTTP)
 
 #ifndef SIM_EN_FEATURE_GPS
 #define SIM_EN_FEATURE_GPS 1
 #endif
 
+#ifndef SIM_EN_FEATURE_STATS
+#define SIM_EN_FEATURE_STATS 0
+#endif
+
+#ifndef SIM_EN_FEATURE_TRACE
+#define SIM_EN_FEATURE_TRACE 0
+#endif
+
+#ifndef SIM_EN_FEATURE_CMUX
+#define SIM_EN_FEATURE_CMUX 0
+#endif
+
 #ifndef SIM_NUM_OF_SOCKET
 #define SIM_NUM_OF_SOCKET  4
 #endif
@@ -47,12 +63,153 @@
 #define SIM_RESP_BUFFER_SIZE  256
 #endif
 
+#ifndef SIM_TMP_BUFFER_SIZE
+#define SIM_TMP_BUFFER_SIZE  64
+#endif
+
+#ifndef SIM_RX_BUFFER_SIZE
+#define SIM_RX_BUFFER_SIZE  512
+#endif
+
+#ifndef SIM_MAX_TOKENS
+#define SIM_MAX_TOKENS  12
+#endif
+
+#ifndef SIM_NUM_OF_URC
+#define SIM_NUM_OF_URC  24
+#endif
+
+#ifndef SIM_CMD_QUEUE_SIZE
+#define SIM_CMD_QUEUE_SIZE  4
+#endif
+
+#ifndef SIM_CMD_QUEUE_CMD_SIZE
+#define SIM_CMD_QUEUE_CMD_SIZE  64
+#endif
+
+#ifndef SIM_RETRY_INTERVAL
+#define SIM_RETRY_INTERVAL  3000    // AT, CPIN and CREG bring-up retry
+#endif
+
+#ifndef SIM_BATCH_SIZE
+#define SIM_BATCH_SIZE      10
+#endif
+
+#ifndef SIM_BATCH_CMD_SIZE
+#define SIM_BATCH_CMD_SIZE  160
+#endif
+
+#ifndef SIM_HEALTH_INTERVAL
+#define SIM_HEALTH_INTERVAL 60000     // CSQ and registration poll when online
+#endif
+
+#ifndef SIM_NUM_OF_OPERATOR
+#define SIM_NUM_OF_OPERATOR   6
+#endif
+
+#ifndef SIM_COPS_SCAN_TIMEOUT
+#define SIM_COPS_SCAN_TIMEOUT 180000  // AT+COPS=? may take minutes
+#endif
+
+#ifndef SIM_COPS_TIMEOUT
+#define SIM_COPS_TIMEOUT      60000   // AT+COPS=0 and AT+COPS=4
+#endif
+
+#ifndef SIM_COPS_CACHE_TTL
+#define SIM_COPS_CACHE_TTL    600000
+#endif
+
+#ifndef SIM_REG_POLL_INTERVAL
+#define SIM_REG_POLL_INTERVAL 30000 // fallback CREG/CGREG poll, URC normally comes first
+#endif
+
+#if SIM_EN_FEATURE_NET
+#ifndef SIM_NET_RETRY_INTERVAL
+#define SIM_NET_RETRY_INTERVAL  5000
+#endif
+#ifndef SIM_NET_OPEN_TIMEOUT
+#define SIM_NET_OPEN_TIMEOUT    30000   // +NETOPEN URC after AT+NETOPEN
+#endif
+#endif
+
+#if SIM_EN_FEATURE_SOCKET
+#ifndef SIM_SOCK_MANUAL_RX
+#define SIM_SOCK_MANUAL_RX      0       // pull received data with AT+CIPRXGET
+#endif
+#ifndef SIM_SOCK_RXGET_MIN
+#define SIM_SOCK_RXGET_MIN      64
+#endif
+#ifndef SIM_SOCK_RXGET_MAX
+#define SIM_SOCK_RXGET_MAX      1500    // modem limit of AT+CIPRXGET=2
+#endif
+#ifndef SIM_SOCK_RXGET_POLL
+#define SIM_SOCK_RXGET_POLL     50      // recheck app space when it was full
+#endif
+#ifndef SIM_SOCK_TRANSPARENT
+#define SIM_SOCK_TRANSPARENT    0       // AT+CIPMODE=1, one TCP socket on link 0 as raw pipe
+#endif
+#ifndef SIM_NUM_OF_SERVER
+#define SIM_NUM_OF_SERVER       1       // listening sockets, modem allows 4
+#endif
+#ifndef SIM_SERVER_BACKLOG
+#define SIM_SERVER_BACKLOG      2       // +CLIENT waiting to be accepted
+#endif
+#ifndef SIM_NUM_OF_TLS
+#define SIM_NUM_OF_TLS          2       // CCH sessions of the modem
+#endif
+#ifndef SIM_SOCK_UDP_BATCH
+#define SIM_SOCK_UDP_BATCH      8       // datagrams sent per lock of the AT channel
+#endif
+#ifndef SIM_SOCK_BACKOFF_MAX
+#define SIM_SOCK_BACKOFF_MAX    120000  // reconnect delay doubles on each failure up to this
+#endif
+#ifndef SIM_SOCK_MAX_OPENING
+#define SIM_SOCK_MAX_OPENING    1       // reconnecting sockets waiting for +CIPOPEN at once
+#endif
+#ifndef SIM_SOCK_DNS_CACHE
+#define SIM_SOCK_DNS_CACHE      2       // resolved hosts kept for reconnect, 0 to disable
+#endif
+#ifndef SIM_SOCK_DNS_TTL
+#define SIM_SOCK_DNS_TTL        600000  // AT+CDNSGIP does not report record TTL
+#endif
+#ifndef SIM_SOCK_DNS_REFRESH
+#define SIM_SOCK_DNS_REFRESH    60000   // resolve again this long before expiry
+#endif
+#ifndef SIM_SOCK_DNS_TIMEOUT
+#define SIM_SOCK_DNS_TIMEOUT    10000
+#endif
+#endif /* SIM_EN_FEATURE_SOCKET */
+
 #if SIM_EN_FEATURE_NTP
 #ifndef SIM_NTP_SYNC_DELAY_TIMEOUT
 #define SIM_NTP_SYNC_DELAY_TIMEOUT 10000
 #endif
 #endif
 
+#if SIM_EN_FEATURE_STATS
+#ifndef SIM_STATS_NUM_OF_CMD
+#define SIM_STATS_NUM_OF_CMD  16
+#endif
+#ifndef SIM_STATS_PREFIX_SIZE
+#define SIM_STATS_PREFIX_SIZE 16
+#endif
+#endif /* SIM_EN_FEATURE_STATS */
+
+#if SIM_EN_FEATURE_CMUX
+#ifndef SIM_CMUX_NUM_OF_CHANNEL
+#define SIM_CMUX_NUM_OF_CHANNEL   3     // control, NMEA, data
+#endif
+#ifndef SIM_CMUX_CH_BUFFER_SIZE
+#define SIM_CMUX_CH_BUFFER_SIZE   512
+#endif
+#ifndef SIM_CMUX_FRAME_SIZE
+#define SIM_CMUX_FRAME_SIZE       31    // N1, max info length of sent frame
+#endif
+#ifndef SIM_CMUX_MAX_FRAME_SIZE
+#define SIM_CMUX_MAX_FRAME_SIZE   128   // max info length of received frame
+#endif
+#endif /* SIM_EN_FEATURE_CMUX */
+
 #ifndef LWGPS_IGNORE_USER_OPTS
 #define LWGPS_IGNORE_USER_OPTS
 #endif
@@ -5,7 +5,7 @@
  *      Author: janoko
  */
 
-#ifndef SIM7600E_INC_GPS_H
+#ifndef SIM7600E_INC_GPS_H_
 #define SIM7600E_INC_GPS_H_
 
 #include "../simcom.h"
@@ -51,8 +51,9 @@ typedef enum {
 } SIM_GPS_ANT_Mode_t;
 
 
-uint8_t SIM_GPS_CheckAsyncResponse(SIM_HandlerTypeDef*);
+void    SIM_GPS_RegisterURC(SIM_HandlerTypeDef*);
 void    SIM_GPS_HandleEvents(SIM_HandlerTypeDef*);
+void    SIM_GPS_Feed(SIM_HandlerTypeDef*, const uint8_t *data, uint16_t len);
 
 void SIM_GPS_Init(SIM_HandlerTypeDef*, uint8_t *buffer, uint16_t bufferSize);
 SIM_Status_t SIM_GPS_DefaultSetup(SIM_HandlerTypeDef*);
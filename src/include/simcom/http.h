@@ -5,7 +5,7 @@
  *      Author: janoko
  */
 
-#ifndef SIM7600E_INC_HTTP_H
+#ifndef SIM7600E_INC_HTTP_H_
 #define SIM7600E_INC_HTTP_H_
 
 #include "../simcom.h"
@@ -50,10 +50,10 @@ typedef struct {
   uint16_t contentHandleLen;
 } SIM_HTTP_Response_t;
 
-uint8_t SIM_HTTP_CheckAsyncResponse(SIM_HandlerTypeDef*);
+void    SIM_HTTP_RegisterURC(SIM_HandlerTypeDef*);
 void    SIM_HTTP_HandleEvents(SIM_HandlerTypeDef*);
 
 SIM_Status_t SIM_HTTP_Get(SIM_HandlerTypeDef*, const char *url, SIM_HTTP_Response_t*, uint32_t timeout);
 
-#endif /* SIM_EN_FEATURE_GPS */
-#endif /* SIM7600E_INC_HTTP_H */
+#endif /* SIM_EN_FEATURE_HTTP */
+#endif /* SIM7600E_INC_HTTP_H_ */
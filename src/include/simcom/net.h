@@ -8,6 +8,9 @@
 #ifndef SIM7600E_INC_SIMNET_H_
 #define SIM7600E_INC_SIMNET_H_
 
+#include "../simcom.h"
+#include "conf.h"
+
 #if SIM_EN_FEATURE_NET
 
 #define SIM_NET_STATUS_OPEN             0x01
@@ -19,16 +22,23 @@
 #define SIM_NET_STATUS_NTP_WAS_SET      0x40
 #define SIM_NET_STATUS_NTP_WAS_SYNCED   0x80
 
+// SIM_HandlerTypeDef.net.armed, deadline holds only while its step is retried
+#define SIM_NET_ARMED_POLL              0x01
+#define SIM_NET_ARMED_WAKE              0x02
+
 #define SIM_NET_EVENT_ON_OPENED           0x01
 #define SIM_NET_EVENT_ON_CLOSED           0x02
 #define SIM_NET_EVENT_ON_GPRS_REGISTERED  0x04
+#define SIM_NET_EVENT_ON_OPEN_FAILED      0x08
 
 
-uint8_t SIM_NetCheckAsyncResponse(SIM_HandlerTypeDef*);
+void    SIM_NetRegisterURC(SIM_HandlerTypeDef*);
 void    SIM_NetHandleEvents(SIM_HandlerTypeDef*);
+void    SIM_NetOnReset(SIM_HandlerTypeDef*);
 
 void    SIM_SetAPN(SIM_HandlerTypeDef*, const char *APN, const char *user, const char *pass);
 void    SIM_NetOpen(SIM_HandlerTypeDef*);
+void    SIM_NetSetGprsStat(SIM_HandlerTypeDef*, uint8_t cgregStat);
 
 #if SIM_EN_FEATURE_NTP
 void SIM_SetNTP(SIM_HandlerTypeDef*, const char *server, int8_t region);
@@ -13,10 +13,15 @@
 
 #include "../simcom.h"
 
-#define SIM_SOCK_DEFAULT_TO 2000
+#define SIM_SOCK_DEFAULT_TO   2000
+#define SIM_SOCK_DEFAULT_MTU  1460
+#define SIM_SOCK_CONNECT_TO   30000   // CONNECT of transparent socket
+#define SIM_SOCK_OPEN_TO      60000   // open without +CIPOPEN is closed and retried after this
+#define SIM_SOCK_ESCAPE_GUARD 1000    // silence around +++
 
 #define SIM_SOCK_UDP    0
 #define SIM_SOCK_TCPIP  1
+#define SIM_SOCK_TLS    2
 
 #define SIM_SOCK_STATE_CLOSED   0x00
 #define SIM_SOCK_STATE_OPENING  0x01
@@ -30,32 +35,71 @@
 #define SIM_SOCK_EVENT_ON_RECEIVED      0x04
 #define SIM_SOCK_EVENT_ON_CLOSED        0x08
 
+#define SIM_SERVER_STATE_STOPPED    0x00
+#define SIM_SERVER_STATE_LISTENING  0x01
+
 #define SIM_SOCK_IS_STATE(sock, stat)    ((sock)->state == stat)
 #define SIM_SOCK_SET_STATE(sock, stat)   ((sock)->state = stat)
 
+#if SIM_EN_FEATURE_TLS
+/*
+ * SSL context of AT+CSSLCFG, certificates are file names in modem
+ * storage (AT+CCERTDOWN)
+ */
+typedef struct {
+  uint8_t     sslVersion;                   // 0 SSL3.0 .. 3 TLS1.2, 4 all
+  uint8_t     authMode;                     // 0 none, 1 server, 2 server and client
+  uint8_t     ignoreLocalTime;              // skip validity check with modem clock
+  uint8_t     enableSNI;
+  const char  *caCert;
+  const char  *clientCert;
+  const char  *clientKey;
+} SIM_TLS_Config_t;
+#endif
+
 typedef struct {
   SIM_HandlerTypeDef  *hsim;
   uint8_t             state;
   uint8_t             events;               // Events flag
   int8_t              linkNum;
-  uint8_t             type;                 // SIM_SOCK_UDP or SIM_SOCK_TCPIP
+  uint8_t             type;                 // SIM_SOCK_UDP, SIM_SOCK_TCPIP or SIM_SOCK_TLS
+#if SIM_EN_FEATURE_TLS
+  int8_t                  session;          // CCH session, also its SSL context
+  const SIM_TLS_Config_t  *tls;
+#endif
 
   // configuration
   struct {
     uint32_t timeout;
     uint8_t  autoReconnect;
-    uint16_t reconnectingDelay;
+    uint16_t reconnectingDelay;             // first reconnect delay, base of backoff
+    uint16_t mtu;                           // max bytes coalesced into one CIPSEND
+    uint8_t  priority;                      // higher reconnects first
   } config;
 
   // tick register for delay and timeout
   struct {
     uint32_t reconnDelay;
     uint32_t connecting;
+    uint32_t sending;
   } tick;
 
+  // reconnect backoff
+  struct {
+    uint32_t backoff;                       // 0 until a reconnect fails
+    uint32_t wait;                          // jittered delay from tick.reconnDelay
+  } reconn;
+
   // server
   char     host[64];
   uint16_t port;
+  uint16_t localPort;                       // UDP only
+
+  // source of the data being delivered to onData/onReceived
+  struct {
+    char     host[40];
+    uint16_t port;
+  } remote;
 
   // listener
   struct {
@@ -64,14 +108,58 @@ typedef struct {
     void (*onConnectError)(void);
     void (*onClosed)(void);
     void (*onReceived)(Buffer_t*);
+    void (*onData)(const uint8_t *data, uint16_t len);  // zero-copy, called from URC context
+    void (*onSent)(uint16_t len);
+    void (*onSendError)(void);
+    uint16_t (*getRxSpace)(void);           // free space of app, manual receive only
   } listeners;
 
   // buffer
   Buffer_t buffer;
+
+  // transmit queue, written by SIM_SOCK_Write and drained by the event handler
+  struct {
+    uint8_t  *buffer;
+    uint16_t size;
+    uint16_t head;
+    uint16_t tail;
+    uint16_t inFlight;                      // bytes waiting for +CIPSEND
+  } tx;
+
+  // manual receive (AT+CIPRXGET)
+  struct {
+    uint8_t  available;                     // modem holds data for this link
+    uint16_t readSize;                      // adaptive read length
+  } rx;
 } SIM_Socket_t;
 
-uint8_t SIM_SockCheckAsyncResponse(SIM_HandlerTypeDef*);
+typedef struct {
+  SIM_HandlerTypeDef  *hsim;
+  uint8_t             state;
+  int8_t              index;                // <server_index> of AT+SERVERSTART
+  uint16_t            port;
+  uint32_t            retryTick;
+
+  // clients reported by +CLIENT, accepted by the event handler
+  struct {
+    int8_t   linkNum;
+    char     host[40];
+    uint16_t port;
+  } backlog[SIM_SERVER_BACKLOG];
+  uint8_t  backlogLen;
+  uint16_t rejectLinks;                     // links to close, backlog was full
+
+  // listener, return socket for the client or NULL to reject it
+  struct {
+    SIM_Socket_t* (*onAccept)(const char *host, uint16_t port);
+  } listeners;
+} SIM_Server_t;
+
+void    SIM_SockRegisterURC(SIM_HandlerTypeDef*);
 void    SIM_SockHandleEvents(SIM_HandlerTypeDef*);
+#if SIM_SOCK_TRANSPARENT
+void    SIM_SockStreamProcess(SIM_HandlerTypeDef*);
+#endif
 
 // glabal event handler
 void    SIM_SockOnStarted(SIM_HandlerTypeDef*);
@@ -79,16 +167,42 @@ void    SIM_SockOnNetOpened(SIM_HandlerTypeDef*);
 
 // simcom feature net and socket
 SIM_Status_t  SIM_SockOpenTCPIP(SIM_HandlerTypeDef*, int8_t *linkNum, const char *host, uint16_t port);
+SIM_Status_t  SIM_SockOpenUDP(SIM_HandlerTypeDef*, int8_t *linkNum, uint16_t localPort);
 SIM_Status_t  SIM_SockClose(SIM_HandlerTypeDef*, uint8_t linkNum);
+#if SIM_EN_FEATURE_TLS
+SIM_Status_t  SIM_SockCloseTLS(SIM_HandlerTypeDef*, uint8_t session);
+uint16_t      SIM_SockSendTLS(SIM_HandlerTypeDef*, uint8_t session, const uint8_t *data, uint16_t length);
+#endif
+SIM_Status_t  SIM_SockServerStart(SIM_HandlerTypeDef*, uint8_t index, uint16_t port);
+SIM_Status_t  SIM_SockServerStop(SIM_HandlerTypeDef*, uint8_t index);
 void          SIM_SockRemoveListener(SIM_HandlerTypeDef*, uint8_t linkNum);
 uint16_t      SIM_SockSendData(SIM_HandlerTypeDef*, int8_t linkNum, const uint8_t *data, uint16_t length);
+uint16_t      SIM_SockSendTo(SIM_HandlerTypeDef*, int8_t linkNum, const char *host, uint16_t port,
+                             const uint8_t *data, uint16_t length);
 
 // socket method
 SIM_Status_t  SIM_SOCK_Init(SIM_Socket_t*, const char *host, uint16_t port);
+SIM_Status_t  SIM_SOCK_InitUDP(SIM_Socket_t*, const char *host, uint16_t port, uint16_t localPort);
+#if SIM_EN_FEATURE_TLS
+SIM_Status_t  SIM_SOCK_InitTLS(SIM_Socket_t*, const char *host, uint16_t port, const SIM_TLS_Config_t*);
+#endif
 void          SIM_SOCK_SetBuffer(SIM_Socket_t*, uint8_t *buffer, uint16_t size);
+void          SIM_SOCK_SetTxBuffer(SIM_Socket_t*, uint8_t *buffer, uint16_t size);
 SIM_Status_t  SIM_SOCK_Open(SIM_Socket_t*, SIM_HandlerTypeDef*);
 void          SIM_SOCK_Close(SIM_Socket_t*);
 uint16_t      SIM_SOCK_SendData(SIM_Socket_t*, const uint8_t *data, uint16_t length);
+uint16_t      SIM_SOCK_Write(SIM_Socket_t*, const uint8_t *data, uint16_t length);
+uint16_t      SIM_SOCK_WriteTo(SIM_Socket_t*, const char *host, uint16_t port,
+                               const uint8_t *data, uint16_t length);
+// server method
+void          SIM_SERVER_Init(SIM_Server_t*, uint16_t port);
+SIM_Status_t  SIM_SERVER_Start(SIM_Server_t*, SIM_HandlerTypeDef*);
+void          SIM_SERVER_Stop(SIM_Server_t*);
+
+#if SIM_SOCK_TRANSPARENT
+SIM_Status_t  SIM_SOCK_Escape(SIM_Socket_t*);
+SIM_Status_t  SIM_SOCK_Resume(SIM_Socket_t*);
+#endif
 
 #endif /* SIM_EN_FEATURE_SOCKET */
 #endif /* SIM7600E_INC_SIMSOCK_H_ */
@@ -0,0 +1,34 @@
+/*
+ * stats.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SIM7600E_INC_SIMCOM_STATS_H_
+#define SIM7600E_INC_SIMCOM_STATS_H_
+
+#include "../simcom.h"
+#include "conf.h"
+
+#if SIM_EN_FEATURE_STATS
+
+#define SIM_STATS_SEND(hsim, cmd, len)    SIM_Stats_OnSend((hsim), (cmd), (len))
+#define SIM_STATS_RESULT(hsim, status)    SIM_Stats_OnResult((hsim), (status))
+#define SIM_STATS_TX(hsim, len)           {if ((hsim)->stats.running >= 0) (hsim)->stats.cmd[(hsim)->stats.running].bytesTx += (len);}
+#define SIM_STATS_RX(hsim, len)           {if ((hsim)->stats.running >= 0) (hsim)->stats.cmd[(hsim)->stats.running].bytesRx += (len);}
+
+void                  SIM_Stats_Init(SIM_HandlerTypeDef*);
+void                  SIM_Stats_OnSend(SIM_HandlerTypeDef*, const char *cmd, uint16_t len);
+void                  SIM_Stats_OnResult(SIM_HandlerTypeDef*, SIM_Status_t);
+
+const SIM_CmdStats_t  *SIM_Stats_Get(SIM_HandlerTypeDef*, const char *prefix);
+void                  SIM_Stats_Reset(SIM_HandlerTypeDef*);
+uint16_t              SIM_Stats_Snapshot(SIM_HandlerTypeDef*, char *dst, uint16_t size);
+
+#else
+#define SIM_STATS_SEND(hsim, cmd, len)
+#define SIM_STATS_RESULT(hsim, status)
+#define SIM_STATS_TX(hsim, len)
+#define SIM_STATS_RX(hsim, len)
+#endif /* SIM_EN_FEATURE_STATS */
+#endif /* SIM7600E_INC_SIMCOM_STATS_H_ */
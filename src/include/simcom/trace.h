@@ -0,0 +1,67 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef SIM7600E_INC_SIMCOM_TRACE_H_
+#define SIM7600E_INC_SIMCOM_TRACE_H_
+
+#include "../simcom.h"
+#include "conf.h"
+
+#if SIM_EN_FEATURE_TRACE
+
+/**
+ * Trace format
+ *  header  "SIMT" <version>
+ *  record  <type> <tick delta varint> <length varint> <data>
+ */
+#define SIM_TRACE_VERSION   1
+
+#define SIM_TRACE_RX        0x01
+#define SIM_TRACE_TX        0x02
+#define SIM_TRACE_TX_LINE   0x03  // data given to writeline, line end is added by serial
+
+// how long replay lets driver run late before dropping a recorded write
+#ifndef SIM_TRACE_TX_SKEW
+#define SIM_TRACE_TX_SKEW   1000
+#endif
+
+typedef struct {
+  SIM_Serial_t  serial;           // wrapped serial, set by SIM_Trace_Attach
+  uint32_t      (*getTick)(void);
+  uint32_t      lastTick;
+
+  // trace sink, e.g. file or flash writer
+  void          *ctx;
+  void          (*output)(void *ctx, const uint8_t *data, uint16_t len);
+} SIM_TraceRecorder_t;
+
+typedef struct {
+  const uint8_t *data;
+  uint32_t      len;
+  uint32_t      pos;
+  uint32_t      tick;             // virtual clock
+  uint32_t      recordTick;       // tick of record at pos
+  const uint8_t *rxData;          // RX record being read
+  uint16_t      rxLen;
+  uint16_t      txPending;        // driver writes not matched to TX record yet
+} SIM_TraceReplay_t;
+
+void      SIM_Trace_Attach(SIM_TraceRecorder_t*, SIM_HandlerTypeDef*);
+void      SIM_Trace_Detach(SIM_TraceRecorder_t*, SIM_HandlerTypeDef*);
+
+/*
+ * To replay, application sets getTick and delay of handler to functions
+ * that call SIM_TraceReplay_GetTick and SIM_TraceReplay_Delay.
+ */
+SIM_Status_t  SIM_TraceReplay_Init(SIM_TraceReplay_t*, const uint8_t *data, uint32_t len);
+void          SIM_TraceReplay_Attach(SIM_TraceReplay_t*, SIM_HandlerTypeDef*);
+uint32_t      SIM_TraceReplay_GetTick(SIM_TraceReplay_t*);
+void          SIM_TraceReplay_Delay(SIM_TraceReplay_t*, uint32_t ms);
+uint8_t       SIM_TraceReplay_IsDone(SIM_TraceReplay_t*);
+void          SIM_TraceReplay_Run(SIM_TraceReplay_t*, SIM_HandlerTypeDef*);
+
+#endif /* SIM_EN_FEATURE_TRACE */
+#endif /* SIM7600E_INC_SIMCOM_TRACE_H_ */
@@ -13,6 +13,8 @@
 
 
 #define SIM_IsTimeout(hsim, lastTick, timeout) (((hsim)->getTick() - (lastTick)) > (timeout))
+#define SIM_IsDue(hsim, deadline)   ((int32_t)((hsim)->getTick() - (deadline)) >= 0)
+#define SIM_Schedule(hsim, deadline, ms) {(deadline) = (hsim)->getTick() + (ms);}
 
 #define SIM_IsResponse(hsim, resp, min_len) \
   ((hsim)->respBufferLen >= (min_len) \
@@ -21,6 +23,13 @@
 #define SIM_IsResponseOK(hsim) \
   (SIM_GetResponse((hsim), NULL, 0, NULL, 0, SIM_GETRESP_WAIT_OK, 0) == SIM_OK)
 
+// UART carries socket data, no AT command can be sent
+#if SIM_SOCK_TRANSPARENT
+#define SIM_IsDataMode(hsim)  ((hsim)->net.stream.isOnline)
+#else
+#define SIM_IsDataMode(hsim)  0
+#endif
+
 
 #define SIM_BITS_IS_ALL(bits, bit) (((bits) & (bit)) == (bit))
 #define SIM_BITS_IS_ANY(bits, bit) ((bits) & (bit))
@@ -28,6 +37,8 @@
 #define SIM_BITS_SET(bits, bit)    {(bits) |= (bit);}
 #define SIM_BITS_UNSET(bits, bit)  {(bits) &= ~(bit);}
 
+#define SIM_SetPending(hsim, subsys)  SIM_BITS_SET((hsim)->pending.bits, 1 << (subsys))
+
 #define SIM_IS_STATUS(hsim, stat)     SIM_BITS_IS_ALL((hsim)->status, stat)
 #define SIM_SET_STATUS(hsim, stat)    SIM_BITS_SET((hsim)->status, stat)
 #define SIM_UNSET_STATUS(hsim, stat)  SIM_BITS_UNSET((hsim)->status, stat)
@@ -50,20 +61,103 @@
 #define SIM_MQTT_UNSET_STATUS(hsim, stat)  SIM_BITS_UNSET((hsim)->mqtt.status, stat)
 #endif
 
+#define SIM_TOKEN_QUOTED  0x01
+
+typedef struct {
+  const uint8_t *str;
+  uint8_t       count;
+  struct {
+    uint16_t offset;
+    uint8_t  len;
+    uint8_t  flags;
+  } field[SIM_MAX_TOKENS];
+} SIM_Tokens_t;
+
+#define SIM_TokenPtr(tokens, idx)       ((tokens)->str + (tokens)->field[idx].offset)
+#define SIM_TokenLen(tokens, idx)       (((idx) < (tokens)->count)? (tokens)->field[idx].len: 0)
+#define SIM_TokenIsQuoted(tokens, idx)  (((idx) < (tokens)->count) && ((tokens)->field[idx].flags & SIM_TOKEN_QUOTED))
+#define SIM_TokenIs(tokens, idx, s, n) \
+  (SIM_TokenLen(tokens, idx) == (n) && strncmp((const char*) SIM_TokenPtr(tokens, idx), (s), (n)) == 0)
+
 #if SIM_EN_FEATURE_GPS
 #define SIM_GPS_IS_STATUS(hsim, stat)     SIM_BITS_IS_ALL((hsim)->gps.status, stat)
 #define SIM_GPS_SET_STATUS(hsim, stat)    SIM_BITS_SET((hsim)->gps.status, stat)
 #define SIM_GPS_UNSET_STATUS(hsim, stat)  SIM_BITS_UNSET((hsim)->gps.status, stat)
 #endif
 
+void          SIM_Wait(SIM_HandlerTypeDef*, uint32_t timeout);
+void          SIM_Notify(SIM_HandlerTypeDef*);
+void          SIM_WakeAt(SIM_HandlerTypeDef*, SIM_Subsys_t, uint32_t tick);
 uint8_t       SIM_SendCMD(SIM_HandlerTypeDef*, const char *format, ...);
 uint8_t       SIM_SendData(SIM_HandlerTypeDef*, const uint8_t *data, uint16_t size);
+uint16_t      SIM_ReadLine(SIM_HandlerTypeDef*, uint32_t timeout);
 uint8_t       SIM_WaitResponse(SIM_HandlerTypeDef*, const char *respCode, uint16_t rcsize, uint32_t timeout);
 SIM_Status_t  SIM_GetResponse(SIM_HandlerTypeDef*, const char *respCode, uint16_t rcsize,
                               uint8_t *respData, uint16_t rdsize,
                               uint8_t getRespType,
                               uint32_t timeout);
 uint16_t      SIM_GetData(SIM_HandlerTypeDef*, uint8_t *respData, uint16_t rdsize, uint32_t timeout);
+uint16_t      SIM_GetDataInto(SIM_HandlerTypeDef*, Buffer_t *buffer, uint16_t rdsize, uint32_t timeout);
+uint16_t      SIM_GetDataSink(SIM_HandlerTypeDef*, SIM_DataSink_t sink, void *ctx, uint16_t rdsize, uint32_t timeout);
+uint16_t      SIM_GetDataAvailable(SIM_HandlerTypeDef*, SIM_DataSink_t sink, void *ctx);
+
+// URC dispatcher
+SIM_Status_t  SIM_RegisterURC(SIM_HandlerTypeDef*, const char *prefix, SIM_URCHandler_t handler);
+uint8_t       SIM_DispatchURC(SIM_HandlerTypeDef*);
+
+// async command queue
+SIM_Status_t  SIM_SendCMDAsync(SIM_HandlerTypeDef*, const char *respCode, uint16_t rcsize,
+                               uint8_t *respData, uint16_t rdsize,
+                               uint32_t timeout,
+                               SIM_CmdCallback_t callback, void *ctx,
+                               const char *format, ...);
+void          SIM_CmdQueueProcess(SIM_HandlerTypeDef*);
+uint8_t       SIM_CmdQueueCheckResponse(SIM_HandlerTypeDef*);
+uint8_t       SIM_CmdQueueFlush(SIM_HandlerTypeDef*);
+uint8_t       SIM_CmdQueueIsBusy(SIM_HandlerTypeDef*);
+#define SIM_CmdQueueIsEmpty(hsim) ((hsim)->cmdQueue.head == (hsim)->cmdQueue.tail)
+
+// modem answers nothing else until operator scan or long queued command ends
+#define SIM_IS_BUSY(hsim)   ((hsim)->cops.isScanning || SIM_CmdQueueIsBusy(hsim))
+
 const uint8_t *SIM_ParseStr(const uint8_t *separator, uint8_t delimiter, int idx, uint8_t *output);
 
+// response tokenizer
+uint8_t       SIM_Tokenize(SIM_Tokens_t*, const uint8_t *str, uint16_t len, uint8_t delimiter);
+uint8_t       SIM_TokenizeResp(SIM_HandlerTypeDef*, SIM_Tokens_t*);
+int32_t       SIM_TokenInt(const SIM_Tokens_t*, uint8_t idx);
+uint32_t      SIM_TokenHex(const SIM_Tokens_t*, uint8_t idx);
+uint16_t      SIM_TokenCopy(const SIM_Tokens_t*, uint8_t idx, char *dst, uint16_t size);
+uint8_t       SIM_TokenRegStat(const SIM_Tokens_t*, uint16_t *lac, uint32_t *ci);
+
+// batch, several commands in one "AT+A;+B?;+C" line with one final result
+typedef struct {
+  const char  *respCode;
+  uint16_t    rcsize;
+  uint8_t     *respData;
+  uint16_t    rdsize;
+  uint8_t     isReceived;
+} SIM_BatchSlot_t;
+
+typedef struct {
+  char            cmd[SIM_BATCH_CMD_SIZE];
+  uint16_t        cmdLen;
+  uint8_t         count;
+  SIM_BatchSlot_t slots[SIM_BATCH_SIZE];
+} SIM_Batch_t;
+
+void          SIM_BatchInit(SIM_Batch_t*);
+SIM_Status_t  SIM_BatchAdd(SIM_Batch_t*, const char *respCode, uint16_t rcsize,
+                           uint8_t *respData, uint16_t rdsize,
+                           const char *format, ...);
+SIM_Status_t  SIM_BatchExec(SIM_HandlerTypeDef*, SIM_Batch_t*, uint32_t timeout);
+
+// config fingerprint
+#define SIM_FINGERPRINT_INIT  0x811C9DC5
+uint32_t      SIM_Fingerprint(uint32_t hash, const void *data, uint16_t len);
+uint32_t      SIM_FingerprintStr(uint32_t hash, const char *str);
+uint8_t       SIM_ConfigIsApplied(SIM_HandlerTypeDef*, SIM_Config_t, uint32_t fingerprint);
+void          SIM_ConfigApplied(SIM_HandlerTypeDef*, SIM_Config_t, uint32_t fingerprint);
+void          SIM_ConfigClear(SIM_HandlerTypeDef*, SIM_Config_t);
+
 #endif /* SIM7600E_SRC_INCLUDE_SIMCOM_UTILS_H_ */
@@ -0,0 +1,395 @@
+/*
+ * cmux.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+
+#include "../include/simcom.h"
+#include "../include/simcom/cmux.h"
+#include "../include/simcom/utils.h"
+#include <string.h>
+
+#if SIM_EN_FEATURE_CMUX
+
+#define CMUX_FLAG       0xF9
+#define CMUX_EA         0x01
+#define CMUX_CR         0x02
+#define CMUX_PF         0x10
+
+#define CMUX_SABM       0x2F
+#define CMUX_UA         0x63
+#define CMUX_DM         0x0F
+#define CMUX_DISC       0x43
+#define CMUX_UIH        0xEF
+
+#define CMUX_MSG_CLD    0xC1          // multiplexer close down (type with EA)
+#define CMUX_NO_ACK     0xFF
+
+enum {
+  RX_FLAG = 0,
+  RX_ADDRESS,
+  RX_CONTROL,
+  RX_LENGTH,
+  RX_INFO,
+  RX_FCS,
+  RX_END,
+};
+
+static uint8_t  fcsCalc(const uint8_t *data, uint8_t len);
+static int      sendFrame(SIM_CMUX_t*, uint8_t dlci, uint8_t control, const uint8_t *info, uint16_t len, uint32_t timeout);
+static SIM_Status_t openDLC(SIM_CMUX_t*, uint8_t dlci);
+static void     parseByte(SIM_CMUX_t*, uint8_t c);
+static void     handleFrame(SIM_CMUX_t*);
+static uint16_t chRead(SIM_CMUX_Channel_t*, uint8_t *dst, uint16_t sz);
+
+// channel serial
+static uint8_t  chIsReadable(void *device);
+static int      chSerialRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+static int      chWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+static int      chWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+
+// reversed CRC-8 (x^8 + x^2 + x + 1) as specified in 27.010 section 5.2.1.6
+static const uint8_t crcTable[256] = {
+  0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED, 0x7C, 0x09, 0x98, 0xEA, 0x7B,
+  0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A, 0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67,
+  0x38, 0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D, 0x36, 0xA7, 0xD5, 0x44, 0x31, 0xA0, 0xD2, 0x43,
+  0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0, 0x51, 0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
+  0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05, 0x7E, 0xEF, 0x9D, 0x0C, 0x79, 0xE8, 0x9A, 0x0B,
+  0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA, 0x88, 0x19, 0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17,
+  0x48, 0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D, 0x46, 0xD7, 0xA5, 0x34, 0x41, 0xD0, 0xA2, 0x33,
+  0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0, 0x21, 0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
+  0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95, 0xEE, 0x7F, 0x0D, 0x9C, 0xE9, 0x78, 0x0A, 0x9B,
+  0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A, 0x18, 0x89, 0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87,
+  0xD8, 0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD, 0xD6, 0x47, 0x35, 0xA4, 0xD1, 0x40, 0x32, 0xA3,
+  0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20, 0xB1, 0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
+  0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5, 0x9E, 0x0F, 0x7D, 0xEC, 0x99, 0x08, 0x7A, 0xEB,
+  0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A, 0x68, 0xF9, 0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7,
+  0xA8, 0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD, 0xA6, 0x37, 0x45, 0xD4, 0xA1, 0x30, 0x42, 0xD3,
+  0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50, 0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF,
+};
+
+
+/*
+ * Switch modem into basic option multiplexer mode, open all channels
+ * and move the driver to the control channel
+ */
+SIM_Status_t SIM_CMUX_Start(SIM_CMUX_t *mux, SIM_HandlerTypeDef *hsim)
+{
+  SIM_Status_t status = SIM_ERROR;
+  uint8_t i;
+
+  memset(&mux->rx, 0, sizeof(mux->rx));
+  mux->serial   = hsim->serial;
+  mux->getTick  = hsim->getTick;
+  for (i = 0; i < SIM_CMUX_NUM_OF_CHANNEL; i++) {
+    memset(&mux->channels[i], 0, sizeof(SIM_CMUX_Channel_t));
+    mux->channels[i].mux  = mux;
+    mux->channels[i].dlci = i+1;
+  }
+
+  hsim->mutexLock(hsim);
+  SIM_SendCMD(hsim, "AT+CMUX=0");
+  if (!SIM_IsResponseOK(hsim)) goto endcmd;
+
+  if (openDLC(mux, 0) != SIM_OK) goto endcmd;
+  for (i = 0; i < SIM_CMUX_NUM_OF_CHANNEL; i++) {
+    if (openDLC(mux, i+1) != SIM_OK) goto endcmd;
+    mux->channels[i].isOpen = 1;
+  }
+
+  // bytes left in ring belong to the physical serial
+  hsim->rxHead    = 0;
+  hsim->rxLen     = 0;
+  hsim->rxScanned = 0;
+  hsim->serial    = SIM_CMUX_GetSerial(mux, SIM_CMUX_CH_CONTROL);
+  status = SIM_OK;
+
+endcmd:
+  hsim->mutexUnlock(hsim);
+  return status;
+}
+
+
+/*
+ * Close down multiplexer and give physical serial back to the driver
+ */
+void SIM_CMUX_Stop(SIM_CMUX_t *mux, SIM_HandlerTypeDef *hsim)
+{
+  const uint8_t cld[2] = {CMUX_MSG_CLD | CMUX_CR, CMUX_EA};
+  uint8_t i;
+
+  hsim->mutexLock(hsim);
+  sendFrame(mux, 0, CMUX_UIH, cld, sizeof(cld), 1000);
+  for (i = 0; i < SIM_CMUX_NUM_OF_CHANNEL; i++) {
+    mux->channels[i].isOpen = 0;
+  }
+  hsim->rxHead    = 0;
+  hsim->rxLen     = 0;
+  hsim->rxScanned = 0;
+  hsim->serial    = mux->serial;
+  hsim->mutexUnlock(hsim);
+}
+
+
+SIM_Serial_t SIM_CMUX_GetSerial(SIM_CMUX_t *mux, uint8_t channel)
+{
+  SIM_Serial_t serial = {0};
+
+  if (channel == 0 || channel > SIM_CMUX_NUM_OF_CHANNEL) return serial;
+
+  serial.device     = &mux->channels[channel-1];
+  serial.isReadable = chIsReadable;
+  serial.read       = chSerialRead;
+  serial.write      = chWrite;
+  serial.writeline  = chWriteline;
+  return serial;
+}
+
+
+/*
+ * Demultiplex all bytes received on physical serial into channel buffers
+ */
+void SIM_CMUX_Process(SIM_CMUX_t *mux)
+{
+  uint8_t buf[32];
+  int len, i;
+
+  while (mux->serial.isReadable(mux->serial.device)) {
+    len = mux->serial.read(mux->serial.device, buf, sizeof(buf), 0);
+    if (len <= 0) break;
+    for (i = 0; i < len; i++) {
+      parseByte(mux, buf[i]);
+    }
+  }
+}
+
+
+static uint8_t fcsCalc(const uint8_t *data, uint8_t len)
+{
+  uint8_t fcs = 0xFF;
+
+  while (len--) {
+    fcs = crcTable[fcs ^ *data++];
+  }
+  return 0xFF - fcs;
+}
+
+
+static int sendFrame(SIM_CMUX_t *mux, uint8_t dlci, uint8_t control, const uint8_t *info, uint16_t len, uint32_t timeout)
+{
+  uint8_t header[5];
+  uint8_t trailer[2];
+  uint8_t headerLen = 4;
+
+  header[0] = CMUX_FLAG;
+  header[1] = (dlci << 2) | CMUX_CR | CMUX_EA;
+  header[2] = control;
+  if (len > 127) {
+    header[3] = (len & 0x7F) << 1;
+    header[4] = len >> 7;
+    headerLen = 5;
+  }
+  else header[3] = (len << 1) | CMUX_EA;
+
+  // UIH checksum covers the header only, other frames have no info field
+  trailer[0] = fcsCalc(&header[1], headerLen - 1);
+  trailer[1] = CMUX_FLAG;
+
+  if (mux->serial.write(mux->serial.device, header, headerLen, timeout) < 0) return -1;
+  if (len > 0 && mux->serial.write(mux->serial.device, info, len, timeout) < 0) return -1;
+  if (mux->serial.write(mux->serial.device, trailer, 2, timeout) < 0) return -1;
+  return len;
+}
+
+
+static SIM_Status_t openDLC(SIM_CMUX_t *mux, uint8_t dlci)
+{
+  uint8_t retry = 3;
+  uint32_t tick;
+  uint8_t c;
+
+  while (retry--) {
+    mux->rx.isAcked = 0;
+    sendFrame(mux, dlci, CMUX_SABM | CMUX_PF, NULL, 0, 1000);
+
+    tick = mux->getTick();
+    while ((mux->getTick() - tick) < 1000) {
+      if (mux->serial.read(mux->serial.device, &c, 1, 100) <= 0) continue;
+      parseByte(mux, c);
+      if (!mux->rx.isAcked) continue;
+      if (mux->rx.ackDLCI == dlci) return SIM_OK;
+      // DM, channel rejected
+      if (mux->rx.ackDLCI == CMUX_NO_ACK) return SIM_ERROR;
+    }
+  }
+  return SIM_TIMEOUT;
+}
+
+
+static void parseByte(SIM_CMUX_t *mux, uint8_t c)
+{
+  switch (mux->rx.state) {
+  case RX_FLAG:
+    if (c == CMUX_FLAG) mux->rx.state = RX_ADDRESS;
+    break;
+
+  case RX_ADDRESS:
+    // repeated flags between frames
+    if (c == CMUX_FLAG) break;
+    mux->rx.address   = c;
+    mux->rx.state     = RX_CONTROL;
+    break;
+
+  case RX_CONTROL:
+    mux->rx.control   = c;
+    mux->rx.len       = 0;
+    mux->rx.lenBytes  = 0;
+    mux->rx.state     = RX_LENGTH;
+    break;
+
+  case RX_LENGTH:
+    mux->rx.header[2 + mux->rx.lenBytes] = c;
+    // only the first octet carries EA, the second is 8 bits of length
+    if (mux->rx.lenBytes == 0) mux->rx.len = c >> 1;
+    else mux->rx.len |= (uint16_t) c << 7;
+    mux->rx.lenBytes++;
+    if (mux->rx.lenBytes == 1 && !(c & CMUX_EA)) break;
+
+    mux->rx.header[0] = mux->rx.address;
+    mux->rx.header[1] = mux->rx.control;
+    mux->rx.fcs   = fcsCalc(mux->rx.header, 2 + mux->rx.lenBytes);
+    mux->rx.idx   = 0;
+    mux->rx.state = (mux->rx.len > 0) ? RX_INFO : RX_FCS;
+    if (mux->rx.len > SIM_CMUX_MAX_FRAME_SIZE) mux->rx.state = RX_FLAG;
+    break;
+
+  case RX_INFO:
+    mux->rx.info[mux->rx.idx++] = c;
+    if (mux->rx.idx >= mux->rx.len) mux->rx.state = RX_FCS;
+    break;
+
+  case RX_FCS:
+    // fcs holds computed value, received one must be equal
+    mux->rx.state = (c == mux->rx.fcs) ? RX_END : RX_FLAG;
+    break;
+
+  case RX_END:
+    mux->rx.state = RX_FLAG;
+    if (c == CMUX_FLAG) {
+      handleFrame(mux);
+      // closing flag may open the next frame
+      mux->rx.state = RX_ADDRESS;
+    }
+    break;
+
+  default:
+    mux->rx.state = RX_FLAG;
+    break;
+  }
+}
+
+
+static void handleFrame(SIM_CMUX_t *mux)
+{
+  SIM_CMUX_Channel_t *ch;
+  uint8_t dlci = mux->rx.address >> 2;
+  uint8_t control = mux->rx.control & ~CMUX_PF;
+  uint16_t i, pos;
+
+  if (control == CMUX_UA || control == CMUX_DM) {
+    mux->rx.ackDLCI = (control == CMUX_UA) ? dlci : CMUX_NO_ACK;
+    mux->rx.isAcked = 1;
+    return;
+  }
+  if (control != CMUX_UIH) return;
+  if (dlci == 0 || dlci > SIM_CMUX_NUM_OF_CHANNEL) return;
+
+  ch = &mux->channels[dlci-1];
+  for (i = 0; i < mux->rx.len; i++) {
+    if (ch->rxLen >= SIM_CMUX_CH_BUFFER_SIZE) {
+      ch->dropped += mux->rx.len - i;
+      break;
+    }
+    pos = (ch->rxHead + ch->rxLen) % SIM_CMUX_CH_BUFFER_SIZE;
+    ch->rxBuffer[pos] = mux->rx.info[i];
+    ch->rxLen++;
+  }
+}
+
+
+static uint16_t chRead(SIM_CMUX_Channel_t *ch, uint8_t *dst, uint16_t sz)
+{
+  uint16_t len = 0;
+
+  while (len < sz && ch->rxLen > 0) {
+    dst[len++] = ch->rxBuffer[ch->rxHead];
+    ch->rxHead = (ch->rxHead + 1) % SIM_CMUX_CH_BUFFER_SIZE;
+    ch->rxLen--;
+  }
+  return len;
+}
+
+
+static uint8_t chIsReadable(void *device)
+{
+  SIM_CMUX_Channel_t *ch = (SIM_CMUX_Channel_t*) device;
+
+  SIM_CMUX_Process(ch->mux);
+  return ch->rxLen > 0;
+}
+
+
+static int chSerialRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  SIM_CMUX_Channel_t *ch = (SIM_CMUX_Channel_t*) device;
+  SIM_CMUX_t *mux = ch->mux;
+  uint32_t tick = mux->getTick();
+  uint32_t elapsed;
+  uint8_t c;
+
+  SIM_CMUX_Process(mux);
+  while (ch->rxLen == 0) {
+    elapsed = mux->getTick() - tick;
+    if (elapsed >= timeout) return 0;
+    // block on physical serial until something arrives for any channel
+    if (mux->serial.read(mux->serial.device, &c, 1, timeout - elapsed) > 0) {
+      parseByte(mux, c);
+      SIM_CMUX_Process(mux);
+    }
+  }
+  return chRead(ch, dst, sz);
+}
+
+
+static int chWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  SIM_CMUX_Channel_t *ch = (SIM_CMUX_Channel_t*) device;
+  uint16_t len;
+  int written = 0;
+
+  if (!ch->isOpen) return -1;
+  while (sz > 0) {
+    len = (sz > SIM_CMUX_FRAME_SIZE) ? SIM_CMUX_FRAME_SIZE : sz;
+    if (sendFrame(ch->mux, ch->dlci, CMUX_UIH, src, len, timeout) < 0) return -1;
+    src     += len;
+    sz      -= len;
+    written += len;
+  }
+  return written;
+}
+
+
+static int chWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  SIM_CMUX_Channel_t *ch = (SIM_CMUX_Channel_t*) device;
+  const uint8_t eol[2] = {'\r', '\n'};
+  int written;
+
+  written = chWrite(ch, src, sz, timeout);
+  if (written < 0) return written;
+  if (sendFrame(ch->mux, ch->dlci, CMUX_UIH, eol, 2, timeout) < 0) return -1;
+  return written + 2;
+}
+
+#endif /* SIM_EN_FEATURE_CMUX */
@@ -16,26 +16,33 @@
 #if SIM_EN_FEATURE_GPS
 
 static void gpsProcessBuffer(SIM_HandlerTypeDef*);
+static uint8_t urcNMEA(SIM_HandlerTypeDef*);
 
+// command of each setting, for its setter and for the default setup batch
+static SIM_Status_t addAccuracy(SIM_Batch_t*, uint16_t meter);
+static SIM_Status_t addOutputRateNMEA(SIM_Batch_t*, SIM_GPS_NMEARate_t rate);
+static SIM_Status_t addAutoDownloadXTRA(SIM_Batch_t*, uint8_t isEnable);
+static SIM_Status_t addReportNMEA(SIM_Batch_t*, uint8_t interval, uint16_t reportEn);
+static SIM_Status_t addMOAGPSMethod(SIM_Batch_t*, SIM_GPS_MOAGPS_Method_t method);
+static SIM_Status_t addAGPSServer(SIM_Batch_t*, const char* url, uint8_t isSecure);
+static SIM_Status_t addAntenna(SIM_Batch_t*, SIM_GPS_ANT_Mode_t mode);
+static SIM_Status_t addAutoSwitchMode(SIM_Batch_t*, uint8_t isAuto);
 
-uint8_t SIM_GPS_CheckAsyncResponse(SIM_HandlerTypeDef *hsim)
-{
-  uint8_t isGet = 0;
-
-  if ((isGet = (hsim->respBufferLen >= 6 && SIM_IsResponse(hsim, "$", 1)))) {
-    SIM_BITS_SET(hsim->gps.events, SIM_GPS_STATE_NMEA_AVAILABLE);
-    Buffer_Write(&hsim->gps.buffer, hsim->respBuffer, hsim->respBufferLen);
-  }
 
-  return isGet;
+void SIM_GPS_RegisterURC(SIM_HandlerTypeDef *hsim)
+{
+  SIM_RegisterURC(hsim, "$", urcNMEA);
 }
 
 
 void SIM_GPS_HandleEvents(SIM_HandlerTypeDef *hsim)
 {
-  if (SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE) 
+  if (SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE)
       && !SIM_GPS_IS_STATUS(hsim, SIM_GPS_STATUS_ACTIVE)
+      && SIM_IsDue(hsim, hsim->gps.retryTick)
   ) {
+    SIM_Schedule(hsim, hsim->gps.retryTick, SIM_RETRY_INTERVAL);
+    SIM_WakeAt(hsim, SIM_SUBSYS_GPS, hsim->gps.retryTick);
     if (SIM_GPS_Deactivate(hsim) != SIM_OK) {
       return;
     }
@@ -65,32 +72,32 @@ void SIM_GPS_Init(SIM_HandlerTypeDef *hsim, uint8_t *buffer, uint16_t bufferSize
 SIM_Status_t SIM_GPS_DefaultSetup(SIM_HandlerTypeDef *hsim)
 {
   SIM_Status_t status = SIM_ERROR;
-
-  if (SIM_GPS_SetAccuracy(hsim, 50) != SIM_OK)
-    goto endcmd;
-
-  if (SIM_GPS_SetOutputRateNMEA(hsim, SIM_GPS_MEARATE_1HZ) != SIM_OK)
-    goto endcmd;
-
-  if (SIM_GPS_AutoDownloadXTRA(hsim, 1) != SIM_OK)
+  uint32_t fingerprint;
+  SIM_Batch_t batch;
+
+  // same commands as SIM_GPS_Set* calls, in one round-trip
+  SIM_BatchInit(&batch);
+  addAccuracy(&batch, 50);
+  addOutputRateNMEA(&batch, SIM_GPS_MEARATE_1HZ);
+  addAutoDownloadXTRA(&batch, 1);
+  addReportNMEA(&batch, 5,
+                SIM_GPS_RPT_GPGGA|SIM_GPS_RPT_GPRMC|SIM_GPS_RPT_GPGSV|SIM_GPS_RPT_GPGSA|SIM_GPS_RPT_GPVTG);
+  addMOAGPSMethod(&batch, SIM_GPS_METHOD_USER_PLANE);
+  addAGPSServer(&batch, "supl.google.com:7276", 0);
+  if (addAntenna(&batch, SIM_GPS_ANT_ACTIVE) != SIM_OK)
     goto endcmd;
 
-  if (SIM_GPS_SetReportNMEA(
-        hsim, 
-        5, 
-        SIM_GPS_RPT_GPGGA|SIM_GPS_RPT_GPRMC|SIM_GPS_RPT_GPGSV|SIM_GPS_RPT_GPGSA|SIM_GPS_RPT_GPVTG
-    ) != SIM_OK)
-    goto endcmd;
-
-  if (SIM_GPS_SetMOAGPSMethod(hsim, SIM_GPS_METHOD_USER_PLANE) != SIM_OK)
-    goto endcmd;
-
-  if (SIM_GPS_SetAGPSServer(hsim, "supl.google.com:7276", 0) != SIM_OK)
+  // GPS settings are saved by the modem, skip them if these were applied
+  fingerprint = SIM_Fingerprint(SIM_FINGERPRINT_INIT, batch.cmd, batch.cmdLen);
+  if (SIM_ConfigIsApplied(hsim, SIM_CONFIG_GPS, fingerprint)) {
+    status = SIM_OK;
     goto endcmd;
+  }
 
-  if (SIM_GPS_SetAntenna(hsim, SIM_GPS_ANT_ACTIVE) != SIM_OK)
+  if (SIM_BatchExec(hsim, &batch, 5000) != SIM_OK)
     goto endcmd;
 
+  SIM_ConfigApplied(hsim, SIM_CONFIG_GPS, fingerprint);
   status = SIM_OK;
   endcmd:
   return status;
@@ -107,6 +114,8 @@ SIM_Status_t SIM_GPS_Activate(SIM_HandlerTypeDef *hsim, SIM_GPS_Mode_t mode)
     status = SIM_OK;
 
   hsim->mutexUnlock(hsim);
+  // settings may be what it refused, SIM_GPS_DefaultSetup sends them again
+  if (status != SIM_OK) SIM_ConfigClear(hsim, SIM_CONFIG_GPS);
   return status;
 
   return SIM_OK;
@@ -140,151 +149,176 @@ SIM_Status_t SIM_GPS_Deactivate(SIM_HandlerTypeDef *hsim)
 
 SIM_Status_t SIM_GPS_SetAccuracy(SIM_HandlerTypeDef *hsim, uint16_t meter)
 {
-  SIM_Status_t status = SIM_ERROR;
+  SIM_Batch_t batch;
 
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSHOR=%d", (int) meter);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
-
-  hsim->mutexUnlock(hsim);
-  return status;
+  SIM_BatchInit(&batch);
+  if (addAccuracy(&batch, meter) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
 }
 
+
 SIM_Status_t SIM_GPS_SetOutputRateNMEA(SIM_HandlerTypeDef *hsim, SIM_GPS_NMEARate_t rate)
 {
-  SIM_Status_t status = SIM_ERROR;
-
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSNMEARATE=%d", rate);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
+  SIM_Batch_t batch;
 
-  hsim->mutexUnlock(hsim);
-  return status;
+  SIM_BatchInit(&batch);
+  if (addOutputRateNMEA(&batch, rate) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
 }
 
 
 SIM_Status_t SIM_GPS_AutoDownloadXTRA(SIM_HandlerTypeDef *hsim, uint8_t isEnable)
 {
-  SIM_Status_t status = SIM_ERROR;
-
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSXDAUTO=%d", (isEnable)?1:0);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
+  SIM_Batch_t batch;
 
-  hsim->mutexUnlock(hsim);
-  return status;
+  SIM_BatchInit(&batch);
+  if (addAutoDownloadXTRA(&batch, isEnable) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
 }
 
 
 SIM_Status_t SIM_GPS_SetReportNMEA(SIM_HandlerTypeDef *hsim, uint8_t interval, uint16_t reportEn)
 {
-  SIM_Status_t status = SIM_ERROR;
-
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSINFOCFG=%d,%d", interval, reportEn);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
+  SIM_Batch_t batch;
 
-  hsim->mutexUnlock(hsim);
-  return status;
+  SIM_BatchInit(&batch);
+  if (addReportNMEA(&batch, interval, reportEn) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
 }
 
 
 SIM_Status_t SIM_GPS_SetMOAGPSMethod(SIM_HandlerTypeDef *hsim, SIM_GPS_MOAGPS_Method_t method)
 {
-  SIM_Status_t status = SIM_ERROR;
-
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSMD=%d", method);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
+  SIM_Batch_t batch;
 
-  hsim->mutexUnlock(hsim);
-  return status;
+  SIM_BatchInit(&batch);
+  if (addMOAGPSMethod(&batch, method) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
 }
 
 
 SIM_Status_t SIM_GPS_SetAGPSServer(SIM_HandlerTypeDef *hsim, const char* url, uint8_t isSecure)
 {
-  SIM_Status_t status = SIM_ERROR;
+  SIM_Batch_t batch;
 
-  hsim->mutexLock(hsim);
+  SIM_BatchInit(&batch);
+  if (addAGPSServer(&batch, url, isSecure) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
+}
 
-  SIM_SendCMD(hsim, "AT+CGPSURL=\"%s\"", url);
-  if (!SIM_IsResponseOK(hsim)) {
-    goto endcmd;
-  }
 
-  SIM_SendCMD(hsim, "AT+CGPSSSL=%d", (isSecure)?1:0);
-  if (!SIM_IsResponseOK(hsim)) {
-    goto endcmd;
+SIM_Status_t SIM_GPS_SetAntenna(SIM_HandlerTypeDef *hsim, SIM_GPS_ANT_Mode_t mode)
+{
+  SIM_Batch_t batch;
+
+  SIM_BatchInit(&batch);
+  if (addAntenna(&batch, mode) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
+}
+
+
+SIM_Status_t SIM_GPS_SetAutoSwitchMode(SIM_HandlerTypeDef *hsim, uint8_t isAuto)
+{
+  SIM_Batch_t batch;
+
+  SIM_BatchInit(&batch);
+  if (addAutoSwitchMode(&batch, isAuto) != SIM_OK) return SIM_ERROR;
+  return SIM_BatchExec(hsim, &batch, 0);
+}
+
+
+static void gpsProcessBuffer(SIM_HandlerTypeDef *hsim)
+{
+  uint16_t readLen = 0;
+
+  while (Buffer_IsAvailable(&hsim->gps.buffer)) {
+    readLen = Buffer_Read(&hsim->gps.buffer, &hsim->gps.readBuffer[0], SIM_GPS_TMP_BUF_SIZE);
+    lwgps_process(&hsim->gps.lwgps, &hsim->gps.readBuffer[0], readLen);
   }
+}
 
-  status = SIM_OK;
-  endcmd:
-  hsim->mutexUnlock(hsim);
-  return status;
+
+/*
+ * Feed NMEA received outside AT stream, e.g. from a CMUX channel
+ */
+void SIM_GPS_Feed(SIM_HandlerTypeDef *hsim, const uint8_t *data, uint16_t len)
+{
+  if (len == 0) return;
+
+  SIM_BITS_SET(hsim->gps.events, SIM_GPS_STATE_NMEA_AVAILABLE);
+  SIM_SetPending(hsim, SIM_SUBSYS_GPS);
+  Buffer_Write(&hsim->gps.buffer, data, len);
 }
 
 
-SIM_Status_t SIM_GPS_SetAntenna(SIM_HandlerTypeDef *hsim, SIM_GPS_ANT_Mode_t mode)
+static SIM_Status_t addAccuracy(SIM_Batch_t *batch, uint16_t meter)
 {
-  SIM_Status_t status = SIM_ERROR;
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSHOR=%d", (int) meter);
+}
 
-  hsim->mutexLock(hsim);
+
+static SIM_Status_t addOutputRateNMEA(SIM_Batch_t *batch, SIM_GPS_NMEARate_t rate)
+{
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSNMEARATE=%d", rate);
+}
+
+
+static SIM_Status_t addAutoDownloadXTRA(SIM_Batch_t *batch, uint8_t isEnable)
+{
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSXDAUTO=%d", (isEnable)?1:0);
+}
+
+
+static SIM_Status_t addReportNMEA(SIM_Batch_t *batch, uint8_t interval, uint16_t reportEn)
+{
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSINFOCFG=%d,%d", interval, reportEn);
+}
+
+
+static SIM_Status_t addMOAGPSMethod(SIM_Batch_t *batch, SIM_GPS_MOAGPS_Method_t method)
+{
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSMD=%d", method);
+}
+
+
+static SIM_Status_t addAGPSServer(SIM_Batch_t *batch, const char* url, uint8_t isSecure)
+{
+  SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSURL=\"%s\"", url);
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSSSL=%d", (isSecure)?1:0);
+}
+
+
+static SIM_Status_t addAntenna(SIM_Batch_t *batch, SIM_GPS_ANT_Mode_t mode)
+{
   switch (mode)
   {
   case SIM_GPS_ANT_PASSIVE:
-    SIM_SendCMD(hsim, "AT+CVAUXS=0");
-    if (SIM_IsResponseOK(hsim))
-      status = SIM_OK;
-    break;
+    return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CVAUXS=%d", 0);
 
   case SIM_GPS_ANT_ACTIVE:
-    SIM_SendCMD(hsim, "AT+CVAUXV=%d", 3050);
-    if (!SIM_IsResponseOK(hsim)) {
-      break;
-    }
-    SIM_SendCMD(hsim, "AT+CVAUXS=1");
-    if (SIM_IsResponseOK(hsim))
-      status = SIM_OK;
-    break;
+    SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CVAUXV=%d", 3050);
+    return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CVAUXS=%d", 1);
 
   default:
-    status = SIM_ERROR;
-    break;
+    return SIM_ERROR;
   }
-
-  hsim->mutexUnlock(hsim);
-  return status;
 }
 
 
-SIM_Status_t SIM_GPS_SetAutoSwitchMode(SIM_HandlerTypeDef *hsim, uint8_t isAuto)
+static SIM_Status_t addAutoSwitchMode(SIM_Batch_t *batch, uint8_t isAuto)
 {
-  SIM_Status_t status = SIM_ERROR;
-
-  hsim->mutexLock(hsim);
-  SIM_SendCMD(hsim, "AT+CGPSMSB=%d", (isAuto)?1:0);
-  if (SIM_IsResponseOK(hsim))
-    status = SIM_OK;
-
-  hsim->mutexUnlock(hsim);
-  return status;
+  return SIM_BatchAdd(batch, NULL, 0, NULL, 0, "+CGPSMSB=%d", (isAuto)?1:0);
 }
 
 
-static void gpsProcessBuffer(SIM_HandlerTypeDef *hsim)
+static uint8_t urcNMEA(SIM_HandlerTypeDef *hsim)
 {
-  uint16_t readLen = 0;
+  if (hsim->respBufferLen < 6) return 0;
 
-  while (Buffer_IsAvailable(&hsim->gps.buffer)) {
-    readLen = Buffer_Read(&hsim->gps.buffer, &hsim->gps.readBuffer[0], SIM_GPS_TMP_BUF_SIZE);
-    lwgps_process(&hsim->gps.lwgps, &hsim->gps.readBuffer[0], readLen);
-  }
+  SIM_BITS_SET(hsim->gps.events, SIM_GPS_STATE_NMEA_AVAILABLE);
+  SIM_SetPending(hsim, SIM_SUBSYS_GPS);
+  Buffer_Write(&hsim->gps.buffer, hsim->respBuffer, hsim->respBufferLen);
+  return 1;
 }
 
 #endif /* SIM_EN_FEATURE_GPS */
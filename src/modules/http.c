@@ -21,54 +21,18 @@ static SIM_Status_t readHead(SIM_HandlerTypeDef*);
 static SIM_Status_t readContent(SIM_HandlerTypeDef*);
 static SIM_Status_t readNextContent(SIM_HandlerTypeDef*);
 static SIM_Status_t closeHttpService(SIM_HandlerTypeDef*);
+static uint8_t urcHttpAction(SIM_HandlerTypeDef*);
+static uint8_t urcHttpHead(SIM_HandlerTypeDef*);
+static uint8_t urcHttpRead(SIM_HandlerTypeDef*);
+static uint8_t urcHttpEvent(SIM_HandlerTypeDef*);
 
-uint8_t SIM_HTTP_CheckAsyncResponse(SIM_HandlerTypeDef *hsim)
+void SIM_HTTP_RegisterURC(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t isGet = 0;
-
-  if ((isGet = (hsim->respBufferLen >= 14
-                && SIM_IsResponse(hsim, "+HTTPACTION", 11))))
-  {
-    SIM_HTTP_Request_t  *request  = (SIM_HTTP_Request_t*)   hsim->http.request;
-    SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
-    char                *resp = (char*) &SIM_RespTmp[32];
-    const uint8_t       *next;
-
-    if (request == 0 || hsim->http.response == 0) return 0;
-
-    next = SIM_ParseStr(&hsim->respBuffer[13], ',', 0, (uint8_t*) resp);
-    if (request->method != (uint8_t) atoi((char*) resp))
-      return 0;
-
-    next = SIM_ParseStr(next, ',', 0, (uint8_t*) resp);
-    response->code = (uint16_t) atoi((char*) resp);
-
-    next = SIM_ParseStr(next, ',', 0, (uint8_t*) resp);
-    response->contentLen = (uint16_t) atoi((char*) resp);
-
-    SIM_BITS_SET(hsim->http.events, SIM_HTTP_EVENT_NEW_RESP);
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 12 && SIM_IsResponse(hsim, "+HTTPHEAD", 9)))) {
-    readHead(hsim);
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 12 && SIM_IsResponse(hsim, "+HTTPREAD", 9)))) {
-    readContent(hsim);
-    SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
-    if (response != 0)
-      SIM_BITS_SET(response->status, SIM_HTTP_STATUS_GOT_CONTENT);
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 17 && SIM_IsResponse(hsim, "+HTTP_PEER_CLOSED", 17)))) {
-
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 17 && SIM_IsResponse(hsim, "+HTTP_NONET_EVENT", 17)))) {
-
-  }
-
-  return isGet;
+  SIM_RegisterURC(hsim, "+HTTPACTION", urcHttpAction);
+  SIM_RegisterURC(hsim, "+HTTPHEAD", urcHttpHead);
+  SIM_RegisterURC(hsim, "+HTTPREAD", urcHttpRead);
+  SIM_RegisterURC(hsim, "+HTTP_PEER_CLOSED", urcHttpEvent);
+  SIM_RegisterURC(hsim, "+HTTP_NONET_EVENT", urcHttpEvent);
 }
 
 
@@ -100,6 +64,7 @@ SIM_Status_t SIM_HTTP_Get(SIM_HandlerTypeDef *hsim,
 {
   SIM_Status_t        status    = SIM_TIMEOUT;
   uint32_t            firstTick = hsim->getTick();
+  uint32_t            elapsed;
   SIM_HTTP_Request_t  request;
 
   request.url     = url;
@@ -117,18 +82,21 @@ SIM_Status_t SIM_HTTP_Get(SIM_HandlerTypeDef *hsim,
 
   // wait requesting was done
   while (SIM_HTTP_IS_STATUS(hsim, SIM_HTTP_STATUS_REQUESTING)) {
-    if (hsim->getTick() - firstTick > timeout) {
+    elapsed = hsim->getTick() - firstTick;
+    if (elapsed > timeout) {
       goto endCmd;
     }
-    hsim->delay(1);
+    SIM_Wait(hsim, timeout - elapsed);
   }
 
   SIM_HTTP_SET_STATUS(hsim, SIM_HTTP_STATUS_REQUESTING);
   SIM_BITS_SET(hsim->http.events, SIM_HTTP_EVENT_NEW_REQ);
+  SIM_SetPending(hsim, SIM_SUBSYS_HTTP);
   SIM_BITS_SET(response->status, SIM_HTTP_STATUS_REQUESTING);
 
   while (1) {
-    if ((hsim->getTick() - firstTick) > timeout) {
+    elapsed = hsim->getTick() - firstTick;
+    if (elapsed > timeout) {
       goto endCmd;
     }
     if (!SIM_BITS_IS(response->status, SIM_HTTP_STATUS_REQUESTING)) {
@@ -144,10 +112,11 @@ SIM_Status_t SIM_HTTP_Get(SIM_HandlerTypeDef *hsim,
       response->contentHandledLen += response->contentHandleLen;
       if (response->contentHandledLen < response->contentLen) {
         SIM_BITS_SET(hsim->http.events, SIM_HTTP_EVENT_NEXT_CONTENT);
+        SIM_SetPending(hsim, SIM_SUBSYS_HTTP);
       }
       continue;
     }
-    hsim->delay(1);
+    SIM_Wait(hsim, timeout - elapsed);
   }
 
   status = SIM_OK;
@@ -217,8 +186,6 @@ static SIM_Status_t httpHandleResponse(SIM_HandlerTypeDef *hsim)
   SIM_Status_t        status    = SIM_TIMEOUT;
   SIM_HTTP_Request_t  *request  = (SIM_HTTP_Request_t*)   hsim->http.request;
   SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
-  uint8_t             *resp     = &SIM_RespTmp[0];
-  uint8_t             *resp2    = &SIM_RespTmp[32];
   // uint16_t            contentLen;
 
   if (request == 0 || response == 0) return SIM_ERROR;
@@ -256,26 +223,26 @@ static SIM_Status_t readHead(SIM_HandlerTypeDef *hsim)
 {
   SIM_Status_t        status    = SIM_TIMEOUT;
   SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
-  const uint8_t       *resp     = &hsim->respBuffer[11];
-  uint8_t             *resp2    = &SIM_RespTmp[0];
-  uint16_t            headLen;
+  uint8_t             *resp2    = &hsim->respTmp[0];
+  uint16_t            headLen   = 0;
   uint16_t            readLen;
+  SIM_Tokens_t        tokens;
 
-  if (strncmp((const char*)resp, "DATA", 4) == 0)
-    SIM_ParseStr(resp, ',', 1, (uint8_t*) resp2);
-
-  headLen = (uint16_t) atoi((char*)resp2);
+  // +HTTPHEAD: DATA,<len>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (SIM_TokenIs(&tokens, 0, "DATA", 4))
+    headLen = (uint16_t) SIM_TokenInt(&tokens, 1);
 
   if (headLen > response->headSize)  readLen = response->headSize;
   else                               readLen = headLen;
-  hsim->serial.read(hsim->serial.device, response->head, readLen, 5000);
+  SIM_GetData(hsim, response->head, readLen, 5000);
   headLen -= readLen;
 
   // just for read all
   while (headLen) {
-    if (headLen > 64)  readLen = 64;
+    if (headLen > SIM_TMP_BUFFER_SIZE)  readLen = SIM_TMP_BUFFER_SIZE;
     else               readLen = headLen;
-    hsim->serial.read(hsim->serial.device, resp2, readLen, 5000);
+    SIM_GetData(hsim, resp2, readLen, 5000);
     headLen -= readLen;
   }
   return status;
@@ -286,31 +253,30 @@ static SIM_Status_t readContent(SIM_HandlerTypeDef *hsim)
 {
   SIM_Status_t        status    = SIM_OK;
   SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
-  const uint8_t       *resp     = &hsim->respBuffer[11];
-  uint8_t             *resp2    = &SIM_RespTmp[0];
+  uint8_t             *resp2    = &hsim->respTmp[0];
   uint16_t            contentLen;
   uint16_t            readLen;
+  SIM_Tokens_t        tokens;
 
-  if (strncmp((const char*)resp, "DATA", 4) == 0)
-    SIM_ParseStr(resp, ',', 1, (uint8_t*) resp2);
-
-  else return;
+  // +HTTPREAD: DATA,<len>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (!SIM_TokenIs(&tokens, 0, "DATA", 4)) return SIM_ERROR;
 
-  contentLen = (uint16_t) atoi((char*)resp2);
+  contentLen = (uint16_t) SIM_TokenInt(&tokens, 1);
   response->contentHandleLen = contentLen;
 
   if (contentLen > response->dataSize)  readLen = response->dataSize;
   else                                  readLen = contentLen;
 
-  hsim->serial.read(hsim->serial.device, response->data, readLen, 5000);
+  SIM_GetData(hsim, response->data, readLen, 5000);
   contentLen -= readLen;
 
   // just for read all
   while (contentLen) {
-    if (contentLen > 64)  readLen = 64;
+    if (contentLen > SIM_TMP_BUFFER_SIZE)  readLen = SIM_TMP_BUFFER_SIZE;
     else                  readLen = contentLen;
 
-    hsim->serial.read(hsim->serial.device, resp2, readLen, 5000);
+    SIM_GetData(hsim, resp2, readLen, 5000);
     contentLen -= readLen;
   }
 
@@ -356,4 +322,56 @@ static SIM_Status_t closeHttpService(SIM_HandlerTypeDef *hsim)
 }
 
 
+static uint8_t urcHttpAction(SIM_HandlerTypeDef *hsim)
+{
+  SIM_HTTP_Request_t  *request  = (SIM_HTTP_Request_t*)   hsim->http.request;
+  SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
+  SIM_Tokens_t        tokens;
+
+  if (hsim->respBufferLen < 14) return 0;
+  if (request == 0 || hsim->http.response == 0) return 0;
+
+  // +HTTPACTION: <method>,<statuscode>,<datalen>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (request->method != (uint8_t) SIM_TokenInt(&tokens, 0))
+    return 0;
+
+  response->code        = (uint16_t) SIM_TokenInt(&tokens, 1);
+  response->contentLen  = (uint16_t) SIM_TokenInt(&tokens, 2);
+
+  SIM_BITS_SET(hsim->http.events, SIM_HTTP_EVENT_NEW_RESP);
+  SIM_SetPending(hsim, SIM_SUBSYS_HTTP);
+  return 1;
+}
+
+
+static uint8_t urcHttpHead(SIM_HandlerTypeDef *hsim)
+{
+  if (hsim->respBufferLen < 12) return 0;
+
+  readHead(hsim);
+  return 1;
+}
+
+
+static uint8_t urcHttpRead(SIM_HandlerTypeDef *hsim)
+{
+  SIM_HTTP_Response_t *response = (SIM_HTTP_Response_t*)  hsim->http.response;
+
+  if (hsim->respBufferLen < 12) return 0;
+
+  readContent(hsim);
+  if (response != 0)
+    SIM_BITS_SET(response->status, SIM_HTTP_STATUS_GOT_CONTENT);
+  return 1;
+}
+
+
+static uint8_t urcHttpEvent(SIM_HandlerTypeDef *hsim)
+{
+  (void) hsim;
+  return 1;
+}
+
+
 #endif /* SIM_EN_FEATURE_HTTP */
@@ -20,73 +20,96 @@ static void     GprsSetAPN(SIM_HandlerTypeDef *hsim,
 static uint8_t  GprsCheck(SIM_HandlerTypeDef *hsim);
 static void     setNTP(SIM_HandlerTypeDef*, const char *server, int8_t region);
 static uint8_t  syncNTP(SIM_HandlerTypeDef*);
+static uint8_t  urcNetOpen(SIM_HandlerTypeDef*);
+static uint8_t  urcCIPEvent(SIM_HandlerTypeDef*);
+static uint8_t  urcCGREG(SIM_HandlerTypeDef*);
+static uint8_t  urcCEREG(SIM_HandlerTypeDef*);
+static void     setGprsStat(SIM_HandlerTypeDef*);
+static void     wakeNext(SIM_HandlerTypeDef*);
 
 
-uint8_t SIM_NetCheckAsyncResponse(SIM_HandlerTypeDef *hsim)
+void SIM_NetRegisterURC(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t isGet = 0;
+  SIM_RegisterURC(hsim, "+NETOPEN", urcNetOpen);
+  SIM_RegisterURC(hsim, "+CIPEVENT", urcCIPEvent);
+  SIM_RegisterURC(hsim, "+CGREG:", urcCGREG);
+  SIM_RegisterURC(hsim, "+CEREG:", urcCEREG);
+}
+
 
-  if ((isGet = (hsim->respBufferLen >= 11 && SIM_IsResponse(hsim, "+NETOPEN", 8)))) {
+void SIM_NetHandleEvents(SIM_HandlerTypeDef *hsim)
+{
+  // +NETOPEN never came
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPENING)
+      && SIM_IsTimeout(hsim, hsim->net.openTick, SIM_NET_OPEN_TIMEOUT))
+  {
     SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPENING);
-    if (hsim->respBuffer[10] == '0') {
-      SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_OPEN);
-      SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_OPENED);
-    } else {
-      SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPEN);
-      SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED);
-    }
   }
 
-  else if ((isGet = SIM_IsResponse(hsim, "+CIPEVENT", 9))) {
-    if (strncmp((const char *)&(hsim->respBuffer[11]), "NETWORK CLOSED", 14)) {
-      SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPEN|SIM_NET_STATUS_OPENING);
-      SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED);
-    }
+  // every status change runs this handler, so a deadline left from an
+  // earlier attempt can not go stale and read as far future after 2^31 ms
+  if (!SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)
+      || SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED))
+  {
+    SIM_BITS_UNSET(hsim->net.armed, SIM_NET_ARMED_POLL);
+  }
+  if (!SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)
+      || SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN))
+  {
+    SIM_BITS_UNSET(hsim->net.armed, SIM_NET_ARMED_WAKE);
   }
 
-  return isGet;
-}
-
+  // +CGREG/+CEREG URC keep the state, polling is only a fallback
+  if (SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)
+      && !SIM_IS_BUSY(hsim)
+      && !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED)
+      && (!SIM_BITS_IS(hsim->net.armed, SIM_NET_ARMED_POLL) || SIM_IsDue(hsim, hsim->net.pollTick)))
+  {
+    if (!GprsCheck(hsim)) {
+      SIM_Schedule(hsim, hsim->net.pollTick, SIM_REG_POLL_INTERVAL);
+      SIM_BITS_SET(hsim->net.armed, SIM_NET_ARMED_POLL);
+    }
+  }
 
-void SIM_NetHandleEvents(SIM_HandlerTypeDef *hsim)
-{
-  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET)
-      && SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED))
+  if (SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)
+      && !SIM_IS_BUSY(hsim)
+      && (!SIM_BITS_IS(hsim->net.armed, SIM_NET_ARMED_WAKE) || SIM_IsDue(hsim, hsim->net.wakeTick)))
   {
-    if (hsim->net.APN.APN != NULL) {
+    if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET) && hsim->net.APN.APN != NULL) {
       GprsSetAPN(hsim,
                  hsim->net.APN.APN,
                  hsim->net.APN.user,
                  hsim->net.APN.pass);
     }
-  }
 
-  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED)
-      && SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED))
-  {
-    GprsCheck(hsim);
-  }
+    if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN)
+        && !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPENING))
+    {
+      SIM_NetOpen(hsim);
+    }
 
-  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN)
-      && !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPENING)
-      && SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED))
-  {
-    SIM_NetOpen(hsim);
+    // next try if this one fails, instead of on every loop
+    if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN)) {
+      SIM_Schedule(hsim, hsim->net.wakeTick, SIM_NET_RETRY_INTERVAL);
+      SIM_BITS_SET(hsim->net.armed, SIM_NET_ARMED_WAKE);
+    }
   }
 
   #if SIM_EN_FEATURE_NTP
   if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET)
-      && SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED))
+      && SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED)
+      && !SIM_IS_BUSY(hsim))
   {
     setNTP(hsim, hsim->NTP.server, hsim->NTP.region);
   }
 
-  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET)) {
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET) && !SIM_IS_BUSY(hsim)) {
     if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SYNCED)
         && SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN))
     {
+      // sends the server again if the last sync failed on it
       if (hsim->NTP.syncTick == 0 || SIM_IsTimeout(hsim, hsim->NTP.syncTick, hsim->NTP.config.retryInterval)) {
-        syncNTP(hsim);
+        setNTP(hsim, hsim->NTP.server, hsim->NTP.region);
       }
     } else {
       if (hsim->NTP.syncTick != 0 && SIM_IsTimeout(hsim, hsim->NTP.syncTick, hsim->NTP.config.resyncInterval)) {
@@ -98,19 +121,46 @@ void SIM_NetHandleEvents(SIM_HandlerTypeDef *hsim)
 
   if (SIM_BITS_IS(hsim->net.events, SIM_NET_EVENT_ON_GPRS_REGISTERED)) {
     SIM_BITS_UNSET(hsim->net.events, SIM_NET_EVENT_ON_GPRS_REGISTERED);
-    SIM_Debug("[GPRS] Registered%s.", (SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_GPRS_ROAMING))? " (Roaming)":"");
+    SIM_Debug("[GPRS] Registered%s.", (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_ROAMING))? " (Roaming)":"");
   }
 
   if (SIM_BITS_IS(hsim->net.events, SIM_NET_EVENT_ON_OPENED)) {
     SIM_BITS_UNSET(hsim->net.events, SIM_NET_EVENT_ON_OPENED);
-    SIM_Debug("Data online");
+    SIM_Debug("Data online (%lu ms since start)", (unsigned long) (hsim->getTick() - hsim->initAt));
+    #if SIM_EN_FEATURE_SOCKET
     SIM_SockOnNetOpened(hsim);
+    #endif
   }
 
   if (SIM_BITS_IS(hsim->net.events, SIM_NET_EVENT_ON_CLOSED)) {
     SIM_BITS_UNSET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED);
     SIM_Debug("Data offline");
   }
+
+  // PDP context may be what failed, send it again on next try
+  if (SIM_BITS_IS(hsim->net.events, SIM_NET_EVENT_ON_OPEN_FAILED)) {
+    SIM_BITS_UNSET(hsim->net.events, SIM_NET_EVENT_ON_OPEN_FAILED);
+    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET);
+    SIM_ConfigClear(hsim, SIM_CONFIG_APN);
+  }
+
+  wakeNext(hsim);
+}
+
+
+/*
+ * modem rebooted, data is down and its settings must be applied again
+ */
+void SIM_NetOnReset(SIM_HandlerTypeDef *hsim)
+{
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN)) {
+    SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED);
+  }
+  hsim->net.status    = 0;
+  hsim->net.armed     = 0;
+  hsim->net.cgregStat = 0;
+  hsim->net.ceregStat = 0;
+  SIM_SetPending(hsim, SIM_SUBSYS_NET);
 }
 
 
@@ -128,6 +178,7 @@ void SIM_SetAPN(SIM_HandlerTypeDef *hsim,
 
   SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
   SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET);
+  SIM_SetPending(hsim, SIM_SUBSYS_NET);
 }
 
 
@@ -150,8 +201,14 @@ void SIM_NetOpen(SIM_HandlerTypeDef *hsim)
       goto endCMD;
     }
   }
+#if SIM_SOCK_TRANSPARENT
+  // can only be changed while net is closed
+  SIM_SendCMD(hsim, "AT+CIPMODE=1");
+  if (SIM_IsResponseOK(hsim)) {}
+#endif
   SIM_SendCMD(hsim, "AT+NETOPEN");
   SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_OPENING);
+  hsim->net.openTick = hsim->getTick();
   if (SIM_IsResponseOK(hsim)) {
     goto endCMD;
   }
@@ -161,6 +218,16 @@ void SIM_NetOpen(SIM_HandlerTypeDef *hsim)
 }
 
 
+/*
+ * +CGREG stat read by someone else, e.g. batched health poll
+ */
+void SIM_NetSetGprsStat(SIM_HandlerTypeDef *hsim, uint8_t cgregStat)
+{
+  hsim->net.cgregStat = cgregStat;
+  setGprsStat(hsim);
+}
+
+
 #if SIM_EN_FEATURE_NTP
 void SIM_SetNTP(SIM_HandlerTypeDef *hsim, const char *server, int8_t region)
 {
@@ -168,6 +235,7 @@ void SIM_SetNTP(SIM_HandlerTypeDef *hsim, const char *server, int8_t region)
   hsim->NTP.region = region;
 
   SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET)
+  SIM_SetPending(hsim, SIM_SUBSYS_NET);
 }
 #endif /* SIM_EN_FEATURE_NTP */
 
@@ -175,6 +243,18 @@ void SIM_SetNTP(SIM_HandlerTypeDef *hsim, const char *server, int8_t region)
 static void GprsSetAPN(SIM_HandlerTypeDef *hsim,
                        const char *APN, const char *user, const char *pass)
 {
+  uint32_t fingerprint = SIM_FINGERPRINT_INIT;
+
+  fingerprint = SIM_FingerprintStr(fingerprint, APN);
+  fingerprint = SIM_FingerprintStr(fingerprint, user);
+  fingerprint = SIM_FingerprintStr(fingerprint, pass);
+
+  // PDP context and auth are kept in modem NV
+  if (SIM_ConfigIsApplied(hsim, SIM_CONFIG_APN, fingerprint)) {
+    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET);
+    return;
+  }
+
   hsim->mutexLock(hsim);
 
   // check net state
@@ -189,48 +269,45 @@ static void GprsSetAPN(SIM_HandlerTypeDef *hsim,
   else {
     if (pass == NULL) SIM_SendCMD(hsim, "AT+CGAUTH=1,3,\"%s\"", user);
     else              SIM_SendCMD(hsim, "AT+CGAUTH=1,3,\"%s\",\"%s\"", user, pass);
-
-    if (!SIM_IsResponseOK(hsim)) {
-      goto endcmd;
-    }
+  }
+  if (!SIM_IsResponseOK(hsim)) {
+    goto endcmd;
   }
 
   SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET);
   SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
+  SIM_BITS_UNSET(hsim->net.armed, SIM_NET_ARMED_POLL);
   endcmd:
   hsim->mutexUnlock(hsim);
+
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_APN_WAS_SET)) {
+    SIM_ConfigApplied(hsim, SIM_CONFIG_APN, fingerprint);
+  }
 }
 
 
 static uint8_t GprsCheck(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
-  // uint8_t resp_n = 0;
+  uint8_t *resp = &hsim->respTmp[0];
   uint8_t resp_stat = 0;
   uint8_t isOK = 0;
+  SIM_Tokens_t tokens;
 
   // send command then get response;
   hsim->mutexLock(hsim);
 
-  memset(resp, 0, 16);
+  memset(resp, 0, 32);
   SIM_SendCMD(hsim, "AT+CGREG?");
-  if (SIM_GetResponse(hsim, "+CGREG", 5, resp, 3, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-    // resp_n = (uint8_t) atoi((char*)&resp[0]);
-    resp_stat = (uint8_t) atoi((char*) resp+2);
+  if (SIM_GetResponse(hsim, "+CGREG", 6, resp, 32, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
+    SIM_Tokenize(&tokens, resp, 32, ',');
+    resp_stat = SIM_TokenRegStat(&tokens, NULL, NULL);
   }
   else goto endcmd;
 
   // check response
-  if (resp_stat == 1 || resp_stat == 5) {
-    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
-    SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_GPRS_REGISTERED);
-    if (resp_stat == 5) {
-      SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_GPRS_ROAMING);
-    }
-    isOK = 1;
-  } else {
-    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
-  }
+  hsim->net.cgregStat = resp_stat;
+  setGprsStat(hsim);
+  isOK = SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
 
   endcmd:
   hsim->mutexUnlock(hsim);
@@ -240,6 +317,17 @@ static uint8_t GprsCheck(SIM_HandlerTypeDef *hsim)
 #if SIM_EN_FEATURE_NTP
 static void setNTP(SIM_HandlerTypeDef *hsim, const char *server, int8_t region)
 {
+  uint32_t fingerprint = SIM_FINGERPRINT_INIT;
+
+  fingerprint = SIM_FingerprintStr(fingerprint, server);
+  fingerprint = SIM_Fingerprint(fingerprint, &region, sizeof(region));
+
+  if (SIM_ConfigIsApplied(hsim, SIM_CONFIG_NTP, fingerprint)) {
+    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET);
+    syncNTP(hsim);
+    return;
+  }
+
   hsim->mutexLock(hsim);
 
   SIM_SendCMD(hsim, "AT+CNTP=\"%s\",%d", server, (int) region);
@@ -251,15 +339,19 @@ static void setNTP(SIM_HandlerTypeDef *hsim, const char *server, int8_t region)
 
   endcmd:
   hsim->mutexUnlock(hsim);
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET)) {
+    SIM_ConfigApplied(hsim, SIM_CONFIG_NTP, fingerprint);
+  }
   syncNTP(hsim);
 }
 
 
 static uint8_t syncNTP(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
+  uint8_t *resp = &hsim->respTmp[0];
   uint8_t status;
   uint8_t isOk = 0;
+  SIM_Tokens_t tokens;
 
   hsim->NTP.syncTick = hsim->getTick();
 
@@ -277,9 +369,11 @@ static uint8_t syncNTP(SIM_HandlerTypeDef *hsim)
     goto endcmd;
   }
 
-  status = (uint8_t) atoi((char*) resp);
+  SIM_Tokenize(&tokens, resp, 5, ',');
+  status = (uint8_t) SIM_TokenInt(&tokens, 0);
   if (status != 0) {
     SIM_Debug("[NTP] error - %d", status);
+    SIM_ConfigClear(hsim, SIM_CONFIG_NTP);
     goto endcmd;
   }
   SIM_Debug("[NTP] Synced", status);
@@ -298,4 +392,121 @@ static uint8_t syncNTP(SIM_HandlerTypeDef *hsim)
 }
 #endif /* SIM_EN_FEATURE_NTP */
 
+
+static uint8_t urcNetOpen(SIM_HandlerTypeDef *hsim)
+{
+  if (hsim->respBufferLen < 11) return 0;
+
+  SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPENING);
+  SIM_SetPending(hsim, SIM_SUBSYS_NET);
+  if (hsim->respBuffer[10] == '0') {
+    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_OPEN);
+    SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_OPENED);
+  } else {
+    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPEN);
+    SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED|SIM_NET_EVENT_ON_OPEN_FAILED);
+  }
+  return 1;
+}
+
+
+static uint8_t urcCIPEvent(SIM_HandlerTypeDef *hsim)
+{
+  if (hsim->respBufferLen >= 25
+      && strncmp((const char *)&(hsim->respBuffer[11]), "NETWORK CLOSED", 14) == 0)
+  {
+    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_OPEN|SIM_NET_STATUS_OPENING);
+    SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_CLOSED);
+    SIM_SetPending(hsim, SIM_SUBSYS_NET);
+  }
+  return 1;
+}
+
+
+static uint8_t urcCGREG(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Tokens_t tokens;
+
+  SIM_TokenizeResp(hsim, &tokens);
+  hsim->net.cgregStat = SIM_TokenRegStat(&tokens, NULL, NULL);
+  setGprsStat(hsim);
+  return 1;
+}
+
+
+static uint8_t urcCEREG(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Tokens_t tokens;
+
+  SIM_TokenizeResp(hsim, &tokens);
+  hsim->net.ceregStat = SIM_TokenRegStat(&tokens, NULL, NULL);
+  setGprsStat(hsim);
+  return 1;
+}
+
+
+/*
+ * arm net wake tick for the nearest deadline checked in SIM_NetHandleEvents
+ */
+static void wakeNext(SIM_HandlerTypeDef *hsim)
+{
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPENING)) {
+    SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->net.openTick + SIM_NET_OPEN_TIMEOUT + 1);
+  }
+
+  // held off by operator scan or long command until it completes, unarmed tick may be stale
+  if (SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED) && !SIM_IS_BUSY(hsim)) {
+    if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED)
+        && SIM_BITS_IS(hsim->net.armed, SIM_NET_ARMED_POLL))
+    {
+      SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->net.pollTick);
+    }
+    if (!SIM_BITS_IS_ANY(hsim->net.status, SIM_NET_STATUS_OPEN|SIM_NET_STATUS_OPENING)
+        && SIM_BITS_IS(hsim->net.armed, SIM_NET_ARMED_WAKE))
+    {
+      SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->net.wakeTick);
+    }
+  }
+
+  #if SIM_EN_FEATURE_NTP
+  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SET)) {
+    if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED))
+      SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->getTick() + SIM_NET_RETRY_INTERVAL);
+  }
+  else if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_NTP_WAS_SYNCED)
+           && SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN))
+  {
+    SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->NTP.syncTick + hsim->NTP.config.retryInterval + 1);
+  }
+  else if (hsim->NTP.syncTick != 0) {
+    SIM_WakeAt(hsim, SIM_SUBSYS_NET, hsim->NTP.syncTick + hsim->NTP.config.resyncInterval + 1);
+  }
+  #endif /* SIM_EN_FEATURE_NTP */
+}
+
+
+/*
+ * packet domain is registered by either GPRS (+CGREG) or LTE EPS (+CEREG)
+ */
+static void setGprsStat(SIM_HandlerTypeDef *hsim)
+{
+  uint8_t cg = hsim->net.cgregStat;
+  uint8_t ce = hsim->net.ceregStat;
+
+  if (cg == 1 || cg == 5 || ce == 1 || ce == 5) {
+    if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED)) {
+      SIM_BITS_SET(hsim->net.events, SIM_NET_EVENT_ON_GPRS_REGISTERED);
+      SIM_SetPending(hsim, SIM_SUBSYS_NET);
+    }
+    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED);
+    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_GPRS_ROAMING);
+    if (cg == 5 || ce == 5) {
+      SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_GPRS_ROAMING);
+    }
+  }
+  else {
+    SIM_NET_UNSET_STATUS(hsim, SIM_NET_STATUS_GPRS_REGISTERED|SIM_NET_STATUS_GPRS_ROAMING);
+  }
+}
+
 #endif /* SIM_EN_FEATURE_NET */
@@ -12,6 +12,7 @@
 #include "../include/simcom/socket.h"
 #include "../include/simcom/utils.h"
 #include "../include/simcom/debug.h"
+#include "../include/simcom/stats.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -21,7 +22,76 @@
 // event handlers
 static void resetOpenedSocket(SIM_HandlerTypeDef*);
 static void receiveData(SIM_HandlerTypeDef*);
+static void deliverData(SIM_HandlerTypeDef*, SIM_Socket_t*, uint16_t dataLen);
+static void sinkData(void *ctx, const uint8_t *data, uint16_t len);
+static uint16_t txQueued(SIM_Socket_t*);
+static void txReset(SIM_Socket_t*);
+static uint16_t txPut(SIM_Socket_t*, uint16_t pos, const uint8_t *data, uint16_t len);
+static uint16_t txGet(SIM_Socket_t*, uint16_t pos, uint8_t *data, uint16_t len);
+static uint8_t txSendRange(SIM_Socket_t*, uint16_t pos, uint16_t len);
+static void txSend(SIM_Socket_t*);
+static void txSendDatagrams(SIM_Socket_t*);
+static uint8_t sendCIPSend(SIM_HandlerTypeDef*, int8_t linkNum, const char *host, uint16_t port, uint16_t length);
+static uint8_t sendPrompt(SIM_Socket_t*, uint16_t length);
+#if SIM_EN_FEATURE_TLS
+static SIM_Status_t tlsOpen(SIM_Socket_t*);
+static SIM_Status_t tlsConfigure(SIM_Socket_t*);
+static int8_t tlsTakeSession(SIM_Socket_t*);
+static SIM_Socket_t* tlsSocket(SIM_HandlerTypeDef*, int8_t session);
+static uint8_t sendCCHSend(SIM_HandlerTypeDef*, uint8_t session, uint16_t length);
+static uint8_t urcCCHOpen(SIM_HandlerTypeDef*);
+static uint8_t urcCCHClose(SIM_HandlerTypeDef*);
+static uint8_t urcCCHRecv(SIM_HandlerTypeDef*);
+
+static const SIM_TLS_Config_t tlsDefault = {
+  .sslVersion       = 4,
+  .authMode         = 0,
+  .ignoreLocalTime  = 1,
+  .enableSNI        = 1,
+};
+#endif
+#if SIM_SOCK_MANUAL_RX
+static void rxGet(SIM_Socket_t*);
+static uint8_t urcCIPRxGet(SIM_HandlerTypeDef*);
+#endif
 static SIM_Status_t sockOpen(SIM_Socket_t*);
+static void reconnSchedule(SIM_Socket_t*, uint8_t isFailed);
+static void reconnNext(SIM_HandlerTypeDef*);
+static void reconnAbort(SIM_Socket_t*);
+static uint32_t jitter(SIM_HandlerTypeDef*);
+static void serverHandleEvents(SIM_HandlerTypeDef*, SIM_Server_t*);
+static void serverAccept(SIM_HandlerTypeDef*, SIM_Server_t*, int8_t linkNum, const char *host, uint16_t port);
+static uint8_t freeLink(SIM_HandlerTypeDef*, int8_t linkNum);
+static void** sockSlot(SIM_HandlerTypeDef*, uint8_t i);
+#if SIM_SOCK_TRANSPARENT
+static SIM_Status_t streamOpen(SIM_Socket_t*);
+static uint16_t streamWrite(SIM_Socket_t*, const uint8_t *data, uint16_t length);
+static void streamSink(void *ctx, const uint8_t *data, uint16_t len);
+
+// modem leaves data mode by itself when the peer closes
+static const char streamClosed[] = "\r\nCLOSED\r\n";
+#endif
+#if SIM_SOCK_DNS_CACHE
+static const char* dnsLookup(SIM_HandlerTypeDef*, const char *host);
+static int8_t dnsResolve(SIM_HandlerTypeDef*, const char *host);
+static int8_t dnsFind(SIM_HandlerTypeDef*, const char *host);
+static void dnsForget(SIM_HandlerTypeDef*, const char *host);
+static void dnsRefresh(SIM_HandlerTypeDef*);
+#endif
+static uint8_t urcReceive(SIM_HandlerTypeDef*);
+static uint8_t urcCIPOpen(SIM_HandlerTypeDef*);
+static uint8_t urcIPClose(SIM_HandlerTypeDef*);
+static uint8_t urcCIPClose(SIM_HandlerTypeDef*);
+static uint8_t urcCIPSend(SIM_HandlerTypeDef*);
+static uint8_t urcRecvFrom(SIM_HandlerTypeDef*);
+static uint8_t urcClient(SIM_HandlerTypeDef*);
+
+// link sockets, then TLS sockets by session
+#if SIM_EN_FEATURE_TLS
+#define SOCK_NUM_OF_SLOT  (SIM_NUM_OF_SOCKET + SIM_NUM_OF_TLS)
+#else
+#define SOCK_NUM_OF_SLOT  SIM_NUM_OF_SOCKET
+#endif
 
 #define Get_Available_LinkNum(hsim, linkNum) {\
   for (int16_t i = 0; i < SIM_NUM_OF_SOCKET; i++) {\
@@ -33,59 +103,24 @@ static SIM_Status_t sockOpen(SIM_Socket_t*);
 }
 
 
-uint8_t SIM_SockCheckAsyncResponse(SIM_HandlerTypeDef *hsim)
+void SIM_SockRegisterURC(SIM_HandlerTypeDef *hsim)
 {
-  int8_t linkNum;
-  SIM_Socket_t *socket;
-  uint8_t isGet = 0;
-
-  if ((isGet = SIM_IsResponse(hsim, "+RECEIVE", 8))) {
-    receiveData(hsim);
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 13 && SIM_IsResponse(hsim, "+CIPOPEN", 8))))
-  {
-    linkNum   = (int8_t) atoi((char*)&(hsim->respBuffer[10]));
-    int err   =          atoi((char*)&(hsim->respBuffer[12]));
-
-    socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
-    if (socket != NULL) {
-      if (err == 0) {
-        SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENED);
-        SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_OPEN);
-      } else {
-        SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENING_ERROR);
-        SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
-      }
-    }
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 13 && SIM_IsResponse(hsim, "+IPCLOSE", 8))))
-  {
-    linkNum     = (int8_t) atoi((char*)&(hsim->respBuffer[10]));
-    // int reason  =          atoi((char*)&(hsim->respBuffer[12]));
-
-    socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
-    if (socket != NULL) {
-      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
-      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
-    }
-  }
-
-  else if ((isGet = (hsim->respBufferLen >= 14 && hsim->respBufferLen <= 16
-                    && SIM_IsResponse(hsim, "+CIPCLOSE", 9))))
-  {
-    linkNum = (int8_t) atoi((char*)&(hsim->respBuffer[11]));
-    int err =          atoi((char*)&(hsim->respBuffer[12]));
-
-    socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
-    if (err == 0 && socket != NULL) {
-      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
-      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
-    }
-  }
-
-  return isGet;
+  SIM_RegisterURC(hsim, "+RECEIVE", urcReceive);
+  SIM_RegisterURC(hsim, "+CIPOPEN", urcCIPOpen);
+  SIM_RegisterURC(hsim, "+IPCLOSE", urcIPClose);
+  SIM_RegisterURC(hsim, "+CIPCLOSE", urcCIPClose);
+  SIM_RegisterURC(hsim, "+CIPSEND", urcCIPSend);
+  SIM_RegisterURC(hsim, "RECV FROM:", urcRecvFrom);
+  SIM_RegisterURC(hsim, "+CLIENT", urcClient);
+#if SIM_EN_FEATURE_TLS
+  SIM_RegisterURC(hsim, "+CCHOPEN", urcCCHOpen);
+  SIM_RegisterURC(hsim, "+CCHCLOSE", urcCCHClose);
+  SIM_RegisterURC(hsim, "+CCH_PEER_CLOSED", urcCCHClose);
+  SIM_RegisterURC(hsim, "+CCHRECV", urcCCHRecv);
+#endif
+#if SIM_SOCK_MANUAL_RX
+  SIM_RegisterURC(hsim, "+CIPRXGET", urcCIPRxGet);
+#endif
 }
 
 
@@ -93,21 +128,34 @@ void SIM_SockHandleEvents(SIM_HandlerTypeDef *hsim)
 {
   int16_t i;
   SIM_Socket_t *socket;
+  void **slot;
+  // events are still delivered, commands wait until the long one completes
+  uint8_t isBusy = SIM_IS_BUSY(hsim);
+
+#if SIM_SOCK_DNS_CACHE
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) && !isBusy) dnsRefresh(hsim);
+#endif
 
   // Socket Event Handler
-  for (i = 0; SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) && i < SIM_NUM_OF_SOCKET; i++)
+  for (i = 0; SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) && i < SOCK_NUM_OF_SLOT; i++)
   {
-    if ((socket = hsim->net.sockets[i]) != NULL) {
+    slot = sockSlot(hsim, i);
+    if ((socket = *slot) != NULL) {
       if (SIM_BITS_IS(socket->events, SIM_SOCK_EVENT_ON_OPENED)) {
         SIM_BITS_UNSET(socket->events, SIM_SOCK_EVENT_ON_OPENED);
+        socket->reconn.backoff = 0;
         if (socket->listeners.onConnected != NULL)
           socket->listeners.onConnected();
       }
 
       if (SIM_BITS_IS(socket->events, SIM_SOCK_EVENT_ON_OPENING_ERROR)) {
         SIM_BITS_UNSET(socket->events, SIM_SOCK_EVENT_ON_OPENING_ERROR);
+#if SIM_SOCK_DNS_CACHE
+        // address may have moved, resolve again on next attempt
+        dnsForget(hsim, socket->host);
+#endif
         if (socket->config.autoReconnect) {
-          socket->tick.reconnDelay = hsim->getTick();
+          reconnSchedule(socket, 1);
           if (socket->listeners.onConnectError != NULL)
             socket->listeners.onConnectError();
         }
@@ -115,9 +163,11 @@ void SIM_SockHandleEvents(SIM_HandlerTypeDef *hsim)
 
       if (SIM_BITS_IS(socket->events, SIM_SOCK_EVENT_ON_CLOSED)) {
         SIM_BITS_UNSET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
+        txReset(socket);
+        socket->rx.available = 0;
         if (!socket->config.autoReconnect)
-          hsim->net.sockets[i] = NULL;
-        else socket->tick.reconnDelay = hsim->getTick();
+          *slot = NULL;
+        else reconnSchedule(socket, 0);
         if (socket->listeners.onClosed != NULL)
           socket->listeners.onClosed();
       }
@@ -128,40 +178,72 @@ void SIM_SockHandleEvents(SIM_HandlerTypeDef *hsim)
           socket->listeners.onReceived(&(socket->buffer));
       }
 
-      // auto reconnect
-      if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_CLOSED)) {
-        if (SIM_IsTimeout(hsim, socket->tick.reconnDelay, socket->config.reconnectingDelay)) {
-          sockOpen(socket);
-        }
+      // transmit queue
+      if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPEN) && !isBusy) {
+        if (socket->type == SIM_SOCK_UDP) txSendDatagrams(socket);
+        else                              txSend(socket);
       }
+
+#if SIM_SOCK_MANUAL_RX
+      if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPEN) && socket->rx.available && !isBusy) {
+        rxGet(socket);
+      }
+#endif
+    }
+  }
+
+  // Server Event Handler, before reconnect may open on the link of a new client
+  for (i = 0; SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) && !isBusy && i < SIM_NUM_OF_SERVER; i++)
+  {
+    if (hsim->net.servers[i] != NULL) {
+      serverHandleEvents(hsim, (SIM_Server_t*) hsim->net.servers[i]);
     }
   }
+
+  if (SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) && !isBusy) reconnNext(hsim);
 }
 
 
 void SIM_SockOnStarted(SIM_HandlerTypeDef *hsim)
 {
   SIM_Socket_t *socket;
+  void **slot;
 
-  for (uint8_t i = 0; i < SIM_NUM_OF_SOCKET; i++) {
-    if ((socket = hsim->net.sockets[i]) != NULL) {
+  for (uint8_t i = 0; i < SOCK_NUM_OF_SLOT; i++) {
+    slot = sockSlot(hsim, i);
+    if ((socket = *slot) != NULL) {
       if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPENING)) {
         if (socket->config.autoReconnect) {
-          socket->tick.reconnDelay = hsim->getTick();
+          reconnSchedule(socket, 1);
           if (socket->listeners.onConnectError != NULL)
             socket->listeners.onConnectError();
         }
       }
 
       else if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPEN)) {
+        txReset(socket);
         if (!socket->config.autoReconnect)
-          hsim->net.sockets[i] = NULL;
+          *slot = NULL;
         if (socket->listeners.onClosed != NULL)
           socket->listeners.onClosed();
       }
       SIM_SOCK_SET_STATE(socket, 0);
     }
   }
+
+  for (uint8_t i = 0; i < SIM_NUM_OF_SERVER; i++) {
+    if (hsim->net.servers[i] != NULL)
+      ((SIM_Server_t*) hsim->net.servers[i])->state = SIM_SERVER_STATE_STOPPED;
+  }
+
+#if SIM_EN_FEATURE_TLS
+  hsim->net.tls.isStarted = 0;
+  memset(hsim->net.tls.applied, 0, sizeof(hsim->net.tls.applied));
+#endif
+
+#if SIM_SOCK_TRANSPARENT
+  hsim->net.stream.isOnline = 0;
+#endif
 }
 
 
@@ -177,6 +259,8 @@ void SIM_SockOnNetOpened(SIM_HandlerTypeDef *hsim)
  */
 SIM_Status_t SIM_SockOpenTCPIP(SIM_HandlerTypeDef *hsim, int8_t *linkNum, const char *host, uint16_t port)
 {
+  SIM_Socket_t *sock;
+
   if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) || !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_AVAILABLE))
   {
     return SIM_ERROR;
@@ -189,40 +273,108 @@ SIM_Status_t SIM_SockOpenTCPIP(SIM_HandlerTypeDef *hsim, int8_t *linkNum, const
 
   hsim->mutexLock(hsim);
   SIM_SendCMD(hsim, "AT+CIPOPEN=%d,\"TCP\",\"%s\",%d", *linkNum, host, port);
-  SIM_SOCK_SET_STATE((SIM_Socket_t*)hsim->net.sockets[*linkNum], SIM_SOCK_STATE_OPENING);
+  // link may be opened without a registered socket
+  sock = (SIM_Socket_t*) hsim->net.sockets[*linkNum];
+  if (sock != NULL) SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPENING);
+
+  if (SIM_IsResponseOK(hsim)) {
+    hsim->mutexUnlock(hsim);
+    return SIM_OK;
+  }
+  if (sock != NULL) SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
+
+  hsim->mutexUnlock(hsim);
+  return SIM_ERROR;
+}
+
+
+SIM_Status_t SIM_SockOpenUDP(SIM_HandlerTypeDef *hsim, int8_t *linkNum, uint16_t localPort)
+{
+  SIM_Socket_t *sock;
+
+  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) || !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_AVAILABLE))
+  {
+    return SIM_ERROR;
+  }
+
+  if (*linkNum == -1 || hsim->net.sockets[*linkNum] == NULL) {
+    Get_Available_LinkNum(hsim, linkNum);
+    if (*linkNum == -1) return SIM_ERROR;
+  }
+
+  hsim->mutexLock(hsim);
+  // show source address of received datagrams, TCP links do not need it
+  if (!hsim->net.isSripOn) {
+    SIM_SendCMD(hsim, "AT+CIPSRIP=1");
+    if (SIM_IsResponseOK(hsim)) hsim->net.isSripOn = 1;
+  }
+  SIM_SendCMD(hsim, "AT+CIPOPEN=%d,\"UDP\",,,%d", *linkNum, localPort);
+  // link may be opened without a registered socket
+  sock = (SIM_Socket_t*) hsim->net.sockets[*linkNum];
+  if (sock != NULL) SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPENING);
 
   if (SIM_IsResponseOK(hsim)) {
     hsim->mutexUnlock(hsim);
     return SIM_OK;
   }
-  SIM_SOCK_SET_STATE((SIM_Socket_t*)hsim->net.sockets[*linkNum], SIM_SOCK_STATE_CLOSED);
+  if (sock != NULL) SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
 
   hsim->mutexUnlock(hsim);
   return SIM_ERROR;
 }
 
 
+SIM_Status_t SIM_SockServerStart(SIM_HandlerTypeDef *hsim, uint8_t index, uint16_t port)
+{
+  SIM_Status_t status = SIM_ERROR;
+
+  hsim->mutexLock(hsim);
+  SIM_SendCMD(hsim, "AT+SERVERSTART=%d,%d", port, index);
+  if (SIM_IsResponseOK(hsim)) status = SIM_OK;
+  hsim->mutexUnlock(hsim);
+
+  return status;
+}
+
+
+SIM_Status_t SIM_SockServerStop(SIM_HandlerTypeDef *hsim, uint8_t index)
+{
+  SIM_Status_t status = SIM_ERROR;
+
+  hsim->mutexLock(hsim);
+  // +SERVERSTOP: <server_index>,<err> comes as URC
+  SIM_SendCMD(hsim, "AT+SERVERSTOP=%d", index);
+  if (SIM_IsResponseOK(hsim)) status = SIM_OK;
+  hsim->mutexUnlock(hsim);
+
+  return status;
+}
+
+
 SIM_Status_t SIM_SockClose(SIM_HandlerTypeDef *hsim, uint8_t linkNum)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
+  uint8_t *resp = &hsim->respTmp[0];
   SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
 
   hsim->mutexLock(hsim);
 
   memset(resp, 0, 20);
   SIM_SendCMD(hsim, "AT+CIPCLOSE?");
   if (SIM_GetResponse(hsim, "+CIPCLOSE", 9, resp, 19, SIM_GETRESP_WAIT_OK, 1000) == SIM_OK) {
-    if (linkNum < 10 && *(resp+(linkNum*2)) == '1') {
+    SIM_Tokenize(&tokens, resp, 19, ',');
+    if (SIM_TokenInt(&tokens, linkNum) == 1) {
       SIM_SendCMD(hsim, "AT+CIPCLOSE=%d", linkNum);
       if (SIM_IsResponseOK(hsim)) {
         hsim->mutexUnlock(hsim);
         return SIM_OK;
       }
-    } else {
+    } else if (linkNum < SIM_NUM_OF_SOCKET) {
       socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
       if (socket != NULL) {
         SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
         SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+        SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
       }
     }
   }
@@ -234,21 +386,41 @@ SIM_Status_t SIM_SockClose(SIM_HandlerTypeDef *hsim, uint8_t linkNum)
 
 uint16_t SIM_SockSendData(SIM_HandlerTypeDef *hsim, int8_t linkNum, const uint8_t *data, uint16_t length)
 {
+  return SIM_SockSendTo(hsim, linkNum, NULL, 0, data, length);
+}
+
+
+/*
+ * Blocking send, host NULL for TCP or to send to the remote of UDP link.
+ * Returns 0 while the link has data queued by SIM_SOCK_Write.
+ */
+uint16_t SIM_SockSendTo(SIM_HandlerTypeDef *hsim, int8_t linkNum, const char *host, uint16_t port,
+                        const uint8_t *data, uint16_t length)
+{
+  SIM_Socket_t *socket = NULL;
   uint16_t sendLen = 0;
   uint8_t resp = 0;
-  uint8_t *cmdTmp = &SIM_CmdTmp[0];
+  char respCode[16];
 
   hsim->mutexLock(hsim);
 
-  sprintf((char*) cmdTmp, "AT+CIPSEND=%d,%d\r", linkNum, length);
-  SIM_SendData(hsim, cmdTmp, strlen((char*)cmdTmp));
-  if (!SIM_WaitResponse(hsim, ">", 1, 3000))
+  // queued data of SIM_SOCK_Write goes first, and its +CIPSEND must not
+  // be taken as the answer to this one
+  if (linkNum >= 0 && linkNum < SIM_NUM_OF_SOCKET)
+    socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (socket != NULL && txQueued(socket) > 0)
+    goto endcmd;
+
+  SIM_CmdQueueFlush(hsim);
+  if (!sendCIPSend(hsim, linkNum, host, port, length))
     goto endcmd;
   if (!SIM_SendData(hsim, data, length))
     goto endcmd;
   if (!SIM_IsResponseOK(hsim))
     goto endcmd;
-  if (SIM_GetResponse(hsim, "+CIPSEND", 8, &resp, 1, SIM_GETRESP_ONLY_DATA, 5000) == SIM_OK) {
+  // match only this link, other links' +CIPSEND go to the queue handler
+  sprintf(respCode, "+CIPSEND: %d,", linkNum);
+  if (SIM_GetResponse(hsim, respCode, strlen(respCode), &resp, 1, SIM_GETRESP_ONLY_DATA, 5000) == SIM_OK) {
     sendLen = length;
   }
   else {
@@ -271,13 +443,17 @@ SIM_Status_t SIM_SOCK_Init(SIM_Socket_t *sock, const char *host, uint16_t port)
   }
 
   sock->port = port;
+  sock->type = SIM_SOCK_TCPIP;
 
   if (sock->config.timeout == 0)
     sock->config.timeout = SIM_SOCK_DEFAULT_TO;
   if (sock->config.reconnectingDelay == 0)
     sock->config.reconnectingDelay = 5000;
+  if (sock->config.mtu == 0)
+    sock->config.mtu = SIM_SOCK_DEFAULT_MTU;
 
-  if (sock->buffer.buffer == NULL || sock->buffer.size == 0)
+  if (sock->listeners.onData == NULL
+      && (sock->buffer.buffer == NULL || sock->buffer.size == 0))
     return SIM_ERROR;
 
   SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
@@ -285,6 +461,35 @@ SIM_Status_t SIM_SOCK_Init(SIM_Socket_t *sock, const char *host, uint16_t port)
 }
 
 
+/*
+ * UDP socket bound to localPort, host and port are the default remote
+ */
+SIM_Status_t SIM_SOCK_InitUDP(SIM_Socket_t *sock, const char *host, uint16_t port, uint16_t localPort)
+{
+  SIM_Status_t status = SIM_SOCK_Init(sock, host, port);
+
+  sock->type = SIM_SOCK_UDP;
+  sock->localPort = localPort;
+  return status;
+}
+
+
+#if SIM_EN_FEATURE_TLS
+/*
+ * TLS client socket over CCH session, tls NULL for no certificate check
+ */
+SIM_Status_t SIM_SOCK_InitTLS(SIM_Socket_t *sock, const char *host, uint16_t port, const SIM_TLS_Config_t *tls)
+{
+  SIM_Status_t status = SIM_SOCK_Init(sock, host, port);
+
+  sock->type = SIM_SOCK_TLS;
+  sock->session = -1;
+  sock->tls = (tls != NULL)? tls: &tlsDefault;
+  return status;
+}
+#endif
+
+
 void SIM_SOCK_SetBuffer(SIM_Socket_t *sock, uint8_t *buffer, uint16_t size)
 {
   sock->buffer.buffer = buffer;
@@ -292,21 +497,45 @@ void SIM_SOCK_SetBuffer(SIM_Socket_t *sock, uint8_t *buffer, uint16_t size)
 }
 
 
+void SIM_SOCK_SetTxBuffer(SIM_Socket_t *sock, uint8_t *buffer, uint16_t size)
+{
+  sock->tx.buffer = buffer;
+  sock->tx.size = size;
+  txReset(sock);
+}
+
+
 SIM_Status_t SIM_SOCK_Open(SIM_Socket_t *sock, SIM_HandlerTypeDef *hsim)
 {
   SIM_Status_t status;
   sock->linkNum = -1;
+  sock->hsim = hsim;
 
   if (sock->config.autoReconnect) {
-    Get_Available_LinkNum(hsim, &(sock->linkNum));
-    if (sock->linkNum < 0) return SIM_ERROR;
-    hsim->net.sockets[sock->linkNum] = (void*)sock;
-    sock->hsim = hsim;
+#if SIM_EN_FEATURE_TLS
+    if (sock->type == SIM_SOCK_TLS) {
+      if (tlsTakeSession(sock) < 0) return SIM_ERROR;
+    }
+    else
+#endif
+    {
+      Get_Available_LinkNum(hsim, &(sock->linkNum));
+      if (sock->linkNum < 0) return SIM_ERROR;
+      hsim->net.sockets[sock->linkNum] = (void*)sock;
+    }
   }
 
   status = sockOpen(sock);
+  // failed socket with auto reconnect is retried by SIM_SockHandleEvents
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
   if (status != SIM_OK && !sock->config.autoReconnect) {
-    hsim->net.sockets[sock->linkNum] = NULL;
+#if SIM_EN_FEATURE_TLS
+    if (sock->type == SIM_SOCK_TLS && sock->session >= 0)
+      hsim->net.tls.sockets[sock->session] = NULL;
+    else
+#endif
+    if (sock->linkNum >= 0 && hsim->net.sockets[sock->linkNum] == (void*)sock)
+      hsim->net.sockets[sock->linkNum] = NULL;
     sock->linkNum = -1;
   }
 
@@ -314,20 +543,216 @@ SIM_Status_t SIM_SOCK_Open(SIM_Socket_t *sock, SIM_HandlerTypeDef *hsim)
 }
 
 
+void SIM_SERVER_Init(SIM_Server_t *server, uint16_t port)
+{
+  server->state = SIM_SERVER_STATE_STOPPED;
+  server->index = -1;
+  server->port = port;
+  server->backlogLen = 0;
+  server->rejectLinks = 0;
+}
+
+
+/*
+ * Register server, AT+SERVERSTART is sent by SIM_SockHandleEvents
+ * whenever net is open and server is not listening
+ */
+SIM_Status_t SIM_SERVER_Start(SIM_Server_t *server, SIM_HandlerTypeDef *hsim)
+{
+  if (server->index < 0) {
+    for (int8_t i = 0; i < SIM_NUM_OF_SERVER; i++) {
+      if (hsim->net.servers[i] == NULL) {
+        server->index = i;
+        break;
+      }
+    }
+    if (server->index < 0) return SIM_ERROR;
+  }
+
+  server->hsim = hsim;
+  server->state = SIM_SERVER_STATE_STOPPED;
+  server->retryTick = hsim->getTick();
+  hsim->net.servers[server->index] = (void*) server;
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+
+  return SIM_OK;
+}
+
+
+void SIM_SERVER_Stop(SIM_Server_t *server)
+{
+  SIM_HandlerTypeDef *hsim = server->hsim;
+
+  if (server->index < 0 || hsim == NULL) return;
+
+  hsim->net.servers[server->index] = NULL;
+  if (server->state == SIM_SERVER_STATE_LISTENING)
+    SIM_SockServerStop(hsim, server->index);
+  server->state = SIM_SERVER_STATE_STOPPED;
+  server->backlogLen = 0;
+  server->index = -1;
+}
+
+
 static SIM_Status_t sockOpen(SIM_Socket_t *sock)
 {
-  if (SIM_SockOpenTCPIP(sock->hsim, &sock->linkNum, sock->host, sock->port) == SIM_OK) {
+  SIM_Status_t status;
+
+  if (sock->type == SIM_SOCK_UDP)
+    status = SIM_SockOpenUDP(sock->hsim, &sock->linkNum, sock->localPort);
+#if SIM_EN_FEATURE_TLS
+  else if (sock->type == SIM_SOCK_TLS)
+    status = tlsOpen(sock);
+#endif
+#if SIM_SOCK_TRANSPARENT
+  else
+    status = streamOpen(sock);
+#elif SIM_SOCK_DNS_CACHE
+  else
+    status = SIM_SockOpenTCPIP(sock->hsim, &sock->linkNum, dnsLookup(sock->hsim, sock->host), sock->port);
+#else
+  else
+    status = SIM_SockOpenTCPIP(sock->hsim, &sock->linkNum, sock->host, sock->port);
+#endif
+
+  if (status == SIM_OK) {
+    sock->tick.connecting = sock->hsim->getTick();
     if (sock->listeners.onConnecting != NULL) sock->listeners.onConnecting();
     return SIM_OK;
   }
   SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
+  reconnSchedule(sock, 1);
 
   return SIM_ERROR;
 }
 
 
+/*
+ * Delay before next open, doubled on each failed attempt up to
+ * SIM_SOCK_BACKOFF_MAX. Half of it is random so sockets dropped together
+ * don't retry in lockstep.
+ */
+static void reconnSchedule(SIM_Socket_t *sock, uint8_t isFailed)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  uint32_t backoff = sock->reconn.backoff;
+
+  if (!isFailed || backoff == 0)
+    backoff = sock->config.reconnectingDelay;
+  else if (backoff < SIM_SOCK_BACKOFF_MAX)
+    backoff = (backoff > SIM_SOCK_BACKOFF_MAX / 2)? SIM_SOCK_BACKOFF_MAX: backoff * 2;
+
+  sock->reconn.backoff = isFailed? backoff: 0;
+  sock->reconn.wait = backoff / 2 + jitter(hsim) % (backoff / 2 + 1);
+  sock->tick.reconnDelay = hsim->getTick();
+}
+
+
+/*
+ * Open due closed sockets, highest priority first, while less than
+ * SIM_SOCK_MAX_OPENING are still waiting for the modem to connect.
+ * Each AT+CIPOPEN blocks the AT channel, after an outage they go one by one.
+ */
+static void reconnNext(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Socket_t *socket;
+  SIM_Socket_t *next;
+  uint8_t opening;
+
+  // bounded, a socket failing with zero delay is due again at once
+  for (uint8_t n = 0; n < SOCK_NUM_OF_SLOT; n++) {
+    next = NULL;
+    opening = 0;
+
+    for (uint8_t i = 0; i < SOCK_NUM_OF_SLOT; i++) {
+      if ((socket = *sockSlot(hsim, i)) == NULL) continue;
+
+      if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPENING)) {
+        if (!SIM_IsTimeout(hsim, socket->tick.connecting, SIM_SOCK_OPEN_TO)) {
+          opening++;
+          SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, socket->tick.connecting + SIM_SOCK_OPEN_TO + 1);
+          continue;
+        }
+        reconnAbort(socket);
+      }
+      if (SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_CLOSED)) {
+        // come back when reconnect delay ends
+        if (!SIM_IsTimeout(hsim, socket->tick.reconnDelay, socket->reconn.wait)) {
+          SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, socket->tick.reconnDelay + socket->reconn.wait + 1);
+          continue;
+        }
+        // same priority, longest waiting first
+        if (next == NULL
+            || socket->config.priority > next->config.priority
+            || (socket->config.priority == next->config.priority
+                && (int32_t)((socket->tick.reconnDelay + socket->reconn.wait)
+                             - (next->tick.reconnDelay + next->reconn.wait)) < 0))
+        {
+          next = socket;
+        }
+      }
+    }
+
+    // +CIPOPEN of opening socket wakes the handler again
+    if (next == NULL || opening >= SIM_SOCK_MAX_OPENING) return;
+    sockOpen(next);
+  }
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+}
+
+
+/*
+ * +CIPOPEN never came, close the link and retry it with backoff
+ */
+static void reconnAbort(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+
+  hsim->mutexLock(hsim);
+#if SIM_EN_FEATURE_TLS
+  if (sock->type == SIM_SOCK_TLS)
+    SIM_SendCMD(hsim, "AT+CCHCLOSE=%d", sock->session);
+  else
+#endif
+  SIM_SendCMD(hsim, "AT+CIPCLOSE=%d", sock->linkNum);
+  if (SIM_IsResponseOK(hsim)) {}
+  hsim->mutexUnlock(hsim);
+
+  SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
+  reconnSchedule(sock, 1);
+  if (sock->listeners.onConnectError != NULL)
+    sock->listeners.onConnectError();
+}
+
+
+/*
+ * xorshift32, seeded by tick of first use
+ */
+static uint32_t jitter(SIM_HandlerTypeDef *hsim)
+{
+  uint32_t x = hsim->net.jitterSeed;
+
+  if (x == 0) x = hsim->getTick() | 1;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  hsim->net.jitterSeed = x;
+  return x;
+}
+
+
 void SIM_SOCK_Close(SIM_Socket_t *sock)
 {
+#if SIM_SOCK_TRANSPARENT
+  if (sock->hsim->net.stream.socket == sock && SIM_IsDataMode(sock->hsim))
+    SIM_SOCK_Escape(sock);
+#endif
+#if SIM_EN_FEATURE_TLS
+  if (sock->type == SIM_SOCK_TLS) {
+    SIM_SockCloseTLS(sock->hsim, sock->session);
+    return;
+  }
+#endif
   SIM_SockClose(sock->hsim, sock->linkNum);
 }
 
@@ -335,75 +760,1337 @@ void SIM_SOCK_Close(SIM_Socket_t *sock)
 uint16_t SIM_SOCK_SendData(SIM_Socket_t *sock, const uint8_t *data, uint16_t length)
 {
   if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_OPEN)) return 0;
+#if SIM_SOCK_TRANSPARENT
+  if (sock->hsim->net.stream.socket == sock)
+    return streamWrite(sock, data, length);
+#endif
+#if SIM_EN_FEATURE_TLS
+  if (sock->type == SIM_SOCK_TLS)
+    return SIM_SockSendTLS(sock->hsim, sock->session, data, length);
+#endif
+  if (sock->type == SIM_SOCK_UDP)
+    return SIM_SockSendTo(sock->hsim, sock->linkNum, sock->host, sock->port, data, length);
   return SIM_SockSendData(sock->hsim, sock->linkNum, data, length);
 }
 
 
-static void resetOpenedSocket(SIM_HandlerTypeDef *hsim)
+/*
+ * Queue data for sending without waiting for the modem. Small writes
+ * are coalesced into one CIPSEND of up to config.mtu bytes, completion
+ * is reported through onSent. Returns length, or 0 if it does not fit.
+ */
+uint16_t SIM_SOCK_Write(SIM_Socket_t *sock, const uint8_t *data, uint16_t length)
+{
+#if SIM_SOCK_TRANSPARENT
+  if (sock->hsim->net.stream.socket == sock) {
+    if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_OPEN)) return 0;
+    return streamWrite(sock, data, length);
+  }
+#endif
+  if (sock->type == SIM_SOCK_UDP)
+    return SIM_SOCK_WriteTo(sock, sock->host, sock->port, data, length);
+
+  if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_OPEN) || sock->tx.buffer == NULL) return 0;
+  if (length == 0 || length > sock->tx.size - 1 - txQueued(sock)) return 0;
+
+  sock->tx.tail = txPut(sock, sock->tx.tail, data, length);
+  SIM_SetPending(sock->hsim, SIM_SUBSYS_SOCK);
+  return length;
+}
+
+
+/*
+ * Queue one datagram for UDP socket. Datagrams keep their boundaries,
+ * each one is stored as <len:2><port:2><hostLen:1><host><data>.
+ */
+uint16_t SIM_SOCK_WriteTo(SIM_Socket_t *sock, const char *host, uint16_t port,
+                          const uint8_t *data, uint16_t length)
+{
+  uint8_t  header[5];
+  uint16_t hostLen = strlen(host);
+  uint16_t space;
+  uint16_t tail;
+
+  if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_OPEN) || sock->tx.buffer == NULL) return 0;
+  if (sock->type != SIM_SOCK_UDP || hostLen == 0 || hostLen >= sizeof(sock->host)) return 0;
+  if (length == 0 || length > sock->config.mtu) return 0;
+
+  space = sock->tx.size - 1 - txQueued(sock);
+  if (sizeof(header) + hostLen + length > space) return 0;
+
+  header[0] = length & 0xFF;
+  header[1] = length >> 8;
+  header[2] = port & 0xFF;
+  header[3] = port >> 8;
+  header[4] = (uint8_t) hostLen;
+
+  tail = txPut(sock, sock->tx.tail, header, sizeof(header));
+  tail = txPut(sock, tail, (const uint8_t*) host, hostLen);
+  tail = txPut(sock, tail, data, length);
+
+  sock->tx.tail = tail;
+  SIM_SetPending(sock->hsim, SIM_SUBSYS_SOCK);
+  return length;
+}
+
+
+#if SIM_SOCK_TRANSPARENT
+/*
+ * Pass bytes received in data mode to the stream socket
+ */
+void SIM_SockStreamProcess(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
-  uint8_t *closing_resp = &SIM_RespTmp[32];
+  // more than the RX buffer may be waiting, stop at the CLOSED trailer
+  while (SIM_IsDataMode(hsim) && SIM_GetDataAvailable(hsim, streamSink, hsim->net.stream.socket) > 0);
+}
+
+
+/*
+ * Switch to command mode, the link stays open. Data already on the
+ * way is delivered before +++ is sent.
+ */
+SIM_Status_t SIM_SOCK_Escape(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  SIM_Status_t status = SIM_ERROR;
+
+  if (hsim->net.stream.socket != sock || !SIM_IsDataMode(hsim)) return SIM_ERROR;
 
   hsim->mutexLock(hsim);
-  // TCP/IP Config
-  SIM_SendCMD(hsim, "AT+CIPCCFG=10,0,0,1,1,0,10000");
-  if (SIM_IsResponseOK(hsim)){}
 
-  memset(resp, 0, 20);
-  SIM_SendCMD(hsim, "AT+CIPCLOSE?");
-  if (SIM_GetResponse(hsim, "+CIPCLOSE", 9, resp, 19, SIM_GETRESP_WAIT_OK, 1000) == SIM_OK) {
-    for (uint8_t i = 0; i < 10; i++) {
-      if (*(resp + (i*2)) == '1') {
-        memset(closing_resp, 0, 3);
-        SIM_SendCMD(hsim, "AT+CIPCLOSE=%d", i);
-        if (SIM_GetResponse(hsim, "+CIPCLOSE", 9, closing_resp, 3, SIM_GETRESP_WAIT_OK, 1000) == SIM_OK) {
+  hsim->delay(SIM_SOCK_ESCAPE_GUARD);
+  SIM_SockStreamProcess(hsim);
+  SIM_SendData(hsim, (const uint8_t*) "+++", 3);
 
-        }
-      }
-    }
-    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_AVAILABLE);
-  }
+  hsim->net.stream.isOnline = 0;
+  if (SIM_GetResponse(hsim, NULL, 0, NULL, 0, SIM_GETRESP_WAIT_OK, SIM_SOCK_ESCAPE_GUARD + 1000) == SIM_OK)
+    status = SIM_OK;
+  else
+    hsim->net.stream.isOnline = 1;
 
   hsim->mutexUnlock(hsim);
+  return status;
 }
 
 
-static void receiveData(SIM_HandlerTypeDef *hsim)
+/*
+ * Back to data mode after SIM_SOCK_Escape
+ */
+SIM_Status_t SIM_SOCK_Resume(SIM_Socket_t *sock)
 {
-  const uint8_t *nextBuf = NULL;
-  uint8_t *linkNum_str = &SIM_RespTmp[0];
-  uint8_t *dataLen_str = &SIM_RespTmp[8];
-  uint8_t linkNum;
-  uint16_t dataLen;
-  uint16_t writeLen;
-  SIM_Socket_t *socket;
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  SIM_Status_t status = SIM_ERROR;
 
-  memset(linkNum_str, 0, 2);
-  memset(dataLen_str, 0, 6);
+  if (hsim->net.stream.socket != sock || SIM_IsDataMode(hsim)) return SIM_ERROR;
+  if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_OPEN)) return SIM_ERROR;
 
-  // skip string "+RECEIVE" and read next data
-  nextBuf = SIM_ParseStr(&hsim->respBuffer[9], ',', 0, linkNum_str);
-  SIM_ParseStr(nextBuf, ',', 0, dataLen_str);
-  linkNum = (uint8_t) atoi((char*) linkNum_str);
-  dataLen = (uint16_t) atoi((char*) dataLen_str);
+  hsim->mutexLock(hsim);
 
-  if (linkNum < SIM_NUM_OF_SOCKET && hsim->net.sockets[linkNum] != NULL) {
-    socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
-    while (dataLen) {
-      if (dataLen > socket->buffer.size)  writeLen = socket->buffer.size;
-      else                                writeLen = dataLen;
+  SIM_SendCMD(hsim, "ATO");
+  if (SIM_GetResponse(hsim, "CONNECT", 7, NULL, 0, SIM_GETRESP_ONLY_DATA, hsim->timeout) == SIM_OK) {
+    hsim->net.stream.closeMatch = 0;
+    hsim->net.stream.isOnline = 1;
+    status = SIM_OK;
+  }
 
-      if (hsim->serial.readinto(hsim->serial.device, &socket->buffer, writeLen, 5000) < 0)
-        break;
+  hsim->mutexUnlock(hsim);
+  return status;
+}
 
-      dataLen -= writeLen;
 
-      if (socket->listeners.onReceived != NULL)
-        socket->listeners.onReceived(&(socket->buffer));
-    }
+/*
+ * Transparent mode only works on link 0, the modem answers CONNECT
+ * instead of OK and +CIPOPEN
+ */
+static SIM_Status_t streamOpen(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  SIM_Status_t status = SIM_ERROR;
+  const char *host = sock->host;
 
-    SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_RECEIVED);
+  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) || !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_AVAILABLE))
+  {
+    return SIM_ERROR;
+  }
+  if (hsim->net.sockets[0] != NULL && hsim->net.sockets[0] != sock) return SIM_ERROR;
+
+  if (sock->linkNum > 0) hsim->net.sockets[sock->linkNum] = NULL;
+  sock->linkNum = 0;
+  hsim->net.sockets[0] = (void*) sock;
+
+#if SIM_SOCK_DNS_CACHE
+  host = dnsLookup(hsim, sock->host);
+#endif
+
+  hsim->mutexLock(hsim);
+  SIM_SendCMD(hsim, "AT+CIPOPEN=0,\"TCP\",\"%s\",%d", host, sock->port);
+  SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPENING);
+
+  // CONNECT [<baud>] or CONNECT FAIL
+  if (SIM_GetResponse(hsim, "CONNECT", 7, NULL, 0, SIM_GETRESP_ONLY_DATA, SIM_SOCK_CONNECT_TO) == SIM_OK
+      && !SIM_IsResponse(hsim, "CONNECT FAIL", 12))
+  {
+    hsim->net.stream.socket = sock;
+    hsim->net.stream.closeMatch = 0;
+    hsim->net.stream.isOnline = 1;
+    SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPEN);
+    SIM_BITS_SET(sock->events, SIM_SOCK_EVENT_ON_OPENED);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+    status = SIM_OK;
+  }
+
+  hsim->mutexUnlock(hsim);
+  return status;
+}
+
+
+static uint16_t streamWrite(SIM_Socket_t *sock, const uint8_t *data, uint16_t length)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  uint16_t sendLen = 0;
+
+  hsim->mutexLock(hsim);
+  if (SIM_IsDataMode(hsim) && SIM_SendData(hsim, data, length))
+    sendLen = length;
+  hsim->mutexUnlock(hsim);
+
+  return sendLen;
+}
+
+
+static void streamSink(void *ctx, const uint8_t *data, uint16_t len)
+{
+  SIM_Socket_t *socket = (SIM_Socket_t*) ctx;
+  SIM_HandlerTypeDef *hsim = socket->hsim;
+  uint8_t match = hsim->net.stream.closeMatch;
+  uint16_t dataLen = len;
+  uint16_t writeLen;
+  uint16_t i;
+
+  for (i = 0; i < len; i++) {
+    if (data[i] == streamClosed[match])  match++;
+    else                                 match = (data[i] == streamClosed[0])? 1: 0;
+
+    if (match == sizeof(streamClosed) - 1) {
+      // trailer is not payload, part of it may be delivered already
+      dataLen = (i + 1 >= match)? i + 1 - match: 0;
+      hsim->net.stream.isOnline = 0;
+      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
+      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+      SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+      match = 0;
+      break;
+    }
+  }
+  hsim->net.stream.closeMatch = match;
+
+  if (dataLen == 0) return;
+
+  if (socket->listeners.onData != NULL) {
+    socket->listeners.onData(data, dataLen);
+  }
+  else if (socket->buffer.size) {
+    writeLen = Buffer_Write(&socket->buffer, data, dataLen);
+    // ring full, app drains it in onReceived
+    while (writeLen < dataLen && socket->listeners.onReceived != NULL) {
+      socket->listeners.onReceived(&(socket->buffer));
+      i = Buffer_Write(&socket->buffer, &data[writeLen], dataLen - writeLen);
+      if (i == 0) break;
+      writeLen += i;
+    }
+    SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_RECEIVED);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+}
+#endif /* SIM_SOCK_TRANSPARENT */
+
+
+static void serverHandleEvents(SIM_HandlerTypeDef *hsim, SIM_Server_t *server)
+{
+  int8_t linkNum;
+  char host[sizeof(server->backlog[0].host)];
+  uint16_t port;
+
+  if (server->state == SIM_SERVER_STATE_STOPPED) {
+    if (!SIM_IsDue(hsim, server->retryTick)) {
+      SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, server->retryTick);
+      return;
+    }
+    if (SIM_SockServerStart(hsim, server->index, server->port) != SIM_OK) {
+      SIM_Schedule(hsim, server->retryTick, SIM_RETRY_INTERVAL);
+      SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, server->retryTick);
+      return;
+    }
+    server->state = SIM_SERVER_STATE_LISTENING;
+  }
+
+  for (linkNum = 0; server->rejectLinks; linkNum++) {
+    if (server->rejectLinks & (1 << linkNum)) {
+      server->rejectLinks &= ~(1 << linkNum);
+      SIM_SockClose(hsim, linkNum);
+    }
+  }
+
+  // take entry out first, +CLIENT may come while accepting
+  while (server->backlogLen) {
+    linkNum = server->backlog[0].linkNum;
+    port = server->backlog[0].port;
+    strcpy(host, server->backlog[0].host);
+
+    server->backlogLen--;
+    memmove(&server->backlog[0], &server->backlog[1], server->backlogLen * sizeof(server->backlog[0]));
+
+    serverAccept(hsim, server, linkNum, host, port);
+  }
+}
+
+
+/*
+ * Bind client link to socket given by onAccept, it then works
+ * like a connected socket without auto reconnect
+ */
+static void serverAccept(SIM_HandlerTypeDef *hsim, SIM_Server_t *server,
+                         int8_t linkNum, const char *host, uint16_t port)
+{
+  SIM_Socket_t *sock = NULL;
+
+  if (freeLink(hsim, linkNum) && server->listeners.onAccept != NULL)
+    sock = server->listeners.onAccept(host, port);
+
+  if (sock == NULL) {
+    SIM_SockClose(hsim, linkNum);
+    return;
+  }
+
+  sock->hsim = hsim;
+  sock->linkNum = linkNum;
+  sock->type = SIM_SOCK_TCPIP;
+  sock->config.autoReconnect = 0;
+  if (sock->config.timeout == 0)
+    sock->config.timeout = SIM_SOCK_DEFAULT_TO;
+  if (sock->config.mtu == 0)
+    sock->config.mtu = SIM_SOCK_DEFAULT_MTU;
+
+  strcpy(sock->remote.host, host);
+  sock->remote.port = port;
+  txReset(sock);
+  sock->rx.available = 0;
+
+  hsim->net.sockets[linkNum] = (void*) sock;
+  SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPEN);
+  SIM_BITS_SET(sock->events, SIM_SOCK_EVENT_ON_OPENED);
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+}
+
+
+/*
+ * Modem picks the link of new client, move a closed socket waiting for
+ * reconnect out of the way
+ */
+static uint8_t freeLink(SIM_HandlerTypeDef *hsim, int8_t linkNum)
+{
+  SIM_Socket_t *sock = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  int8_t newLink = -1;
+
+  if (sock == NULL) return 1;
+  if (!SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_CLOSED)) return 0;
+
+  for (int8_t i = 0; i < SIM_NUM_OF_SOCKET; i++) {
+    if (i != linkNum && hsim->net.sockets[i] == NULL) {
+      newLink = i;
+      break;
+    }
+  }
+  if (newLink < 0) return 0;
+
+  hsim->net.sockets[newLink] = (void*) sock;
+  hsim->net.sockets[linkNum] = NULL;
+  sock->linkNum = newLink;
+  return 1;
+}
+
+
+static void** sockSlot(SIM_HandlerTypeDef *hsim, uint8_t i)
+{
+#if SIM_EN_FEATURE_TLS
+  if (i >= SIM_NUM_OF_SOCKET) return &hsim->net.tls.sockets[i - SIM_NUM_OF_SOCKET];
+#endif
+  return &hsim->net.sockets[i];
+}
+
+
+static void resetOpenedSocket(SIM_HandlerTypeDef *hsim)
+{
+  uint8_t *resp = &hsim->respTmp[0];
+  uint8_t *closing_resp = &hsim->respTmp[32];
+  SIM_Tokens_t tokens;
+
+  hsim->mutexLock(hsim);
+  // TCP/IP Config
+  SIM_SendCMD(hsim, "AT+CIPCCFG=10,0,0,1,1,0,10000");
+  if (SIM_IsResponseOK(hsim)){}
+  // source address report is enabled again by the next UDP open
+  hsim->net.isSripOn = 0;
+
+#if SIM_EN_FEATURE_TLS
+  // CCH sessions do not survive net reopen
+  hsim->net.tls.isStarted = 0;
+  for (uint8_t i = 0; i < SIM_NUM_OF_TLS; i++) {
+    SIM_Socket_t *sock = (SIM_Socket_t*) hsim->net.tls.sockets[i];
+    if (sock != NULL && !SIM_SOCK_IS_STATE(sock, SIM_SOCK_STATE_CLOSED)) {
+      SIM_BITS_SET(sock->events, SIM_SOCK_EVENT_ON_CLOSED);
+      SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_CLOSED);
+      SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+    }
+  }
+#endif
+
+  // servers left from before are started again by the event handler
+  for (uint8_t i = 0; i < SIM_NUM_OF_SERVER; i++) {
+    if (hsim->net.servers[i] != NULL) {
+      SIM_SendCMD(hsim, "AT+SERVERSTOP=%d", i);
+      if (SIM_IsResponseOK(hsim)){}
+      ((SIM_Server_t*) hsim->net.servers[i])->state = SIM_SERVER_STATE_STOPPED;
+    }
+  }
+#if SIM_SOCK_MANUAL_RX
+  SIM_SendCMD(hsim, "AT+CIPRXGET=1");
+  if (SIM_IsResponseOK(hsim)){}
+#endif
+
+  memset(resp, 0, 20);
+  SIM_SendCMD(hsim, "AT+CIPCLOSE?");
+  if (SIM_GetResponse(hsim, "+CIPCLOSE", 9, resp, 19, SIM_GETRESP_WAIT_OK, 1000) == SIM_OK) {
+    SIM_Tokenize(&tokens, resp, 19, ',');
+    for (uint8_t i = 0; i < tokens.count; i++) {
+      if (SIM_TokenInt(&tokens, i) == 1) {
+        memset(closing_resp, 0, 3);
+        SIM_SendCMD(hsim, "AT+CIPCLOSE=%d", i);
+        if (SIM_GetResponse(hsim, "+CIPCLOSE", 9, closing_resp, 3, SIM_GETRESP_WAIT_OK, 1000) == SIM_OK) {
+
+        }
+      }
+    }
+    SIM_NET_SET_STATUS(hsim, SIM_NET_STATUS_AVAILABLE);
+  }
+
+  hsim->mutexUnlock(hsim);
+}
+
+
+static void receiveData(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Tokens_t tokens;
+  uint8_t linkNum;
+  uint16_t dataLen;
+  SIM_Socket_t *socket;
+
+  // +RECEIVE,<link_num>,<data_len>
+  SIM_Tokenize(&tokens, hsim->respBuffer, hsim->respBufferLen, ',');
+  linkNum = (uint8_t) SIM_TokenInt(&tokens, 1);
+  dataLen = (uint16_t) SIM_TokenInt(&tokens, 2);
+
+  if (linkNum >= SIM_NUM_OF_SOCKET || hsim->net.sockets[linkNum] == NULL) {
+    SIM_GetDataSink(hsim, NULL, NULL, dataLen, 5000);
+    return;
+  }
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  strcpy(socket->remote.host, hsim->net.recvFrom.host);
+  socket->remote.port = hsim->net.recvFrom.port;
+  hsim->net.recvFrom.host[0] = 0;
+  hsim->net.recvFrom.port = 0;
+
+  deliverData(hsim, socket, dataLen);
+}
+
+
+static void deliverData(SIM_HandlerTypeDef *hsim, SIM_Socket_t *socket, uint16_t dataLen)
+{
+  uint16_t writeLen;
+
+  /*
+   * payload goes straight from the RX ring to the application
+   */
+  if (socket->listeners.onData != NULL) {
+    SIM_GetDataSink(hsim, sinkData, socket, dataLen, 5000);
+    return;
+  }
+
+  // no buffer set, drop payload to keep the AT stream in sync
+  if (socket->buffer.size < 2) {
+    SIM_GetDataSink(hsim, NULL, NULL, dataLen, 5000);
+    return;
+  }
+
+  while (dataLen) {
+    // ring keeps one slot free, app drains it in onReceived
+    if (dataLen > socket->buffer.size - 1)  writeLen = socket->buffer.size - 1;
+    else                                    writeLen = dataLen;
+
+    if (SIM_GetDataInto(hsim, &socket->buffer, writeLen, 5000) < writeLen)
+      break;
+
+    dataLen -= writeLen;
+
+    if (socket->listeners.onReceived != NULL)
+      socket->listeners.onReceived(&(socket->buffer));
+  }
+
+  SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_RECEIVED);
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+}
+
+
+static void sinkData(void *ctx, const uint8_t *data, uint16_t len)
+{
+  SIM_Socket_t *socket = (SIM_Socket_t*) ctx;
+
+  socket->listeners.onData(data, len);
+}
+
+
+static uint16_t txQueued(SIM_Socket_t *sock)
+{
+  if (sock->tx.size == 0) return 0;
+  return (sock->tx.tail + sock->tx.size - sock->tx.head) % sock->tx.size;
+}
+
+
+static uint16_t txPut(SIM_Socket_t *sock, uint16_t pos, const uint8_t *data, uint16_t len)
+{
+  uint16_t chunk = sock->tx.size - pos;
+
+  if (chunk > len) chunk = len;
+  memcpy(&sock->tx.buffer[pos], data, chunk);
+  memcpy(&sock->tx.buffer[0], data + chunk, len - chunk);
+  return (pos + len) % sock->tx.size;
+}
+
+
+static uint16_t txGet(SIM_Socket_t *sock, uint16_t pos, uint8_t *data, uint16_t len)
+{
+  uint16_t chunk = sock->tx.size - pos;
+
+  if (chunk > len) chunk = len;
+  memcpy(data, &sock->tx.buffer[pos], chunk);
+  memcpy(data + chunk, &sock->tx.buffer[0], len - chunk);
+  return (pos + len) % sock->tx.size;
+}
+
+
+static uint8_t txSendRange(SIM_Socket_t *sock, uint16_t pos, uint16_t len)
+{
+  uint16_t chunk = sock->tx.size - pos;
+
+  if (chunk > len) chunk = len;
+  if (!SIM_SendData(sock->hsim, &sock->tx.buffer[pos], chunk)) return 0;
+  if (chunk < len && !SIM_SendData(sock->hsim, &sock->tx.buffer[0], len - chunk)) return 0;
+  return 1;
+}
+
+
+static void txReset(SIM_Socket_t *sock)
+{
+  sock->tx.head = sock->tx.tail;
+  sock->tx.inFlight = 0;
+}
+
+
+/*
+ * Stage the next CIPSEND with everything queued so far. Only one send is
+ * in flight per link; the next one goes out once +CIPSEND confirms it.
+ */
+static void txSend(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  uint16_t length;
+
+  if (sock->tx.inFlight) {
+    if (SIM_IsTimeout(hsim, sock->tick.sending, sock->config.timeout)) {
+      sock->tx.inFlight = 0;
+      if (sock->listeners.onSendError != NULL)
+        sock->listeners.onSendError();
+    }
+    else {
+      SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, sock->tick.sending + sock->config.timeout + 1);
+      return;
+    }
+  }
+
+  length = txQueued(sock);
+  if (length == 0) return;
+  if (length > sock->config.mtu) length = sock->config.mtu;
+
+  hsim->mutexLock(hsim);
+
+  SIM_CmdQueueFlush(hsim);
+  if (!sendPrompt(sock, length))
+    goto endcmd;
+
+  if (!txSendRange(sock, sock->tx.head, length))
+    goto endcmd;
+
+  sock->tx.inFlight = length;
+  sock->tick.sending = hsim->getTick();
+  if (!SIM_IsResponseOK(hsim))
+    sock->tx.inFlight = 0;
+
+endcmd:
+  hsim->mutexUnlock(hsim);
+
+#if SIM_EN_FEATURE_TLS
+  // CCHSEND has no +CIPSEND, data is taken by SSL stack once OK came
+  if (sock->tx.inFlight && sock->type == SIM_SOCK_TLS) {
+    sock->tx.head = (sock->tx.head + length) % sock->tx.size;
+    sock->tx.inFlight = 0;
+    if (sock->listeners.onSent != NULL)
+      sock->listeners.onSent(length);
+    if (txQueued(sock)) SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+    return;
+  }
+#endif
+
+  if (sock->tx.inFlight) {
+    SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, sock->tick.sending + sock->config.timeout + 1);
+    return;
+  }
+
+  // data stays queued, try again later
+  SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, hsim->getTick() + SIM_RETRY_INTERVAL);
+  if (sock->listeners.onSendError != NULL)
+    sock->listeners.onSendError();
+}
+
+
+/*
+ * Send up to SIM_SOCK_UDP_BATCH datagrams in one lock of the AT channel.
+ * Each one still needs its own AT+CIPSEND, the batch only saves the
+ * lock and the wait for +CIPSEND between them. UDP has no delivery
+ * confirmation so a datagram is done once the modem accepted it.
+ */
+static void txSendDatagrams(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  uint8_t  header[5];
+  char     host[sizeof(sock->host)];
+  uint16_t length;
+  uint16_t port;
+  uint16_t pos;
+  uint8_t  count = 0;
+  uint8_t  isFailed = 0;
+
+  if (txQueued(sock) == 0) return;
+
+  hsim->mutexLock(hsim);
+  SIM_CmdQueueFlush(hsim);
+
+  while (count < SIM_SOCK_UDP_BATCH && txQueued(sock)) {
+    pos = txGet(sock, sock->tx.head, header, sizeof(header));
+    length = header[0] | (header[1] << 8);
+    port   = header[2] | (header[3] << 8);
+    pos = txGet(sock, pos, (uint8_t*) host, header[4]);
+    host[header[4]] = 0;
+
+    if (!sendCIPSend(hsim, sock->linkNum, host, port, length)
+        || !txSendRange(sock, pos, length)
+        || !SIM_IsResponseOK(hsim))
+    {
+      isFailed = 1;
+      break;
+    }
+
+    sock->tx.head = (pos + length) % sock->tx.size;
+    count++;
+    if (sock->listeners.onSent != NULL)
+      sock->listeners.onSent(length);
+  }
+
+  hsim->mutexUnlock(hsim);
+
+  if (isFailed) {
+    SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, hsim->getTick() + SIM_RETRY_INTERVAL);
+    if (sock->listeners.onSendError != NULL)
+      sock->listeners.onSendError();
+  }
+  else if (txQueued(sock)) {
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+}
+
+
+/*
+ * AT+CIPSEND ends with CR only, the modem answers with '>' prompt
+ */
+static uint8_t sendCIPSend(SIM_HandlerTypeDef *hsim, int8_t linkNum, const char *host, uint16_t port, uint16_t length)
+{
+  if (host != NULL)
+    hsim->cmdBufferLen = sprintf(hsim->cmdBuffer, "AT+CIPSEND=%d,%d,\"%s\",%d\r", linkNum, length, host, port);
+  else
+    hsim->cmdBufferLen = sprintf(hsim->cmdBuffer, "AT+CIPSEND=%d,%d\r", linkNum, length);
+
+  if (!SIM_SendData(hsim, (uint8_t*) hsim->cmdBuffer, hsim->cmdBufferLen)) return 0;
+  SIM_STATS_SEND(hsim, hsim->cmdBuffer, hsim->cmdBufferLen);
+  return SIM_WaitResponse(hsim, ">", 1, 3000);
+}
+
+
+#if SIM_SOCK_DNS_CACHE
+/*
+ * Hostname is resolved once with AT+CDNSGIP and reconnects open the cached
+ * address instead of letting the modem resolve it on every AT+CIPOPEN.
+ * Any failure falls back to the hostname.
+ */
+static const char* dnsLookup(SIM_HandlerTypeDef *hsim, const char *host)
+{
+  int8_t i;
+
+  // already an address (IPv6 always has ':')
+  if (strchr(host, ':') != NULL || strspn(host, "0123456789.") == strlen(host))
+    return host;
+
+  i = dnsFind(hsim, host);
+  if (i < 0 || SIM_IsDue(hsim, hsim->net.dns[i].expireTick))
+    i = dnsResolve(hsim, host);
+
+  return (i < 0)? host: hsim->net.dns[i].ip;
+}
+
+
+/*
+ * return cache index, -1 if not resolved
+ */
+static int8_t dnsResolve(SIM_HandlerTypeDef *hsim, const char *host)
+{
+  uint8_t resp[sizeof(hsim->net.dns[0].host) + sizeof(hsim->net.dns[0].ip) + 8];
+  char ip[sizeof(hsim->net.dns[0].ip)];
+  SIM_Tokens_t tokens;
+  uint8_t isOK = 0;
+  int8_t i;
+
+  if (strlen(host) >= sizeof(hsim->net.dns[0].host)) return -1;
+
+  hsim->mutexLock(hsim);
+
+  // +CDNSGIP: 1,<domain>,<ip>[,<ip2>] or +CDNSGIP: 0,<err>
+  memset(resp, 0, sizeof(resp));
+  SIM_SendCMD(hsim, "AT+CDNSGIP=\"%s\"", host);
+  if (SIM_GetResponse(hsim, "+CDNSGIP", 8, resp, sizeof(resp)-1, SIM_GETRESP_WAIT_OK, SIM_SOCK_DNS_TIMEOUT) == SIM_OK) {
+    SIM_Tokenize(&tokens, resp, sizeof(resp)-1, ',');
+    if (SIM_TokenInt(&tokens, 0) == 1
+        && SIM_TokenLen(&tokens, 2) > 0 && SIM_TokenLen(&tokens, 2) < sizeof(ip))
+    {
+      SIM_TokenCopy(&tokens, 2, ip, sizeof(ip));
+      isOK = 1;
+    }
+  }
+
+  hsim->mutexUnlock(hsim);
+
+  i = dnsFind(hsim, host);
+  if (!isOK) {
+    if (i < 0) return -1;
+    // keep serving it until expired, retry soon
+    if (SIM_IsDue(hsim, hsim->net.dns[i].expireTick)) {
+      hsim->net.dns[i].host[0] = 0;
+      return -1;
+    }
+    SIM_Schedule(hsim, hsim->net.dns[i].refreshTick, SIM_RETRY_INTERVAL);
+    return i;
+  }
+
+  // take empty entry or the one expiring first
+  if (i < 0) {
+    i = 0;
+    for (int8_t j = 0; j < SIM_SOCK_DNS_CACHE; j++) {
+      if (hsim->net.dns[j].host[0] == 0) {
+        i = j;
+        break;
+      }
+      if ((int32_t)(hsim->net.dns[j].expireTick - hsim->net.dns[i].expireTick) < 0) i = j;
+    }
+    strcpy(hsim->net.dns[i].host, host);
+  }
+  strcpy(hsim->net.dns[i].ip, ip);
+  SIM_Schedule(hsim, hsim->net.dns[i].expireTick, SIM_SOCK_DNS_TTL);
+  hsim->net.dns[i].refreshTick = hsim->net.dns[i].expireTick - SIM_SOCK_DNS_REFRESH;
+
+  return i;
+}
+
+
+static int8_t dnsFind(SIM_HandlerTypeDef *hsim, const char *host)
+{
+  for (int8_t i = 0; i < SIM_SOCK_DNS_CACHE; i++) {
+    if (hsim->net.dns[i].host[0] != 0 && strcmp(hsim->net.dns[i].host, host) == 0)
+      return i;
+  }
+  return -1;
+}
+
+
+static void dnsForget(SIM_HandlerTypeDef *hsim, const char *host)
+{
+  int8_t i = dnsFind(hsim, host);
+
+  if (i >= 0) hsim->net.dns[i].host[0] = 0;
+}
+
+
+/*
+ * Resolve again before expiry only hosts of registered sockets,
+ * the rest is dropped once expired.
+ */
+static void dnsRefresh(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Socket_t *socket;
+  uint8_t isUsed;
+
+  for (int8_t i = 0; i < SIM_SOCK_DNS_CACHE; i++) {
+    if (hsim->net.dns[i].host[0] == 0) continue;
+
+    isUsed = 0;
+    for (uint8_t j = 0; j < SIM_NUM_OF_SOCKET; j++) {
+      socket = (SIM_Socket_t*) hsim->net.sockets[j];
+      if (socket != NULL && strcmp(socket->host, hsim->net.dns[i].host) == 0) {
+        isUsed = 1;
+        break;
+      }
+    }
+
+    if (!isUsed) {
+      if (SIM_IsDue(hsim, hsim->net.dns[i].expireTick)) hsim->net.dns[i].host[0] = 0;
+      continue;
+    }
+
+    if (SIM_IsDue(hsim, hsim->net.dns[i].refreshTick))
+      dnsResolve(hsim, hsim->net.dns[i].host);
+    if (hsim->net.dns[i].host[0] != 0)
+      SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, hsim->net.dns[i].refreshTick);
+  }
+}
+#endif /* SIM_SOCK_DNS_CACHE */
+
+
+#if SIM_SOCK_MANUAL_RX
+/*
+ * Pull at most what the application can take, read length grows while
+ * the modem keeps more data and shrinks when reads come back short.
+ */
+static void rxGet(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  uint8_t *resp = &hsim->respTmp[0];
+  SIM_Tokens_t tokens;
+  uint16_t space;
+  uint16_t reqLen;
+  uint16_t readLen;
+  uint16_t restLen;
+
+  if (sock->listeners.getRxSpace != NULL)   space = sock->listeners.getRxSpace();
+  else if (sock->listeners.onData != NULL)  space = SIM_SOCK_RXGET_MAX;
+  // ring keeps one slot free
+  else if (sock->buffer.size)               space = sock->buffer.size - 1;
+  else                                      space = 0;
+
+  if (space == 0) {
+    SIM_WakeAt(hsim, SIM_SUBSYS_SOCK, hsim->getTick() + SIM_SOCK_RXGET_POLL);
+    return;
+  }
+
+  if (sock->rx.readSize < SIM_SOCK_RXGET_MIN) sock->rx.readSize = SIM_SOCK_RXGET_MIN;
+  reqLen = sock->rx.readSize;
+  if (reqLen > space) reqLen = space;
+
+  hsim->mutexLock(hsim);
+
+  memset(resp, 0, 32);
+  SIM_SendCMD(hsim, "AT+CIPRXGET=2,%d,%d", sock->linkNum, reqLen);
+  // +CIPRXGET: 2,<link_num>,<read_len>,<rest_len>
+  if (SIM_GetResponse(hsim, "+CIPRXGET: 2,", 13, resp, 31, SIM_GETRESP_ONLY_DATA, sock->config.timeout) != SIM_OK) {
+    sock->rx.available = 0;
+    goto endcmd;
+  }
+  SIM_Tokenize(&tokens, resp, strlen((char*) resp), ',');
+  readLen = (uint16_t) SIM_TokenInt(&tokens, 2);
+  restLen = (uint16_t) SIM_TokenInt(&tokens, 3);
+
+  if (readLen) deliverData(hsim, sock, readLen);
+  if (SIM_IsResponseOK(hsim)) {}
+
+  if (restLen && readLen == sock->rx.readSize) {
+    sock->rx.readSize *= 2;
+    if (sock->rx.readSize > SIM_SOCK_RXGET_MAX) sock->rx.readSize = SIM_SOCK_RXGET_MAX;
+  }
+  else if (!restLen && readLen < sock->rx.readSize / 2) {
+    sock->rx.readSize /= 2;
+    if (sock->rx.readSize < SIM_SOCK_RXGET_MIN) sock->rx.readSize = SIM_SOCK_RXGET_MIN;
+  }
+
+  // continue on next loop so other subsystems get their turn
+  sock->rx.available = (restLen > 0);
+  if (sock->rx.available) SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+
+endcmd:
+  hsim->mutexUnlock(hsim);
+}
+
+
+static uint8_t urcCIPRxGet(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  // +CIPRXGET: 1,<link_num>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (tokens.count != 2 || SIM_TokenInt(&tokens, 0) != 1) return 0;
+  linkNum = (int8_t) SIM_TokenInt(&tokens, 1);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (socket != NULL) {
+    socket->rx.available = 1;
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+#endif /* SIM_SOCK_MANUAL_RX */
+
+
+static uint8_t urcReceive(SIM_HandlerTypeDef *hsim)
+{
+  receiveData(hsim);
+  return 1;
+}
+
+
+static uint8_t urcCIPOpen(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  if (hsim->respBufferLen < 13) return 0;
+
+  // +CIPOPEN: <link_num>,<err>
+  SIM_TokenizeResp(hsim, &tokens);
+  linkNum   = (int8_t) SIM_TokenInt(&tokens, 0);
+  int err   =          SIM_TokenInt(&tokens, 1);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (socket != NULL) {
+    if (err == 0) {
+      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENED);
+      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_OPEN);
+    } else {
+      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENING_ERROR);
+      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+    }
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+
+
+static uint8_t urcIPClose(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  if (hsim->respBufferLen < 13) return 0;
+
+  // +IPCLOSE: <link_num>,<reason>
+  SIM_TokenizeResp(hsim, &tokens);
+  linkNum = (int8_t) SIM_TokenInt(&tokens, 0);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (socket != NULL) {
+    SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
+    SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+
+
+static uint8_t urcCIPClose(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  if (hsim->respBufferLen < 14 || hsim->respBufferLen > 16) return 0;
+
+  // +CIPCLOSE: <link_num>,<err>
+  SIM_TokenizeResp(hsim, &tokens);
+  linkNum = (int8_t) SIM_TokenInt(&tokens, 0);
+  int err =          SIM_TokenInt(&tokens, 1);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (err == 0 && socket != NULL && !SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_CLOSED)) {
+    SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
+    SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+
+
+static uint8_t sendPrompt(SIM_Socket_t *sock, uint16_t length)
+{
+#if SIM_EN_FEATURE_TLS
+  if (sock->type == SIM_SOCK_TLS)
+    return sendCCHSend(sock->hsim, sock->session, length);
+#endif
+  return sendCIPSend(sock->hsim, sock->linkNum, NULL, 0, length);
+}
+
+
+#if SIM_EN_FEATURE_TLS
+SIM_Status_t SIM_SockCloseTLS(SIM_HandlerTypeDef *hsim, uint8_t session)
+{
+  SIM_Status_t status = SIM_ERROR;
+
+  hsim->mutexLock(hsim);
+  // +CCHCLOSE: <session_id>,<err> comes as URC
+  SIM_SendCMD(hsim, "AT+CCHCLOSE=%d", session);
+  if (SIM_IsResponseOK(hsim)) status = SIM_OK;
+  hsim->mutexUnlock(hsim);
+
+  return status;
+}
+
+
+uint16_t SIM_SockSendTLS(SIM_HandlerTypeDef *hsim, uint8_t session, const uint8_t *data, uint16_t length)
+{
+  uint16_t sendLen = 0;
+
+  hsim->mutexLock(hsim);
+
+  SIM_CmdQueueFlush(hsim);
+  if (!sendCCHSend(hsim, session, length))
+    goto endcmd;
+  if (!SIM_SendData(hsim, data, length))
+    goto endcmd;
+  if (SIM_IsResponseOK(hsim))
+    sendLen = length;
+
+endcmd:
+  hsim->mutexUnlock(hsim);
+  return sendLen;
+}
+
+
+/*
+ * SSL service is started once and SSL context is configured only when
+ * its config changed, so reconnect costs only AT+CCHOPEN handshake.
+ * CCH has no control of TLS session resumption.
+ */
+static SIM_Status_t tlsOpen(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  SIM_Status_t status = SIM_ERROR;
+  uint8_t resp = 0;
+
+  if (!SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_OPEN) || !SIM_NET_IS_STATUS(hsim, SIM_NET_STATUS_AVAILABLE))
+  {
+    return SIM_ERROR;
+  }
+
+  if (tlsTakeSession(sock) < 0) return SIM_ERROR;
+
+  hsim->mutexLock(hsim);
+
+  if (!hsim->net.tls.isStarted) {
+    SIM_SendCMD(hsim, "AT+CCHSTART");
+    if (!SIM_IsResponseOK(hsim)) {
+      // may be left started, stop it so next attempt starts clean
+      SIM_SendCMD(hsim, "AT+CCHSTOP");
+      if (SIM_IsResponseOK(hsim)) {}
+      goto endcmd;
+    }
+    if (SIM_GetResponse(hsim, "+CCHSTART", 9, &resp, 1, SIM_GETRESP_ONLY_DATA, 10000) != SIM_OK || resp != '0')
+      goto endcmd;
+    hsim->net.tls.isStarted = 1;
+  }
+
+  if (tlsConfigure(sock) != SIM_OK)
+    goto endcmd;
+
+  SIM_SendCMD(hsim, "AT+CCHOPEN=%d,\"%s\",%d,2", sock->session, sock->host, sock->port);
+  SIM_SOCK_SET_STATE(sock, SIM_SOCK_STATE_OPENING);
+  if (SIM_IsResponseOK(hsim))
+    status = SIM_OK;
+
+endcmd:
+  hsim->mutexUnlock(hsim);
+  return status;
+}
+
+
+static SIM_Status_t tlsConfigure(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+  const SIM_TLS_Config_t *tls = sock->tls;
+  uint8_t ctx = sock->session;
+  uint32_t fingerprint = SIM_FINGERPRINT_INIT;
+
+  fingerprint = SIM_Fingerprint(fingerprint, &tls->sslVersion, 1);
+  fingerprint = SIM_Fingerprint(fingerprint, &tls->authMode, 1);
+  fingerprint = SIM_Fingerprint(fingerprint, &tls->ignoreLocalTime, 1);
+  fingerprint = SIM_Fingerprint(fingerprint, &tls->enableSNI, 1);
+  fingerprint = SIM_FingerprintStr(fingerprint, tls->caCert);
+  fingerprint = SIM_FingerprintStr(fingerprint, tls->clientCert);
+  fingerprint = SIM_FingerprintStr(fingerprint, tls->clientKey);
+  if (hsim->net.tls.applied[ctx] == fingerprint) return SIM_OK;
+
+  SIM_SendCMD(hsim, "AT+CSSLCFG=\"sslversion\",%d,%d", ctx, tls->sslVersion);
+  if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  SIM_SendCMD(hsim, "AT+CSSLCFG=\"authmode\",%d,%d", ctx, tls->authMode);
+  if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  SIM_SendCMD(hsim, "AT+CSSLCFG=\"ignorelocaltime\",%d,%d", ctx, tls->ignoreLocalTime);
+  if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  SIM_SendCMD(hsim, "AT+CSSLCFG=\"enableSNI\",%d,%d", ctx, tls->enableSNI);
+  if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+
+  if (tls->caCert != NULL) {
+    SIM_SendCMD(hsim, "AT+CSSLCFG=\"cacert\",%d,\"%s\"", ctx, tls->caCert);
+    if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  }
+  if (tls->clientCert != NULL) {
+    SIM_SendCMD(hsim, "AT+CSSLCFG=\"clientcert\",%d,\"%s\"", ctx, tls->clientCert);
+    if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  }
+  if (tls->clientKey != NULL) {
+    SIM_SendCMD(hsim, "AT+CSSLCFG=\"clientkey\",%d,\"%s\"", ctx, tls->clientKey);
+    if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+  }
+
+  SIM_SendCMD(hsim, "AT+CCHSSLCFG=%d,%d", sock->session, ctx);
+  if (!SIM_IsResponseOK(hsim)) return SIM_ERROR;
+
+  hsim->net.tls.applied[ctx] = fingerprint;
+  return SIM_OK;
+}
+
+
+/*
+ * Keep session of socket, or take a free one if it was released
+ */
+static int8_t tlsTakeSession(SIM_Socket_t *sock)
+{
+  SIM_HandlerTypeDef *hsim = sock->hsim;
+
+  if (sock->session >= 0 && tlsSocket(hsim, sock->session) == sock) return sock->session;
+
+  sock->session = -1;
+  for (int8_t session = 0; session < SIM_NUM_OF_TLS; session++) {
+    if (hsim->net.tls.sockets[session] == NULL) {
+      hsim->net.tls.sockets[session] = (void*) sock;
+      sock->session = session;
+      break;
+    }
+  }
+  return sock->session;
+}
+
+
+static SIM_Socket_t* tlsSocket(SIM_HandlerTypeDef *hsim, int8_t session)
+{
+  if (session < 0 || session >= SIM_NUM_OF_TLS) return NULL;
+  return (SIM_Socket_t*) hsim->net.tls.sockets[session];
+}
+
+
+static uint8_t sendCCHSend(SIM_HandlerTypeDef *hsim, uint8_t session, uint16_t length)
+{
+  hsim->cmdBufferLen = sprintf(hsim->cmdBuffer, "AT+CCHSEND=%d,%d\r", session, length);
+
+  if (!SIM_SendData(hsim, (uint8_t*) hsim->cmdBuffer, hsim->cmdBufferLen)) return 0;
+  SIM_STATS_SEND(hsim, hsim->cmdBuffer, hsim->cmdBufferLen);
+  return SIM_WaitResponse(hsim, ">", 1, 3000);
+}
+
+
+static uint8_t urcCCHOpen(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  // +CCHOPEN: <session_id>,<err>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (tokens.count < 2) return 0;
+
+  socket = tlsSocket(hsim, (int8_t) SIM_TokenInt(&tokens, 0));
+  if (socket != NULL && SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_OPENING)) {
+    if (SIM_TokenInt(&tokens, 1) == 0) {
+      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENED);
+      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_OPEN);
+    } else {
+      SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_OPENING_ERROR);
+      SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+    }
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+
+
+/*
+ * +CCHCLOSE: <session_id>,<err> or +CCH_PEER_CLOSED: <session_id>
+ */
+static uint8_t urcCCHClose(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  SIM_TokenizeResp(hsim, &tokens);
+  if (tokens.count < 1) return 0;
+
+  socket = tlsSocket(hsim, (int8_t) SIM_TokenInt(&tokens, 0));
+  if (socket != NULL && !SIM_SOCK_IS_STATE(socket, SIM_SOCK_STATE_CLOSED)) {
+    SIM_BITS_SET(socket->events, SIM_SOCK_EVENT_ON_CLOSED);
+    SIM_SOCK_SET_STATE(socket, SIM_SOCK_STATE_CLOSED);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+  return 1;
+}
+
+
+static uint8_t urcCCHRecv(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+  uint16_t dataLen;
+
+  // +CCHRECV: DATA,<session_id>,<len> followed by data, +CCHRECV: <session_id>,<err> ends it
+  SIM_TokenizeResp(hsim, &tokens);
+  if (!SIM_TokenIs(&tokens, 0, "DATA", 4)) return 1;
+
+  dataLen = (uint16_t) SIM_TokenInt(&tokens, 2);
+  socket = tlsSocket(hsim, (int8_t) SIM_TokenInt(&tokens, 1));
+  if (socket == NULL) {
+    SIM_GetDataSink(hsim, NULL, NULL, dataLen, 5000);
+    return 1;
+  }
+
+  socket->remote.host[0] = 0;
+  socket->remote.port = 0;
+  deliverData(hsim, socket, dataLen);
+  return 1;
+}
+#endif /* SIM_EN_FEATURE_TLS */
+
+
+/*
+ * RECV FROM:<ip>:<port>, comes right before +RECEIVE
+ */
+static uint8_t urcRecvFrom(SIM_HandlerTypeDef *hsim)
+{
+  const char *addr = (const char*) hsim->respBuffer + 10;
+  uint16_t addrLen = hsim->respBufferLen - 10;
+  uint16_t hostLen = addrLen;
+  uint16_t port = 0;
+
+  // port follows the last colon, IPv6 host has colons too
+  while (hostLen && addr[hostLen-1] != ':') hostLen--;
+  if (hostLen == 0) return 1;
+
+  for (uint16_t i = hostLen; i < addrLen && addr[i] >= '0' && addr[i] <= '9'; i++)
+    port = port * 10 + (addr[i] - '0');
+
+  hostLen--;
+  if (hostLen >= sizeof(hsim->net.recvFrom.host)) hostLen = sizeof(hsim->net.recvFrom.host) - 1;
+
+  memcpy(hsim->net.recvFrom.host, addr, hostLen);
+  hsim->net.recvFrom.host[hostLen] = 0;
+  hsim->net.recvFrom.port = port;
+  return 1;
+}
+
+
+static uint8_t urcClient(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  int8_t index;
+  SIM_Server_t *server;
+  SIM_Tokens_t tokens;
+  const char *addr;
+  uint16_t addrLen;
+  uint16_t hostLen;
+  uint16_t port = 0;
+
+  // +CLIENT: <link_num>,<server_index>,<client_IP>:<port>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (tokens.count < 3) return 0;
+  linkNum = (int8_t) SIM_TokenInt(&tokens, 0);
+  index   = (int8_t) SIM_TokenInt(&tokens, 1);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+  if (index < 0 || index >= SIM_NUM_OF_SERVER || hsim->net.servers[index] == NULL) return 1;
+
+  server = (SIM_Server_t*) hsim->net.servers[index];
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+
+  if (server->backlogLen >= SIM_SERVER_BACKLOG) {
+    server->rejectLinks |= 1 << linkNum;
+    return 1;
+  }
+
+  addr = (const char*) SIM_TokenPtr(&tokens, 2);
+  addrLen = SIM_TokenLen(&tokens, 2);
+  hostLen = addrLen;
+  while (hostLen && addr[hostLen-1] != ':') hostLen--;
+  for (uint16_t i = hostLen; i < addrLen && addr[i] >= '0' && addr[i] <= '9'; i++)
+    port = port * 10 + (addr[i] - '0');
+  if (hostLen) hostLen--;
+  if (hostLen >= sizeof(server->backlog[0].host)) hostLen = sizeof(server->backlog[0].host) - 1;
+
+  server->backlog[server->backlogLen].linkNum = linkNum;
+  memcpy(server->backlog[server->backlogLen].host, addr, hostLen);
+  server->backlog[server->backlogLen].host[hostLen] = 0;
+  server->backlog[server->backlogLen].port = port;
+  server->backlogLen++;
+  return 1;
+}
+
+
+static uint8_t urcCIPSend(SIM_HandlerTypeDef *hsim)
+{
+  int8_t linkNum;
+  int cnfLen;
+  SIM_Socket_t *socket;
+  SIM_Tokens_t tokens;
+
+  // +CIPSEND: <link_num>,<reqSendLength>,<cnfSendLength>
+  SIM_TokenizeResp(hsim, &tokens);
+  if (tokens.count < 3) return 0;
+  linkNum = (int8_t) SIM_TokenInt(&tokens, 0);
+  cnfLen  =          SIM_TokenInt(&tokens, 2);
+  if (linkNum < 0 || linkNum >= SIM_NUM_OF_SOCKET) return 1;
+
+  socket = (SIM_Socket_t*) hsim->net.sockets[linkNum];
+  if (socket == NULL || socket->tx.inFlight == 0) return 1;
+
+  // unconfirmed bytes stay queued and go out with the next CIPSEND
+  if (cnfLen > 0) {
+    if (cnfLen > socket->tx.inFlight) cnfLen = socket->tx.inFlight;
+    socket->tx.head = (socket->tx.head + cnfLen) % socket->tx.size;
+    socket->tx.inFlight = 0;
+    if (socket->listeners.onSent != NULL)
+      socket->listeners.onSent((uint16_t) cnfLen);
+  }
+  else {
+    socket->tx.inFlight = 0;
+    if (socket->listeners.onSendError != NULL)
+      socket->listeners.onSendError();
   }
+  SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  return 1;
 }
 
 
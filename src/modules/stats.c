@@ -0,0 +1,165 @@
+/*
+ * stats.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+
+#include "../include/simcom.h"
+#include "../include/simcom/stats.h"
+#include "../include/simcom/utils.h"
+#include <stdio.h>
+#include <string.h>
+
+#if SIM_EN_FEATURE_STATS
+
+static int8_t getEntry(SIM_HandlerTypeDef*, const char *cmd, uint16_t len);
+
+
+void SIM_Stats_Init(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Stats_Reset(hsim);
+}
+
+
+/*
+ * Start measuring command, called after command was written
+ */
+void SIM_Stats_OnSend(SIM_HandlerTypeDef *hsim, const char *cmd, uint16_t len)
+{
+  hsim->stats.running = getEntry(hsim, cmd, len);
+  hsim->stats.sentTick = hsim->getTick();
+  SIM_STATS_TX(hsim, len);
+}
+
+
+/*
+ * Record final result of running command
+ */
+void SIM_Stats_OnResult(SIM_HandlerTypeDef *hsim, SIM_Status_t status)
+{
+  SIM_CmdStats_t *stats;
+  SIM_Tokens_t tokens;
+  uint32_t elapsed;
+  uint32_t limit = 8;
+  uint8_t bucket = 0;
+
+  if (hsim->stats.running < 0) return;
+
+  stats   = &hsim->stats.cmd[hsim->stats.running];
+  elapsed = hsim->getTick() - hsim->stats.sentTick;
+  hsim->stats.running = -1;
+
+  stats->count++;
+  stats->totalTime += elapsed;
+  if (elapsed > stats->maxTime) stats->maxTime = elapsed;
+
+  while (bucket < SIM_STATS_NUM_OF_BUCKET - 1 && elapsed >= limit) {
+    bucket++;
+    limit <<= 2;
+  }
+  stats->histogram[bucket]++;
+
+  if (status == SIM_TIMEOUT) {
+    stats->timeouts++;
+  }
+  else if (status == SIM_ERROR) {
+    stats->errors++;
+    if (SIM_IsResponse(hsim, "+CME ERROR", 10)) {
+      SIM_TokenizeResp(hsim, &tokens);
+      stats->lastErrCode = (uint16_t) SIM_TokenInt(&tokens, 0);
+    }
+  }
+}
+
+
+const SIM_CmdStats_t *SIM_Stats_Get(SIM_HandlerTypeDef *hsim, const char *prefix)
+{
+  for (uint8_t i = 0; i < hsim->stats.count; i++) {
+    if (strncmp(hsim->stats.cmd[i].prefix, prefix, SIM_STATS_PREFIX_SIZE) == 0)
+      return &hsim->stats.cmd[i];
+  }
+  return NULL;
+}
+
+
+void SIM_Stats_Reset(SIM_HandlerTypeDef *hsim)
+{
+  memset(&hsim->stats, 0, sizeof(hsim->stats));
+  hsim->stats.running = -1;
+}
+
+
+/*
+ * Write one line per command:
+ * <prefix> n=<count> to=<timeouts> err=<errors>/<last code> avg=<ms> max=<ms> tx=<bytes> rx=<bytes> h=<histogram>
+ * return written length
+ */
+uint16_t SIM_Stats_Snapshot(SIM_HandlerTypeDef *hsim, char *dst, uint16_t size)
+{
+  SIM_CmdStats_t *stats;
+  uint16_t len = 0;
+  int written;
+
+  if (size == 0) return 0;
+  dst[0] = 0;
+
+  for (uint8_t i = 0; i < hsim->stats.count; i++) {
+    stats = &hsim->stats.cmd[i];
+    written = snprintf(dst + len, size - len,
+                       "%s n=%lu to=%lu err=%lu/%u avg=%lu max=%lu tx=%lu rx=%lu h=",
+                       stats->prefix,
+                       (unsigned long) stats->count,
+                       (unsigned long) stats->timeouts,
+                       (unsigned long) stats->errors,
+                       (unsigned) stats->lastErrCode,
+                       (unsigned long) ((stats->count)? stats->totalTime / stats->count: 0),
+                       (unsigned long) stats->maxTime,
+                       (unsigned long) stats->bytesTx,
+                       (unsigned long) stats->bytesRx);
+    if (written < 0 || written >= size - len) break;
+    len += written;
+
+    for (uint8_t j = 0; j < SIM_STATS_NUM_OF_BUCKET; j++) {
+      written = snprintf(dst + len, size - len, (j < SIM_STATS_NUM_OF_BUCKET-1)? "%lu,": "%lu\n",
+                         (unsigned long) stats->histogram[j]);
+      if (written < 0 || written >= size - len) return len;
+      len += written;
+    }
+  }
+
+  return len;
+}
+
+
+/*
+ * find stats entry of command, command is keyed until '=' or '?'
+ * return -1 when table is full
+ */
+static int8_t getEntry(SIM_HandlerTypeDef *hsim, const char *cmd, uint16_t len)
+{
+  SIM_CmdStats_t *stats;
+  uint16_t prefixLen = 0;
+
+  while (prefixLen < len && prefixLen < SIM_STATS_PREFIX_SIZE-1
+         && cmd[prefixLen] != '=' && cmd[prefixLen] != '?'
+         && cmd[prefixLen] != '\r' && cmd[prefixLen] != 0)
+  {
+    prefixLen++;
+  }
+
+  for (uint8_t i = 0; i < hsim->stats.count; i++) {
+    stats = &hsim->stats.cmd[i];
+    if (strncmp(stats->prefix, cmd, prefixLen) == 0 && stats->prefix[prefixLen] == 0)
+      return (int8_t) i;
+  }
+
+  if (hsim->stats.count >= SIM_STATS_NUM_OF_CMD) return -1;
+
+  stats = &hsim->stats.cmd[hsim->stats.count];
+  memcpy(stats->prefix, cmd, prefixLen);
+  stats->prefix[prefixLen] = 0;
+  return (int8_t) hsim->stats.count++;
+}
+
+#endif /* SIM_EN_FEATURE_STATS */
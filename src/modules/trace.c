@@ -0,0 +1,309 @@
+/*
+ * trace.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+
+#include "../include/simcom.h"
+#include "../include/simcom/trace.h"
+#include "../include/simcom/utils.h"
+#include <string.h>
+
+#if SIM_EN_FEATURE_TRACE
+
+static void     writeRecord(SIM_TraceRecorder_t*, uint8_t type, const uint8_t *data, uint16_t len);
+static uint8_t  putVarint(uint8_t *dst, uint32_t value);
+static uint8_t  getVarint(const uint8_t *src, uint32_t len, uint32_t *pos, uint32_t *value);
+static uint8_t  peekRecord(SIM_TraceReplay_t*, uint32_t *pos, uint32_t *tick, uint8_t *type, uint16_t *len);
+static uint8_t  loadRX(SIM_TraceReplay_t*, uint32_t maxTick);
+
+// recorder serial
+static uint8_t  recIsReadable(void *device);
+static int      recRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+static int      recWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+static int      recWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+
+// replay serial
+static uint8_t  repIsReadable(void *device);
+static int      repRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout);
+static int      repWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout);
+
+
+/*
+ * Wrap serial of handler, every read and write is written to output
+ */
+void SIM_Trace_Attach(SIM_TraceRecorder_t *rec, SIM_HandlerTypeDef *hsim)
+{
+  const uint8_t header[5] = {'S', 'I', 'M', 'T', SIM_TRACE_VERSION};
+
+  rec->serial   = hsim->serial;
+  rec->getTick  = hsim->getTick;
+  rec->lastTick = hsim->getTick();
+
+  hsim->serial.device     = rec;
+  hsim->serial.isReadable = recIsReadable;
+  hsim->serial.read       = recRead;
+  hsim->serial.write      = recWrite;
+  hsim->serial.writeline  = recWriteline;
+
+  if (rec->output != NULL) rec->output(rec->ctx, header, sizeof(header));
+}
+
+
+void SIM_Trace_Detach(SIM_TraceRecorder_t *rec, SIM_HandlerTypeDef *hsim)
+{
+  if (hsim->serial.device == rec)
+    hsim->serial = rec->serial;
+}
+
+
+SIM_Status_t SIM_TraceReplay_Init(SIM_TraceReplay_t *replay, const uint8_t *data, uint32_t len)
+{
+  memset(replay, 0, sizeof(SIM_TraceReplay_t));
+  if (len < 5 || memcmp(data, "SIMT", 4) != 0 || data[4] != SIM_TRACE_VERSION)
+    return SIM_ERROR;
+
+  replay->data = data;
+  replay->len  = len;
+  replay->pos  = 5;
+  return SIM_OK;
+}
+
+
+void SIM_TraceReplay_Attach(SIM_TraceReplay_t *replay, SIM_HandlerTypeDef *hsim)
+{
+  hsim->serial.device     = replay;
+  hsim->serial.isReadable = repIsReadable;
+  hsim->serial.read       = repRead;
+  hsim->serial.write      = repWrite;
+  hsim->serial.writeline  = repWrite;
+}
+
+
+uint32_t SIM_TraceReplay_GetTick(SIM_TraceReplay_t *replay)
+{
+  return replay->tick;
+}
+
+
+void SIM_TraceReplay_Delay(SIM_TraceReplay_t *replay, uint32_t ms)
+{
+  replay->tick += ms;
+}
+
+
+uint8_t SIM_TraceReplay_IsDone(SIM_TraceReplay_t *replay)
+{
+  return replay->rxLen == 0 && replay->pos >= replay->len;
+}
+
+
+/*
+ * Feed whole trace to handler. Virtual clock jumps to the next record
+ * when driver is idle, so replay does not wait real time. A recorded
+ * write holds back the RX after it until driver does the write too.
+ */
+void SIM_TraceReplay_Run(SIM_TraceReplay_t *replay, SIM_HandlerTypeDef *hsim)
+{
+  uint32_t pos;
+  uint32_t tick;
+  uint8_t  type;
+  uint16_t len;
+
+  while (!SIM_TraceReplay_IsDone(replay)) {
+    SIM_CheckAnyResponse(hsim);
+
+    if (replay->rxLen == 0) {
+      pos = replay->pos;
+      tick = replay->recordTick;
+      if (!peekRecord(replay, &pos, &tick, &type, &len)) break;
+      if (tick > replay->tick) replay->tick = tick;
+      else if (type != SIM_TRACE_RX && replay->txPending == 0) {
+        // let timers of driver run until it writes
+        if (replay->tick - tick < SIM_TRACE_TX_SKEW) replay->tick++;
+        else {
+          replay->pos = pos + len;
+          replay->recordTick = tick;
+        }
+      }
+      loadRX(replay, replay->tick);
+    }
+  }
+}
+
+
+static uint8_t recIsReadable(void *device)
+{
+  SIM_TraceRecorder_t *rec = (SIM_TraceRecorder_t*) device;
+  return rec->serial.isReadable(rec->serial.device);
+}
+
+
+static int recRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  SIM_TraceRecorder_t *rec = (SIM_TraceRecorder_t*) device;
+  int readStatus = rec->serial.read(rec->serial.device, dst, sz, timeout);
+
+  if (readStatus > 0) writeRecord(rec, SIM_TRACE_RX, dst, (uint16_t) readStatus);
+  return readStatus;
+}
+
+
+static int recWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  SIM_TraceRecorder_t *rec = (SIM_TraceRecorder_t*) device;
+  int writeStatus = rec->serial.write(rec->serial.device, src, sz, timeout);
+
+  if (writeStatus > 0) writeRecord(rec, SIM_TRACE_TX, src, (uint16_t) writeStatus);
+  return writeStatus;
+}
+
+
+static int recWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  SIM_TraceRecorder_t *rec = (SIM_TraceRecorder_t*) device;
+  int writeStatus = rec->serial.writeline(rec->serial.device, src, sz, timeout);
+
+  if (writeStatus >= 0) writeRecord(rec, SIM_TRACE_TX_LINE, src, sz);
+  return writeStatus;
+}
+
+
+static uint8_t repIsReadable(void *device)
+{
+  SIM_TraceReplay_t *replay = (SIM_TraceReplay_t*) device;
+  return loadRX(replay, replay->tick);
+}
+
+
+static int repRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  SIM_TraceReplay_t *replay = (SIM_TraceReplay_t*) device;
+  uint16_t readLen;
+
+  if (!loadRX(replay, replay->tick + timeout)) {
+    replay->tick += timeout;
+    return 0;
+  }
+
+  readLen = (sz < replay->rxLen)? sz: replay->rxLen;
+  memcpy(dst, replay->rxData, readLen);
+  replay->rxData += readLen;
+  replay->rxLen  -= readLen;
+  return readLen;
+}
+
+
+static int repWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  SIM_TraceReplay_t *replay = (SIM_TraceReplay_t*) device;
+
+  (void) src;
+  (void) timeout;
+  replay->txPending++;
+  return sz;
+}
+
+
+static void writeRecord(SIM_TraceRecorder_t *rec, uint8_t type, const uint8_t *data, uint16_t len)
+{
+  uint8_t  head[11];
+  uint8_t  headLen = 0;
+  uint32_t tick = rec->getTick();
+
+  if (rec->output == NULL) return;
+
+  head[headLen++] = type;
+  headLen += putVarint(&head[headLen], tick - rec->lastTick);
+  headLen += putVarint(&head[headLen], len);
+  rec->lastTick = tick;
+
+  rec->output(rec->ctx, head, headLen);
+  rec->output(rec->ctx, data, len);
+}
+
+
+static uint8_t putVarint(uint8_t *dst, uint32_t value)
+{
+  uint8_t len = 0;
+
+  while (value >= 0x80) {
+    dst[len++] = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  dst[len++] = (uint8_t) value;
+  return len;
+}
+
+
+static uint8_t getVarint(const uint8_t *src, uint32_t len, uint32_t *pos, uint32_t *value)
+{
+  uint8_t shift = 0;
+
+  *value = 0;
+  while (*pos < len && shift < 32) {
+    *value |= (uint32_t) (src[*pos] & 0x7F) << shift;
+    if ((src[(*pos)++] & 0x80) == 0) return 1;
+    shift += 7;
+  }
+  return 0;
+}
+
+
+/*
+ * parse record header at pos, pos is moved to record data
+ */
+static uint8_t peekRecord(SIM_TraceReplay_t *replay, uint32_t *pos, uint32_t *tick, uint8_t *type, uint16_t *len)
+{
+  uint32_t delta;
+  uint32_t dataLen;
+
+  if (*pos >= replay->len) return 0;
+  *type = replay->data[(*pos)++];
+  if (!getVarint(replay->data, replay->len, pos, &delta)) return 0;
+  if (!getVarint(replay->data, replay->len, pos, &dataLen)) return 0;
+  if (*pos + dataLen > replay->len) return 0;
+
+  *tick += delta;
+  *len = (uint16_t) dataLen;
+  return 1;
+}
+
+
+/*
+ * make next RX record readable if it was received before maxTick,
+ * TX records are passed once driver did a write, data is not compared
+ */
+static uint8_t loadRX(SIM_TraceReplay_t *replay, uint32_t maxTick)
+{
+  uint32_t pos;
+  uint32_t tick;
+  uint8_t  type;
+  uint16_t len;
+
+  while (replay->rxLen == 0) {
+    pos = replay->pos;
+    tick = replay->recordTick;
+    if (!peekRecord(replay, &pos, &tick, &type, &len)) {
+      replay->pos = replay->len;
+      return 0;
+    }
+    if (tick > maxTick) return 0;
+    if (type != SIM_TRACE_RX) {
+      if (replay->txPending == 0) return 0;
+      replay->txPending--;
+    }
+
+    if (tick > replay->tick) replay->tick = tick;
+    replay->pos         = pos + len;
+    replay->recordTick  = tick;
+    if (type == SIM_TRACE_RX) {
+      replay->rxData  = &replay->data[pos];
+      replay->rxLen   = len;
+    }
+  }
+  return 1;
+}
+
+#endif /* SIM_EN_FEATURE_TRACE */
@@ -14,19 +14,31 @@
 #include "include/simcom/socket.h"
 #include "include/simcom/gps.h"
 #include "include/simcom/http.h"
+#include "include/simcom/stats.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 
-uint8_t SIM_CmdTmp[64];
-uint8_t SIM_RespTmp[64];
-
 // static function initiation
 static void mutexLock(SIM_HandlerTypeDef*);
 static void mutexUnlock(SIM_HandlerTypeDef*);
 static void SIM_reset(SIM_HandlerTypeDef*);
-static void str2Time(SIM_Datetime*, const char*);
+static void bringUp(SIM_HandlerTypeDef*);
+static void healthCheck(SIM_HandlerTypeDef*);
+static void setReady(SIM_HandlerTypeDef*);
+static void checkStateChange(SIM_HandlerTypeDef*);
+static void handleCoreEvents(SIM_HandlerTypeDef*);
+static void str2Time(SIM_Datetime*, const uint8_t *str, uint16_t len);
+static uint8_t urcReady(SIM_HandlerTypeDef*);
+static uint8_t urcPBDone(SIM_HandlerTypeDef*);
+static uint8_t urcCREG(SIM_HandlerTypeDef*);
+static uint8_t urcCOPSList(SIM_HandlerTypeDef*);
+static void scanDone(SIM_HandlerTypeDef*, SIM_Status_t, void *ctx);
+static void updateLastGood(SIM_HandlerTypeDef*);
+static uint8_t isOperatorUsable(SIM_HandlerTypeDef*, const char *numeric);
+static void setRegReport(SIM_HandlerTypeDef*);
+static void setRegStat(SIM_HandlerTypeDef*, uint8_t stat);
 
 
 // function definition
@@ -38,16 +50,27 @@ SIM_Status_t SIM_Init(SIM_HandlerTypeDef *hsim)
   hsim->events = 0;
   hsim->errors = 0;
   hsim->signal = 0;
+  hsim->rxHead    = 0;
+  hsim->rxLen     = 0;
+  hsim->rxScanned = 0;
+  hsim->cmdQueue.head   = 0;
+  hsim->cmdQueue.tail   = 0;
+  hsim->cmdQueue.isSent = 0;
+  hsim->urc.count = 0;
+  hsim->cops.isScanning = 0;
+  hsim->pending.bits    = SIM_SUBSYS_ALL;
+  hsim->pending.armed   = 0;
+  hsim->pending.status  = 0;
+  hsim->pending.netStatus = 0;
+  memset(hsim->urc.table, SIM_URC_NONE, SIM_URC_TABLE_SIZE);
   if (hsim->timeout == 0)
     hsim->timeout = 5000;
 
   if (hsim->delay == 0) return SIM_ERROR;
   if (hsim->getTick == 0) return SIM_ERROR;
   if (hsim->serial.device == 0) return SIM_ERROR;
+  if (hsim->serial.isReadable == 0) return SIM_ERROR;
   if (hsim->serial.read == 0) return SIM_ERROR;
-  if (hsim->serial.readline == 0) return SIM_ERROR;
-  if (hsim->serial.readinto == 0) return SIM_ERROR;
-  if (hsim->serial.unread == 0) return SIM_ERROR;
   if (hsim->serial.write == 0) return SIM_ERROR;
   if (hsim->serial.writeline == 0) return SIM_ERROR;
 
@@ -57,7 +80,35 @@ SIM_Status_t SIM_Init(SIM_HandlerTypeDef *hsim)
   if (hsim->mutexUnlock == 0)
     hsim->mutexUnlock = mutexUnlock;
 
+  #if SIM_EN_FEATURE_STATS
+  SIM_Stats_Init(hsim);
+  #endif
+
+  SIM_RegisterURC(hsim, "RDY", urcReady);
+  SIM_RegisterURC(hsim, "PB ", urcPBDone);
+  SIM_RegisterURC(hsim, "+CREG:", urcCREG);
+  SIM_RegisterURC(hsim, "+COPS: (", urcCOPSList);
+
+  #if SIM_EN_FEATURE_NET
+  SIM_NetRegisterURC(hsim);
+  #endif
+
+  #if SIM_EN_FEATURE_SOCKET
+  SIM_SockRegisterURC(hsim);
+  #endif
+
+  #if SIM_EN_FEATURE_HTTP
+  SIM_HTTP_RegisterURC(hsim);
+  #endif
+
+  #if SIM_EN_FEATURE_GPS
+  SIM_GPS_RegisterURC(hsim);
+  #endif
+
+  // give modem time to send RDY before probing with AT
   hsim->initAt = hsim->getTick();
+  hsim->bringUp.state = SIM_STATE_AT;
+  SIM_Schedule(hsim, hsim->bringUp.wakeTick, hsim->timeout);
 
   return SIM_OK;
 }
@@ -72,17 +123,22 @@ void SIM_CheckAnyResponse(SIM_HandlerTypeDef *hsim)
 
   // Read incoming Response
   hsim->mutexLock(hsim);
-  while (hsim->serial.isReadable(hsim->serial.device)) {
-    readStatus = hsim->serial.readline(hsim->serial.device, hsim->respBuffer, SIM_RESP_BUFFER_SIZE, 5000);
-    if (readStatus > 0) {
-      hsim->respBufferLen = readStatus;
-      SIM_CheckAsyncResponse(hsim);
-    }
+  #if SIM_SOCK_TRANSPARENT
+  // everything is payload while online, not a line to parse
+  if (SIM_IsDataMode(hsim)) SIM_SockStreamProcess(hsim);
+  else
+  #endif
+  while ((readStatus = SIM_ReadLine(hsim, 0)) > 0) {
+    SIM_CheckAsyncResponse(hsim);
   }
+  SIM_CmdQueueProcess(hsim);
   hsim->mutexUnlock(hsim);
 
   // Event Handler
   SIM_HandleEvents(hsim);
+
+  // wake up tasks waiting for state change
+  SIM_Notify(hsim);
 }
 
 
@@ -94,47 +150,98 @@ void SIM_CheckAsyncResponse(SIM_HandlerTypeDef *hsim)
     return;
   }
 
-  if (SIM_IsResponse(hsim, "RDY", 3)) {
-    SIM_BITS_SET(hsim->events, SIM_EVENT_ON_STARTING);
+  if (SIM_CmdQueueCheckResponse(hsim)) return;
+
+  SIM_DispatchURC(hsim);
+}
+
+
+/*
+ * Handle async response, only subsystems marked pending are serviced
+ * so idle modem gets no AT command from here
+ */
+void SIM_HandleEvents(SIM_HandlerTypeDef *hsim)
+{
+  uint8_t pending;
+  uint8_t i;
+
+  checkStateChange(hsim);
+
+  // marks are set under the lock by URC handlers of other tasks
+  hsim->mutexLock(hsim);
+  for (i = 0; i < SIM_SUBSYS_MAX; i++) {
+    if (SIM_BITS_IS(hsim->pending.armed, 1 << i) && SIM_IsDue(hsim, hsim->pending.wakeTick[i])) {
+      SIM_BITS_UNSET(hsim->pending.armed, 1 << i);
+      SIM_SetPending(hsim, i);
+    }
   }
 
-  else if (!SIM_IS_STATUS(hsim, SIM_STATUS_START) && SIM_IsResponse(hsim, "PB ", 3)) {
-    SIM_SET_STATUS(hsim, SIM_STATUS_START);
-    SIM_BITS_SET(hsim->events, SIM_EVENT_ON_STARTED);
+  // clear first, handler may mark itself again
+  pending = hsim->pending.bits;
+  // other subsystems keep their marks until command mode is back
+  if (SIM_IsDataMode(hsim)) pending &= 1 << SIM_SUBSYS_SOCK;
+  hsim->pending.bits &= ~pending;
+  hsim->mutexUnlock(hsim);
+
+  if (SIM_BITS_IS(pending, 1 << SIM_SUBSYS_CORE)) {
+    handleCoreEvents(hsim);
   }
 
-  #if SIM_EN_FEATURE_NET
-  else if (SIM_NetCheckAsyncResponse(hsim)) return;
-  #endif
+#if SIM_EN_FEATURE_NET
+  if (SIM_BITS_IS(pending, 1 << SIM_SUBSYS_NET)) {
+    SIM_NetHandleEvents(hsim);
+  }
+#endif
 
-  #if SIM_EN_FEATURE_SOCKET
-  else if (SIM_SockCheckAsyncResponse(hsim)) return;
-  #endif
+#if SIM_EN_FEATURE_SOCKET
+  if (SIM_BITS_IS(pending, 1 << SIM_SUBSYS_SOCK)) {
+    SIM_SockHandleEvents(hsim);
+  }
+#endif
 
-  #if SIM_EN_FEATURE_SOCKET
-  else if (SIM_HTTP_CheckAsyncResponse(hsim)) return;
-  #endif
+#if SIM_EN_FEATURE_HTTP
+  if (SIM_BITS_IS(pending, 1 << SIM_SUBSYS_HTTP)) {
+    SIM_HTTP_HandleEvents(hsim);
+  }
+#endif
 
-  #if SIM_EN_FEATURE_GPS
-  else if (SIM_GPS_CheckAsyncResponse(hsim)) return;
-  #endif
+#if SIM_EN_FEATURE_GPS
+  if (SIM_BITS_IS(pending, 1 << SIM_SUBSYS_GPS)) {
+    SIM_GPS_HandleEvents(hsim);
+  }
+#endif
+
+  // status changed by handlers is seen on next call
+  checkStateChange(hsim);
 }
 
 
 /*
- * Handle async response
+ * Mark all subsystems that depend on changed status
  */
-void SIM_HandleEvents(SIM_HandlerTypeDef *hsim)
+static void checkStateChange(SIM_HandlerTypeDef *hsim)
 {
-  // check async response
-  if (hsim->status == 0 && (hsim->getTick() - hsim->initAt > hsim->timeout)) {
-    if (!SIM_CheckAT(hsim)) {
-      hsim->initAt = hsim->getTick();
-    } else {
-      SIM_Echo(hsim, 0);
-    }
+  // command and uart bits change on every command
+  uint8_t status = hsim->status & ~(SIM_STATUS_UART_READING|SIM_STATUS_UART_WRITING|SIM_STATUS_CMD_RUNNING);
+
+  if (status != hsim->pending.status) {
+    hsim->pending.status = status;
+    SIM_BITS_SET(hsim->pending.bits, SIM_SUBSYS_ALL);
   }
 
+  #if SIM_EN_FEATURE_NET
+  if (hsim->net.status != hsim->pending.netStatus) {
+    hsim->pending.netStatus = hsim->net.status;
+    SIM_SetPending(hsim, SIM_SUBSYS_NET);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+    SIM_SetPending(hsim, SIM_SUBSYS_HTTP);
+  }
+  #endif
+}
+
+
+static void handleCoreEvents(SIM_HandlerTypeDef *hsim)
+{
   if (SIM_BITS_IS(hsim->events, SIM_EVENT_ON_STARTING)) {
     SIM_BITS_UNSET(hsim->events, SIM_EVENT_ON_STARTING);
     SIM_Debug("Starting...");
@@ -143,47 +250,28 @@ void SIM_HandleEvents(SIM_HandlerTypeDef *hsim)
   if (SIM_BITS_IS(hsim->events, SIM_EVENT_ON_STARTED)) {
     SIM_BITS_UNSET(hsim->events, SIM_EVENT_ON_STARTED);
     SIM_Debug("Started.");
+    #if SIM_EN_FEATURE_SOCKET
     SIM_SockOnStarted(hsim);
+    #endif
   }
   if (SIM_BITS_IS(hsim->events, SIM_EVENT_ON_REGISTERED)) {
     SIM_BITS_UNSET(hsim->events, SIM_EVENT_ON_REGISTERED);
     SIM_Debug("Network Registered%s.", (SIM_IS_STATUS(hsim, SIM_STATUS_ROAMING))? " (Roaming)": "");
-  }
-  
-  if (SIM_IS_STATUS(hsim, SIM_STATUS_START) && !SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE)) {
-    SIM_Debug("Activating...");
-    SIM_Echo(hsim, 0);
-    if (SIM_CheckAT(hsim)) {
-      SIM_Debug("Activated.");
-    }
-  }
-  if (SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE) && !SIM_IS_STATUS(hsim, SIM_STATUS_SIM_INSERTED)) {
-    if(!SIM_CheckSIMCard(hsim)) {
-      hsim->delay(3000);
-    }
-  }
-  if (SIM_IS_STATUS(hsim, SIM_STATUS_SIM_INSERTED) && !SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)) {
-    if(!SIM_ReqisterNetwork(hsim)) {
-      hsim->delay(3000);
-    }
+    // only used to pin the operator, skip the blocking query otherwise
+    if (hsim->cops.config.pinLastGood) updateLastGood(hsim);
   }
 
-#ifdef SIM_EN_FEATURE_NET
-  SIM_NetHandleEvents(hsim);
-#endif
+  bringUp(hsim);
+  healthCheck(hsim);
 
-#ifdef SIM_EN_FEATURE_SOCKET
-  SIM_SockHandleEvents(hsim);
-#endif
-
-#if SIM_EN_FEATURE_HTTP
-  SIM_HTTP_HandleEvents(hsim);
-#endif
-
-#if SIM_EN_FEATURE_GPS
-  SIM_GPS_HandleEvents(hsim);
-#endif
+  // both wait for the scan or long command, its completion marks core pending again
+  if (SIM_IS_BUSY(hsim)) return;
 
+  // next bring-up retry or health check
+  if (hsim->bringUp.state != SIM_STATE_READY)
+    SIM_WakeAt(hsim, SIM_SUBSYS_CORE, hsim->bringUp.wakeTick);
+  else
+    SIM_WakeAt(hsim, SIM_SUBSYS_CORE, hsim->bringUp.healthTick);
 }
 
 
@@ -224,8 +312,8 @@ uint8_t SIM_CheckAT(SIM_HandlerTypeDef *hsim)
 uint8_t SIM_CheckSignal(SIM_HandlerTypeDef *hsim)
 {
   uint8_t signal = 0;
-  uint8_t *resp = &SIM_RespTmp[0];
-  char *signalStr = (char*) &SIM_RespTmp[32];
+  uint8_t *resp = &hsim->respTmp[0];
+  SIM_Tokens_t tokens;
 
   if (!SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE)) return signal;
 
@@ -237,8 +325,8 @@ uint8_t SIM_CheckSignal(SIM_HandlerTypeDef *hsim)
 
   // do with response
   if (SIM_GetResponse(hsim, "+CSQ", 4, resp, 16, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-    SIM_ParseStr(resp, ',', 1, (uint8_t*) signalStr);
-    signal = (uint8_t) atoi((char*)resp);
+    SIM_Tokenize(&tokens, resp, 16, ',');
+    signal = (uint8_t) SIM_TokenInt(&tokens, 0);
     hsim->signal = signal;
   }
   hsim->mutexUnlock(hsim);
@@ -255,16 +343,17 @@ uint8_t SIM_CheckSignal(SIM_HandlerTypeDef *hsim)
 
 uint8_t SIM_CheckSIMCard(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
+  uint8_t *resp = &hsim->respTmp[0];
   uint8_t isOK = 0;
+  SIM_Tokens_t tokens;
 
   hsim->mutexLock(hsim);
 
   memset(resp, 0, 11);
   SIM_SendCMD(hsim, "AT+CPIN?");
   if (SIM_GetResponse(hsim, "+CPIN", 5, resp, 10, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-    // resp_n = (uint8_t) atoi((char*)&resp[0]);
-    if (strcmp((char*) resp, "READY")) {
+    SIM_Tokenize(&tokens, resp, 10, ',');
+    if (SIM_TokenIs(&tokens, 0, "READY", 5)) {
       SIM_Debug("SIM Ready.");
       isOK = 1;
       SIM_SET_STATUS(hsim, SIM_STATUS_SIM_INSERTED);
@@ -279,60 +368,62 @@ uint8_t SIM_CheckSIMCard(SIM_HandlerTypeDef *hsim)
 
 uint8_t SIM_ReqisterNetwork(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *resp = &SIM_RespTmp[0];
+  uint8_t *resp = &hsim->respTmp[0];
   // uint8_t resp_n = 0;
   uint8_t resp_stat = 0;
   uint8_t resp_mode = 0;
   uint8_t isOK = 0;
+  SIM_Tokens_t tokens;
 
   // send command then get response;
   hsim->mutexLock(hsim);
 
-  memset(resp, 0, 4);
+  memset(resp, 0, 32);
   SIM_SendCMD(hsim, "AT+CREG?");
-  if (SIM_GetResponse(hsim, "+CREG", 5, resp, 3, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-    // resp_n = (uint8_t) atoi((char*)&resp[0]);
-    resp_stat = (uint8_t) atoi((char*) resp+2);
+  if (SIM_GetResponse(hsim, "+CREG", 5, resp, 32, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
+    SIM_Tokenize(&tokens, resp, 32, ',');
+    resp_stat = SIM_TokenRegStat(&tokens, &hsim->cell.lac, &hsim->cell.ci);
   }
   else goto endcmd;
 
   // check response
+  setRegStat(hsim, resp_stat);
   if (resp_stat == 1 || resp_stat == 5) {
-    SIM_SET_STATUS(hsim, SIM_STATUS_REGISTERED);
-    SIM_BITS_SET(hsim->events, SIM_EVENT_ON_REGISTERED);
     isOK = 1;
-    if (resp_stat == 5) {
-      SIM_SET_STATUS(hsim, SIM_STATUS_ROAMING);
-    }
   }
   else {
-    SIM_UNSET_STATUS(hsim, SIM_STATUS_REGISTERED);
-
     if (resp_stat == 0) {
       SIM_Debug("Registering network....");
 
       // Select operator automatically
       memset(resp, 0, 16);
       SIM_SendCMD(hsim, "AT+COPS?");
-      if (SIM_GetResponse(hsim, "+COPS", 5, resp, 1, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-        resp_mode = (uint8_t) atoi((char*) resp);
+      if (SIM_GetResponse(hsim, "+COPS", 5, resp, 16, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
+        SIM_Tokenize(&tokens, resp, 16, ',');
+        resp_mode = (uint8_t) SIM_TokenInt(&tokens, 0);
       }
       else goto endcmd;
 
-      SIM_SendCMD(hsim, "AT+COPS=?");
-      if (!SIM_IsResponseOK(hsim)) goto endcmd;
+      // selection and scan are long, run them in queue and let +CREG tell the result
+      if (!SIM_CmdQueueIsEmpty(hsim)) goto endcmd;
 
-      if (resp_mode != 0) {
-        SIM_SendCMD(hsim, "AT+COPS=0");
-        if (!SIM_IsResponseOK(hsim)) goto endcmd;
+      if (hsim->cops.config.pinLastGood
+          && hsim->cops.lastGood[0] != 0
+          && isOperatorUsable(hsim, hsim->cops.lastGood))
+      {
+        SIM_SendCMDAsync(hsim, NULL, 0, NULL, 0, SIM_COPS_TIMEOUT, NULL, NULL,
+                         "AT+COPS=4,2,\"%s\"", hsim->cops.lastGood);
+      }
+      else if (resp_mode != 0) {
+        SIM_SendCMDAsync(hsim, NULL, 0, NULL, 0, SIM_COPS_TIMEOUT, NULL, NULL, "AT+COPS=0");
+      }
 
-        SIM_SendCMD(hsim, "AT+COPS");
-        if (!SIM_IsResponseOK(hsim)) goto endcmd;
+      if (SIM_GetOperators(hsim, NULL) == NULL) {
+        SIM_ScanOperators(hsim);
       }
     }
     else if (resp_stat == 2) {
       SIM_Debug("Searching network....");
-      hsim->delay(2000);
     }
   }
 
@@ -342,18 +433,53 @@ uint8_t SIM_ReqisterNetwork(SIM_HandlerTypeDef *hsim)
 }
 
 
+/*
+ * Queue AT+COPS=?, result is cached for SIM_COPS_CACHE_TTL.
+ * Modem does not answer other commands until scan is done.
+ */
+SIM_Status_t SIM_ScanOperators(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Status_t status;
+
+  if (hsim->cops.isScanning) return SIM_OK;
+
+  hsim->cops.count = 0;
+  hsim->cops.isScanning = 1;
+  status = SIM_SendCMDAsync(hsim, NULL, 0, NULL, 0, SIM_COPS_SCAN_TIMEOUT,
+                            scanDone, NULL, "AT+COPS=?");
+  if (status != SIM_OK) hsim->cops.isScanning = 0;
+  return status;
+}
+
+
+/*
+ * return cached operators or NULL when there is no fresh scan result
+ */
+const SIM_Operator_t *SIM_GetOperators(SIM_HandlerTypeDef *hsim, uint8_t *count)
+{
+  if (hsim->cops.scanTick == 0 || SIM_IsTimeout(hsim, hsim->cops.scanTick, SIM_COPS_CACHE_TTL))
+    return NULL;
+
+  if (count != NULL) *count = hsim->cops.count;
+  return hsim->cops.list;
+}
+
+
 SIM_Datetime SIM_GetTime(SIM_HandlerTypeDef *hsim)
 {
   SIM_Datetime result = {0};
-  uint8_t *resp = &SIM_RespTmp[0];
+  uint8_t *resp = &hsim->respTmp[0];
+  SIM_Tokens_t tokens;
 
   // send command then get response;
   hsim->mutexLock(hsim);
 
-  memset(resp, 0, 22);
+  memset(resp, 0, 32);
   SIM_SendCMD(hsim, "AT+CCLK?");
-  if (SIM_GetResponse(hsim, "+CCLK", 5, resp, 22, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
-    str2Time(&result, (char*)&resp[0]);
+  if (SIM_GetResponse(hsim, "+CCLK", 5, resp, 31, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
+    // date and time are one quoted field: "yy/MM/dd,hh:mm:ss+zz"
+    SIM_Tokenize(&tokens, resp, 31, ',');
+    str2Time(&result, SIM_TokenPtr(&tokens, 0), SIM_TokenLen(&tokens, 0));
   }
   hsim->mutexUnlock(hsim);
 
@@ -400,7 +526,7 @@ void SIM_SendUSSD(SIM_HandlerTypeDef *hsim, const char *ussd)
 static void mutexLock(SIM_HandlerTypeDef *hsim)
 {
   while (SIM_IS_STATUS(hsim, SIM_STATUS_CMD_RUNNING)) {
-    hsim->delay(1);
+    SIM_Wait(hsim, hsim->timeout);
   }
   SIM_SET_STATUS(hsim, SIM_STATUS_CMD_RUNNING);
 }
@@ -409,6 +535,7 @@ static void mutexLock(SIM_HandlerTypeDef *hsim)
 static void mutexUnlock(SIM_HandlerTypeDef *hsim)
 {
   SIM_UNSET_STATUS(hsim, SIM_STATUS_CMD_RUNNING);
+  SIM_Notify(hsim);
 }
 
 
@@ -417,27 +544,325 @@ static void SIM_reset(SIM_HandlerTypeDef *hsim)
   hsim->signal = 0;
   hsim->status = 0;
   hsim->errors = 0;
+  hsim->initAt = hsim->getTick();
+  hsim->bringUp.state     = SIM_STATE_AT;
+  hsim->bringUp.wakeTick  = hsim->initAt;
+
+  // NV settings survive the reboot, each is sent again when it fails in use
+  #if SIM_EN_FEATURE_NET
+  SIM_NetOnReset(hsim);
+  #endif
+}
+
+
+/*
+ * Signal and registration in one batched round-trip, catches
+ * changes that URC did not report
+ */
+static void healthCheck(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Batch_t batch;
+  SIM_Tokens_t tokens;
+  // parsed after unlock, so not in respTmp
+  uint8_t csq[16];
+  uint8_t creg[24];
+  #if SIM_EN_FEATURE_NET
+  uint8_t cgreg[24];
+  #endif
+
+  if (hsim->bringUp.state != SIM_STATE_READY) return;
+  if (SIM_IS_BUSY(hsim)) return;
+  if (!SIM_IsDue(hsim, hsim->bringUp.healthTick)) return;
+  SIM_Schedule(hsim, hsim->bringUp.healthTick, SIM_HEALTH_INTERVAL);
+
+  SIM_BatchInit(&batch);
+  SIM_BatchAdd(&batch, "+CSQ", 4, csq, 16, "+CSQ");
+  SIM_BatchAdd(&batch, "+CREG", 5, creg, 24, "+CREG?");
+  #if SIM_EN_FEATURE_NET
+  SIM_BatchAdd(&batch, "+CGREG", 6, cgreg, 24, "+CGREG?");
+  #endif
+
+  if (SIM_BatchExec(hsim, &batch, 2000) != SIM_OK) return;
+
+  if (batch.slots[0].isReceived) {
+    SIM_Tokenize(&tokens, csq, 16, ',');
+    hsim->signal = (uint8_t) SIM_TokenInt(&tokens, 0);
+    if (hsim->signal == 99) hsim->signal = 0;
+  }
+  if (batch.slots[1].isReceived) {
+    SIM_Tokenize(&tokens, creg, 24, ',');
+    setRegStat(hsim, SIM_TokenRegStat(&tokens, &hsim->cell.lac, &hsim->cell.ci));
+  }
+  #if SIM_EN_FEATURE_NET
+  if (batch.slots[2].isReceived) {
+    SIM_Tokenize(&tokens, cgreg, 24, ',');
+    SIM_NetSetGprsStat(hsim, SIM_TokenRegStat(&tokens, NULL, NULL));
+  }
+  #endif
 }
 
-static void str2Time(SIM_Datetime *dt, const char *str)
+
+/*
+ * AT -> CPIN -> CREG, one step per call. Failed step is retried at wakeTick
+ * so the event loop keeps serving URC, GPS and sockets meanwhile.
+ */
+static void bringUp(SIM_HandlerTypeDef *hsim)
 {
-  uint8_t *dtbytes;
+  // modem lost by other command, start over now, wakeTick may be stale
+  if (hsim->bringUp.state != SIM_STATE_AT && !SIM_IS_STATUS(hsim, SIM_STATUS_ACTIVE)) {
+    hsim->bringUp.state = SIM_STATE_AT;
+    hsim->bringUp.wakeTick = hsim->getTick();
+  }
+  if (hsim->bringUp.state == SIM_STATE_READY && !SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)) {
+    hsim->bringUp.state = SIM_STATE_CREG;
+    SIM_Schedule(hsim, hsim->bringUp.wakeTick, SIM_REG_POLL_INTERVAL);
+  }
+  // registered by +CREG URC, no need to poll
+  if (hsim->bringUp.state == SIM_STATE_CREG && SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)) {
+    setReady(hsim);
+  }
+
+  if (!SIM_IsDue(hsim, hsim->bringUp.wakeTick)) return;
+  // every command would wait for AT+COPS=? or AT+COPS=0/4 to finish
+  if (SIM_IS_BUSY(hsim)) return;
+
+  switch (hsim->bringUp.state) {
+  case SIM_STATE_AT:
+    SIM_Debug("Activating...");
+    SIM_Echo(hsim, 0);
+    if (!SIM_CheckAT(hsim)) {
+      SIM_Schedule(hsim, hsim->bringUp.wakeTick, SIM_RETRY_INTERVAL);
+      break;
+    }
+    SIM_Debug("Activated.");
+    setRegReport(hsim);
+    hsim->bringUp.state = SIM_STATE_CPIN;
+    break;
+
+  case SIM_STATE_CPIN:
+    if (!SIM_CheckSIMCard(hsim)) {
+      SIM_Schedule(hsim, hsim->bringUp.wakeTick, SIM_RETRY_INTERVAL);
+      break;
+    }
+    hsim->bringUp.state = SIM_STATE_CREG;
+    break;
+
+  case SIM_STATE_CREG:
+    if (!SIM_ReqisterNetwork(hsim)) {
+      SIM_Schedule(hsim, hsim->bringUp.wakeTick, SIM_REG_POLL_INTERVAL);
+      break;
+    }
+    setReady(hsim);
+    break;
+
+  default:
+    break;
+  }
+}
+
+
+/*
+ * health check is due at once, healthTick is left from the last time
+ * ready and can read as far future after 2^31 ms
+ */
+static void setReady(SIM_HandlerTypeDef *hsim)
+{
+  hsim->bringUp.state = SIM_STATE_READY;
+  hsim->bringUp.healthTick = hsim->getTick();
+}
+
+static uint8_t urcReady(SIM_HandlerTypeDef *hsim)
+{
+  SIM_BITS_SET(hsim->events, SIM_EVENT_ON_STARTING);
+  SIM_SetPending(hsim, SIM_SUBSYS_CORE);
+  return 1;
+}
+
+
+static uint8_t urcPBDone(SIM_HandlerTypeDef *hsim)
+{
+  if (SIM_IS_STATUS(hsim, SIM_STATUS_START)) return 0;
+
+  SIM_SET_STATUS(hsim, SIM_STATUS_START);
+  SIM_BITS_SET(hsim->events, SIM_EVENT_ON_STARTED);
+  SIM_SetPending(hsim, SIM_SUBSYS_CORE);
+  return 1;
+}
+
+
+static uint8_t urcCREG(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Tokens_t tokens;
+
+  SIM_TokenizeResp(hsim, &tokens);
+  setRegStat(hsim, SIM_TokenRegStat(&tokens, &hsim->cell.lac, &hsim->cell.ci));
+  return 1;
+}
+
+
+/*
+ * +COPS: (2,"long","short","46000",7),(1,...),,(0,1,2,3,4),(0,1,2)
+ * operators are parsed in place, trailing mode and format lists are ignored
+ */
+static uint8_t urcCOPSList(SIM_HandlerTypeDef *hsim)
+{
+  SIM_Operator_t *op;
+  SIM_Tokens_t tokens;
+  const uint8_t *start = NULL;
+  uint16_t i;
+
+  if (!hsim->cops.isScanning) return 0;
+
+  for (i = 7; i < hsim->respBufferLen; i++) {
+    if (hsim->respBuffer[i] == '(') {
+      start = &hsim->respBuffer[i+1];
+      continue;
+    }
+    if (hsim->respBuffer[i] != ')' || start == NULL) continue;
+
+    SIM_Tokenize(&tokens, start, &hsim->respBuffer[i] - start, ',');
+    start = NULL;
+    if (!SIM_TokenIsQuoted(&tokens, 3)) break;
+    if (hsim->cops.count >= SIM_NUM_OF_OPERATOR) break;
+
+    op = &hsim->cops.list[hsim->cops.count++];
+    op->stat = (uint8_t) SIM_TokenInt(&tokens, 0);
+    op->act  = (uint8_t) SIM_TokenInt(&tokens, 4);
+    SIM_TokenCopy(&tokens, 3, op->numeric, SIM_OPERATOR_SIZE);
+  }
+  return 1;
+}
+
+
+static void scanDone(SIM_HandlerTypeDef *hsim, SIM_Status_t status, void *ctx)
+{
+  (void) ctx;
+
+  // work held off by scan
+  hsim->cops.isScanning = 0;
+  SIM_SetPending(hsim, SIM_SUBSYS_CORE);
+  SIM_SetPending(hsim, SIM_SUBSYS_NET);
+  if (status != SIM_OK) {
+    hsim->cops.count = 0;
+    return;
+  }
+  hsim->cops.scanTick = hsim->getTick();
+  if (hsim->cops.scanTick == 0) hsim->cops.scanTick = 1;
+  SIM_Debug("Found %d operator(s).", hsim->cops.count);
+}
+
+
+/*
+ * remember registered operator, format was set to numeric by setRegReport
+ */
+static void updateLastGood(SIM_HandlerTypeDef *hsim)
+{
+  uint8_t *resp = &hsim->respTmp[0];
+  SIM_Tokens_t tokens;
+
+  hsim->mutexLock(hsim);
+
+  memset(resp, 0, 24);
+  SIM_SendCMD(hsim, "AT+COPS?");
+  if (SIM_GetResponse(hsim, "+COPS", 5, resp, 24, SIM_GETRESP_WAIT_OK, 2000) == SIM_OK) {
+    SIM_Tokenize(&tokens, resp, 24, ',');
+    if (SIM_TokenInt(&tokens, 1) == 2 && SIM_TokenIsQuoted(&tokens, 2)) {
+      SIM_TokenCopy(&tokens, 2, hsim->cops.lastGood, SIM_OPERATOR_SIZE);
+    }
+  }
+  hsim->mutexUnlock(hsim);
+}
+
+
+/*
+ * operator is not forbidden in last scan, or there is no scan to tell
+ */
+static uint8_t isOperatorUsable(SIM_HandlerTypeDef *hsim, const char *numeric)
+{
+  const SIM_Operator_t *list;
+  uint8_t count = 0;
+  uint8_t i;
+
+  list = SIM_GetOperators(hsim, &count);
+  if (list == NULL) return 1;
+
+  for (i = 0; i < count; i++) {
+    if (strncmp(list[i].numeric, numeric, SIM_OPERATOR_SIZE) == 0)
+      return list[i].stat != 3;
+  }
+  return 0;
+}
+
+
+/*
+ * Let modem report registration and cell changes as URC,
+ * AT+CEREG is for LTE and may be rejected on older firmware
+ */
+static void setRegReport(SIM_HandlerTypeDef *hsim)
+{
+  hsim->mutexLock(hsim);
+  SIM_SendCMD(hsim, "AT+CREG=2");
+  if (!SIM_IsResponseOK(hsim)) goto endcmd;
+
+  // numeric operator in AT+COPS? without changing selection mode
+  SIM_SendCMD(hsim, "AT+COPS=3,2");
+  if (!SIM_IsResponseOK(hsim)) goto endcmd;
+
+  #if SIM_EN_FEATURE_NET
+  SIM_SendCMD(hsim, "AT+CGREG=2");
+  if (!SIM_IsResponseOK(hsim)) goto endcmd;
+  SIM_SendCMD(hsim, "AT+CEREG=2");
+  if (!SIM_IsResponseOK(hsim)) goto endcmd;
+  #endif
+
+  endcmd:
+  hsim->mutexUnlock(hsim);
+}
+
+
+static void setRegStat(SIM_HandlerTypeDef *hsim, uint8_t stat)
+{
+  if (stat == 1 || stat == 5) {
+    if (!SIM_IS_STATUS(hsim, SIM_STATUS_REGISTERED)) {
+      SIM_BITS_SET(hsim->events, SIM_EVENT_ON_REGISTERED);
+      SIM_SetPending(hsim, SIM_SUBSYS_CORE);
+    }
+    SIM_SET_STATUS(hsim, SIM_STATUS_REGISTERED);
+    SIM_UNSET_STATUS(hsim, SIM_STATUS_ROAMING);
+    if (stat == 5) {
+      SIM_SET_STATUS(hsim, SIM_STATUS_ROAMING);
+    }
+  }
+  else {
+    SIM_UNSET_STATUS(hsim, SIM_STATUS_REGISTERED|SIM_STATUS_ROAMING);
+  }
+}
+
+
+/*
+ * parse "yy/MM/dd,hh:mm:ss+zz" in one pass, fields are written in
+ * SIM_Datetime member order
+ */
+static void str2Time(SIM_Datetime *dt, const uint8_t *str, uint16_t len)
+{
+  uint8_t *dtbytes = (uint8_t*) dt;
+  uint8_t idx = 0;
+  int16_t value = 0;
   int8_t mult = 1;
 
-  str++;
-  dt->year = (uint8_t) atoi(str);
-  dtbytes = ((uint8_t*) dt) + 1;
-  while (*str && *str != '\"') {
-    if (*str < '0' || *str > '9') {
-      if (*str == '-') {
-        mult = -1;
-      } else {
-        mult = 1;
-      }
+  while (idx < 7) {
+    if (len && *str >= '0' && *str <= '9') {
+      value = (value * 10) + (*str - '0');
+    }
+    else {
+      dtbytes[idx++] = (uint8_t) (value * mult);
+      value = 0;
+      if (!len) break;
+      mult = (*str == '-')? -1: 1;
+    }
+    if (len) {
       str++;
-      *dtbytes = ((int8_t) atoi(str)) * mult;
-      dtbytes++;
+      len--;
     }
-    str++;
   }
 }
@@ -9,6 +9,7 @@
 #include "include/simcom/conf.h"
 #include "include/simcom/utils.h"
 #include "include/simcom/debug.h"
+#include "include/simcom/stats.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
@@ -17,11 +18,55 @@
  __attribute__((weak)) void SIM_Printf(const char *format, ...) {}
  __attribute__((weak)) void SIM_Println(const char *format, ...) {}
 
+static uint8_t copyRespData(SIM_HandlerTypeDef*, uint8_t *respData, uint16_t rdsize);
+static void cmdQueueComplete(SIM_HandlerTypeDef*, SIM_Status_t);
+static uint8_t urcKey(const uint8_t *str, uint16_t len);
+static uint16_t rxFill(SIM_HandlerTypeDef*, uint32_t timeout);
+static void rxConsume(SIM_HandlerTypeDef*, uint16_t len);
+static void bufferSink(void *ctx, const uint8_t *data, uint16_t len);
+
+
+/*
+ * Wait until driver state changes
+ */
+void SIM_Wait(SIM_HandlerTypeDef *hsim, uint32_t timeout)
+{
+  if (hsim->waitEvent != NULL) hsim->waitEvent(hsim, timeout);
+  else hsim->delay(1);
+}
+
+
+void SIM_Notify(SIM_HandlerTypeDef *hsim)
+{
+  if (hsim->notifyEvent != NULL) hsim->notifyEvent(hsim);
+}
+
+
+/*
+ * Mark subsystem pending at tick, earliest of armed ticks is kept
+ */
+void SIM_WakeAt(SIM_HandlerTypeDef *hsim, SIM_Subsys_t subsys, uint32_t tick)
+{
+  uint8_t bit = 1 << subsys;
+
+  if (SIM_BITS_IS(hsim->pending.armed, bit)
+      && (int32_t)(tick - hsim->pending.wakeTick[subsys]) >= 0)
+  {
+    return;
+  }
+  hsim->pending.wakeTick[subsys] = tick;
+  SIM_BITS_SET(hsim->pending.armed, bit);
+}
+
+
 uint8_t SIM_SendCMD(SIM_HandlerTypeDef *hsim, const char *format, ...)
 {
-  uint16_t writeStatus;
+  int writeStatus;
   va_list arglist;
 
+  if (SIM_IsDataMode(hsim)) return 0;
+  if (!SIM_CmdQueueFlush(hsim)) return 0;
+
   va_start( arglist, format );
   hsim->cmdBufferLen = vsprintf(hsim->cmdBuffer, format, arglist);
   va_end( arglist );
@@ -29,17 +74,19 @@ uint8_t SIM_SendCMD(SIM_HandlerTypeDef *hsim, const char *format, ...)
                                        (uint8_t*)hsim->cmdBuffer,
                                        hsim->cmdBufferLen, 5000);
   if (writeStatus < 0) return 0;
+  SIM_STATS_SEND(hsim, hsim->cmdBuffer, hsim->cmdBufferLen);
   return 1;
 }
 
 
 uint8_t SIM_SendData(SIM_HandlerTypeDef *hsim, const uint8_t *data, uint16_t size)
 {
-  uint16_t writeStatus;
+  int writeStatus;
 
   do {
     writeStatus = hsim->serial.write(hsim->serial.device, data, size, 5000);
     if (writeStatus <= 0) return 0;
+    SIM_STATS_TX(hsim, writeStatus);
     data += writeStatus;
     size -= writeStatus;
   } while (size);
@@ -49,30 +96,82 @@ uint8_t SIM_SendData(SIM_HandlerTypeDef *hsim, const uint8_t *data, uint16_t siz
 
 
 
+/*
+ * Frame next line from RX ring into respBuffer. Line includes its "\r\n",
+ * a data prompt "> " is framed as line too because it has no line end.
+ * return line length or 0 when no line was completed before timeout
+ */
+uint16_t SIM_ReadLine(SIM_HandlerTypeDef *hsim, uint32_t timeout)
+{
+  uint32_t tickstart = hsim->getTick();
+  uint32_t elapsed;
+  uint16_t lineLen = 0;
+  uint16_t i;
+
+  while (1) {
+    // data prompt is the only response without line end
+    if (hsim->rxLen > 0 && hsim->rxScanned == 0 && hsim->rxBuffer[hsim->rxHead] == '>') {
+      lineLen = (hsim->rxLen > 1 && hsim->rxBuffer[(hsim->rxHead + 1) % SIM_RX_BUFFER_SIZE] == ' ')? 2: 1;
+      break;
+    }
+
+    // continue scan where last call stopped, so each byte is checked once
+    for (i = hsim->rxScanned; i < hsim->rxLen; i++) {
+      if (hsim->rxBuffer[(hsim->rxHead + i) % SIM_RX_BUFFER_SIZE] == '\n') {
+        lineLen = i + 1;
+        break;
+      }
+    }
+    hsim->rxScanned = i;
+    if (lineLen) break;
+
+    // line longer than ring, give it as is
+    if (hsim->rxLen == SIM_RX_BUFFER_SIZE) {
+      lineLen = SIM_RX_BUFFER_SIZE;
+      break;
+    }
+
+    elapsed = hsim->getTick() - tickstart;
+    if (elapsed >= timeout) {
+      if (rxFill(hsim, 0) == 0) return 0;
+    }
+    else rxFill(hsim, timeout - elapsed);
+  }
+
+  hsim->respBufferLen = SIM_GetData(hsim, hsim->respBuffer,
+                                    (lineLen < SIM_RESP_BUFFER_SIZE)? lineLen: SIM_RESP_BUFFER_SIZE-1,
+                                    0);
+  hsim->respBuffer[hsim->respBufferLen] = 0;
+
+  // drop the rest of too long line
+  if (lineLen >= SIM_RESP_BUFFER_SIZE) rxConsume(hsim, lineLen - (SIM_RESP_BUFFER_SIZE-1));
+
+  return hsim->respBufferLen;
+}
+
+
 uint8_t SIM_WaitResponse(SIM_HandlerTypeDef *hsim,
                          const char *respCode, uint16_t rcsize,
                          uint32_t timeout)
 {
-  int readStatus;
   uint32_t tickstart = hsim->getTick();
+  uint32_t elapsed;
+  if (SIM_IsDataMode(hsim)) return 0;
   if (rcsize > SIM_RESP_BUFFER_SIZE) rcsize = SIM_RESP_BUFFER_SIZE;
   if (timeout == 0) timeout = hsim->timeout;
 
   while (1) {
-    if ((hsim->getTick() - tickstart) >= timeout) break;
-    readStatus = hsim->serial.read(hsim->serial.device, hsim->respBuffer, rcsize, timeout);
-    if (SIM_IsResponse(hsim, respCode, rcsize)) {
-      return 1;
-    }
+    elapsed = hsim->getTick() - tickstart;
+    if (elapsed >= timeout) break;
 
-    hsim->serial.unread(hsim->serial.device, readStatus);
-
-    readStatus = hsim->serial.readline(hsim->serial.device, hsim->respBuffer, SIM_RESP_BUFFER_SIZE, timeout);
-    if (readStatus > 0) {
-      hsim->respBufferLen = readStatus;
+    if (SIM_ReadLine(hsim, timeout - elapsed) > 0) {
+      if (SIM_IsResponse(hsim, respCode, rcsize)) {
+        return 1;
+      }
       SIM_CheckAsyncResponse(hsim);
     }
   }
+  SIM_STATS_RESULT(hsim, SIM_TIMEOUT);
   return 0;
 }
 
@@ -83,39 +182,29 @@ SIM_Status_t SIM_GetResponse( SIM_HandlerTypeDef *hsim,
                               uint8_t getRespType,
                               uint32_t timeout)
 {
-  uint16_t i;
   uint8_t resp = SIM_TIMEOUT;
   uint8_t flagToReadResp = 0;
   uint32_t tickstart = hsim->getTick();
-  int readStatus;
+  uint32_t elapsed;
 
   if (timeout == 0) timeout = hsim->timeout;
 
+  // bytes on UART belong to the socket
+  if (SIM_IsDataMode(hsim)) return SIM_ERROR;
+  // command was not sent, see SIM_CmdQueueFlush
+  if (SIM_CmdQueueIsBusy(hsim)) return SIM_BUSY;
+
   // wait until available
   while(1) {
-    if((hsim->getTick() - tickstart) >= timeout) break;
+    elapsed = hsim->getTick() - tickstart;
+    if(elapsed >= timeout) break;
 
-    readStatus = hsim->serial.readline(hsim->serial.device, hsim->respBuffer, SIM_RESP_BUFFER_SIZE, timeout);
-    if (readStatus > 0) {
-      hsim->respBufferLen = readStatus;
-      hsim->respBuffer[hsim->respBufferLen] = 0;
+    if (SIM_ReadLine(hsim, timeout - elapsed) > 0) {
       if (rcsize && strncmp((char *)hsim->respBuffer, respCode, (int) rcsize) == 0) {
         if (flagToReadResp) continue;
 
         // read response data
-        for (i = 2; i < hsim->respBufferLen && rdsize; i++) {
-          // split string
-          if (!flagToReadResp && hsim->respBuffer[i-2] == ':' && hsim->respBuffer[i-1] == ' ') {
-            flagToReadResp = 1;
-          }
-
-          if (flagToReadResp) {
-            *respData = hsim->respBuffer[i];
-            respData++;
-            rdsize--;
-          }
-        }
-        if (rdsize) *respData = 0;
+        flagToReadResp = copyRespData(hsim, respData, rdsize);
         if (getRespType == SIM_GETRESP_ONLY_DATA) {
           resp = SIM_OK;
           break;
@@ -146,13 +235,299 @@ SIM_Status_t SIM_GetResponse( SIM_HandlerTypeDef *hsim,
     }
   }
 
+  SIM_STATS_RESULT(hsim, resp);
   return resp;
 }
 
 
+/*
+ * Read binary data by length, bytes already in RX ring go first
+ */
 uint16_t SIM_GetData(SIM_HandlerTypeDef *hsim, uint8_t *respData, uint16_t rdsize, uint32_t timeout)
 {
-  return hsim->serial.read(hsim->serial.device, respData, rdsize, timeout);
+  uint16_t readLen = 0;
+  uint16_t chunk;
+  int readStatus;
+
+  while (hsim->rxLen && readLen < rdsize) {
+    chunk = SIM_RX_BUFFER_SIZE - hsim->rxHead;
+    if (chunk > hsim->rxLen)        chunk = hsim->rxLen;
+    if (chunk > rdsize - readLen)   chunk = rdsize - readLen;
+    memcpy(respData + readLen, &hsim->rxBuffer[hsim->rxHead], chunk);
+    rxConsume(hsim, chunk);
+    readLen += chunk;
+  }
+
+  if (readLen < rdsize) {
+    readStatus = hsim->serial.read(hsim->serial.device, respData + readLen, rdsize - readLen, timeout);
+    if (readStatus > 0) readLen += readStatus;
+  }
+
+  SIM_STATS_RX(hsim, readLen);
+  return readLen;
+}
+
+
+/*
+ * Same as SIM_GetData but write to Buffer_t through RX ring
+ */
+uint16_t SIM_GetDataInto(SIM_HandlerTypeDef *hsim, Buffer_t *buffer, uint16_t rdsize, uint32_t timeout)
+{
+  return SIM_GetDataSink(hsim, bufferSink, buffer, rdsize, timeout);
+}
+
+
+/*
+ * Read binary data by length and hand it to sink as spans pointing
+ * into the RX ring, no intermediate copy. Spans are only valid during
+ * the call. With sink NULL the data is discarded.
+ */
+uint16_t SIM_GetDataSink(SIM_HandlerTypeDef *hsim, SIM_DataSink_t sink, void *ctx,
+                         uint16_t rdsize, uint32_t timeout)
+{
+  uint32_t tickstart = hsim->getTick();
+  uint32_t elapsed;
+  uint16_t readLen = 0;
+  uint16_t chunk;
+
+  while (readLen < rdsize) {
+    if (hsim->rxLen == 0) {
+      elapsed = hsim->getTick() - tickstart;
+      if (elapsed >= timeout) break;
+      rxFill(hsim, timeout - elapsed);
+      continue;
+    }
+
+    chunk = SIM_RX_BUFFER_SIZE - hsim->rxHead;
+    if (chunk > hsim->rxLen)        chunk = hsim->rxLen;
+    if (chunk > rdsize - readLen)   chunk = rdsize - readLen;
+    if (sink != NULL) sink(ctx, &hsim->rxBuffer[hsim->rxHead], chunk);
+    rxConsume(hsim, chunk);
+    readLen += chunk;
+  }
+
+  SIM_STATS_RX(hsim, readLen);
+  return readLen;
+}
+
+
+/*
+ * Hand whatever already arrived to sink without waiting, used for
+ * transparent socket where the UART has no line framing
+ */
+uint16_t SIM_GetDataAvailable(SIM_HandlerTypeDef *hsim, SIM_DataSink_t sink, void *ctx)
+{
+  uint16_t readLen = 0;
+  uint16_t chunk;
+
+  rxFill(hsim, 0);
+  while (hsim->rxLen) {
+    chunk = SIM_RX_BUFFER_SIZE - hsim->rxHead;
+    if (chunk > hsim->rxLen) chunk = hsim->rxLen;
+    if (sink != NULL) sink(ctx, &hsim->rxBuffer[hsim->rxHead], chunk);
+    rxConsume(hsim, chunk);
+    readLen += chunk;
+  }
+
+  SIM_STATS_RX(hsim, readLen);
+  return readLen;
+}
+
+
+/*
+ * Register handler for unsolicited result codes starting with prefix.
+ * Handlers with the same prefix key are tried in registration order
+ * until one of them returns 1.
+ */
+SIM_Status_t SIM_RegisterURC(SIM_HandlerTypeDef *hsim, const char *prefix, SIM_URCHandler_t handler)
+{
+  SIM_URC_t *urc;
+  uint8_t   key;
+  uint8_t   idx;
+  size_t    prefixLen = strlen(prefix);
+
+  if (hsim->urc.count >= SIM_NUM_OF_URC || prefixLen == 0 || prefixLen > 0xFF) return SIM_ERROR;
+
+  key = urcKey((const uint8_t*) prefix, (uint16_t) prefixLen);
+  if (key == SIM_URC_NONE) return SIM_ERROR;
+
+  urc = &hsim->urc.handlers[hsim->urc.count];
+  urc->prefix     = prefix;
+  urc->prefixLen  = (uint8_t) prefixLen;
+  urc->next       = SIM_URC_NONE;
+  urc->handler    = handler;
+
+  // append to the end of bucket
+  if (hsim->urc.table[key] == SIM_URC_NONE) {
+    hsim->urc.table[key] = hsim->urc.count;
+  } else {
+    idx = hsim->urc.table[key];
+    while (hsim->urc.handlers[idx].next != SIM_URC_NONE) {
+      idx = hsim->urc.handlers[idx].next;
+    }
+    hsim->urc.handlers[idx].next = hsim->urc.count;
+  }
+
+  hsim->urc.count++;
+  return SIM_OK;
+}
+
+
+/*
+ * Call registered handler of respBuffer
+ * return 1 if line was handled
+ */
+uint8_t SIM_DispatchURC(SIM_HandlerTypeDef *hsim)
+{
+  SIM_URC_t *urc;
+  uint8_t   key;
+  uint8_t   idx;
+
+  key = urcKey(hsim->respBuffer, hsim->respBufferLen);
+  if (key == SIM_URC_NONE) return 0;
+
+  for (idx = hsim->urc.table[key]; idx != SIM_URC_NONE; idx = urc->next) {
+    urc = &hsim->urc.handlers[idx];
+    if (hsim->respBufferLen >= urc->prefixLen
+        && memcmp(hsim->respBuffer, urc->prefix, urc->prefixLen) == 0
+        && urc->handler(hsim))
+    {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+/*
+ * Queue a command without waiting for the modem. The command is sent by
+ * SIM_CheckAnyResponse once every previously queued command has finished,
+ * then callback is called with the final result code. Callbacks run with the
+ * driver locked so they must not call blocking commands.
+ */
+SIM_Status_t SIM_SendCMDAsync(SIM_HandlerTypeDef *hsim,
+                              const char *respCode, uint16_t rcsize,
+                              uint8_t *respData, uint16_t rdsize,
+                              uint32_t timeout,
+                              SIM_CmdCallback_t callback, void *ctx,
+                              const char *format, ...)
+{
+  SIM_CmdEntry_t *entry;
+  va_list arglist;
+  int cmdLen;
+
+  if ((uint8_t)(hsim->cmdQueue.tail - hsim->cmdQueue.head) >= SIM_CMD_QUEUE_SIZE)
+    return SIM_ERROR;
+
+  entry = &hsim->cmdQueue.entries[hsim->cmdQueue.tail % SIM_CMD_QUEUE_SIZE];
+
+  va_start( arglist, format );
+  cmdLen = vsnprintf(entry->cmd, SIM_CMD_QUEUE_CMD_SIZE, format, arglist);
+  va_end( arglist );
+  if (cmdLen < 0 || cmdLen >= SIM_CMD_QUEUE_CMD_SIZE) return SIM_ERROR;
+
+  entry->cmdLen   = (uint16_t) cmdLen;
+  entry->respCode = respCode;
+  entry->rcsize   = (respCode == NULL)? 0: rcsize;
+  entry->respData = respData;
+  entry->rdsize   = (respData == NULL)? 0: rdsize;
+  entry->timeout  = (timeout == 0)? hsim->timeout: timeout;
+  entry->callback = callback;
+  entry->ctx      = ctx;
+
+  hsim->cmdQueue.tail++;
+  return SIM_OK;
+}
+
+
+/*
+ * Send next queued command and expire the running one.
+ * Must be called with driver locked.
+ */
+void SIM_CmdQueueProcess(SIM_HandlerTypeDef *hsim)
+{
+  SIM_CmdEntry_t *entry;
+
+  // queued commands wait until the modem is back in command mode
+  if (SIM_IsDataMode(hsim)) return;
+
+  if (hsim->cmdQueue.isSent) {
+    entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+    if (!SIM_IsTimeout(hsim, hsim->cmdQueue.sentTick, entry->timeout)) return;
+    cmdQueueComplete(hsim, SIM_TIMEOUT);
+  }
+
+  if (hsim->cmdQueue.head == hsim->cmdQueue.tail) return;
+
+  entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+  if (hsim->serial.writeline(hsim->serial.device,
+                             (uint8_t*) entry->cmd, entry->cmdLen, 5000) < 0)
+  {
+    cmdQueueComplete(hsim, SIM_ERROR);
+    return;
+  }
+  hsim->cmdQueue.isSent   = 1;
+  hsim->cmdQueue.sentTick = hsim->getTick();
+  SIM_STATS_SEND(hsim, entry->cmd, entry->cmdLen);
+}
+
+
+/*
+ * Match respBuffer against running queued command.
+ * return 1 if line was consumed
+ */
+uint8_t SIM_CmdQueueCheckResponse(SIM_HandlerTypeDef *hsim)
+{
+  SIM_CmdEntry_t *entry;
+
+  if (!hsim->cmdQueue.isSent) return 0;
+
+  entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+
+  if (entry->rcsize && SIM_IsResponse(hsim, entry->respCode, entry->rcsize)) {
+    copyRespData(hsim, entry->respData, entry->rdsize);
+    return 1;
+  }
+  if (SIM_IsResponse(hsim, "OK", 2)) {
+    cmdQueueComplete(hsim, SIM_OK);
+    return 1;
+  }
+  if (SIM_IsResponse(hsim, "ERROR", 5)) {
+    cmdQueueComplete(hsim, SIM_ERROR);
+    return 1;
+  }
+  if (SIM_IsResponse(hsim, "+CME ERROR", 10)) {
+    SIM_Debug("[Error] %s", (char*) (hsim->respBuffer+10));
+    cmdQueueComplete(hsim, SIM_ERROR);
+    return 1;
+  }
+  return 0;
+}
+
+
+/*
+ * Wait until running queued command was done, so blocking command will not
+ * get its response. Long command, e.g. AT+COPS=?, is not waited for.
+ * Must be called with driver locked.
+ * return 0 if a long command is still running and nothing may be sent
+ */
+uint8_t SIM_CmdQueueFlush(SIM_HandlerTypeDef *hsim)
+{
+  SIM_CmdEntry_t *entry;
+
+  while (hsim->cmdQueue.isSent) {
+    entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+    if (SIM_IsTimeout(hsim, hsim->cmdQueue.sentTick, entry->timeout)) {
+      cmdQueueComplete(hsim, SIM_TIMEOUT);
+      break;
+    }
+    if (SIM_CmdQueueIsBusy(hsim)) return 0;
+
+    if (SIM_ReadLine(hsim, entry->timeout) > 0) {
+      SIM_CheckAsyncResponse(hsim);
+    }
+  }
+  return 1;
 }
 
 
@@ -190,3 +565,439 @@ const uint8_t * SIM_ParseStr(const uint8_t *separator, uint8_t delimiter, int id
 
   return separator;
 }
+
+
+/*
+ * Split str in one pass into fields separated by delimiter. Quoted field
+ * is stored without its quotes and delimiter inside quotes is ignored.
+ * Stop at line end, NUL or len.
+ * return number of fields
+ */
+uint8_t SIM_Tokenize(SIM_Tokens_t *tokens, const uint8_t *str, uint16_t len, uint8_t delimiter)
+{
+  uint16_t i;
+  uint16_t start = 0;
+  uint8_t  isInStr = 0;
+  uint8_t  flags = 0;
+  uint8_t  c;
+
+  tokens->str   = str;
+  tokens->count = 0;
+
+  for (i = 0; ; i++) {
+    c = (i < len)? str[i]: 0;
+
+    if (c == '\"') {
+      if (!isInStr) {
+        start = i + 1;
+        flags = SIM_TOKEN_QUOTED;
+      }
+      isInStr = !isInStr;
+      continue;
+    }
+    if (isInStr && c != 0 && c != '\r' && c != '\n') continue;
+
+    if (c == delimiter || c == 0 || c == '\r' || c == '\n') {
+      if (tokens->count < SIM_MAX_TOKENS) {
+        uint16_t end = i;
+        // closing quote is not part of field
+        if ((flags & SIM_TOKEN_QUOTED) && end > start && str[end-1] == '\"') end--;
+        tokens->field[tokens->count].offset = start;
+        tokens->field[tokens->count].len    = (end - start > 0xFF)? 0xFF: (uint8_t) (end - start);
+        tokens->field[tokens->count].flags  = flags;
+        tokens->count++;
+      }
+      if (c != delimiter) break;
+      start = i + 1;
+      flags = 0;
+    }
+  }
+
+  return tokens->count;
+}
+
+
+/*
+ * Tokenize respBuffer after its "+XXX: " prefix
+ */
+uint8_t SIM_TokenizeResp(SIM_HandlerTypeDef *hsim, SIM_Tokens_t *tokens)
+{
+  uint16_t i;
+
+  for (i = 2; i < hsim->respBufferLen; i++) {
+    if (hsim->respBuffer[i-2] == ':' && hsim->respBuffer[i-1] == ' ') {
+      return SIM_Tokenize(tokens, &hsim->respBuffer[i], hsim->respBufferLen - i, ',');
+    }
+  }
+  return SIM_Tokenize(tokens, hsim->respBuffer, hsim->respBufferLen, ',');
+}
+
+
+int32_t SIM_TokenInt(const SIM_Tokens_t *tokens, uint8_t idx)
+{
+  const uint8_t *str;
+  uint8_t len;
+  int32_t result = 0;
+  int8_t  sign = 1;
+
+  if (idx >= tokens->count) return 0;
+
+  str = SIM_TokenPtr(tokens, idx);
+  len = tokens->field[idx].len;
+
+  while (len && *str == ' ') { str++; len--; }
+  if (len && (*str == '-' || *str == '+')) {
+    if (*str == '-') sign = -1;
+    str++;
+    len--;
+  }
+  while (len && *str >= '0' && *str <= '9') {
+    result = (result * 10) + (*str - '0');
+    str++;
+    len--;
+  }
+  return result * sign;
+}
+
+
+uint32_t SIM_TokenHex(const SIM_Tokens_t *tokens, uint8_t idx)
+{
+  const uint8_t *str;
+  uint8_t len;
+  uint32_t result = 0;
+  uint8_t c;
+
+  if (idx >= tokens->count) return 0;
+
+  str = SIM_TokenPtr(tokens, idx);
+  len = tokens->field[idx].len;
+
+  while (len) {
+    c = *str;
+    if (c >= '0' && c <= '9')       c = c - '0';
+    else if (c >= 'A' && c <= 'F')  c = c - 'A' + 10;
+    else if (c >= 'a' && c <= 'f')  c = c - 'a' + 10;
+    else break;
+    result = (result << 4) | c;
+    str++;
+    len--;
+  }
+  return result;
+}
+
+
+/*
+ * +CREG, +CGREG and +CEREG, URC "<stat>[,<lac>,<ci>]" or query response
+ * "<n>,<stat>[,<lac>,<ci>]". lac and ci are left untouched when not reported
+ */
+uint8_t SIM_TokenRegStat(const SIM_Tokens_t *tokens, uint16_t *lac, uint32_t *ci)
+{
+  uint8_t idx = 0;
+
+  // second field of URC is quoted lac
+  if (tokens->count >= 2 && !SIM_TokenIsQuoted(tokens, 1)) idx = 1;
+
+  if (tokens->count >= idx + 3) {
+    if (lac != NULL) *lac = (uint16_t) SIM_TokenHex(tokens, idx + 1);
+    if (ci != NULL)  *ci  = SIM_TokenHex(tokens, idx + 2);
+  }
+  return (uint8_t) SIM_TokenInt(tokens, idx);
+}
+
+
+/*
+ * copy field as NUL terminated string
+ * return copied length
+ */
+uint16_t SIM_TokenCopy(const SIM_Tokens_t *tokens, uint8_t idx, char *dst, uint16_t size)
+{
+  uint16_t len = SIM_TokenLen(tokens, idx);
+
+  if (size == 0) return 0;
+  if (len > size - 1) len = size - 1;
+  if (len) memcpy(dst, SIM_TokenPtr(tokens, idx), len);
+  dst[len] = 0;
+  return len;
+}
+
+
+void SIM_BatchInit(SIM_Batch_t *batch)
+{
+  memcpy(batch->cmd, "AT", 3);
+  batch->cmdLen = 2;
+  batch->count  = 0;
+}
+
+
+/*
+ * Append command without "AT", e.g. "+CSQ". respCode selects the
+ * intermediate response that is copied to respData, NULL when only OK.
+ * After a failed add the batch stays failed, so only last result needs check
+ */
+SIM_Status_t SIM_BatchAdd(SIM_Batch_t *batch,
+                          const char *respCode, uint16_t rcsize,
+                          uint8_t *respData, uint16_t rdsize,
+                          const char *format, ...)
+{
+  SIM_BatchSlot_t *slot;
+  va_list arglist;
+  uint16_t len = batch->cmdLen;
+  int cmdLen;
+
+  if (len >= SIM_BATCH_CMD_SIZE) return SIM_ERROR;
+  if (batch->count >= SIM_BATCH_SIZE) goto overflow;
+  if (batch->count > 0) batch->cmd[len++] = ';';
+
+  va_start( arglist, format );
+  cmdLen = vsnprintf(&batch->cmd[len], SIM_BATCH_CMD_SIZE - len, format, arglist);
+  va_end( arglist );
+  if (cmdLen < 0 || cmdLen >= SIM_BATCH_CMD_SIZE - len) goto overflow;
+  batch->cmdLen = len + cmdLen;
+
+  slot = &batch->slots[batch->count++];
+  slot->respCode    = respCode;
+  slot->rcsize      = (respCode == NULL)? 0: rcsize;
+  slot->respData    = respData;
+  slot->rdsize      = (respData == NULL)? 0: rdsize;
+  slot->isReceived  = 0;
+  return SIM_OK;
+
+  overflow:
+  batch->cmdLen = SIM_BATCH_CMD_SIZE;
+  return SIM_ERROR;
+}
+
+
+/*
+ * Send batch as one line, intermediate responses go to slots in order.
+ * On ERROR modem stops at the failed command, isReceived tells how far it got
+ */
+SIM_Status_t SIM_BatchExec(SIM_HandlerTypeDef *hsim, SIM_Batch_t *batch, uint32_t timeout)
+{
+  SIM_BatchSlot_t *slot;
+  SIM_Status_t resp = SIM_TIMEOUT;
+  uint32_t tickstart;
+  uint32_t elapsed;
+  uint8_t i;
+
+  if (batch->cmdLen >= SIM_BATCH_CMD_SIZE) return SIM_ERROR;
+  if (batch->count == 0) return SIM_OK;
+  if (timeout == 0) timeout = hsim->timeout;
+
+  hsim->mutexLock(hsim);
+  if (!SIM_SendCMD(hsim, "%s", batch->cmd)) {
+    resp = SIM_ERROR;
+    goto endcmd;
+  }
+
+  tickstart = hsim->getTick();
+  while (resp == SIM_TIMEOUT) {
+    elapsed = hsim->getTick() - tickstart;
+    if (elapsed >= timeout) break;
+    if (SIM_ReadLine(hsim, timeout - elapsed) == 0) continue;
+
+    for (i = 0; i < batch->count; i++) {
+      slot = &batch->slots[i];
+      if (slot->isReceived || slot->rcsize == 0) continue;
+      if (SIM_IsResponse(hsim, slot->respCode, slot->rcsize)) break;
+    }
+    if (i < batch->count) {
+      copyRespData(hsim, slot->respData, slot->rdsize);
+      slot->isReceived = 1;
+    }
+    else if (SIM_IsResponse(hsim, "OK", 2)) {
+      resp = SIM_OK;
+    }
+    else if (SIM_IsResponse(hsim, "ERROR", 5)) {
+      resp = SIM_ERROR;
+    }
+    else if (SIM_IsResponse(hsim, "+CME ERROR", 10)) {
+      resp = SIM_ERROR;
+      SIM_Debug("[Error] %s", (char*) (hsim->respBuffer+10));
+    }
+    else {
+      SIM_CheckAsyncResponse(hsim);
+    }
+  }
+  SIM_STATS_RESULT(hsim, resp);
+
+  endcmd:
+  hsim->mutexUnlock(hsim);
+  return resp;
+}
+
+
+/*
+ * FNV-1a, start with SIM_FINGERPRINT_INIT
+ */
+uint32_t SIM_Fingerprint(uint32_t hash, const void *data, uint16_t len)
+{
+  const uint8_t *bytes = (const uint8_t*) data;
+
+  while (len--) {
+    hash ^= *bytes++;
+    hash *= 0x01000193;
+  }
+  return hash;
+}
+
+
+/*
+ * hash string with its terminator, so ("ab","c") differs from ("a","bc")
+ * and NULL differs from ""
+ */
+uint32_t SIM_FingerprintStr(uint32_t hash, const char *str)
+{
+  if (str == NULL) return SIM_Fingerprint(hash, "\xff", 1);
+  return SIM_Fingerprint(hash, str, strlen(str) + 1);
+}
+
+
+/*
+ * return 1 if host storage says this config was applied to the modem
+ */
+uint8_t SIM_ConfigIsApplied(SIM_HandlerTypeDef *hsim, SIM_Config_t config, uint32_t fingerprint)
+{
+  if (hsim->loadConfig == NULL) return 0;
+  return hsim->loadConfig(hsim, config) == fingerprint;
+}
+
+
+void SIM_ConfigApplied(SIM_HandlerTypeDef *hsim, SIM_Config_t config, uint32_t fingerprint)
+{
+  if (hsim->saveConfig == NULL) return;
+  if (hsim->loadConfig != NULL && hsim->loadConfig(hsim, config) == fingerprint) return;
+  hsim->saveConfig(hsim, config, fingerprint);
+}
+
+
+/*
+ * forget that config was applied, it is sent again on next use
+ */
+void SIM_ConfigClear(SIM_HandlerTypeDef *hsim, SIM_Config_t config)
+{
+  SIM_ConfigApplied(hsim, config, 0);
+}
+
+
+/*
+ * copy data after ": " of respBuffer
+ * return 1 if data was found
+ */
+static uint8_t copyRespData(SIM_HandlerTypeDef *hsim, uint8_t *respData, uint16_t rdsize)
+{
+  uint8_t flagToReadResp = 0;
+  uint16_t i;
+
+  for (i = 2; i < hsim->respBufferLen && rdsize; i++) {
+    // split string
+    if (!flagToReadResp && hsim->respBuffer[i-2] == ':' && hsim->respBuffer[i-1] == ' ') {
+      flagToReadResp = 1;
+    }
+
+    if (flagToReadResp) {
+      *respData = hsim->respBuffer[i];
+      respData++;
+      rdsize--;
+    }
+  }
+  if (rdsize) *respData = 0;
+  return flagToReadResp;
+}
+
+
+static void cmdQueueComplete(SIM_HandlerTypeDef *hsim, SIM_Status_t status)
+{
+  SIM_CmdEntry_t *entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+  SIM_CmdCallback_t callback = entry->callback;
+  void *ctx = entry->ctx;
+
+  SIM_STATS_RESULT(hsim, status);
+
+  // work held off while the modem was busy with it
+  if (SIM_CmdQueueIsBusy(hsim)) {
+    SIM_SetPending(hsim, SIM_SUBSYS_CORE);
+    SIM_SetPending(hsim, SIM_SUBSYS_NET);
+    SIM_SetPending(hsim, SIM_SUBSYS_SOCK);
+  }
+
+  // free the slot first, callback may queue next command
+  hsim->cmdQueue.isSent = 0;
+  hsim->cmdQueue.head++;
+  if (callback != NULL)
+    callback(hsim, status, ctx);
+}
+
+
+/*
+ * queued command running longer than a blocking command may wait
+ */
+uint8_t SIM_CmdQueueIsBusy(SIM_HandlerTypeDef *hsim)
+{
+  SIM_CmdEntry_t *entry = &hsim->cmdQueue.entries[hsim->cmdQueue.head % SIM_CMD_QUEUE_SIZE];
+
+  return hsim->cmdQueue.isSent && entry->timeout > hsim->timeout;
+}
+
+
+/*
+ * get table index of URC, most of URC start with '+' so use next char
+ */
+static uint8_t urcKey(const uint8_t *str, uint16_t len)
+{
+  uint8_t c;
+
+  if (len == 0) return SIM_URC_NONE;
+  c = str[0];
+  if (c == '+' && len > 1) c = str[1];
+  if (c < 0x20 || c >= 0x20 + SIM_URC_TABLE_SIZE) return SIM_URC_NONE;
+  return c - 0x20;
+}
+
+
+/*
+ * Pull received bytes into RX ring. When ring is empty wait up to timeout
+ * for first byte, then take the rest that already received.
+ * return number of new bytes
+ */
+static uint16_t rxFill(SIM_HandlerTypeDef *hsim, uint32_t timeout)
+{
+  uint16_t tail;
+  uint16_t space;
+  uint16_t fillLen = 0;
+  int readStatus;
+
+  while (hsim->rxLen < SIM_RX_BUFFER_SIZE) {
+    tail  = (hsim->rxHead + hsim->rxLen) % SIM_RX_BUFFER_SIZE;
+    space = SIM_RX_BUFFER_SIZE - hsim->rxLen;
+    if (space > SIM_RX_BUFFER_SIZE - tail) space = SIM_RX_BUFFER_SIZE - tail;
+
+    if (hsim->serial.isReadable(hsim->serial.device))
+      readStatus = hsim->serial.read(hsim->serial.device, &hsim->rxBuffer[tail], space, 0);
+    else if (fillLen == 0 && timeout > 0)
+      readStatus = hsim->serial.read(hsim->serial.device, &hsim->rxBuffer[tail], 1, timeout);
+    else
+      break;
+
+    if (readStatus <= 0) break;
+    hsim->rxLen += readStatus;
+    fillLen     += readStatus;
+  }
+
+  return fillLen;
+}
+
+
+static void rxConsume(SIM_HandlerTypeDef *hsim, uint16_t len)
+{
+  if (len > hsim->rxLen) len = hsim->rxLen;
+  hsim->rxHead = (hsim->rxHead + len) % SIM_RX_BUFFER_SIZE;
+  hsim->rxLen -= len;
+  hsim->rxScanned = (hsim->rxScanned > len)? hsim->rxScanned - len: 0;
+}
+
+
+static void bufferSink(void *ctx, const uint8_t *data, uint16_t len)
+{
+  Buffer_Write((Buffer_t*) ctx, data, len);
+}
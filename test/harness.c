@@ -0,0 +1,135 @@
+/*
+ * harness.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include <string.h>
+
+#define HARNESS_STEP 1000   // max clock jump of an idle pass
+
+ModemSim_t  sim;
+uint32_t    savedConfig[SIM_CONFIG_MAX];
+uint32_t    harnessPasses;
+int         testFailed;
+
+
+static uint32_t loadConfig(SIM_HandlerTypeDef *hsim, SIM_Config_t config)
+{
+  (void) hsim;
+  return savedConfig[config];
+}
+
+
+static void saveConfig(SIM_HandlerTypeDef *hsim, SIM_Config_t config, uint32_t fingerprint)
+{
+  (void) hsim;
+  savedConfig[config] = fingerprint;
+}
+
+
+void Harness_Init(SIM_HandlerTypeDef *hsim)
+{
+  memset(savedConfig, 0, sizeof(savedConfig));
+  ModemSim_Init(&sim);
+  ModemSim_SetTick(0x1000);
+  Harness_Restart(hsim);
+}
+
+
+/*
+ * MCU reset, modem keeps running and host storage keeps savedConfig
+ */
+void Harness_Restart(SIM_HandlerTypeDef *hsim)
+{
+  memset(hsim, 0, sizeof(SIM_HandlerTypeDef));
+  hsim->delay             = ModemSim_Delay;
+  hsim->getTick           = ModemSim_Tick;
+  hsim->loadConfig        = loadConfig;
+  hsim->saveConfig        = saveConfig;
+  hsim->serial.device     = &sim;
+  hsim->serial.isReadable = ModemSim_IsReadable;
+  hsim->serial.read       = ModemSim_Read;
+  hsim->serial.write      = ModemSim_Write;
+  hsim->serial.writeline  = ModemSim_Writeline;
+
+  // what firmware sets up before SIM_Init
+  #if SIM_EN_FEATURE_NTP
+  hsim->NTP.server                = "pool.ntp.org";
+  hsim->NTP.region                = 28;
+  hsim->NTP.config.retryInterval  = 10000;
+  hsim->NTP.config.resyncInterval = 3600000;
+  #endif
+}
+
+
+void Harness_Free(void)
+{
+  ModemSim_Free(&sim);
+}
+
+
+/*
+ * Poll the driver like the main loop of firmware for ms of virtual time,
+ * idle passes jump the clock to the next modem output or armed wake
+ */
+void Harness_Run(SIM_HandlerTypeDef *hsim, uint32_t ms)
+{
+  uint32_t end = ModemSim_Tick() + ms;
+  uint32_t next;
+  uint32_t now;
+
+  for (;;) {
+    SIM_CheckAnyResponse(hsim);
+    harnessPasses++;
+
+    now = ModemSim_Tick();
+    if ((int32_t)(now - end) >= 0) break;
+    if (hsim->pending.bits || ModemSim_IsReadable(&sim)) {
+      ModemSim_Delay(1);
+      continue;
+    }
+
+    next = end;
+    if ((int32_t)(next - now) > HARNESS_STEP) next = now + HARNESS_STEP;
+    if (ModemSim_NextEvent(&sim, &now) && (int32_t)(now - next) < 0) next = now;
+    for (int i = 0; i < SIM_SUBSYS_MAX; i++) {
+      if ((hsim->pending.armed & (1 << i)) && (int32_t)(hsim->pending.wakeTick[i] - next) < 0)
+        next = hsim->pending.wakeTick[i];
+    }
+    now = ModemSim_Tick();
+    ModemSim_Delay(((int32_t)(next - now) > 0)? next - now: 1);
+  }
+}
+
+
+uint8_t Harness_RunUntil(SIM_HandlerTypeDef *hsim, uint8_t (*cond)(SIM_HandlerTypeDef*), uint32_t ms)
+{
+  uint32_t end = ModemSim_Tick() + ms;
+
+  while (!cond(hsim)) {
+    if ((int32_t)(ModemSim_Tick() - end) >= 0) return 0;
+    Harness_Run(hsim, 10);
+  }
+  return 1;
+}
+
+
+static uint8_t isReady(SIM_HandlerTypeDef *hsim)
+{
+  return hsim->bringUp.state == SIM_STATE_READY
+      && (hsim->status & SIM_STATUS_REGISTERED);
+}
+
+
+/*
+ * Power on modem and run until the driver sees it registered
+ */
+uint8_t Harness_BringUp(SIM_HandlerTypeDef *hsim)
+{
+  if (SIM_Init(hsim) != SIM_OK) return 0;
+  ModemSim_PowerOn(&sim);
+  return Harness_RunUntil(hsim, isReady, 60000);
+}
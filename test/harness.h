@@ -0,0 +1,28 @@
+/*
+ * harness.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TEST_HARNESS_H_
+#define TEST_HARNESS_H_
+
+#include "simcom.h"
+#include "modem_sim.h"
+
+/*
+ * Driver wired to the simulator on the virtual clock
+ */
+
+extern ModemSim_t   sim;
+extern uint32_t     savedConfig[SIM_CONFIG_MAX];
+extern uint32_t     harnessPasses;      // event loop passes of Harness_Run
+
+void      Harness_Init(SIM_HandlerTypeDef*);
+void      Harness_Restart(SIM_HandlerTypeDef*);
+void      Harness_Free(void);
+void      Harness_Run(SIM_HandlerTypeDef*, uint32_t ms);
+uint8_t   Harness_RunUntil(SIM_HandlerTypeDef*, uint8_t (*cond)(SIM_HandlerTypeDef*), uint32_t ms);
+uint8_t   Harness_BringUp(SIM_HandlerTypeDef*);
+
+#endif /* TEST_HARNESS_H_ */
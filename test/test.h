@@ -0,0 +1,48 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#ifndef TEST_TEST_H_
+#define TEST_TEST_H_
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Each test file is one executable, a failed check prints its location
+ * and the executable returns non zero
+ */
+
+extern int testFailed;
+
+#define CHECK(cond) do { \
+  if (!(cond)) { \
+    printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+    testFailed++; \
+  } \
+} while (0)
+
+#define CHECK_EQ(a, b) do { \
+  long long _a = (long long) (a), _b = (long long) (b); \
+  if (_a != _b) { \
+    printf("%s:%d: CHECK_EQ(%s, %s) failed, %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+    testFailed++; \
+  } \
+} while (0)
+
+#define CHECK_MEM(a, b, len) do { \
+  if (memcmp((a), (b), (len)) != 0) { \
+    printf("%s:%d: CHECK_MEM(%s, %s) failed\n", __FILE__, __LINE__, #a, #b); \
+    testFailed++; \
+  } \
+} while (0)
+
+#define RUN(test) do { \
+  int _before = testFailed; \
+  test(); \
+  printf("%s %s\n", (testFailed == _before)? "ok  ": "FAIL", #test); \
+} while (0)
+
+#endif /* TEST_TEST_H_ */
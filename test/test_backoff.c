@@ -0,0 +1,163 @@
+/*
+ * test_backoff.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+static SIM_Socket_t client;
+static SIM_Server_t server;
+static uint32_t connectErrors;
+static uint32_t closed;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  (void) data;
+  (void) len;
+}
+
+
+static void onConnectError(void)
+{
+  connectErrors++;
+}
+
+
+static void onClosed(void)
+{
+  closed++;
+}
+
+
+static SIM_Socket_t* onAccept(const char *host, uint16_t port)
+{
+  (void) host;
+  (void) port;
+  client.listeners.onData = onData;
+  return &client;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static uint8_t isSockOpening(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPENING);
+}
+
+
+static uint8_t isListening(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return server.state == SIM_SERVER_STATE_LISTENING;
+}
+
+
+static void setUp(void)
+{
+  memset(&sock, 0, sizeof(sock));
+  memset(&client, 0, sizeof(client));
+  memset(&server, 0, sizeof(server));
+  connectErrors = 0;
+  closed = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.config.autoReconnect = 1;
+  sock.config.reconnectingDelay = 2000;
+  sock.listeners.onData = onData;
+  sock.listeners.onConnectError = onConnectError;
+  sock.listeners.onClosed = onClosed;
+  CHECK_EQ(SIM_SOCK_Init(&sock, "10.0.0.1", 80), SIM_OK);
+}
+
+
+static void testStuckOpenIsRetried(void)
+{
+  uint32_t backoff = 0;
+
+  setUp();
+  // OK, but +CIPOPEN never comes
+  ModemSim_On(&sim, "AT+CIPOPEN", 0, 3, "\r\nOK\r\n");
+  SIM_SOCK_Open(&sock, &hsim);
+
+  for (int i = 1; i <= 3; i++) {
+    CHECK(Harness_RunUntil(&hsim, isSockOpening, 20000));
+    Harness_Run(&hsim, SIM_SOCK_OPEN_TO + 100);
+    CHECK_EQ(ModemSim_Count(&sim, "AT+CIPCLOSE=0"), i);
+    CHECK_EQ(connectErrors, i);
+    CHECK(!SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN));
+
+    // doubled on each abort, jitter keeps it in the upper half
+    if (backoff) CHECK_EQ(sock.reconn.backoff, backoff * 2);
+    CHECK(sock.reconn.backoff >= sock.config.reconnectingDelay);
+    CHECK(sock.reconn.wait >= sock.reconn.backoff / 2 && sock.reconn.wait <= sock.reconn.backoff);
+    backoff = sock.reconn.backoff;
+    Harness_Run(&hsim, backoff + 100);
+    CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN=0,"), i + 1);
+  }
+
+  // modem answers again
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  CHECK_EQ(sock.reconn.backoff, 0);
+  CHECK_EQ(closed, 0);
+  Harness_Free();
+}
+
+
+static void testAcceptBeforeReconnect(void)
+{
+  uint32_t due;
+
+  setUp();
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  CHECK_EQ(sock.linkNum, 0);
+
+  SIM_SERVER_Init(&server, 8080);
+  server.listeners.onAccept = onAccept;
+  CHECK_EQ(SIM_SERVER_Start(&server, &hsim), SIM_OK);
+  CHECK(Harness_RunUntil(&hsim, isListening, 20000));
+
+  ModemSim_PeerClose(&sim, 0);
+  Harness_Run(&hsim, 100);
+  CHECK(!isSockOpen(&hsim));
+  ModemSim_ClearLog(&sim);
+
+  // modem hands link 0 to a client just as the reconnect is due
+  due = sock.tick.reconnDelay + sock.reconn.wait + 1;
+  sim.links[0].state = MODEMSIM_LINK_OPEN;
+  ModemSim_URC(&sim, due - sim.now, "+CLIENT: 0,0,10.9.8.7:40000");
+  Harness_Run(&hsim, due - sim.now + 1000);
+
+  CHECK(hsim.net.sockets[0] == (void*) &client);
+  CHECK(SIM_SOCK_IS_STATE(&client, SIM_SOCK_STATE_OPEN));
+  CHECK_EQ(sock.linkNum, 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN=0,"), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN=1,"), 1);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testStuckOpenIsRetried);
+  RUN(testAcceptBeforeReconnect);
+  return testFailed != 0;
+}
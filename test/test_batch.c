@@ -0,0 +1,151 @@
+/*
+ * test_batch.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+#include "simcom/gps.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 2000);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testResponsesToSlots(void)
+{
+  SIM_Batch_t batch;
+  uint8_t csq[16];
+  uint8_t cpin[16];
+
+  setUp();
+  sim.csq = 21;
+  SIM_BatchInit(&batch);
+  SIM_BatchAdd(&batch, "+CSQ", 4, csq, sizeof(csq), "+CSQ");
+  SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "+CGPSHOR=%d", 50);
+  SIM_BatchAdd(&batch, "+CPIN", 5, cpin, sizeof(cpin), "+CPIN?");
+  CHECK_EQ(batch.count, 3);
+  CHECK(strcmp(batch.cmd, "AT+CSQ;+CGPSHOR=50;+CPIN?") == 0);
+
+  CHECK_EQ(SIM_BatchExec(&hsim, &batch, 1000), SIM_OK);
+  CHECK(batch.slots[0].isReceived);
+  CHECK(strncmp((char*) csq, "21,99", 5) == 0);
+  CHECK(batch.slots[2].isReceived);
+  CHECK(strncmp((char*) cpin, "READY", 5) == 0);
+
+  // one line, one round-trip
+  CHECK_EQ(ModemSim_Count(&sim, "AT"), 1);
+  Harness_Free();
+}
+
+
+static void testErrorStopsBatch(void)
+{
+  SIM_Batch_t batch;
+  uint8_t csq[16];
+  uint8_t creg[24];
+
+  setUp();
+  sim.simReady = 0;
+  SIM_BatchInit(&batch);
+  SIM_BatchAdd(&batch, "+CSQ", 4, csq, sizeof(csq), "+CSQ");
+  SIM_BatchAdd(&batch, "+CPIN", 5, NULL, 0, "+CPIN?");
+  SIM_BatchAdd(&batch, "+CREG", 5, creg, sizeof(creg), "+CREG?");
+
+  CHECK_EQ(SIM_BatchExec(&hsim, &batch, 1000), SIM_ERROR);
+  CHECK(batch.slots[0].isReceived);
+  CHECK(!batch.slots[2].isReceived);
+  Harness_Free();
+}
+
+
+static void testOverflowIsNotSent(void)
+{
+  SIM_Batch_t batch;
+  SIM_Status_t status = SIM_OK;
+
+  setUp();
+  SIM_BatchInit(&batch);
+  for (int i = 0; i <= SIM_BATCH_SIZE; i++) {
+    status = SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "+CGPSHOR=%d", i);
+  }
+  CHECK_EQ(status, SIM_ERROR);
+  // stays failed after a later add that would fit
+  SIM_BatchInit(&batch);
+  SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "+CGPSURL=\"%0*d\"", SIM_BATCH_CMD_SIZE, 0);
+  CHECK_EQ(SIM_BatchAdd(&batch, NULL, 0, NULL, 0, "+CSQ"), SIM_ERROR);
+
+  CHECK_EQ(SIM_BatchExec(&hsim, &batch, 1000), SIM_ERROR);
+  CHECK_EQ(ModemSim_Count(&sim, "AT"), 0);
+  Harness_Free();
+}
+
+
+static void testGPSSetupOneLine(void)
+{
+  setUp();
+  // already done by bring-up, apply again
+  savedConfig[SIM_CONFIG_GPS] = 0;
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSHOR=50;+CGPSNMEARATE="), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT"), 1);
+  Harness_Free();
+}
+
+
+static void testSettersMatchSetup(void)
+{
+  setUp();
+  CHECK_EQ(SIM_GPS_SetAccuracy(&hsim, 50), SIM_OK);
+  CHECK_EQ(SIM_GPS_SetAGPSServer(&hsim, "supl.google.com:7276", 0), SIM_OK);
+  CHECK_EQ(SIM_GPS_SetAntenna(&hsim, SIM_GPS_ANT_ACTIVE), SIM_OK);
+  CHECK_EQ(SIM_GPS_SetAntenna(&hsim, (SIM_GPS_ANT_Mode_t) 9), SIM_ERROR);
+
+  // each setter sends what it adds to the default setup line
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSHOR=50\n"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSURL=\"supl.google.com:7276\";+CGPSSSL=0"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CVAUXV=3050;+CVAUXS=1"), 1);
+  CHECK_EQ(sim.commands, 3);
+
+  savedConfig[SIM_CONFIG_GPS] = 0;
+  ModemSim_ClearLog(&sim);
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  CHECK(strstr(sim.log, "+CGPSHOR=50;") != NULL);
+  CHECK(strstr(sim.log, ";+CGPSURL=\"supl.google.com:7276\";+CGPSSSL=0;") != NULL);
+  CHECK(strstr(sim.log, ";+CVAUXV=3050;+CVAUXS=1") != NULL);
+  Harness_Free();
+}
+
+
+static void testHealthPollOneLine(void)
+{
+  setUp();
+  sim.csq = 12;
+  Harness_Run(&hsim, SIM_HEALTH_INTERVAL + 1000);
+
+  CHECK_EQ(hsim.signal, 12);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CSQ;+CREG?"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CREG?"), 0);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testResponsesToSlots);
+  RUN(testErrorStopsBatch);
+  RUN(testOverflowIsNotSent);
+  RUN(testGPSSetupOneLine);
+  RUN(testSettersMatchSetup);
+  RUN(testHealthPollOneLine);
+  return testFailed != 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * test_bringup.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static void testBringUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  CHECK_EQ(hsim.bringUp.state, SIM_STATE_READY);
+  CHECK(ModemSim_Count(&sim, "ATE0") >= 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CPIN?"), 1);
+  CHECK_EQ(hsim.cell.lac, 0x1A2B);
+  Harness_Free();
+}
+
+
+static void testBlockingCommands(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(SIM_CheckAT(&hsim));
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 20);
+  sim.simReady = 0;
+  CHECK(!SIM_CheckSIMCard(&hsim));
+  Harness_Free();
+}
+
+
+static void testIdleIsQuiet(void)
+{
+  uint32_t commands;
+
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 1000);
+  ModemSim_ClearLog(&sim);
+  Harness_Run(&hsim, 50000);
+  commands = sim.commands;
+  // one health check batch per SIM_HEALTH_INTERVAL, nothing else
+  CHECK(commands <= 1);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testBringUp);
+  RUN(testBlockingCommands);
+  RUN(testIdleIsQuiet);
+  return testFailed != 0;
+}
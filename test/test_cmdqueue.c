@@ -0,0 +1,111 @@
+/*
+ * test_cmdqueue.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Status_t results[8];
+static int resultCount;
+
+
+static void onDone(SIM_HandlerTypeDef *h, SIM_Status_t status, void *ctx)
+{
+  (void) h;
+  (void) ctx;
+  results[resultCount++] = status;
+}
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 2000);
+  resultCount = 0;
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testInOrder(void)
+{
+  uint8_t csq[16] = {0};
+
+  setUp();
+  CHECK_EQ(SIM_SendCMDAsync(&hsim, "+CSQ", 4, csq, sizeof(csq) - 1, 0, onDone, NULL, "AT+CSQ"), SIM_OK);
+  CHECK_EQ(SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT"), SIM_OK);
+  // nothing goes out until the driver is polled
+  CHECK_EQ(sim.commands, 0);
+
+  SIM_CheckAnyResponse(&hsim);
+  // one command on the line at a time
+  CHECK_EQ(sim.commands, 1);
+
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(resultCount, 2);
+  CHECK_EQ(results[0], SIM_OK);
+  CHECK_EQ(results[1], SIM_OK);
+  CHECK(strncmp((char*) csq, "20,99", 5) == 0);
+  Harness_Free();
+}
+
+
+static void testTimeout(void)
+{
+  setUp();
+  // modem answers long after the entry gave up
+  ModemSim_On(&sim, "AT+CGPSINFO", 3000, 1, "\r\nOK\r\n");
+  SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 1000, onDone, NULL, "AT+CGPSINFO");
+  SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT");
+  Harness_Run(&hsim, 1500);
+  CHECK(resultCount >= 1);
+  CHECK_EQ(results[0], SIM_TIMEOUT);
+  Harness_Free();
+}
+
+
+static void testErrorAndFull(void)
+{
+  setUp();
+  CHECK_EQ(SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT+UNKNOWN"), SIM_OK);
+  for (int i = 1; i < SIM_CMD_QUEUE_SIZE; i++)
+    CHECK_EQ(SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT"), SIM_OK);
+  CHECK_EQ(SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT"), SIM_ERROR);
+
+  Harness_Run(&hsim, 200);
+  CHECK_EQ(resultCount, SIM_CMD_QUEUE_SIZE);
+  CHECK_EQ(results[0], SIM_ERROR);
+  CHECK_EQ(results[1], SIM_OK);
+  Harness_Free();
+}
+
+
+static void testBlockingAfterQueued(void)
+{
+  setUp();
+  ModemSim_On(&sim, "AT+CGPSINFO", 200, 1, "\r\n+CGPSINFO: ,,,,,,,,\r\n\r\nOK\r\n");
+  SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, 0, onDone, NULL, "AT+CGPSINFO");
+  SIM_CheckAnyResponse(&hsim);
+
+  // blocking command must not take the queued command's OK
+  sim.csq = 17;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 17);
+  CHECK_EQ(resultCount, 1);
+  CHECK_EQ(results[0], SIM_OK);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testInOrder);
+  RUN(testTimeout);
+  RUN(testErrorAndFull);
+  RUN(testBlockingAfterQueued);
+  return testFailed != 0;
+}
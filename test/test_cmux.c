@@ -0,0 +1,303 @@
+/*
+ * test_cmux.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/cmux.h"
+
+/*
+ * Modem side of 27.010 in front of the simulator. Text passes through
+ * until driver sends the first flag, then DLCI 1 carries the AT port of
+ * the simulator and DLCI 2 carries what the test injects.
+ */
+
+#define FLAG  0xF9
+
+typedef struct {
+  uint8_t   isMuxed;
+  uint8_t   frame[256];
+  uint16_t  frameLen;
+  uint8_t   out[4096];
+  uint32_t  outLen;
+
+  uint32_t  sabm;
+  uint32_t  badFcs;
+  uint32_t  maxInfo;
+  uint8_t   closed;
+  uint8_t   data[256];            // UIH info received on data channel
+  uint32_t  dataLen;
+  uint32_t  dataFrames;
+} MuxPeer_t;
+
+static SIM_HandlerTypeDef hsim;
+static SIM_CMUX_t mux;
+static MuxPeer_t peer;
+
+
+// bitwise 27.010 FCS, independent from the table of the driver
+static uint8_t fcs(const uint8_t *data, uint8_t len)
+{
+  uint8_t crc = 0xFF;
+
+  while (len--) {
+    crc ^= *data++;
+    for (int i = 0; i < 8; i++) crc = (crc & 1)? (crc >> 1) ^ 0xE0: crc >> 1;
+  }
+  return 0xFF - crc;
+}
+
+
+static void peerFrame(uint8_t dlci, uint8_t control, const uint8_t *info, uint16_t len, uint8_t isBad)
+{
+  uint8_t *p = &peer.out[peer.outLen];
+  uint8_t hlen = 4;
+
+  p[0] = FLAG;
+  p[1] = (dlci << 2) | 0x01;
+  p[2] = control;
+  if (len > 127) {
+    p[3] = (len & 0x7F) << 1;
+    p[4] = len >> 7;
+    hlen = 5;
+  }
+  else p[3] = (len << 1) | 0x01;
+  if (len > 0) memcpy(&p[hlen], info, len);
+  p[hlen + len] = fcs(&p[1], hlen - 1) ^ isBad;
+  p[hlen + len + 1] = FLAG;
+  peer.outLen += hlen + 2 + len;
+}
+
+
+static void peerHandleFrame(void)
+{
+  uint8_t dlci = peer.frame[1] >> 2;
+  uint8_t control = peer.frame[2] & ~0x10;
+  uint16_t len = peer.frame[3] >> 1;
+  uint8_t *info = &peer.frame[4];
+
+  if (peer.frame[4 + len] != fcs(&peer.frame[1], 3)) {
+    peer.badFcs++;
+    return;
+  }
+  if (len > peer.maxInfo) peer.maxInfo = len;
+
+  if (control == 0x2F) {
+    peer.sabm++;
+    peerFrame(dlci, 0x73, NULL, 0, 0);
+  }
+  else if (control == 0xEF && dlci == 0 && len > 0 && (info[0] & ~0x02) == 0xC1) {
+    peer.closed = 1;
+    peer.isMuxed = 0;
+  }
+  else if (control == 0xEF && dlci == SIM_CMUX_CH_CONTROL) {
+    ModemSim_Write(&sim, info, len, 0);
+  }
+  else if (control == 0xEF && dlci == SIM_CMUX_CH_DATA) {
+    memcpy(&peer.data[peer.dataLen], info, len);
+    peer.dataLen += len;
+    peer.dataFrames++;
+  }
+}
+
+
+// wrap what the simulator printed into control channel frames
+static void peerPump(uint32_t timeout)
+{
+  uint8_t buf[100];
+  int len;
+
+  if (peer.outLen > 0 || !peer.isMuxed) return;
+  len = ModemSim_Read(&sim, buf, sizeof(buf), timeout);
+  if (len > 0) peerFrame(SIM_CMUX_CH_CONTROL, 0xEF, buf, len, 0);
+}
+
+
+static uint8_t peerIsReadable(void *device)
+{
+  (void) device;
+  if (!peer.isMuxed) return ModemSim_IsReadable(&sim);
+  if (peer.outLen == 0 && ModemSim_IsReadable(&sim)) peerPump(0);
+  return peer.outLen > 0;
+}
+
+
+static int peerRead(void *device, uint8_t *dst, uint16_t sz, uint32_t timeout)
+{
+  uint16_t len;
+
+  (void) device;
+  if (!peer.isMuxed && peer.outLen == 0) return ModemSim_Read(&sim, dst, sz, timeout);
+  peerPump(timeout);
+
+  len = (sz < peer.outLen)? sz: peer.outLen;
+  memcpy(dst, peer.out, len);
+  memmove(peer.out, &peer.out[len], peer.outLen - len);
+  peer.outLen -= len;
+  return len;
+}
+
+
+static int peerWrite(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  (void) device;
+
+  for (uint16_t i = 0; i < sz; i++) {
+    if (!peer.isMuxed) {
+      if (src[i] != FLAG) {
+        ModemSim_Write(&sim, &src[i], 1, timeout);
+        continue;
+      }
+      peer.isMuxed = 1;
+    }
+
+    // opening flag, or closing flag of a complete frame
+    if (src[i] == FLAG && (peer.frameLen < 5 || peer.frameLen >= 5 + (peer.frame[3] >> 1))) {
+      if (peer.frameLen > 1) {
+        peer.frame[peer.frameLen++] = FLAG;
+        peerHandleFrame();
+      }
+      peer.frame[0] = FLAG;
+      peer.frameLen = 1;
+      continue;
+    }
+    if (peer.frameLen < sizeof(peer.frame)) peer.frame[peer.frameLen++] = src[i];
+  }
+  return sz;
+}
+
+
+static int peerWriteline(void *device, const uint8_t *src, uint16_t sz, uint32_t timeout)
+{
+  peerWrite(device, src, sz, timeout);
+  peerWrite(device, (const uint8_t*) "\r\n", 2, timeout);
+  return sz;
+}
+
+
+static void setUp(void)
+{
+  memset(&peer, 0, sizeof(peer));
+  memset(&mux, 0, sizeof(mux));
+  Harness_Init(&hsim);
+  hsim.serial.isReadable  = peerIsReadable;
+  hsim.serial.read        = peerRead;
+  hsim.serial.write       = peerWrite;
+  hsim.serial.writeline   = peerWriteline;
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 100);
+
+  ModemSim_On(&sim, "AT+CMUX=0", 5, 1, "\r\nOK\r\n");
+  CHECK_EQ(SIM_CMUX_Start(&mux, &hsim), SIM_OK);
+}
+
+
+static void testStart(void)
+{
+  setUp();
+  // DLCI 0 and every channel
+  CHECK_EQ(peer.sabm, 1 + SIM_CMUX_NUM_OF_CHANNEL);
+  CHECK(peer.isMuxed);
+
+  // driver talks on control channel
+  sim.csq = 17;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 17);
+  CHECK_EQ(peer.badFcs, 0);
+  Harness_Free();
+}
+
+
+static void testWriteSplitsFrames(void)
+{
+  SIM_Serial_t data;
+  uint8_t buf[100];
+
+  setUp();
+  for (int i = 0; i < (int) sizeof(buf); i++) buf[i] = (uint8_t) i;
+  data = SIM_CMUX_GetSerial(&mux, SIM_CMUX_CH_DATA);
+  CHECK_EQ(data.write(data.device, buf, sizeof(buf), 100), sizeof(buf));
+
+  CHECK_EQ(peer.dataLen, sizeof(buf));
+  CHECK_MEM(peer.data, buf, sizeof(buf));
+  CHECK_EQ(peer.dataFrames, (sizeof(buf) + SIM_CMUX_FRAME_SIZE - 1) / SIM_CMUX_FRAME_SIZE);
+  CHECK(peer.maxInfo <= SIM_CMUX_FRAME_SIZE);
+  Harness_Free();
+}
+
+
+static void testChannelsDemux(void)
+{
+  const char nmea[] = "$GPGSV,3,1,11,10,63,137,17*7F\r\n";
+  SIM_Serial_t gps;
+  char buf[64];
+  int len;
+
+  setUp();
+  gps = SIM_CMUX_GetSerial(&mux, SIM_CMUX_CH_NMEA);
+
+  // corrupted frame is dropped, the valid one after it is kept
+  peerFrame(SIM_CMUX_CH_NMEA, 0xEF, (const uint8_t*) "$BAD\r\n", 6, 0x5A);
+  peerFrame(SIM_CMUX_CH_NMEA, 0xEF, (const uint8_t*) nmea, strlen(nmea), 0);
+
+  // control channel answer while NMEA frames are waiting
+  sim.csq = 9;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 9);
+
+  CHECK(gps.isReadable(gps.device));
+  len = gps.read(gps.device, (uint8_t*) buf, sizeof(buf), 0);
+  CHECK_EQ(len, strlen(nmea));
+  CHECK_MEM(buf, nmea, strlen(nmea));
+  CHECK(!gps.isReadable(gps.device));
+  Harness_Free();
+}
+
+
+static void testLongFrame(void)
+{
+  SIM_Serial_t gps;
+  uint8_t info[SIM_CMUX_MAX_FRAME_SIZE];
+  uint8_t buf[SIM_CMUX_MAX_FRAME_SIZE];
+  int len;
+
+  setUp();
+  gps = SIM_CMUX_GetSerial(&mux, SIM_CMUX_CH_NMEA);
+  for (int i = 0; i < (int) sizeof(info); i++) info[i] = (uint8_t) ('A' + i % 26);
+
+  // over 127 bytes, length takes two octets
+  peerFrame(SIM_CMUX_CH_NMEA, 0xEF, info, sizeof(info), 0);
+  CHECK(gps.isReadable(gps.device));
+  len = gps.read(gps.device, buf, sizeof(buf), 0);
+  CHECK_EQ(len, sizeof(info));
+  CHECK_MEM(buf, info, sizeof(info));
+  Harness_Free();
+}
+
+
+static void testStop(void)
+{
+  setUp();
+  SIM_CMUX_Stop(&mux, &hsim);
+  CHECK(peer.closed);
+  CHECK(hsim.serial.read == peerRead);
+
+  // plain AT again
+  sim.csq = 25;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 25);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testStart);
+  RUN(testWriteSplitsFrames);
+  RUN(testChannelsDemux);
+  RUN(testLongFrame);
+  RUN(testStop);
+  return testFailed != 0;
+}
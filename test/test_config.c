@@ -0,0 +1,151 @@
+/*
+ * test_config.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/gps.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static uint8_t isNetOpen(SIM_HandlerTypeDef *h)
+{
+  return (h->net.status & SIM_NET_STATUS_OPEN) != 0;
+}
+
+
+static uint8_t isSynced(SIM_HandlerTypeDef *h)
+{
+  return (h->net.status & SIM_NET_STATUS_NTP_WAS_SYNCED) != 0;
+}
+
+
+static uint8_t isNetOpenFailed(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return ModemSim_Count(&sim, "AT+NETOPEN") > ModemSim_Count(&sim, "AT+NETOPEN?");
+}
+
+
+// cold start, everything sent and fingerprinted
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 10000));
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  Harness_Run(&hsim, 1000);
+  CHECK(savedConfig[SIM_CONFIG_APN] != 0);
+  CHECK(savedConfig[SIM_CONFIG_NTP] != 0);
+  CHECK(savedConfig[SIM_CONFIG_GPS] != 0);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testWarmStartSkipsConfig(void)
+{
+  setUp();
+
+  // MCU and modem restart together, modem says RDY again
+  Harness_Restart(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK_EQ(SIM_Init(&hsim), SIM_OK);
+  ModemSim_PowerOn(&sim);
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 30000));
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  Harness_Run(&hsim, 1000);
+
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGDCONT"), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CNTP="), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSHOR"), 0);
+  CHECK(isSynced(&hsim));
+  Harness_Free();
+}
+
+
+static void testModemRebootKeepsConfig(void)
+{
+  setUp();
+
+  ModemSim_PowerOn(&sim);
+  Harness_Run(&hsim, 150);
+  CHECK(!isNetOpen(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 30000));
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  Harness_Run(&hsim, 1000);
+
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGDCONT"), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CNTP="), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSHOR"), 0);
+  CHECK(savedConfig[SIM_CONFIG_APN] != 0);
+  CHECK(savedConfig[SIM_CONFIG_NTP] != 0);
+  CHECK(savedConfig[SIM_CONFIG_GPS] != 0);
+  Harness_Free();
+}
+
+
+static void testSyncFailureSendsServer(void)
+{
+  setUp();
+
+  ModemSim_PowerOn(&sim);
+  ModemSim_On(&sim, "AT+CNTP", 0, 1, "\r\nOK\r\n\r\n+CNTP: 1\r\n");
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 30000));
+  Harness_Run(&hsim, 1000);
+  CHECK(!isSynced(&hsim));
+  CHECK_EQ(savedConfig[SIM_CONFIG_NTP], 0);
+
+  CHECK(Harness_RunUntil(&hsim, isSynced, 2 * hsim.NTP.config.retryInterval));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CNTP="), 1);
+  CHECK(savedConfig[SIM_CONFIG_NTP] != 0);
+  Harness_Free();
+}
+
+
+static void testRefusedStartSendsGPS(void)
+{
+  setUp();
+
+  ModemSim_On(&sim, "AT+CGPS=1", 0, 1, "\r\nERROR\r\n");
+  CHECK_EQ(SIM_GPS_Activate(&hsim, SIM_GPS_MODE_STANDALONE), SIM_ERROR);
+  CHECK_EQ(savedConfig[SIM_CONFIG_GPS], 0);
+  CHECK_EQ(SIM_GPS_DefaultSetup(&hsim), SIM_OK);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGPSHOR"), 1);
+  CHECK(savedConfig[SIM_CONFIG_GPS] != 0);
+  Harness_Free();
+}
+
+
+static void testOpenFailureSendsAPN(void)
+{
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  sim.netOpenErr = 1;
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isNetOpenFailed, 10000));
+  Harness_Run(&hsim, 1000);
+  CHECK_EQ(savedConfig[SIM_CONFIG_APN], 0);
+
+  ModemSim_ClearLog(&sim);
+  sim.netOpenErr = 0;
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 2 * SIM_NET_RETRY_INTERVAL));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGDCONT"), 1);
+  CHECK(savedConfig[SIM_CONFIG_APN] != 0);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testWarmStartSkipsConfig);
+  RUN(testModemRebootKeepsConfig);
+  RUN(testSyncFailureSendsServer);
+  RUN(testRefusedStartSendsGPS);
+  RUN(testOpenFailureSendsAPN);
+  return testFailed != 0;
+}
@@ -0,0 +1,166 @@
+/*
+ * test_cops.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+// AT+COPS=? queued and sent
+static uint8_t isScanning(SIM_HandlerTypeDef *h)
+{
+  return h->cops.isScanning && h->cmdQueue.isSent;
+}
+
+
+static uint8_t isScanDone(SIM_HandlerTypeDef *h)
+{
+  return !h->cops.isScanning;
+}
+
+
+// modem boots without network, driver starts a scan
+static void setUp(uint32_t scanDelay)
+{
+  Harness_Init(&hsim);
+  sim.delay.scan = scanDelay;
+  sim.creg = 0;
+  sim.cgreg = 0;
+  CHECK_EQ(SIM_Init(&hsim), SIM_OK);
+  ModemSim_PowerOn(&sim);
+  CHECK(Harness_RunUntil(&hsim, isScanning, 10000));
+}
+
+
+static void testBlockingFailsFast(void)
+{
+  uint32_t tick;
+
+  setUp(30000);
+  tick = ModemSim_Tick();
+  CHECK(!SIM_CheckSignal(&hsim));
+  CHECK(ModemSim_Tick() - tick < 100);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CSQ"), 0);
+  CHECK(hsim.cops.isScanning);
+
+  // works again once the scan is done
+  Harness_Run(&hsim, sim.delay.scan);
+  CHECK(!hsim.cops.isScanning);
+  CHECK(SIM_CheckSignal(&hsim));
+  Harness_Free();
+}
+
+
+static void testLoopIdlesDuringScan(void)
+{
+  uint32_t passes;
+
+  // scan outlasts the registration retry of bring-up
+  setUp(3 * SIM_REG_POLL_INTERVAL);
+  passes = harnessPasses;
+  Harness_Run(&hsim, 2 * SIM_REG_POLL_INTERVAL);
+  // one pass per idle step, not one per ms
+  CHECK(harnessPasses - passes < 100);
+  CHECK(hsim.cops.isScanning);
+  Harness_Free();
+}
+
+
+static void testResultIsCached(void)
+{
+  const SIM_Operator_t *ops;
+  uint8_t count = 0;
+
+  setUp(30000);
+  ModemSim_SetReg(&sim, 1);
+  CHECK(Harness_RunUntil(&hsim, isScanDone, sim.delay.scan + 5000));
+  CHECK(hsim.status & SIM_STATUS_REGISTERED);
+
+  ops = SIM_GetOperators(&hsim, &count);
+  CHECK(ops != NULL);
+  CHECK_EQ(count, 3);
+  if (ops != NULL) {
+    CHECK(strcmp(ops[0].numeric, "46000") == 0);
+    CHECK_EQ(ops[0].stat, 2);
+    CHECK_EQ(ops[2].stat, 3);
+  }
+
+  // registration lost again, fresh result is reused
+  ModemSim_SetReg(&sim, 0);
+  Harness_Run(&hsim, 2 * SIM_REG_POLL_INTERVAL);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+COPS=?"), 1);
+  CHECK(!hsim.cops.isScanning);
+  Harness_Free();
+}
+
+
+// AT+COPS=0 sent from queue, no scan behind it
+static uint8_t isSelecting(SIM_HandlerTypeDef *h)
+{
+  return SIM_CmdQueueIsBusy(h) && !h->cops.isScanning;
+}
+
+
+static void testLoopIdlesDuringSelection(void)
+{
+  uint32_t passes;
+
+  Harness_Init(&hsim);
+  sim.creg = 0;
+  sim.cgreg = 0;
+  ModemSim_On(&sim, "AT+COPS?", 0, 1, "\r\n+COPS: 1\r\n\r\nOK\r\n");
+  ModemSim_On(&sim, "AT+COPS=0", 3 * SIM_REG_POLL_INTERVAL, 1, "\r\nOK\r\n");
+  CHECK_EQ(SIM_Init(&hsim), SIM_OK);
+  // fresh scan result, only the selection is queued
+  hsim.cops.scanTick = ModemSim_Tick();
+  ModemSim_PowerOn(&sim);
+  CHECK(Harness_RunUntil(&hsim, isSelecting, 10000));
+
+  ModemSim_ClearLog(&sim);
+  passes = harnessPasses;
+  Harness_Run(&hsim, 2 * SIM_REG_POLL_INTERVAL);
+  CHECK(harnessPasses - passes < 100);
+  CHECK_EQ(ModemSim_Count(&sim, "AT"), 0);
+  CHECK(isSelecting(&hsim));
+
+  // registration polled again once it is done
+  ModemSim_SetReg(&sim, 1);
+  Harness_Run(&hsim, 2 * SIM_REG_POLL_INTERVAL);
+  CHECK(!SIM_CmdQueueIsBusy(&hsim));
+  CHECK(hsim.status & SIM_STATUS_REGISTERED);
+  Harness_Free();
+}
+
+
+static void testLastGoodOnlyWhenPinned(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+COPS?"), 0);
+  CHECK_EQ(hsim.cops.lastGood[0], 0);
+  Harness_Free();
+
+  Harness_Init(&hsim);
+  hsim.cops.config.pinLastGood = 1;
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+COPS?"), 1);
+  CHECK(strcmp(hsim.cops.lastGood, sim.operator) == 0);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testBlockingFailsFast);
+  RUN(testLoopIdlesDuringScan);
+  RUN(testResultIsCached);
+  RUN(testLoopIdlesDuringSelection);
+  RUN(testLastGoodOnlyWhenPinned);
+  return testFailed != 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * test_dns.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+#include <stdio.h>
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+static char openByIP[96];
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  (void) data;
+  (void) len;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static uint32_t opens(const char *host)
+{
+  char prefix[96];
+
+  sprintf(prefix, "AT+CIPOPEN=0,\"TCP\",\"%s\",80", host);
+  return ModemSim_Count(&sim, prefix);
+}
+
+
+static void reopen(void)
+{
+  ModemSim_PeerClose(&sim, sock.linkNum);
+  Harness_Run(&hsim, 100);
+  CHECK(!isSockOpen(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 60000));
+}
+
+
+static void setUp(uint8_t isDNSFailing)
+{
+  memset(&sock, 0, sizeof(sock));
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sim.dnsFail = isDNSFailing;
+  sock.config.autoReconnect = 1;
+  sock.config.reconnectingDelay = 1000;
+  sock.listeners.onData = onData;
+  CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  sprintf(openByIP, "%s", hsim.net.dns[0].ip);
+}
+
+
+static void testReconnectByIP(void)
+{
+  setUp(0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CDNSGIP=\"example.com\""), 1);
+  CHECK(strncmp(openByIP, "10.0.", 5) == 0);
+  CHECK_EQ(opens(openByIP), 1);
+  CHECK_EQ(opens("example.com"), 0);
+
+  // no lookup on the way back
+  ModemSim_ClearLog(&sim);
+  reopen();
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CDNSGIP"), 0);
+  CHECK_EQ(opens(openByIP), 1);
+  Harness_Free();
+}
+
+
+static void testRefreshBeforeExpiry(void)
+{
+  uint32_t expireTick;
+
+  setUp(0);
+  expireTick = hsim.net.dns[0].expireTick;
+  ModemSim_ClearLog(&sim);
+
+  Harness_Run(&hsim, SIM_SOCK_DNS_TTL - SIM_SOCK_DNS_REFRESH + 5000);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CDNSGIP=\"example.com\""), 1);
+  CHECK((int32_t)(hsim.net.dns[0].expireTick - expireTick) > 0);
+  CHECK(isSockOpen(&hsim));
+
+  // entry still fresh at the old expiry
+  Harness_Run(&hsim, SIM_SOCK_DNS_REFRESH);
+  ModemSim_ClearLog(&sim);
+  reopen();
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CDNSGIP"), 0);
+  CHECK_EQ(opens(openByIP), 1);
+  Harness_Free();
+}
+
+
+static void testFallbackToHost(void)
+{
+  setUp(1);
+  CHECK_EQ(opens("example.com"), 1);
+  CHECK_EQ(hsim.net.dns[0].host[0], 0);
+  Harness_Free();
+}
+
+
+static void testFailedRefreshKeepsIP(void)
+{
+  setUp(0);
+  sim.dnsFail = 1;
+
+  // served until expired while resolving fails
+  Harness_Run(&hsim, SIM_SOCK_DNS_TTL - SIM_SOCK_DNS_REFRESH + 5000);
+  CHECK(ModemSim_Count(&sim, "AT+CDNSGIP") >= 2);
+  ModemSim_ClearLog(&sim);
+  reopen();
+  CHECK_EQ(opens(openByIP), 1);
+
+  Harness_Run(&hsim, SIM_SOCK_DNS_REFRESH);
+  ModemSim_ClearLog(&sim);
+  reopen();
+  CHECK_EQ(opens("example.com"), 1);
+  Harness_Free();
+}
+
+
+static void testConnectErrorResolvesAgain(void)
+{
+  setUp(0);
+  ModemSim_On(&sim, "AT+CIPOPEN", 0, 1, "\r\nOK\r\n\r\n+CIPOPEN: 0,4\r\n");
+  ModemSim_ClearLog(&sim);
+
+  // address may have moved
+  reopen();
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CDNSGIP=\"example.com\""), 1);
+  CHECK_EQ(opens(openByIP), 2);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testReconnectByIP);
+  RUN(testRefreshBeforeExpiry);
+  RUN(testFallbackToHost);
+  RUN(testFailedRefreshKeepsIP);
+  RUN(testConnectErrorResolvesAgain);
+  return testFailed != 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * test_framer.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK_EQ(SIM_Init(&hsim), SIM_OK);
+}
+
+
+static void emit(uint32_t delay, const char *str)
+{
+  ModemSim_Emit(&sim, delay, (const uint8_t*) str, strlen(str));
+}
+
+
+static uint8_t readIs(uint32_t timeout, const char *line)
+{
+  uint16_t len = SIM_ReadLine(&hsim, timeout);
+  return len == strlen(line) && memcmp(hsim.respBuffer, line, len) == 0;
+}
+
+
+static void testSplitLine(void)
+{
+  setUp();
+  emit(0, "\r\n+CS");
+  emit(20, "Q: 1");
+  emit(40, "2,99\r\n\r\nOK\r\n");
+
+  CHECK(readIs(1000, "\r\n"));
+  CHECK(readIs(1000, "+CSQ: 12,99\r\n"));
+  CHECK(readIs(1000, "\r\n"));
+  CHECK(readIs(1000, "OK\r\n"));
+  // nothing left, waits the whole timeout
+  CHECK_EQ(SIM_ReadLine(&hsim, 100), 0);
+  Harness_Free();
+}
+
+
+static void testPromptAndData(void)
+{
+  uint8_t data[8];
+
+  setUp();
+  emit(0, "\r\n> ");
+  CHECK(readIs(1000, "\r\n"));
+  CHECK(readIs(1000, "> "));
+
+  // payload may hold line ends, it is taken by length
+  emit(0, "\r\n+RECEIVE,0,6\r\nab\ncd\n\r\nOK\r\n");
+  CHECK(readIs(1000, "\r\n"));
+  CHECK(readIs(1000, "+RECEIVE,0,6\r\n"));
+  CHECK_EQ(SIM_GetData(&hsim, data, 6, 1000), 6);
+  CHECK_MEM(data, "ab\ncd\n", 6);
+  CHECK(readIs(1000, "\r\n"));
+  CHECK(readIs(1000, "OK\r\n"));
+  Harness_Free();
+}
+
+
+static void testWrapAround(void)
+{
+  char line[32];
+  int i;
+
+  setUp();
+  // several times the ring size, read while it arrives
+  for (i = 0; i < 200; i++) {
+    snprintf(line, sizeof(line), "+LINE: %03d\r\n", i);
+    emit(i, line);
+  }
+  for (i = 0; i < 200; i++) {
+    snprintf(line, sizeof(line), "+LINE: %03d\r\n", i);
+    if (!readIs(1000, line)) break;
+  }
+  CHECK_EQ(i, 200);
+  Harness_Free();
+}
+
+
+static void testLongLine(void)
+{
+  char line[SIM_RESP_BUFFER_SIZE + 100];
+
+  setUp();
+  memset(line, 'x', sizeof(line));
+  line[sizeof(line) - 3] = '\r';
+  line[sizeof(line) - 2] = '\n';
+  line[sizeof(line) - 1] = 0;
+  emit(0, line);
+  emit(0, "OK\r\n");
+
+  // truncated to the response buffer, rest of it dropped
+  CHECK_EQ(SIM_ReadLine(&hsim, 1000), SIM_RESP_BUFFER_SIZE - 1);
+  CHECK(readIs(1000, "OK\r\n"));
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testSplitLine);
+  RUN(testPromptAndData);
+  RUN(testWrapAround);
+  RUN(testLongLine);
+  return testFailed != 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * test_handles.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+
+/*
+ * Two modems driven from one process, parse scratch lives in each handle
+ * so results must not leak between them
+ */
+
+static SIM_HandlerTypeDef hsimA;
+static SIM_HandlerTypeDef hsimB;
+static ModemSim_t simB;
+
+
+static uint8_t isReady(SIM_HandlerTypeDef *hsim)
+{
+  return hsim->bringUp.state == SIM_STATE_READY && (hsim->status & SIM_STATUS_REGISTERED);
+}
+
+
+static void testTwoHandles(void)
+{
+  Harness_Init(&hsimA);
+  hsimB = hsimA;
+  ModemSim_Init(&simB);
+  hsimB.serial.device = &simB;
+
+  CHECK_EQ(SIM_Init(&hsimA), SIM_OK);
+  CHECK_EQ(SIM_Init(&hsimB), SIM_OK);
+  ModemSim_PowerOn(&sim);
+  ModemSim_PowerOn(&simB);
+
+  for (int i = 0; i < 2000 && !(isReady(&hsimA) && isReady(&hsimB)); i++) {
+    SIM_CheckAnyResponse(&hsimA);
+    SIM_CheckAnyResponse(&hsimB);
+    ModemSim_Delay(10);
+  }
+  CHECK(isReady(&hsimA));
+  CHECK(isReady(&hsimB));
+
+  sim.csq = 11;
+  simB.csq = 27;
+  for (int i = 0; i < 3; i++) {
+    CHECK(SIM_CheckSignal(&hsimA));
+    CHECK(SIM_CheckSignal(&hsimB));
+    CHECK_EQ(hsimA.signal, 11);
+    CHECK_EQ(hsimB.signal, 27);
+  }
+
+  ModemSim_Free(&simB);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testTwoHandles);
+  return testFailed != 0;
+}
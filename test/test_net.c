@@ -0,0 +1,83 @@
+/*
+ * test_net.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+
+#define DAY   (24UL * 3600 * 1000)
+
+static SIM_HandlerTypeDef hsim;
+
+
+// AT+NETOPEN without the AT+NETOPEN? queries
+static uint32_t netOpens(void)
+{
+  return ModemSim_Count(&sim, "AT+NETOPEN") - ModemSim_Count(&sim, "AT+NETOPEN?");
+}
+
+
+static uint8_t isNetOpen(SIM_HandlerTypeDef *h)
+{
+  return (h->net.status & SIM_NET_STATUS_OPEN) != 0;
+}
+
+
+static uint8_t isNetOpenFailed(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return netOpens() >= 1 && !sim.netOpen;
+}
+
+
+static void testRetryAfterLongUptime(void)
+{
+  Harness_Init(&hsim);
+  // first NETOPEN fails so a retry deadline was used once
+  sim.netOpenErr = 1;
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isNetOpenFailed, 10000));
+  sim.netOpenErr = 0;
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 2 * SIM_NET_RETRY_INTERVAL));
+
+  // idle past half the tick range, old deadline would read as future
+  sim.gpsOn = 0;
+  Harness_Run(&hsim, 2000);
+  ModemSim_Delay(25 * DAY);
+  Harness_Run(&hsim, 1000);
+  CHECK(isNetOpen(&hsim));
+
+  ModemSim_ClearLog(&sim);
+  ModemSim_NetDrop(&sim);
+  Harness_Run(&hsim, 10);
+  CHECK(!isNetOpen(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isNetOpen, 2 * SIM_NET_RETRY_INTERVAL));
+  CHECK_EQ(netOpens(), 1);
+  Harness_Free();
+}
+
+
+static void testOpenRetryInterval(void)
+{
+  Harness_Init(&hsim);
+  sim.netOpenErr = 1;
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 3 * SIM_NET_RETRY_INTERVAL + 1000);
+
+  // failed open is retried once per interval, not on every pass
+  CHECK(netOpens() >= 3);
+  CHECK(netOpens() <= 5);
+  CHECK(!isNetOpen(&hsim));
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testRetryAfterLongUptime);
+  RUN(testOpenRetryInterval);
+  return testFailed != 0;
+}
@@ -0,0 +1,135 @@
+/*
+ * test_pending.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/utils.h"
+
+#define DAY   (24UL * 3600 * 1000)
+
+static SIM_HandlerTypeDef hsim;
+
+
+static uint8_t isSynced(SIM_HandlerTypeDef *h)
+{
+  return (h->net.status & SIM_NET_STATUS_NTP_WAS_SYNCED) != 0;
+}
+
+
+static uint8_t isReady(SIM_HandlerTypeDef *h)
+{
+  return h->bringUp.state == SIM_STATE_READY;
+}
+
+
+static uint8_t isLocked;
+static uint8_t bitsAtLock;
+static uint8_t bitsAtUnlock;
+static uint32_t locks;
+
+
+static void lock(SIM_HandlerTypeDef *h)
+{
+  if (locks++ == 0) bitsAtLock = h->pending.bits;
+  isLocked = 1;
+}
+
+
+static void unlock(SIM_HandlerTypeDef *h)
+{
+  if (locks == 1) bitsAtUnlock = h->pending.bits;
+  isLocked = 0;
+}
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isSynced, 20000));
+  sim.gpsOn = 0;
+  Harness_Run(&hsim, 2000);
+  ModemSim_ClearLog(&sim);
+  harnessPasses = 0;
+}
+
+
+static void testIdleSendsOnlyHealthPoll(void)
+{
+  setUp();
+  Harness_Run(&hsim, 5 * SIM_HEALTH_INTERVAL);
+
+  // nothing but the periodic batch, idle passes only as long as the
+  // harness clock step
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CSQ;+CREG?"), 5);
+  CHECK_EQ(ModemSim_Count(&sim, "AT"), 5);
+  CHECK(harnessPasses < 5 * SIM_HEALTH_INTERVAL / 1000 + 50);
+  Harness_Free();
+}
+
+
+static void testHealthAfterLongOutage(void)
+{
+  setUp();
+  ModemSim_SetReg(&sim, 0);
+  Harness_Run(&hsim, 100);
+  CHECK(!isReady(&hsim));
+
+  // out of coverage past half the tick range, deadlines from before are stale
+  ModemSim_Delay(25 * DAY);
+  ModemSim_ClearLog(&sim);
+  ModemSim_SetReg(&sim, 1);
+  CHECK(Harness_RunUntil(&hsim, isReady, 1000));
+  Harness_Run(&hsim, 1000);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CSQ;+CREG?"), 1);
+  Harness_Free();
+}
+
+
+static void testBringUpAfterModemLost(void)
+{
+  setUp();
+  ModemSim_Delay(25 * DAY);
+  Harness_Run(&hsim, 100);
+
+  // command of the application finds modem gone
+  ModemSim_On(&sim, "AT", hsim.timeout + 1000, 1, "\r\nOK\r\n");
+  CHECK(!SIM_CheckAT(&hsim));
+  ModemSim_ClearLog(&sim);
+  Harness_Run(&hsim, 5000);
+  CHECK(isReady(&hsim));
+  CHECK(ModemSim_Count(&sim, "AT+CPIN?") >= 1);
+  Harness_Free();
+}
+
+
+static void testMarksTakenUnderLock(void)
+{
+  setUp();
+  hsim.mutexLock = lock;
+  hsim.mutexUnlock = unlock;
+  locks = 0;
+
+  // another task marked net pending, snapshot and clear in one critical section
+  SIM_SetPending(&hsim, SIM_SUBSYS_NET);
+  SIM_HandleEvents(&hsim);
+  CHECK(locks >= 1);
+  CHECK(bitsAtLock & (1 << SIM_SUBSYS_NET));
+  CHECK(!(bitsAtUnlock & (1 << SIM_SUBSYS_NET)));
+  CHECK(!isLocked);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testIdleSendsOnlyHealthPoll);
+  RUN(testHealthAfterLongOutage);
+  RUN(testBringUpAfterModemLost);
+  RUN(testMarksTakenUnderLock);
+  return testFailed != 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * test_registration.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static uint8_t isRegistered(SIM_HandlerTypeDef *h)
+{
+  return (h->status & SIM_STATUS_REGISTERED) != 0;
+}
+
+
+static uint8_t isGprsRegistered(SIM_HandlerTypeDef *h)
+{
+  return (h->net.status & SIM_NET_STATUS_GPRS_REGISTERED) != 0;
+}
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  CHECK(Harness_RunUntil(&hsim, isGprsRegistered, 10000));
+  Harness_Run(&hsim, 1000);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testURCTracksRegistration(void)
+{
+  setUp();
+
+  ModemSim_SetReg(&sim, 0);
+  Harness_Run(&hsim, 100);
+  CHECK(!isRegistered(&hsim));
+  CHECK(!isGprsRegistered(&hsim));
+
+  ModemSim_SetReg(&sim, 5);
+  Harness_Run(&hsim, 100);
+  CHECK(isRegistered(&hsim));
+  CHECK(hsim.status & SIM_STATUS_ROAMING);
+  CHECK(hsim.net.status & SIM_NET_STATUS_GPRS_ROAMING);
+
+  // serving cell comes with the URC
+  ModemSim_URC(&sim, 0, "+CREG: 1,\"00FF\",\"10\"");
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(hsim.cell.lac, 0xFF);
+  CHECK_EQ(hsim.cell.ci, 0x10);
+  CHECK(!(hsim.status & SIM_STATUS_ROAMING));
+
+  // state came without asking
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CREG?"), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CGREG?"), 0);
+  Harness_Free();
+}
+
+
+static void testPollFallback(void)
+{
+  setUp();
+
+  // modem stops reporting, driver finds out by polling
+  sim.regReport = 0;
+  ModemSim_SetReg(&sim, 0);
+  Harness_Run(&hsim, SIM_HEALTH_INTERVAL + 1000);
+  CHECK(!isRegistered(&hsim));
+
+  ModemSim_SetReg(&sim, 1);
+  CHECK(Harness_RunUntil(&hsim, isRegistered, SIM_REG_POLL_INTERVAL + 1000));
+  CHECK(ModemSim_Count(&sim, "AT+CREG?") >= 1);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testURCTracksRegistration);
+  RUN(testPollFallback);
+  return testFailed != 0;
+}
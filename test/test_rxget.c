@@ -0,0 +1,140 @@
+/*
+ * test_rxget.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+#define BURST 8000
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+
+static uint8_t received[BURST];
+static uint32_t receivedLen;
+static uint16_t space;
+static uint32_t sinceSpace;         // delivered since space was last asked
+static uint32_t overruns;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+  sinceSpace += len;
+  if (sinceSpace > space) overruns++;
+}
+
+
+static uint16_t getRxSpace(void)
+{
+  sinceSpace = 0;
+  return space;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static uint32_t reads(void)
+{
+  return ModemSim_Count(&sim, "AT+CIPRXGET=2,");
+}
+
+
+static void setUp(uint8_t isLimited)
+{
+  memset(&sock, 0, sizeof(sock));
+  receivedLen = 0;
+  sinceSpace = 0;
+  overruns = 0;
+  space = SIM_SOCK_RXGET_MAX;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.config.autoReconnect = 1;
+  sock.listeners.onData = onData;
+  if (isLimited) sock.listeners.getRxSpace = getRxSpace;
+  CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(sim.manualRx, 1);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void fillBurst(uint8_t *burst)
+{
+  for (int i = 0; i < BURST; i++) burst[i] = (uint8_t) (i * 13 + (i >> 8));
+}
+
+
+static void testBurstWaitsForSpace(void)
+{
+  static uint8_t burst[BURST];
+
+  setUp(1);
+  fillBurst(burst);
+
+  // application is full, modem keeps the burst
+  space = 0;
+  ModemSim_PeerSend(&sim, sock.linkNum, burst, BURST);
+  Harness_Run(&hsim, 500);
+  CHECK_EQ(receivedLen, 0);
+  CHECK_EQ(reads(), 0);
+  CHECK_EQ(sim.links[sock.linkNum].rxLen, BURST);
+
+  space = 256;
+  Harness_Run(&hsim, 2000);
+  CHECK_EQ(receivedLen, BURST);
+  CHECK_MEM(received, burst, BURST);
+  CHECK_EQ(overruns, 0);
+  CHECK_EQ(sim.links[sock.linkNum].rxLen, 0);
+  Harness_Free();
+}
+
+
+static void testReadSizeGrows(void)
+{
+  static uint8_t burst[BURST];
+
+  setUp(0);
+  fillBurst(burst);
+  ModemSim_PeerSend(&sim, sock.linkNum, burst, BURST);
+  Harness_Run(&hsim, 2000);
+
+  CHECK_EQ(receivedLen, BURST);
+  CHECK_MEM(received, burst, BURST);
+  // 64, 128 .. 1024, then 1500 per read, last short one halves it
+  CHECK(reads() <= 10);
+  CHECK_EQ(sock.rx.readSize, SIM_SOCK_RXGET_MAX / 2);
+
+  // small messages bring it back down
+  for (int i = 0; i < 6; i++) {
+    ModemSim_PeerSend(&sim, sock.linkNum, burst, 10);
+    Harness_Run(&hsim, 100);
+  }
+  CHECK_EQ(receivedLen, BURST + 60);
+  CHECK_EQ(sock.rx.readSize, SIM_SOCK_RXGET_MIN);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testBurstWaitsForSpace);
+  RUN(testReadSizeGrows);
+  return testFailed != 0;
+}
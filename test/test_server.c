@@ -0,0 +1,189 @@
+/*
+ * test_server.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Server_t server;
+static SIM_Socket_t clients[3];
+static uint8_t txBuffers[3][256];
+static uint8_t clientCount;
+static uint8_t isRejecting;
+
+static char acceptedHost[40];
+static uint16_t acceptedPort;
+static uint8_t received[64];
+static uint32_t receivedLen;
+static uint32_t closed;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+}
+
+
+static void onClosed(void)
+{
+  closed++;
+}
+
+
+static SIM_Socket_t* onAccept(const char *host, uint16_t port)
+{
+  SIM_Socket_t *sock;
+
+  strcpy(acceptedHost, host);
+  acceptedPort = port;
+  if (isRejecting || clientCount >= 3) return NULL;
+
+  sock = &clients[clientCount];
+  SIM_SOCK_SetTxBuffer(sock, txBuffers[clientCount], sizeof(txBuffers[0]));
+  clientCount++;
+  sock->listeners.onData = onData;
+  sock->listeners.onClosed = onClosed;
+  return sock;
+}
+
+
+static uint8_t isListening(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return server.state == SIM_SERVER_STATE_LISTENING;
+}
+
+
+static void setUp(void)
+{
+  memset(&server, 0, sizeof(server));
+  memset(clients, 0, sizeof(clients));
+  clientCount = 0;
+  isRejecting = 0;
+  acceptedHost[0] = 0;
+  acceptedPort = 0;
+  receivedLen = 0;
+  closed = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  SIM_SERVER_Init(&server, 8080);
+  server.listeners.onAccept = onAccept;
+  CHECK_EQ(SIM_SERVER_Start(&server, &hsim), SIM_OK);
+  CHECK(Harness_RunUntil(&hsim, isListening, 20000));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+SERVERSTART=8080,0"), 1);
+  CHECK(sim.servers[0]);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testAcceptClient(void)
+{
+  SIM_Socket_t *client = &clients[0];
+
+  setUp();
+  ModemSim_ClientConnect(&sim, 3, 0, "10.9.8.7:40000");
+  Harness_Run(&hsim, 100);
+
+  CHECK_EQ(clientCount, 1);
+  CHECK(strcmp(acceptedHost, "10.9.8.7") == 0);
+  CHECK_EQ(acceptedPort, 40000);
+  CHECK(SIM_SOCK_IS_STATE(client, SIM_SOCK_STATE_OPEN));
+  CHECK_EQ(client->linkNum, 3);
+  CHECK(hsim.net.sockets[3] == (void*) client);
+
+  // same RX and TX path as an outbound socket
+  ModemSim_PeerSend(&sim, 3, (const uint8_t*) "hello", 5);
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, 5);
+  CHECK_MEM(received, "hello", 5);
+
+  CHECK_EQ(SIM_SOCK_Write(client, (const uint8_t*) "world", 5), 5);
+  Harness_Run(&hsim, 500);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND=3,5"), 1);
+  CHECK_EQ(sim.links[3].txLen, 5);
+  CHECK_MEM(sim.links[3].tx, "world", 5);
+
+  // no reconnect to the client after it leaves
+  ModemSim_PeerClose(&sim, 3);
+  Harness_Run(&hsim, 10000);
+  CHECK_EQ(closed, 1);
+  CHECK(SIM_SOCK_IS_STATE(client, SIM_SOCK_STATE_CLOSED));
+  CHECK(hsim.net.sockets[3] == NULL);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN"), 0);
+  Harness_Free();
+}
+
+
+static void testRejectClient(void)
+{
+  setUp();
+  isRejecting = 1;
+  ModemSim_ClientConnect(&sim, 2, 0, "10.9.8.7:40001");
+  Harness_Run(&hsim, 100);
+
+  CHECK_EQ(acceptedPort, 40001);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPCLOSE=2"), 1);
+  CHECK(hsim.net.sockets[2] == NULL);
+  CHECK(server.state == SIM_SERVER_STATE_LISTENING);
+  Harness_Free();
+}
+
+
+static void testBacklogFull(void)
+{
+  setUp();
+  // all reported before the event handler runs
+  ModemSim_ClientConnect(&sim, 1, 0, "10.9.8.7:40001");
+  ModemSim_ClientConnect(&sim, 2, 0, "10.9.8.7:40002");
+  ModemSim_ClientConnect(&sim, 3, 0, "10.9.8.7:40003");
+  Harness_Run(&hsim, 100);
+
+  CHECK_EQ(clientCount, SIM_SERVER_BACKLOG);
+  CHECK(hsim.net.sockets[1] == (void*) &clients[0]);
+  CHECK(hsim.net.sockets[2] == (void*) &clients[1]);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPCLOSE=3"), 1);
+  CHECK(hsim.net.sockets[3] == NULL);
+  Harness_Free();
+}
+
+
+static void testListenAfterNetDrop(void)
+{
+  setUp();
+  ModemSim_NetDrop(&sim);
+  CHECK(!sim.servers[0]);
+
+  // listening again once net is back
+  Harness_Run(&hsim, 30000);
+  CHECK(SIM_NET_IS_STATUS(&hsim, SIM_NET_STATUS_OPEN));
+  CHECK(isListening(&hsim));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+SERVERSTART=8080,0"), 1);
+  CHECK(sim.servers[0]);
+
+  ModemSim_ClientConnect(&sim, 0, 0, "10.9.8.7:40004");
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(clientCount, 1);
+  CHECK(SIM_SOCK_IS_STATE(&clients[0], SIM_SOCK_STATE_OPEN));
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testAcceptClient);
+  RUN(testRejectClient);
+  RUN(testBacklogFull);
+  RUN(testListenAfterNetDrop);
+  return testFailed != 0;
+}
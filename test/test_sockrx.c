@@ -0,0 +1,128 @@
+/*
+ * test_sockrx.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+
+static uint8_t received[4096];
+static uint32_t receivedLen;
+static uint32_t spans;
+static uint32_t spansOutsideRing;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (data < hsim.rxBuffer || data + len > hsim.rxBuffer + SIM_RX_BUFFER_SIZE)
+    spansOutsideRing++;
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+  spans++;
+}
+
+
+// second copy, out of the socket buffer
+static void onReceived(Buffer_t *buffer)
+{
+  uint16_t len;
+
+  while ((len = Buffer_Read(buffer, &received[receivedLen % sizeof(received)], 64)) > 0)
+    receivedLen += len;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static void setUp(void)
+{
+  memset(&sock, 0, sizeof(sock));
+  receivedLen = 0;
+  spans = 0;
+  spansOutsideRing = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.listeners.onData = onData;
+  sock.config.autoReconnect = 1;
+  CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  // net may not be open yet, reconnect takes over
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+}
+
+
+static void testDataFromRing(void)
+{
+  uint8_t payload[3000];
+
+  setUp();
+  // longer than the RX ring, and looks like responses inside
+  for (int i = 0; i < (int) sizeof(payload); i++) payload[i] = (uint8_t) (i * 7);
+  memcpy(&payload[100], "\r\nOK\r\n", 6);
+  ModemSim_PeerSend(&sim, sock.linkNum, payload, sizeof(payload));
+  Harness_Run(&hsim, 100);
+
+  CHECK_EQ(receivedLen, sizeof(payload));
+  CHECK_MEM(received, payload, sizeof(payload));
+  CHECK(spans >= sizeof(payload) / SIM_RX_BUFFER_SIZE);
+  CHECK_EQ(spansOutsideRing, 0);
+
+  // AT stream still in step after the payload
+  sim.csq = 14;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 14);
+  Harness_Free();
+}
+
+
+static void testBufferChunks(void)
+{
+  static uint8_t buffer[256];
+  uint8_t payload[1024];
+
+  setUp();
+  sock.listeners.onData = NULL;
+  sock.listeners.onReceived = onReceived;
+  SIM_SOCK_SetBuffer(&sock, buffer, sizeof(buffer));
+
+  // ring holds one byte less than its size, nothing may be dropped
+  for (int i = 0; i < (int) sizeof(payload); i++) payload[i] = (uint8_t) (i * 7);
+  ModemSim_PeerSend(&sim, sock.linkNum, payload, sizeof(payload));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, sizeof(payload));
+  CHECK_MEM(received, payload, sizeof(payload));
+  Harness_Free();
+}
+
+
+static void testNeedsBufferOrSink(void)
+{
+  SIM_Socket_t bare;
+
+  memset(&bare, 0, sizeof(bare));
+  CHECK_EQ(SIM_SOCK_Init(&bare, "example.com", 80), SIM_ERROR);
+}
+
+
+int main(void)
+{
+  RUN(testDataFromRing);
+  RUN(testBufferChunks);
+  RUN(testNeedsBufferOrSink);
+  return testFailed != 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * test_socktx.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+static uint8_t rxBuffer[256];
+static uint8_t txBuffer[1024];
+
+static uint32_t sentLen;
+static uint32_t sentCalls;
+static uint32_t sendErrors;
+
+
+static void onSent(uint16_t len)
+{
+  sentLen += len;
+  sentCalls++;
+}
+
+
+static void onSendError(void)
+{
+  sendErrors++;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static ModemSim_Link_t* link(void)
+{
+  return &sim.links[sock.linkNum];
+}
+
+
+static void setUp(uint16_t mtu)
+{
+  memset(&sock, 0, sizeof(sock));
+  sentLen = 0;
+  sentCalls = 0;
+  sendErrors = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.config.autoReconnect = 1;
+  sock.config.mtu = mtu;
+  sock.listeners.onSent = onSent;
+  sock.listeners.onSendError = onSendError;
+  SIM_SOCK_SetBuffer(&sock, rxBuffer, sizeof(rxBuffer));
+  SIM_SOCK_SetTxBuffer(&sock, txBuffer, sizeof(txBuffer));
+  CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  Harness_Run(&hsim, 100);
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testSmallWritesCoalesce(void)
+{
+  uint8_t msg[32];
+
+  setUp(0);
+  for (int i = 0; i < 10; i++) {
+    memset(msg, 'a' + i, sizeof(msg));
+    CHECK_EQ(SIM_SOCK_Write(&sock, msg, sizeof(msg)), sizeof(msg));
+  }
+  Harness_Run(&hsim, 500);
+
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND="), 1);
+  CHECK_EQ(link()->txLen, 10 * sizeof(msg));
+  CHECK_EQ(link()->tx[10 * sizeof(msg) - 1], 'j');
+  CHECK_EQ(sentLen, 10 * sizeof(msg));
+  CHECK_EQ(sendErrors, 0);
+  Harness_Free();
+}
+
+
+static void testSplitByMTU(void)
+{
+  uint8_t data[250];
+
+  setUp(100);
+  for (int i = 0; i < (int) sizeof(data); i++) data[i] = (uint8_t) i;
+  CHECK_EQ(SIM_SOCK_Write(&sock, data, sizeof(data)), sizeof(data));
+  Harness_Run(&hsim, 1000);
+
+  // one CIPSEND in flight at a time, next one after +CIPSEND
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND="), 3);
+  CHECK_EQ(link()->txLen, sizeof(data));
+  CHECK_MEM(link()->tx, data, sizeof(data));
+  CHECK_EQ(sentCalls, 3);
+  CHECK_EQ(sentLen, sizeof(data));
+  Harness_Free();
+}
+
+
+static void testBlockingSendWaitsForQueue(void)
+{
+  const uint8_t queued[] = "queued";
+  const uint8_t direct[] = "direct";
+
+  setUp(0);
+  sim.delay.sendAck = 500;
+  CHECK_EQ(SIM_SOCK_Write(&sock, queued, 6), 6);
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(sock.tx.inFlight, 6);
+
+  // would wait for the +CIPSEND of the queued chunk
+  CHECK_EQ(SIM_SOCK_SendData(&sock, direct, 6), 0);
+
+  Harness_Run(&hsim, 1000);
+  CHECK_EQ(sentLen, 6);
+  CHECK_EQ(SIM_SOCK_SendData(&sock, direct, 6), 6);
+  CHECK_EQ(link()->txLen, 12);
+  CHECK_MEM(link()->tx, "queueddirect", 12);
+  CHECK_EQ(sentCalls, 1);
+  Harness_Free();
+}
+
+
+static void testWaitsForLongCommand(void)
+{
+  setUp(0);
+  // operator selection holds the modem
+  ModemSim_On(&sim, "AT+COPS=0", 10000, 1, "\r\nOK\r\n");
+  CHECK_EQ(SIM_SendCMDAsync(&hsim, NULL, 0, NULL, 0, SIM_COPS_TIMEOUT, NULL, NULL, "AT+COPS=0"), SIM_OK);
+  Harness_Run(&hsim, 100);
+  CHECK(SIM_CmdQueueIsBusy(&hsim));
+
+  ModemSim_PeerSend(&sim, sock.linkNum, (const uint8_t*) "ping", 4);
+  CHECK_EQ(SIM_SOCK_Write(&sock, (const uint8_t*) "hello", 5), 5);
+  Harness_Run(&hsim, 5000);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND"), 0);
+  CHECK_EQ(sendErrors, 0);
+  CHECK(isSockOpen(&hsim));
+
+  // sent right after, without waiting for a timer
+  Harness_Run(&hsim, 5000);
+  CHECK(!SIM_CmdQueueIsBusy(&hsim));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND"), 1);
+  CHECK_EQ(sentLen, 5);
+  CHECK_MEM(link()->tx, "hello", 5);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testSmallWritesCoalesce);
+  RUN(testSplitByMTU);
+  RUN(testBlockingSendWaitsForQueue);
+  RUN(testWaitsForLongCommand);
+  return testFailed != 0;
+}
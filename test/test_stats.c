@@ -0,0 +1,74 @@
+/*
+ * test_stats.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/stats.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static void setUp(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 2000);
+  SIM_Stats_Reset(&hsim);
+}
+
+
+static void testLatency(void)
+{
+  const SIM_CmdStats_t *stats;
+
+  setUp();
+  sim.delay.cmd = 20;
+  for (int i = 0; i < 10; i++) CHECK(SIM_CheckSignal(&hsim));
+
+  stats = SIM_Stats_Get(&hsim, "AT+CSQ");
+  CHECK(stats != NULL);
+  if (stats == NULL) return;
+  CHECK_EQ(stats->count, 10);
+  CHECK_EQ(stats->timeouts, 0);
+  CHECK_EQ(stats->maxTime, 20);
+  CHECK_EQ(stats->totalTime, 200);
+  // 8..32 ms bucket
+  CHECK_EQ(stats->histogram[1], 10);
+  CHECK_EQ(stats->bytesTx, 10 * strlen("AT+CSQ"));
+  Harness_Free();
+}
+
+
+static void testOutcomes(void)
+{
+  const SIM_CmdStats_t *stats;
+  char snapshot[512];
+
+  setUp();
+  sim.simReady = 0;
+  CHECK(!SIM_CheckSIMCard(&hsim));
+  stats = SIM_Stats_Get(&hsim, "AT+CPIN");
+  CHECK(stats != NULL && stats->errors == 1 && stats->lastErrCode == 10);
+
+  // answer comes after the driver gave up
+  ModemSim_On(&sim, "AT+CCLK", hsim.timeout + 1000, 1, "\r\n+CCLK: \"26/10/17,09:00:00+28\"\r\n\r\nOK\r\n");
+  SIM_GetTime(&hsim);
+  stats = SIM_Stats_Get(&hsim, "AT+CCLK");
+  CHECK(stats != NULL && stats->timeouts == 1);
+
+  CHECK(SIM_Stats_Snapshot(&hsim, snapshot, sizeof(snapshot)) > 0);
+  CHECK(strstr(snapshot, "AT+CPIN n=1") != NULL);
+  CHECK(strstr(snapshot, "AT+CCLK n=1 to=1") != NULL);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testLatency);
+  RUN(testOutcomes);
+  return testFailed != 0;
+}
@@ -0,0 +1,186 @@
+/*
+ * test_stream.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/utils.h"
+#include "simcom/socket.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+
+static uint8_t sockBuffer[256];
+static uint8_t received[4096];
+static uint32_t receivedLen;
+static uint32_t closed;
+static uint8_t isBuffered;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+}
+
+
+static void onReceived(Buffer_t *buffer)
+{
+  uint16_t len;
+
+  do {
+    len = Buffer_Read(buffer, &received[receivedLen % sizeof(received)], 64);
+    receivedLen += len;
+  } while (len);
+}
+
+
+static void onClosed(void)
+{
+  closed++;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static void setUp(void)
+{
+  memset(&sock, 0, sizeof(sock));
+  receivedLen = 0;
+  closed = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.config.autoReconnect = 1;
+  if (isBuffered) {
+    SIM_SOCK_SetBuffer(&sock, sockBuffer, sizeof(sockBuffer));
+    sock.listeners.onReceived = onReceived;
+  }
+  else {
+    sock.listeners.onData = onData;
+  }
+  sock.listeners.onClosed = onClosed;
+  CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  Harness_Run(&hsim, 100);
+  CHECK(sim.isStream);
+  CHECK(SIM_IsDataMode(&hsim));
+  ModemSim_ClearLog(&sim);
+}
+
+
+static void testRawPipe(void)
+{
+  uint8_t data[1000];
+  const char reply[] = "HTTP/1.1 200 OK\r\n\r\nOK\r\n";
+
+  setUp();
+  for (int i = 0; i < (int) sizeof(data); i++) data[i] = (uint8_t) ('a' + i % 26);
+  CHECK_EQ(SIM_SOCK_Write(&sock, data, sizeof(data)), sizeof(data));
+  CHECK_EQ(SIM_SOCK_SendData(&sock, data, 10), 10);
+  Harness_Run(&hsim, 100);
+
+  // no AT framing around the payload
+  CHECK_EQ(sim.links[0].txLen, sizeof(data) + 10);
+  CHECK_MEM(sim.links[0].tx, data, sizeof(data));
+  CHECK_EQ(sim.logLen, 0);
+
+  // response-like bytes are payload while online
+  ModemSim_PeerSend(&sim, 0, (const uint8_t*) reply, strlen(reply));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, strlen(reply));
+  CHECK_MEM(received, reply, strlen(reply));
+  Harness_Free();
+}
+
+
+static void testBulkReceive(void)
+{
+  uint8_t data[3000];
+
+  setUp();
+  for (int i = 0; i < (int) sizeof(data); i++) data[i] = (uint8_t) i;
+
+  // more than the RX buffer arrives between two passes
+  ModemSim_PeerSend(&sim, 0, data, sizeof(data));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, sizeof(data));
+  CHECK_MEM(received, data, sizeof(data));
+  CHECK(SIM_IsDataMode(&hsim));
+  Harness_Free();
+
+  // and through a socket buffer smaller than that
+  isBuffered = 1;
+  setUp();
+  ModemSim_PeerSend(&sim, 0, data, sizeof(data));
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, sizeof(data));
+  CHECK_MEM(received, data, sizeof(data));
+  isBuffered = 0;
+  Harness_Free();
+}
+
+
+static void testEscapeAndResume(void)
+{
+  setUp();
+  CHECK_EQ(SIM_SOCK_Escape(&sock), SIM_OK);
+  CHECK(!SIM_IsDataMode(&hsim));
+  CHECK(!sim.isStream);
+
+  // AT works while the link stays open, payload does not go out
+  sim.csq = 11;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 11);
+  CHECK_EQ(SIM_SOCK_Write(&sock, (const uint8_t*) "x", 1), 0);
+  CHECK(isSockOpen(&hsim));
+
+  CHECK_EQ(SIM_SOCK_Resume(&sock), SIM_OK);
+  CHECK(SIM_IsDataMode(&hsim));
+  CHECK_EQ(SIM_SOCK_Write(&sock, (const uint8_t*) "after", 5), 5);
+  CHECK_EQ(sim.links[0].txLen, 5);
+  CHECK_MEM(sim.links[0].tx, "after", 5);
+  Harness_Free();
+}
+
+
+static void testPeerClose(void)
+{
+  setUp();
+  ModemSim_PeerSend(&sim, 0, (const uint8_t*) "bye", 3);
+  ModemSim_PeerClose(&sim, 0);
+  Harness_Run(&hsim, 100);
+
+  // CLOSED trailer is not payload
+  CHECK_EQ(receivedLen, 3);
+  CHECK_MEM(received, "bye", 3);
+  CHECK_EQ(closed, 1);
+  CHECK(!SIM_IsDataMode(&hsim));
+
+  sim.csq = 8;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 8);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testRawPipe);
+  RUN(testBulkReceive);
+  RUN(testEscapeAndResume);
+  RUN(testPeerClose);
+  return testFailed != 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * test_threads.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+#include <pthread.h>
+
+/*
+ * Several modems, each driven by its own thread on its own virtual clock.
+ * The driver keeps all state in the handle, so nothing a thread parses or
+ * sends may show up on another modem.
+ */
+
+#define NUM_OF_MODEM  8
+#define ROUNDS        3000
+#define RX_LEN        32
+#define TX_LEN        16
+
+typedef struct {
+  uint8_t             id;
+  ModemSim_t          sim;
+  SIM_HandlerTypeDef  hsim;
+  SIM_Socket_t        sock;
+  uint8_t             rx[ROUNDS * RX_LEN];
+  uint32_t            rxLen;
+  uint32_t            failed;
+} Modem_t;
+
+static Modem_t modems[NUM_OF_MODEM];
+static __thread Modem_t *self;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (self->rxLen + len <= sizeof(self->rx))
+    memcpy(&self->rx[self->rxLen], data, len);
+  self->rxLen += len;
+}
+
+
+static void run(Modem_t *m, uint32_t ms)
+{
+  uint32_t end = ModemSim_Tick() + ms;
+
+  while ((int32_t)(ModemSim_Tick() - end) < 0) {
+    SIM_CheckAnyResponse(&m->hsim);
+    ModemSim_Delay(1);
+  }
+}
+
+
+static uint8_t runUntilOpen(Modem_t *m, uint32_t ms)
+{
+  uint32_t end = ModemSim_Tick() + ms;
+
+  while (!SIM_SOCK_IS_STATE(&m->sock, SIM_SOCK_STATE_OPEN)) {
+    if ((int32_t)(ModemSim_Tick() - end) >= 0) return 0;
+    run(m, 10);
+  }
+  return 1;
+}
+
+
+static void *modemTask(void *arg)
+{
+  Modem_t *m = (Modem_t*) arg;
+  SIM_HandlerTypeDef *hsim = &m->hsim;
+  uint8_t expect[RX_LEN];
+  uint8_t data[TX_LEN];
+  ModemSim_Link_t *link;
+  char host[16];
+
+  self = m;
+  ModemSim_Init(&m->sim);
+  ModemSim_SetTick(0x1000 + m->id * 7777);
+  hsim->delay             = ModemSim_Delay;
+  hsim->getTick           = ModemSim_Tick;
+  hsim->serial.device     = &m->sim;
+  hsim->serial.isReadable = ModemSim_IsReadable;
+  hsim->serial.read       = ModemSim_Read;
+  hsim->serial.write      = ModemSim_Write;
+  hsim->serial.writeline  = ModemSim_Writeline;
+  SIM_Init(hsim);
+  SIM_SetAPN(hsim, "internet", "", "");
+  ModemSim_PowerOn(&m->sim);
+
+  sprintf(host, "10.0.0.%u", m->id);
+  m->sock.config.autoReconnect = 1;
+  m->sock.listeners.onData = onData;
+  SIM_SOCK_Init(&m->sock, host, (uint16_t) (8000 + m->id));
+  SIM_SOCK_Open(&m->sock, hsim);
+  if (!runUntilOpen(m, 60000)) {
+    m->failed++;
+    return NULL;
+  }
+  link = &m->sim.links[m->sock.linkNum];
+
+  for (int r = 0; r < ROUNDS; r++) {
+    // response parsed into this handle only
+    m->sim.csq = (uint8_t) ((m->id * 7 + r) % 30 + 1);
+    if (!SIM_CheckSignal(hsim) || hsim->signal != m->sim.csq) m->failed++;
+
+    memset(expect, m->id, sizeof(expect));
+    expect[0] = (uint8_t) r;
+    ModemSim_PeerSend(&m->sim, m->sock.linkNum, expect, sizeof(expect));
+    run(m, 5);
+
+    memset(data, 'a' + m->id, sizeof(data));
+    if (SIM_SOCK_SendData(&m->sock, data, sizeof(data)) != sizeof(data)) m->failed++;
+  }
+  run(m, 100);
+
+  if (m->rxLen != sizeof(m->rx)) m->failed++;
+  for (int r = 0; r < ROUNDS && m->rxLen == sizeof(m->rx); r++) {
+    memset(expect, m->id, sizeof(expect));
+    expect[0] = (uint8_t) r;
+    if (memcmp(&m->rx[r * RX_LEN], expect, RX_LEN) != 0) m->failed++;
+  }
+  if (link->txLen != ROUNDS * TX_LEN) m->failed++;
+  for (uint32_t i = 0; i < link->txLen; i++)
+    if (link->tx[i] != 'a' + m->id) {
+      m->failed++;
+      break;
+    }
+
+  ModemSim_Free(&m->sim);
+  return NULL;
+}
+
+
+static void testConcurrentModems(void)
+{
+  pthread_t threads[NUM_OF_MODEM];
+
+  memset(modems, 0, sizeof(modems));
+  for (int i = 0; i < NUM_OF_MODEM; i++) {
+    modems[i].id = (uint8_t) (i + 1);
+    CHECK_EQ(pthread_create(&threads[i], NULL, modemTask, &modems[i]), 0);
+  }
+  for (int i = 0; i < NUM_OF_MODEM; i++)
+    pthread_join(threads[i], NULL);
+
+  for (int i = 0; i < NUM_OF_MODEM; i++) {
+    CHECK_EQ(modems[i].failed, 0);
+    CHECK_EQ(modems[i].rxLen, ROUNDS * RX_LEN);
+    CHECK_EQ(modems[i].hsim.signal, (modems[i].id * 7 + ROUNDS - 1) % 30 + 1);
+  }
+}
+
+
+int main(void)
+{
+  RUN(testConcurrentModems);
+  return testFailed != 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * test_tls.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t tls[SIM_NUM_OF_TLS + 1];
+static SIM_Socket_t tcp[SIM_NUM_OF_SOCKET];
+static uint8_t txBuffer[256];
+
+static uint8_t received[64];
+static uint32_t receivedLen;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+}
+
+
+static uint8_t isTLSOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&tls[0], SIM_SOCK_STATE_OPEN);
+}
+
+
+static void setUp(void)
+{
+  memset(tls, 0, sizeof(tls));
+  memset(tcp, 0, sizeof(tcp));
+  receivedLen = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+}
+
+
+static SIM_Status_t openTLS(SIM_Socket_t *sock)
+{
+  sock->config.autoReconnect = 1;
+  sock->listeners.onData = onData;
+  CHECK_EQ(SIM_SOCK_InitTLS(sock, "secure.example.com", 443, NULL), SIM_OK);
+  return SIM_SOCK_Open(sock, &hsim);
+}
+
+
+static void openTCP(SIM_Socket_t *sock)
+{
+  sock->config.autoReconnect = 1;
+  sock->listeners.onData = onData;
+  CHECK_EQ(SIM_SOCK_Init(sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(sock, &hsim);
+}
+
+
+static void testLinksStayFree(void)
+{
+  setUp();
+  openTLS(&tls[0]);
+  CHECK(Harness_RunUntil(&hsim, isTLSOpen, 20000));
+  CHECK_EQ(tls[0].session, 0);
+  CHECK(hsim.net.tls.sockets[0] == (void*) &tls[0]);
+  for (int i = 0; i < SIM_NUM_OF_SOCKET; i++)
+    CHECK(hsim.net.sockets[i] == NULL);
+
+  // every link is left for CIPOPEN
+  for (int i = 0; i < SIM_NUM_OF_SOCKET; i++) {
+    openTCP(&tcp[i]);
+    CHECK_EQ(tcp[i].linkNum, i);
+    CHECK(hsim.net.sockets[i] == (void*) &tcp[i]);
+  }
+  Harness_Run(&hsim, 5000);
+  for (int i = 0; i < SIM_NUM_OF_SOCKET; i++)
+    CHECK(SIM_SOCK_IS_STATE(&tcp[i], SIM_SOCK_STATE_OPEN));
+  CHECK(isTLSOpen(&hsim));
+  Harness_Free();
+}
+
+
+static void testSessionData(void)
+{
+  setUp();
+  SIM_SOCK_SetTxBuffer(&tls[0], txBuffer, sizeof(txBuffer));
+  openTLS(&tls[0]);
+  CHECK(Harness_RunUntil(&hsim, isTLSOpen, 20000));
+  ModemSim_ClearLog(&sim);
+
+  CHECK_EQ(SIM_SOCK_Write(&tls[0], (const uint8_t*) "hello", 5), 5);
+  Harness_Run(&hsim, 500);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CCHSEND=0,5"), 1);
+  CHECK_EQ(sim.sessions[0].txLen, 5);
+  CHECK_MEM(sim.sessions[0].tx, "hello", 5);
+
+  ModemSim_SessionSend(&sim, 0, (const uint8_t*) "world", 5);
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, 5);
+  CHECK_MEM(received, "world", 5);
+  Harness_Free();
+}
+
+
+static void testSessionsLimit(void)
+{
+  setUp();
+  for (int i = 0; i < SIM_NUM_OF_TLS; i++) {
+    openTLS(&tls[i]);
+    CHECK_EQ(tls[i].session, i);
+  }
+  // modem has no more CCH sessions
+  CHECK_EQ(openTLS(&tls[SIM_NUM_OF_TLS]), SIM_ERROR);
+  CHECK_EQ(tls[SIM_NUM_OF_TLS].session, -1);
+
+  Harness_Run(&hsim, 20000);
+  for (int i = 0; i < SIM_NUM_OF_TLS; i++)
+    CHECK(SIM_SOCK_IS_STATE(&tls[i], SIM_SOCK_STATE_OPEN));
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CCHSTART"), 1);
+  Harness_Free();
+}
+
+
+static void testReconnectKeepsSession(void)
+{
+  setUp();
+  openTLS(&tls[0]);
+  CHECK(Harness_RunUntil(&hsim, isTLSOpen, 20000));
+  ModemSim_ClearLog(&sim);
+
+  ModemSim_SessionClose(&sim, 0);
+  Harness_Run(&hsim, 100);
+  CHECK(!isTLSOpen(&hsim));
+
+  // service started and context configured already, only handshake again
+  CHECK(Harness_RunUntil(&hsim, isTLSOpen, 20000));
+  CHECK_EQ(tls[0].session, 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CCHOPEN=0,"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CCHSTART"), 0);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CSSLCFG"), 0);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testLinksStayFree);
+  RUN(testSessionData);
+  RUN(testSessionsLimit);
+  RUN(testReconnectKeepsSession);
+  return testFailed != 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * test_tokenizer.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+
+
+static uint8_t tokenize(SIM_Tokens_t *tokens, const char *str)
+{
+  return SIM_Tokenize(tokens, (const uint8_t*) str, strlen(str), ',');
+}
+
+
+static void testFields(void)
+{
+  SIM_Tokens_t tokens;
+  char str[16];
+
+  CHECK_EQ(tokenize(&tokens, "1,\"a,b\",,-42,+7\r\n"), 5);
+  CHECK_EQ(SIM_TokenInt(&tokens, 0), 1);
+  CHECK(SIM_TokenIsQuoted(&tokens, 1));
+  CHECK(SIM_TokenIs(&tokens, 1, "a,b", 3));
+  CHECK_EQ(SIM_TokenLen(&tokens, 2), 0);
+  CHECK_EQ(SIM_TokenInt(&tokens, 3), -42);
+  CHECK_EQ(SIM_TokenInt(&tokens, 4), 7);
+  // out of range reads as empty
+  CHECK_EQ(SIM_TokenInt(&tokens, 9), 0);
+  CHECK_EQ(SIM_TokenLen(&tokens, 9), 0);
+
+  CHECK_EQ(SIM_TokenCopy(&tokens, 1, str, sizeof(str)), 3);
+  CHECK(strcmp(str, "a,b") == 0);
+  CHECK_EQ(SIM_TokenCopy(&tokens, 1, str, 2), 1);
+  CHECK(strcmp(str, "a") == 0);
+}
+
+
+static void testHexAndRegStat(void)
+{
+  SIM_Tokens_t tokens;
+  uint16_t lac = 0;
+  uint32_t ci = 0;
+
+  // +CREG: <n>,<stat>,<lac>,<ci> answer of AT+CREG?
+  tokenize(&tokens, "2,5,\"1A2B\",\"0c3d4e5f\"");
+  CHECK_EQ(SIM_TokenRegStat(&tokens, &lac, &ci), 5);
+  CHECK_EQ(lac, 0x1A2B);
+  CHECK_EQ(ci, 0x0C3D4E5F);
+
+  // +CREG: <stat>,<lac>,<ci> URC
+  lac = 0;
+  tokenize(&tokens, "1,\"00FF\",\"10\"");
+  CHECK_EQ(SIM_TokenRegStat(&tokens, &lac, &ci), 1);
+  CHECK_EQ(lac, 0xFF);
+  CHECK_EQ(ci, 0x10);
+
+  tokenize(&tokens, "2,0");
+  CHECK_EQ(SIM_TokenRegStat(&tokens, NULL, NULL), 0);
+}
+
+
+static void testTooManyFields(void)
+{
+  SIM_Tokens_t tokens;
+
+  CHECK_EQ(tokenize(&tokens, "0,1,2,3,4,5,6,7,8,9,10,11,12,13,14"), SIM_MAX_TOKENS);
+  CHECK_EQ(SIM_TokenInt(&tokens, SIM_MAX_TOKENS - 1), SIM_MAX_TOKENS - 1);
+}
+
+
+static void testResponses(void)
+{
+  SIM_Datetime dt;
+
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+
+  // +CCLK: "yy/MM/dd,hh:mm:ss+zz"
+  dt = SIM_GetTime(&hsim);
+  CHECK_EQ(dt.year, 26);
+  CHECK_EQ(dt.month, 10);
+  CHECK_EQ(dt.day, 17);
+  CHECK_EQ(dt.hour, 9);
+
+  sim.csq = 31;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(hsim.signal, 31);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testFields);
+  RUN(testHexAndRegStat);
+  RUN(testTooManyFields);
+  RUN(testResponses);
+  return testFailed != 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * test_trace.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/trace.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_HandlerTypeDef replayed;
+static SIM_TraceReplay_t replay;
+
+typedef struct {
+  uint8_t   data[65536];
+  uint32_t  len;
+} Capture_t;
+
+static Capture_t recorded;
+static Capture_t rerecorded;
+
+
+static void captureOutput(void *ctx, const uint8_t *data, uint16_t len)
+{
+  Capture_t *capture = (Capture_t*) ctx;
+
+  if (capture->len + len > sizeof(capture->data)) return;
+  memcpy(&capture->data[capture->len], data, len);
+  capture->len += len;
+}
+
+
+static uint32_t replayTick(void)
+{
+  return SIM_TraceReplay_GetTick(&replay);
+}
+
+
+static void replayDelay(uint32_t ms)
+{
+  SIM_TraceReplay_Delay(&replay, ms);
+}
+
+
+static uint32_t varint(const uint8_t *data, uint32_t *pos)
+{
+  uint32_t value = 0;
+  uint8_t shift = 0;
+
+  while (data[*pos] & 0x80) {
+    value |= (uint32_t) (data[(*pos)++] & 0x7F) << shift;
+    shift += 7;
+  }
+  return value | ((uint32_t) data[(*pos)++] << shift);
+}
+
+
+/*
+ * concatenated payload of the TX records, what the driver wrote
+ */
+static uint32_t txOf(const Capture_t *capture, uint8_t *dst, uint32_t size)
+{
+  uint32_t pos = 5;
+  uint32_t out = 0;
+  uint32_t len;
+  uint8_t type;
+
+  while (pos < capture->len) {
+    type = capture->data[pos++];
+    varint(capture->data, &pos);
+    len = varint(capture->data, &pos);
+    if (type != SIM_TRACE_RX && out + len + 1 <= size) {
+      memcpy(&dst[out], &capture->data[pos], len);
+      out += len;
+      dst[out++] = '\n';
+    }
+    pos += len;
+  }
+  return out;
+}
+
+
+static void testRecordAndReplay(void)
+{
+  static SIM_TraceRecorder_t rec;
+  static SIM_TraceRecorder_t rerec;
+  static uint8_t tx1[16384];
+  static uint8_t tx2[16384];
+  uint32_t len1;
+  uint32_t len2;
+
+  // live session against the simulator
+  Harness_Init(&hsim);
+  rec.ctx = &recorded;
+  rec.output = captureOutput;
+  SIM_Trace_Attach(&rec, &hsim);
+  // only the event loop talks to the modem, replay runs nothing else
+  CHECK(Harness_BringUp(&hsim));
+  Harness_Run(&hsim, 2000);
+  SIM_Trace_Detach(&rec, &hsim);
+  CHECK(hsim.serial.device == &sim);
+
+  // same driver fed by the trace alone, its writes traced again
+  memset(&replayed, 0, sizeof(replayed));
+  CHECK_EQ(SIM_TraceReplay_Init(&replay, recorded.data, recorded.len), SIM_OK);
+  replayed.getTick = replayTick;
+  replayed.delay = replayDelay;
+  replayed.NTP = hsim.NTP;
+  SIM_TraceReplay_Attach(&replay, &replayed);
+  rerec.ctx = &rerecorded;
+  rerec.output = captureOutput;
+  SIM_Trace_Attach(&rerec, &replayed);
+  CHECK_EQ(SIM_Init(&replayed), SIM_OK);
+  SIM_TraceReplay_Run(&replay, &replayed);
+
+  CHECK_EQ(replayed.bringUp.state, SIM_STATE_READY);
+  CHECK(replayed.status & SIM_STATUS_REGISTERED);
+  CHECK_EQ(replayed.cell.lac, hsim.cell.lac);
+
+  len1 = txOf(&recorded, tx1, sizeof(tx1));
+  len2 = txOf(&rerecorded, tx2, sizeof(tx2));
+  CHECK(len1 > 0);
+  CHECK(len2 >= len1);
+  CHECK_MEM(tx1, tx2, len1);
+  Harness_Free();
+}
+
+
+static void testBadHeader(void)
+{
+  static const uint8_t bad[] = {'S', 'I', 'M', 'X', SIM_TRACE_VERSION};
+
+  CHECK_EQ(SIM_TraceReplay_Init(&replay, bad, sizeof(bad)), SIM_ERROR);
+  CHECK_EQ(SIM_TraceReplay_Init(&replay, bad, 3), SIM_ERROR);
+}
+
+
+int main(void)
+{
+  RUN(testRecordAndReplay);
+  RUN(testBadHeader);
+  return testFailed != 0;
+}
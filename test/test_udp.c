@@ -0,0 +1,140 @@
+/*
+ * test_udp.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/net.h"
+#include "simcom/socket.h"
+
+static SIM_HandlerTypeDef hsim;
+static SIM_Socket_t sock;
+static uint8_t txBuffer[512];
+
+static uint8_t received[64];
+static uint32_t receivedLen;
+static uint32_t sentCalls;
+
+
+static void onData(const uint8_t *data, uint16_t len)
+{
+  if (receivedLen + len <= sizeof(received))
+    memcpy(&received[receivedLen], data, len);
+  receivedLen += len;
+}
+
+
+static void onSent(uint16_t len)
+{
+  (void) len;
+  sentCalls++;
+}
+
+
+static uint8_t isSockOpen(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  return SIM_SOCK_IS_STATE(&sock, SIM_SOCK_STATE_OPEN);
+}
+
+
+static void setUp(uint8_t type)
+{
+  memset(&sock, 0, sizeof(sock));
+  receivedLen = 0;
+  sentCalls = 0;
+
+  Harness_Init(&hsim);
+  SIM_SetAPN(&hsim, "internet", "", "");
+  CHECK(Harness_BringUp(&hsim));
+
+  sock.config.autoReconnect = 1;
+  sock.listeners.onData = onData;
+  sock.listeners.onSent = onSent;
+  SIM_SOCK_SetTxBuffer(&sock, txBuffer, sizeof(txBuffer));
+  if (type == SIM_SOCK_UDP)
+    CHECK_EQ(SIM_SOCK_InitUDP(&sock, "10.0.0.1", 9000, 4000), SIM_OK);
+  else
+    CHECK_EQ(SIM_SOCK_Init(&sock, "example.com", 80), SIM_OK);
+  SIM_SOCK_Open(&sock, &hsim);
+  CHECK(Harness_RunUntil(&hsim, isSockOpen, 20000));
+  Harness_Run(&hsim, 100);
+}
+
+
+static void testSourceOnlyForUDP(void)
+{
+  setUp(SIM_SOCK_TCPIP);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSRIP"), 0);
+  CHECK(!sim.srip);
+  Harness_Free();
+}
+
+
+static void testReceiveFrom(void)
+{
+  setUp(SIM_SOCK_UDP);
+  CHECK(sim.links[sock.linkNum].isUDP);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSRIP=1"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN=0,\"UDP\",,,4000"), 1);
+
+  ModemSim_PeerSend(&sim, sock.linkNum, (const uint8_t*) "ping", 4);
+  Harness_Run(&hsim, 100);
+  CHECK_EQ(receivedLen, 4);
+  CHECK_MEM(received, "ping", 4);
+  CHECK(strcmp(sock.remote.host, "10.1.2.3") == 0);
+  CHECK_EQ(sock.remote.port, 5000);
+  Harness_Free();
+}
+
+
+static void testQueuedDatagrams(void)
+{
+  setUp(SIM_SOCK_UDP);
+  ModemSim_ClearLog(&sim);
+
+  CHECK_EQ(SIM_SOCK_Write(&sock, (const uint8_t*) "one", 3), 3);
+  CHECK_EQ(SIM_SOCK_WriteTo(&sock, "10.0.0.2", 9001, (const uint8_t*) "two", 3), 3);
+  CHECK_EQ(SIM_SOCK_Write(&sock, (const uint8_t*) "three", 5), 5);
+  Harness_Run(&hsim, 500);
+
+  // boundaries and remotes kept, one CIPSEND each
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND=0,3,\"10.0.0.1\",9000"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND=0,3,\"10.0.0.2\",9001"), 1);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPSEND=0,5,\"10.0.0.1\",9000"), 1);
+  CHECK_EQ(sim.links[sock.linkNum].sends, 3);
+  CHECK_EQ(sim.links[sock.linkNum].txLen, 11);
+  CHECK_MEM(sim.links[sock.linkNum].tx, "onetwothree", 11);
+  CHECK_EQ(sentCalls, 3);
+  Harness_Free();
+}
+
+
+static void testOpenWithoutReconnect(void)
+{
+  SIM_Socket_t single;
+
+  setUp(SIM_SOCK_TCPIP);
+  memset(&single, 0, sizeof(single));
+  single.listeners.onData = onData;
+  CHECK_EQ(SIM_SOCK_InitUDP(&single, "10.0.0.1", 9000, 4001), SIM_OK);
+
+  // no slot is taken, open must not touch one
+  CHECK_EQ(SIM_SOCK_Open(&single, &hsim), SIM_OK);
+  CHECK(single.hsim == &hsim);
+  CHECK_EQ(ModemSim_Count(&sim, "AT+CIPOPEN=1,\"UDP\",,,4001"), 1);
+  CHECK(hsim.net.sockets[1] == NULL);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testSourceOnlyForUDP);
+  RUN(testReceiveFrom);
+  RUN(testQueuedDatagrams);
+  RUN(testOpenWithoutReconnect);
+  return testFailed != 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * test_urc.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+#include "simcom/utils.h"
+
+static SIM_HandlerTypeDef hsim;
+static int ringCount;
+static int declined;
+static int fallback;
+
+
+static uint8_t urcRing(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  ringCount++;
+  return 1;
+}
+
+
+// first handler of the bucket lets the line through
+static uint8_t urcDecline(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  declined++;
+  return 0;
+}
+
+
+static uint8_t urcFallback(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  fallback++;
+  return 1;
+}
+
+
+static void testDispatch(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+  ringCount = declined = fallback = 0;
+
+  CHECK_EQ(SIM_RegisterURC(&hsim, "RING", urcRing), SIM_OK);
+  CHECK_EQ(SIM_RegisterURC(&hsim, "+CMTI:", urcDecline), SIM_OK);
+  CHECK_EQ(SIM_RegisterURC(&hsim, "+CM", urcFallback), SIM_OK);
+
+  ModemSim_URC(&sim, 0, "RING");
+  ModemSim_URC(&sim, 0, "RINGING");
+  ModemSim_URC(&sim, 0, "+CMTI: \"SM\",1");
+  ModemSim_URC(&sim, 0, "+CMT");
+  ModemSim_URC(&sim, 0, "+XYZ: 1");
+  Harness_Run(&hsim, 100);
+
+  // prefix match, bucketed by char after '+'
+  CHECK_EQ(ringCount, 2);
+  CHECK_EQ(declined, 1);
+  CHECK_EQ(fallback, 2);
+  Harness_Free();
+}
+
+
+static void testBuiltinHandlers(void)
+{
+  Harness_Init(&hsim);
+  CHECK(Harness_BringUp(&hsim));
+
+  ModemSim_SetReg(&sim, 0);
+  Harness_Run(&hsim, 100);
+  CHECK(!(hsim.status & SIM_STATUS_REGISTERED));
+
+  ModemSim_SetReg(&sim, 1);
+  Harness_Run(&hsim, 100);
+  CHECK(hsim.status & SIM_STATUS_REGISTERED);
+  Harness_Free();
+}
+
+
+static void testTableLimits(void)
+{
+  Harness_Init(&hsim);
+  CHECK_EQ(SIM_Init(&hsim), SIM_OK);
+
+  CHECK_EQ(SIM_RegisterURC(&hsim, "", urcRing), SIM_ERROR);
+  while (hsim.urc.count < SIM_NUM_OF_URC)
+    CHECK_EQ(SIM_RegisterURC(&hsim, "RING", urcRing), SIM_OK);
+  CHECK_EQ(SIM_RegisterURC(&hsim, "RING", urcRing), SIM_ERROR);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testDispatch);
+  RUN(testBuiltinHandlers);
+  RUN(testTableLimits);
+  return testFailed != 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * test_wait.c
+ *
+ *  Created on: Oct 17, 2026
+ */
+
+#include "harness.h"
+#include "test.h"
+
+static SIM_HandlerTypeDef hsim;
+static int waits;
+static int notifies;
+static int delays;
+static uint32_t waitTimeout;
+
+
+// other task releases the driver while this one is blocked
+static void waitEvent(SIM_HandlerTypeDef *h, uint32_t timeout)
+{
+  waits++;
+  waitTimeout = timeout;
+  ModemSim_Delay(3);
+  h->status &= ~SIM_STATUS_CMD_RUNNING;
+}
+
+
+static void notifyEvent(SIM_HandlerTypeDef *h)
+{
+  (void) h;
+  notifies++;
+}
+
+
+static void countingDelay(uint32_t ms)
+{
+  delays++;
+  // other task gives the lock back after a few ticks
+  if (delays == 5) hsim.status &= ~SIM_STATUS_CMD_RUNNING;
+  ModemSim_Delay(ms);
+}
+
+
+static void testBlocksOnEvent(void)
+{
+  Harness_Init(&hsim);
+  hsim.waitEvent = waitEvent;
+  hsim.notifyEvent = notifyEvent;
+  CHECK(Harness_BringUp(&hsim));
+
+  waits = notifies = 0;
+  hsim.status |= SIM_STATUS_CMD_RUNNING;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(waits, 1);
+  CHECK_EQ(waitTimeout, hsim.timeout);
+  // unlock wakes waiters
+  CHECK(notifies >= 1);
+
+  notifies = 0;
+  Harness_Run(&hsim, 10);
+  CHECK(notifies >= 1);
+  Harness_Free();
+}
+
+
+static void testPollsWithoutHook(void)
+{
+  Harness_Init(&hsim);
+  hsim.delay = countingDelay;
+  CHECK(Harness_BringUp(&hsim));
+
+  delays = 0;
+  hsim.status |= SIM_STATUS_CMD_RUNNING;
+  CHECK(SIM_CheckSignal(&hsim));
+  CHECK_EQ(delays, 5);
+  Harness_Free();
+}
+
+
+int main(void)
+{
+  RUN(testBlocksOnEvent);
+  RUN(testPollsWithoutHook);
+  return testFailed != 0;
+}